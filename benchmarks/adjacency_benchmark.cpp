@@ -0,0 +1,184 @@
+/*
+ * Builds the adjacency info of a large grid mesh, split into bands of
+ * submeshes which each have their own vertices (so the borders have to be
+ * welded). Times a full rebuild, an incremental rebuild after one submesh
+ * changed, and the previous hash map based builder for comparison.
+ *
+ * Usage: adjacency_benchmark [grid_size] [submesh_count]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <tuple>
+#include <unordered_map>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+#include "simulant/meshes/adjacency_info.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+/* 708 x 708 quads is just over 1M triangles */
+static uint32_t grid_size = 708;
+static uint32_t submesh_count = 16;
+
+/* The previous implementation, which welds and pairs edges using hash maps */
+static std::size_t hash_map_adjacency(Mesh* mesh) {
+    typedef std::tuple<uint32_t, uint32_t> edge_pair;
+    typedef std::tuple<float, float, float> vec_tuple;
+    std::unordered_map<vec_tuple, uint32_t> position_map;
+    std::unordered_map<edge_pair, uint32_t> edge_triangles;
+
+    auto vertices = mesh->vertex_data.get();
+
+    auto weld = [&](uint32_t i) -> uint32_t {
+        auto v = vertices->position_at<Vec3>(i);
+        auto t = std::make_tuple(v.x, v.y, v.z);
+        return position_map.insert(std::make_pair(t, i)).first->second;
+    };
+
+    mesh->each([&](const std::string&, SubMeshPtr submesh) {
+        submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
+            a = weld(a);
+            b = weld(b);
+            c = weld(c);
+
+            edge_triangles.insert(std::make_pair(std::make_pair(a, b), c));
+            edge_triangles.insert(std::make_pair(std::make_pair(b, c), a));
+            edge_triangles.insert(std::make_pair(std::make_pair(c, a), b));
+        });
+    });
+
+    std::unordered_map<edge_pair, std::size_t> edge_lookup;
+    std::size_t edges = 0;
+    for(auto& p: edge_triangles) {
+        auto reversed = std::make_tuple(std::get<1>(p.first), std::get<0>(p.first));
+        if(!edge_lookup.count(reversed)) {
+            edge_lookup.insert(std::make_pair(p.first, edges++));
+        }
+    }
+
+    return edges;
+}
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        auto mesh = stage_->assets->mesh(
+            stage_->assets->new_mesh(VertexSpecification::POSITION_ONLY)
+        ).get();
+
+        build_grid(mesh);
+
+        uint32_t triangles = grid_size * grid_size * 2;
+        std::printf("%dx%d quads, %d triangles, %d submeshes\n", grid_size, grid_size, triangles, submesh_count);
+
+        AdjacencyInfo adjacency(mesh);
+
+        benchmark::run_throughput("rebuild: full", 5, triangles, "triangles", [&]() {
+            // Touching the vertices invalidates everything
+            mesh->vertex_data->done();
+            adjacency.rebuild();
+        });
+
+        auto first = mesh->first_submesh();
+        benchmark::run_throughput("rebuild: one submesh changed", 5, triangles, "triangles", [&]() {
+            first->index_data->done();
+            adjacency.rebuild();
+        });
+
+        std::size_t reference_edges = 0;
+        benchmark::run_throughput("rebuild: hash maps (previous)", 1, triangles, "triangles", [&]() {
+            reference_edges = hash_map_adjacency(mesh);
+        });
+
+        std::printf("%-40s %10d\n", "edges", (int) adjacency.edge_count());
+        std::printf("%-40s %10d\n", "edges (previous)", (int) reference_edges);
+    }
+
+    void update(float dt) {
+        window->stop_running();
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+
+    void build_grid(Mesh* mesh) {
+        auto vertices = mesh->vertex_data.get();
+
+        const uint32_t rows_per_band = (grid_size + submesh_count - 1) / submesh_count;
+
+        for(uint32_t band = 0; band * rows_per_band < grid_size; ++band) {
+            auto submesh = mesh->new_submesh(
+                "band" + std::to_string(band), MESH_ARRANGEMENT_TRIANGLES, INDEX_TYPE_32_BIT
+            );
+
+            const uint32_t first_row = band * rows_per_band;
+            const uint32_t last_row = std::min(grid_size, first_row + rows_per_band);
+            const uint32_t base = vertices->count();
+
+            // Each band has its own copy of the vertices along its edges
+            for(uint32_t z = first_row; z <= last_row; ++z) {
+                for(uint32_t x = 0; x <= grid_size; ++x) {
+                    vertices->position(float(x), 0.0f, float(z));
+                    vertices->move_next();
+                }
+            }
+
+            auto index = [=](uint32_t x, uint32_t z) {
+                return base + (z - first_row) * (grid_size + 1) + x;
+            };
+
+            auto indexes = submesh->index_data.get();
+            for(uint32_t z = first_row; z < last_row; ++z) {
+                for(uint32_t x = 0; x < grid_size; ++x) {
+                    indexes->index(index(x, z));
+                    indexes->index(index(x, z + 1));
+                    indexes->index(index(x + 1, z + 1));
+
+                    indexes->index(index(x, z));
+                    indexes->index(index(x + 1, z + 1));
+                    indexes->index(index(x + 1, z));
+                }
+            }
+            indexes->done();
+        }
+
+        vertices->done();
+    }
+};
+
+
+class AdjacencyBenchmark: public smlt::Application {
+public:
+    AdjacencyBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) grid_size = std::max(1, std::atoi(argv[1]));
+    if(argc > 2) submesh_count = std::max(1, std::atoi(argv[2]));
+
+    smlt::AppConfig config;
+    config.title = "Adjacency Benchmark";
+    config.fullscreen = false;
+    config.width = 640;
+    config.height = 480;
+
+    AdjacencyBenchmark app(config);
+    return app.run();
+}
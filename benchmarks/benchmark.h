@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * Minimal timing harness shared by the benchmark executables. Each benchmark
+ * prints one line per case so the output is easy to diff between runs.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <functional>
+
+namespace benchmark {
+
+/* Runs func `iterations` times (after one warm-up run) and returns the mean time in milliseconds */
+inline double run(const std::string& name, int iterations, std::function<void ()> func) {
+    func();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        func();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count() / double(iterations);
+    std::printf("%-40s %10.3f ms\n", name.c_str(), ms);
+    return ms;
+}
+
+/* Like run(), but also reports a throughput figure of `items` per iteration */
+inline double run_throughput(const std::string& name, int iterations, double items, const std::string& unit, std::function<void ()> func) {
+    double ms = run(name, iterations, func);
+    std::printf("%-40s %10.3f %s/ms\n", "", items / ms, unit.c_str());
+    return ms;
+}
+
+}
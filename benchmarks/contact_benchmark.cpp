@@ -0,0 +1,124 @@
+/*
+ * Drops a pile of boxes onto the ground and lets it settle, with a collision
+ * listener on every box. Times the simulation steps (which includes sending
+ * the contact events) once the pile is resting, when almost every contact
+ * is a stay.
+ *
+ * Usage: contact_benchmark [box_count] [steps]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static uint32_t box_count = 1000;
+static uint32_t steps = 300;
+
+/* Steps to let the pile settle before timing */
+const static uint32_t SETTLE_STEPS = 300;
+
+class CountingListener : public behaviours::CollisionListener {
+public:
+    void on_collision_enter(const behaviours::Collision& collision) override {
+        ++events;
+    }
+
+    void on_collision_stay() override {
+        ++events;
+    }
+
+    void on_collision_exit(const behaviours::Collision& collision) override {
+        ++events;
+    }
+
+    uint64_t events = 0;
+};
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        physics_ = behaviours::RigidBodySimulation::create(window->time_keeper);
+
+        auto ground = stage_->new_actor();
+        auto floor = ground->new_behaviour<behaviours::StaticBody>(physics_.get());
+        floor->add_box_collider(Vec3(100, 1, 100), behaviours::PhysicsMaterial::STONE);
+
+        const uint32_t side = std::max(1u, uint32_t(std::cbrt(float(box_count))));
+        for(uint32_t i = 0; i < box_count; ++i) {
+            uint32_t x = i % side;
+            uint32_t z = (i / side) % side;
+            uint32_t y = i / (side * side);
+
+            auto actor = stage_->new_actor();
+            actor->move_to(x * 1.01f, 1.0f + y * 1.01f, z * 1.01f);
+
+            auto body = actor->new_behaviour<behaviours::RigidBody>(physics_.get());
+            body->add_box_collider(Vec3(1, 1, 1), behaviours::PhysicsMaterial::WOOD);
+            body->register_collision_listener(&listener_);
+        }
+
+        const float step = 1.0f / 60.0f;
+        for(uint32_t i = 0; i < SETTLE_STEPS; ++i) {
+            physics_->fixed_update(step);
+        }
+
+        listener_.events = 0;
+
+        benchmark::run("step (resting pile)", steps, [&]() {
+            physics_->fixed_update(step);
+        });
+
+        std::printf("%-40s %10d\n", "boxes", (int) box_count);
+        std::printf("%-40s %10d\n", "contacts", (int) physics_->contact_count());
+        std::printf("%-40s %10.1f\n", "events per step", double(listener_.events) / double(steps + 1));
+    }
+
+    void update(float dt) {
+        window->stop_running();
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+    behaviours::PhysicsSimulationPtr physics_;
+    CountingListener listener_;
+};
+
+
+class ContactBenchmark: public smlt::Application {
+public:
+    ContactBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) box_count = std::max(1, std::atoi(argv[1]));
+    if(argc > 2) steps = std::max(1, std::atoi(argv[2]));
+
+    smlt::AppConfig config;
+    config.title = "Contact Benchmark";
+    config.fullscreen = false;
+    config.width = 640;
+    config.height = 480;
+
+    ContactBenchmark app(config);
+    return app.run();
+}
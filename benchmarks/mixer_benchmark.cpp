@@ -0,0 +1,108 @@
+/*
+ * Mixes a large number of one-shot effects with the software mixer in manual
+ * output mode. Times mixing at a few hardware voice limits, with half of the
+ * effects resampled from 22050Hz, and reports voices mixed per millisecond.
+ *
+ * Usage: mixer_benchmark [logical_voices] [frames_per_mix]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "simulant/simulant.h"
+#include "simulant/sound_drivers/mixer_sound_driver.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static uint32_t logical_voices = 500;
+static uint32_t frames_per_mix = 1024;
+
+const static uint32_t HARDWARE_VOICE_COUNTS[] = {16, 64, 256};
+
+static void run_case(uint32_t hardware_voices) {
+    MixerSoundDriver driver(nullptr, MIXER_OUTPUT_MANUAL, hardware_voices);
+    driver.startup();
+
+    // Ten seconds of noise so nothing runs out mid-benchmark
+    std::vector<int16_t> pcm(driver.sample_rate() * 10 * 2);
+    for(auto& s: pcm) {
+        s = int16_t((std::rand() % 2000) - 1000);
+    }
+
+    auto sources = driver.generate_sources(logical_voices);
+    for(uint32_t i = 0; i < logical_voices; ++i) {
+        const bool stereo = (i % 3 == 0);
+        const uint32_t rate = (i % 2) ? driver.sample_rate() / 2 : driver.sample_rate();
+
+        auto buffers = driver.generate_buffers(1);
+        driver.upload_buffer_data(
+            buffers[0],
+            (stereo) ? AUDIO_DATA_FORMAT_STEREO16 : AUDIO_DATA_FORMAT_MONO16,
+            &pcm[0], pcm.size() * sizeof(int16_t) / 4, rate
+        );
+
+        driver.queue_buffers_to_source(sources[i], 1, buffers);
+        driver.set_source_distance(sources[i], float(std::rand() % 100));
+        driver.play_source(sources[i]);
+    }
+
+    std::vector<int16_t> out(frames_per_mix * 2);
+
+    const uint32_t mixed = std::min(hardware_voices, logical_voices);
+    const std::string name = "mix: " + std::to_string(hardware_voices) + " hardware voices";
+
+    benchmark::run_throughput(name, 20, mixed, "voices", [&]() {
+        driver.mix(&out[0], frames_per_mix);
+    });
+
+    std::printf("%-40s %10d\n", "virtual voices", (int) driver.virtual_voice_count());
+}
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        std::printf("%d logical voices, %d frames per mix\n", logical_voices, frames_per_mix);
+
+        for(auto count: HARDWARE_VOICE_COUNTS) {
+            run_case(count);
+        }
+    }
+
+    void update(float dt) {
+        window->stop_running();
+    }
+};
+
+
+class MixerBenchmark: public smlt::Application {
+public:
+    MixerBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) logical_voices = std::atoi(argv[1]);
+    if(argc > 2) frames_per_mix = std::atoi(argv[2]);
+
+    smlt::AppConfig config;
+    config.title = "Mixer Benchmark";
+    config.fullscreen = false;
+    config.width = 640;
+    config.height = 480;
+
+    MixerBenchmark app(config);
+    return app.run();
+}
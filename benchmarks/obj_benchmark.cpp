@@ -0,0 +1,120 @@
+/*
+ * Times parse_obj on a synthetic grid mesh generated in memory, with
+ * positions, texture coordinates and normals, reporting megabytes and
+ * triangles per second. A getline/stringstream parser, the way the loader
+ * used to read files, is timed alongside for comparison.
+ *
+ * Usage: obj_benchmark [grid size]
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/loaders/obj_parser.h"
+
+using namespace smlt;
+using namespace smlt::loaders;
+
+static std::string generate_grid(uint32_t size) {
+    std::string out;
+    char line[128];
+
+    for(uint32_t z = 0; z <= size; ++z) {
+        for(uint32_t x = 0; x <= size; ++x) {
+            // A bit of height so the numbers aren't all integers
+            float y = float((x * 7 + z * 13) % 17) * 0.0625f;
+            std::snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\n", float(x), y, float(z), float(x) / size, float(z) / size);
+            out += line;
+        }
+    }
+
+    out += "vn 0.0 1.0 0.0\n";
+
+    const uint32_t stride = size + 1;
+    for(uint32_t z = 0; z < size; ++z) {
+        for(uint32_t x = 0; x < size; ++x) {
+            uint32_t a = z * stride + x + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + stride + 1;
+            uint32_t d = a + stride;
+
+            std::snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, b, b, c, c, d, d);
+            out += line;
+        }
+    }
+
+    return out;
+}
+
+/* Reads the same data the way the loader used to, a line and a token at a
+ * time into std::strings. Returns the triangle count. */
+static std::size_t reference_parse(const std::string& text, std::vector<Vec3>& positions) {
+    std::istringstream stream(text);
+    std::string line;
+    std::size_t triangles = 0;
+
+    while(std::getline(stream, line)) {
+        std::istringstream tokens(line);
+        std::vector<std::string> parts;
+        std::string part;
+        while(tokens >> part) {
+            parts.push_back(part);
+        }
+
+        if(parts.empty()) {
+            continue;
+        }
+
+        if(parts[0] == "v") {
+            positions.push_back(Vec3(std::stof(parts[1]), std::stof(parts[2]), std::stof(parts[3])));
+        } else if(parts[0] == "f") {
+            for(std::size_t i = 1; i < parts.size(); ++i) {
+                std::stoi(parts[i].substr(0, parts[i].find('/')));
+            }
+            triangles += parts.size() - 3;
+        }
+    }
+
+    return triangles;
+}
+
+static void report(const char* name, int iterations, double bytes, double triangles, std::function<void ()> func) {
+    double ms = benchmark::run(name, iterations, func);
+    std::printf("%-40s %10.1f MB/s %10.2f Mtri/s\n", "",
+        (bytes / (1024.0 * 1024.0)) / (ms / 1000.0),
+        (triangles / 1000000.0) / (ms / 1000.0)
+    );
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t size = (argc > 1) ? std::atoi(argv[1]) : 1000;
+
+    std::string text = generate_grid(size);
+    const double triangles = double(size) * size * 2;
+
+    std::printf("Grid: %dx%d quads, %.0f triangles, %.1f MB of text\n",
+        size, size, triangles, text.size() / (1024.0 * 1024.0)
+    );
+
+    std::vector<Vec3> positions;
+    report("reference (getline)", 1, text.size(), triangles, [&]() {
+        positions.clear();
+        reference_parse(text, positions);
+    });
+
+    OBJData data;
+    report("parse_obj", 3, text.size(), triangles, [&]() {
+        data = OBJData();
+        parse_obj(text.c_str(), text.c_str() + text.size(), data);
+    });
+
+    std::printf("%u unique vertices, %u indices\n",
+        (uint32_t) data.cache.size(), (uint32_t) data.groups[0].indices.size()
+    );
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/*
+ * Times a particle system's per-frame work (integrate, kill, manipulate and
+ * expand to quads) for a large number of particles, comparing the old
+ * array-of-structures approach with the ParticleStore kernels. Simulation
+ * and vertex expansion are timed separately as the latter is mostly bound
+ * by memory bandwidth.
+ *
+ * Usage: particle_benchmark [particle_count]
+ */
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+#include "benchmark.h"
+#include "simulant/nodes/particles/particle_store.h"
+
+using namespace smlt;
+using namespace smlt::particles;
+
+static const float DT = 1.0f / 60.0f;
+
+/* Same layout as the particle system's vertex specification */
+static const VertexLayout LAYOUT = {48, 0, 12, 20};
+
+static Particle make_particle(uint32_t i) {
+    Particle p;
+    p.position = Vec3(float(i % 100), float((i / 100) % 100), float(i / 10000));
+    p.velocity = Vec3(0.1f, 1.0f, -0.1f);
+    p.dimensions = Vec2(1.0f, 1.0f);
+    p.colour = Colour(1, 1, 1, 1);
+    // Spread the deaths out so that a few particles die every frame
+    p.ttl = 0.5f + float(i % 1000) * 0.01f;
+    return p;
+}
+
+/* The old update loop, minus VertexData's per-attribute cursor overhead */
+static void reference_simulate(std::vector<Particle>& particles) {
+    for(auto& particle: particles) {
+        particle.position += particle.velocity * DT;
+        particle.ttl -= DT;
+    }
+
+    particles.erase(
+        std::remove_if(particles.begin(), particles.end(), [](const Particle& p) { return p.ttl <= 0.0f; }),
+        particles.end()
+    );
+
+    const float rate_diff = 1.0f + (0.1f * DT);
+    for(auto& particle: particles) {
+        particle.dimensions.x = std::max(0.0f, particle.dimensions.x * rate_diff);
+        particle.dimensions.y = std::max(0.0f, particle.dimensions.y * rate_diff);
+    }
+}
+
+static void reference_expand(const std::vector<Particle>& particles, std::vector<uint8_t>& vertices) {
+    const static Vec3 corners[4] = {
+        Vec3(-0.5, -0.5, 0), Vec3(0.5, -0.5, 0), Vec3(0.5, 0.5, 0), Vec3(-0.5, 0.5, 0)
+    };
+
+    const static Vec2 uvs[4] = {
+        Vec2(0, 0), Vec2(1, 0), Vec2(1, 1), Vec2(0, 1)
+    };
+
+    uint8_t* out = &vertices[0];
+    for(auto& particle: particles) {
+        auto scale = Vec3(particle.dimensions.x, particle.dimensions.y, 0);
+        for(uint32_t i = 0; i < 4; ++i) {
+            *((Vec3*) (out + LAYOUT.position_offset)) = particle.position + (corners[i] * scale);
+            *((Vec2*) (out + LAYOUT.texcoord_offset)) = uvs[i];
+            *((Colour*) (out + LAYOUT.colour_offset)) = particle.colour;
+            out += LAYOUT.stride;
+        }
+    }
+}
+
+static void store_simulate(ParticleStore& particles) {
+    particles.integrate(DT);
+    particles.remove_dead();
+
+    const float rate_diff = 1.0f + (0.1f * DT);
+    scale_clamped(particles.channel(PARTICLE_CHANNEL_WIDTH), particles.size(), rate_diff, 0.0f);
+    scale_clamped(particles.channel(PARTICLE_CHANNEL_HEIGHT), particles.size(), rate_diff, 0.0f);
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t count = (argc > 1) ? std::atoi(argv[1]) : 100000;
+    const int frames = 100;
+
+    std::printf("Particles: %d\n", count);
+
+    std::vector<uint8_t> vertices(count * 4 * LAYOUT.stride);
+
+    // Both sets lose the same particles over the run, so they do the same work
+    std::vector<Particle> aos;
+    ParticleStore soa;
+
+    aos.reserve(count);
+    soa.reserve(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        aos.push_back(make_particle(i));
+        soa.push(make_particle(i));
+    }
+
+    benchmark::run_throughput("simulate: AoS (reference)", frames, count, "particles", [&]() {
+        reference_simulate(aos);
+    });
+
+    benchmark::run_throughput("simulate: ParticleStore", frames, count, "particles", [&]() {
+        store_simulate(soa);
+    });
+
+    benchmark::run_throughput("expand: AoS (reference)", frames, count, "particles", [&]() {
+        reference_expand(aos, vertices);
+    });
+
+    benchmark::run_throughput("expand: ParticleStore", frames, count, "particles", [&]() {
+        write_quads(soa, &vertices[0], LAYOUT);
+    });
+
+    return 0;
+}
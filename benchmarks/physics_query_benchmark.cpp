@@ -0,0 +1,123 @@
+/*
+ * Casts a large number of rays into a field of static boxes, one at a time
+ * with intersect_ray() and then as a batch (on one thread and on the thread
+ * pool). Coherent rays (downwards from a grid, like line of sight or wheel
+ * rays) and incoherent rays (random start and direction) are timed
+ * separately. Nothing is rendered, the window closes after the first frame.
+ *
+ * Usage: physics_query_benchmark [ray_count] [grid_size]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static uint32_t ray_count = 100000;
+static uint32_t grid_size = 32;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (float(std::rand()) / float(RAND_MAX));
+}
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        physics_ = behaviours::RigidBodySimulation::create(window->time_keeper);
+
+        // A grid of boxes with gaps between them
+        for(uint32_t z = 0; z < grid_size; ++z) {
+            for(uint32_t x = 0; x < grid_size; ++x) {
+                auto actor = stage_->new_actor();
+                actor->move_to(x * 4.0f, 0, z * 4.0f);
+
+                auto body = actor->new_behaviour<behaviours::StaticBody>(physics_.get());
+                body->add_box_collider(Vec3(2, 2, 2), behaviours::PhysicsMaterial::STONE);
+            }
+        }
+
+        const float extent = grid_size * 4.0f;
+
+        std::vector<behaviours::RayQuery> coherent;
+        std::vector<behaviours::RayQuery> incoherent;
+        for(uint32_t i = 0; i < ray_count; ++i) {
+            coherent.push_back(behaviours::RayQuery(
+                Vec3(random_float(0, extent), 5.0f, random_float(0, extent)), Vec3(0, -10, 0)
+            ));
+
+            Vec3 start(random_float(0, extent), random_float(-5, 5), random_float(0, extent));
+            Vec3 end(random_float(0, extent), random_float(-5, 5), random_float(0, extent));
+            incoherent.push_back(behaviours::RayQuery(start, end - start));
+        }
+
+        std::vector<behaviours::QueryHit> hits;
+
+        for(auto& p: {std::make_pair("coherent", &coherent), std::make_pair("incoherent", &incoherent)}) {
+            auto& rays = *p.second;
+            std::string name = p.first;
+
+            benchmark::run_throughput(name + ": one at a time", 3, rays.size(), "rays", [&]() {
+                for(auto& ray: rays) {
+                    physics_->intersect_ray(ray.start, ray.direction);
+                }
+            });
+
+            benchmark::run_throughput(name + ": batched", 3, rays.size(), "rays", [&]() {
+                physics_->intersect_rays(rays, hits);
+            });
+
+            benchmark::run_throughput(name + ": batched, parallel", 3, rays.size(), "rays", [&]() {
+                physics_->intersect_rays(rays, hits, true);
+            });
+
+            std::printf("%-40s %10d\n", (name + ": hits").c_str(), (int) physics_->intersect_rays(rays, hits));
+        }
+    }
+
+    void update(float dt) {
+        window->stop_running();
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+    behaviours::PhysicsSimulationPtr physics_;
+};
+
+
+class PhysicsQueryBenchmark: public smlt::Application {
+public:
+    PhysicsQueryBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) ray_count = std::max(1, std::atoi(argv[1]));
+    if(argc > 2) grid_size = std::max(1, std::atoi(argv[2]));
+
+    smlt::AppConfig config;
+    config.title = "Physics Query Benchmark";
+    config.fullscreen = false;
+    config.width = 640;
+    config.height = 480;
+
+    PhysicsQueryBenchmark app(config);
+    return app.run();
+}
@@ -0,0 +1,118 @@
+/*
+ * A version of samples/2d_sample.cpp with lots of moving sprites instead of
+ * the tile map. Renders a fixed number of frames and prints the frame time
+ * statistics and draw calls, with and without sprite batching.
+ *
+ * Usage: sprite_benchmark [sprite_count] [batched|unbatched] [frames]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+
+using namespace smlt;
+
+static uint32_t sprite_count = 5000;
+static bool batched = true;
+static uint32_t frames_to_run = 500;
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        float render_height = 16.0;
+        render_width_ = camera_->set_orthographic_projection_from_height(
+            render_height, float(window->width()) / float(window->height())
+        );
+
+        stage_->sprites->set_batching_enabled(batched);
+
+        /* A few spritesheets, so there's more than one batch. The content
+         * doesn't matter, only the size */
+        std::vector<TextureID> textures;
+        for(uint32_t i = 0; i < 4; ++i) {
+            auto texture = stage_->assets->new_texture();
+            texture.fetch()->resize(64, 64);
+            textures.push_back(texture);
+        }
+
+        for(uint32_t i = 0; i < sprite_count; ++i) {
+            auto sprite = stage_->sprites->new_sprite_from_texture(textures[i % textures.size()], 16, 16);
+            sprite->set_render_dimensions(0.5f, 0.5f);
+            sprite->move_to(
+                (float(std::rand()) / RAND_MAX) * render_width_,
+                (float(std::rand()) / RAND_MAX) * render_height,
+                -(float(i) / sprite_count)
+            );
+            sprites_.push_back(sprite);
+        }
+
+        camera_->move_to(render_width_ / 2, render_height / 2, 0);
+    }
+
+    void update(float dt) {
+        // Move everything each frame, so nothing can be cached
+        for(auto sprite: sprites_) {
+            sprite->move_by(std::sin(elapsed_) * dt, 0, 0);
+        }
+
+        elapsed_ += dt;
+
+        if(++frames_ == frames_to_run) {
+            auto stats = window->stats->frame_time_stats();
+            std::printf("%d sprites, %s\n", sprite_count, (batched) ? "batched" : "unbatched");
+            std::printf("%-40s %10.3f ms\n", "mean frame", stats.mean);
+            std::printf("%-40s %10.3f ms\n", "p95 frame", stats.p95);
+            std::printf("%-40s %10d\n", "draw calls", window->stats->draw_calls());
+            std::printf("%-40s %10d\n", "batches", (int) stage_->sprites->batch_count());
+            window->stop_running();
+        }
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+    std::vector<SpritePtr> sprites_;
+
+    float render_width_ = 0.0f;
+    float elapsed_ = 0.0f;
+    uint32_t frames_ = 0;
+};
+
+
+class SpriteBenchmark: public smlt::Application {
+public:
+    SpriteBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) sprite_count = std::atoi(argv[1]);
+    if(argc > 2) batched = std::strcmp(argv[2], "unbatched") != 0;
+    if(argc > 3) frames_to_run = std::atoi(argv[3]);
+
+    smlt::AppConfig config;
+    config.title = "Sprite Benchmark";
+    config.fullscreen = false;
+    config.width = 1280;
+    config.height = 960;
+
+    SpriteBenchmark app(config);
+    return app.run();
+}
@@ -0,0 +1,86 @@
+/*
+ * Times the heightmap processing kernels on a synthetic terrain, i.e. the
+ * work HeightmapLoader::into does once the source image has been decoded.
+ *
+ * Usage: terrain_benchmark [size] [smooth_iterations]
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/utils/noise.h"
+#include "simulant/utils/terrain_kernels.h"
+#include "simulant/generic/threading/thread_pool.h"
+
+using namespace smlt;
+
+/* The old approach: gather the neighbours of every vertex into a vector
+ * and average them. Kept here for comparison. */
+static void reference_smooth(std::vector<float>& heights, int width, int depth) {
+    std::vector<float> neighbours;
+
+    for(int z = 0; z < depth; ++z) {
+        for(int x = 0; x < width; ++x) {
+            neighbours.clear();
+            for(int oz = -1; oz <= 1; ++oz) {
+                for(int ox = -1; ox <= 1; ++ox) {
+                    int nx = x + ox, nz = z + oz;
+                    if(nx < 0 || nz < 0 || nx >= width || nz >= depth) continue;
+                    neighbours.push_back(heights[(nz * width) + nx]);
+                }
+            }
+
+            float total = 0.0f;
+            for(auto h: neighbours) total += h;
+            heights[(z * width) + x] = total / float(neighbours.size());
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t size = (argc > 1) ? std::atoi(argv[1]) : 2048;
+    const uint32_t iterations = (argc > 2) ? std::atoi(argv[2]) : 20;
+    const float spacing = 2.5f;
+
+    std::printf("Terrain: %dx%d, %d smoothing iterations, %d worker threads\n",
+        size, size, iterations, (int) thread::ThreadPool::global().worker_count()
+    );
+
+    noise::Perlin perlin;
+    std::vector<float> source(size * size);
+    for(uint32_t z = 0; z < size; ++z) {
+        for(uint32_t x = 0; x < size; ++x) {
+            source[(z * size) + x] = 64.0f * perlin.noise(x * 0.01, z * 0.01);
+        }
+    }
+
+    std::vector<float> heights;
+    std::vector<Vec3> normals(size * size);
+    std::vector<float> occlusion(size * size);
+
+    benchmark::run("reference smooth (1 iteration)", 1, [&]() {
+        heights = source;
+        reference_smooth(heights, size, size);
+    });
+
+    benchmark::run("smooth_heights (1 iteration)", 5, [&]() {
+        heights = source;
+        terrain::smooth_heights(&heights[0], size, size, 1);
+    });
+
+    benchmark::run("smooth_heights (all iterations)", 3, [&]() {
+        heights = source;
+        terrain::smooth_heights(&heights[0], size, size, iterations);
+    });
+
+    benchmark::run("calculate_normals", 5, [&]() {
+        terrain::calculate_normals(&heights[0], size, size, spacing, &normals[0]);
+    });
+
+    benchmark::run("calculate_occlusion", 3, [&]() {
+        terrain::calculate_occlusion(&heights[0], &normals[0], size, size, spacing, &occlusion[0]);
+    });
+
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Lays out a large number of labels. Times the text layout on its own, with
+ * and without the layout cache, then creating and laying out the labels
+ * themselves.
+ *
+ * Usage: text_layout_benchmark [label_count] [distinct_texts]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+#include "benchmark.h"
+
+using namespace smlt;
+
+static uint32_t label_count = 10000;
+
+/* Most UI text repeats (button captions, item names, etc.) */
+static uint32_t distinct_texts = 500;
+
+const static char* WORDS[] = {
+    "Health", "Mana", "Score", "Sword", "Shield", "Potion", "of", "the",
+    "Ancient", "Quick", "Brown", "Fox", "Level", "Gold", "Inventory", "Quest"
+};
+
+static unicode make_text(uint32_t i) {
+    const uint32_t word_count = sizeof(WORDS) / sizeof(WORDS[0]);
+
+    std::string text;
+    uint32_t seed = i;
+    for(uint32_t w = 0; w < 2 + (i % 5); ++w) {
+        text += WORDS[seed % word_count];
+        text += " ";
+        seed = seed * 1103515245 + 12345;
+    }
+
+    return unicode(text + std::to_string(i));
+}
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        auto font = stage_->assets->font(stage_->assets->default_font_id()).get();
+
+        std::vector<unicode> texts;
+        for(uint32_t i = 0; i < label_count; ++i) {
+            texts.push_back(make_text(i % distinct_texts));
+        }
+
+        const float width = 200.0f;
+        const float line_height = 20.0f;
+
+        benchmark::run_throughput("layout: uncached", 5, label_count, "labels", [&]() {
+            for(auto& text: texts) {
+                ui::TextLayout layout(font, text, width, line_height);
+            }
+        });
+
+        ui::TextLayoutCache cache(distinct_texts);
+        benchmark::run_throughput("layout: cached", 5, label_count, "labels", [&]() {
+            for(auto& text: texts) {
+                cache.layout(font, text, width, line_height);
+            }
+        });
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for(auto& text: texts) {
+            stage_->ui->new_widget_as_label(text, width);
+        }
+        stage_->ui->_sync_batches();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::printf(
+            "%-40s %10.3f ms\n", "labels: create and lay out",
+            std::chrono::duration<double, std::milli>(end - start).count()
+        );
+
+        auto layouts = stage_->ui->_text_layouts();
+        std::printf("%-40s %10d\n", "labels", (int) label_count);
+        std::printf("%-40s %10d\n", "layout cache hits", (int) layouts->hits());
+        std::printf("%-40s %10d\n", "layout cache misses", (int) layouts->misses());
+        std::printf("%-40s %10d\n", "batches", (int) stage_->ui->batch_count());
+    }
+
+    void update(float dt) {
+        window->stop_running();
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+};
+
+
+class TextLayoutBenchmark: public smlt::Application {
+public:
+    TextLayoutBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) label_count = std::atoi(argv[1]);
+    if(argc > 2) distinct_texts = std::max(1, std::atoi(argv[2]));
+
+    smlt::AppConfig config;
+    config.title = "Text Layout Benchmark";
+    config.fullscreen = false;
+    config.width = 1280;
+    config.height = 960;
+
+    TextLayoutBenchmark app(config);
+    return app.run();
+}
@@ -0,0 +1,96 @@
+/*
+ * Times the texel kernels used by Texture::convert, flip_vertically,
+ * premultiply_alpha and generate_mipmaps on a synthetic image, reporting
+ * megapixels per second for each.
+ *
+ * Usage: texture_benchmark [size]
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include "benchmark.h"
+#include "simulant/utils/texel_kernels.h"
+#include "simulant/generic/threading/thread_pool.h"
+
+using namespace smlt;
+
+/* The old per-texel conversion, unpacking through floats. Kept here for
+ * comparison. */
+static void reference_convert(const uint8_t* in, uint16_t* out, uint32_t count) {
+    for(uint32_t i = 0; i < count; ++i, in += 4) {
+        float r = float(in[0]) / 255.0f;
+        float g = float(in[1]) / 255.0f;
+        float b = float(in[2]) / 255.0f;
+        float a = float(in[3]) / 255.0f;
+
+        out[i] = (uint8_t(15.0f * r) << 12) | (uint8_t(15.0f * g) << 8) | (uint8_t(15.0f * b) << 4) | uint8_t(15.0f * a);
+    }
+}
+
+static void report(const char* name, int iterations, double pixels, std::function<void ()> func) {
+    double ms = benchmark::run(name, iterations, func);
+    std::printf("%-40s %10.1f MP/s\n", "", (pixels / 1000000.0) / (ms / 1000.0));
+}
+
+int main(int argc, char* argv[]) {
+    const uint32_t size = (argc > 1) ? std::atoi(argv[1]) : 2048;
+    const double pixels = double(size) * size;
+
+    std::printf("Texture: %dx%d RGBA8888, %d worker threads\n",
+        size, size, (int) thread::ThreadPool::global().worker_count()
+    );
+
+    std::vector<uint8_t> source(size * size * 4);
+    for(std::size_t i = 0; i < source.size(); ++i) {
+        source[i] = uint8_t((i * 2654435761u) >> 13);
+    }
+
+    std::vector<uint8_t> rgba = source;
+    std::vector<uint8_t> rgb(size * size * 3);
+    std::vector<uint16_t> packed(size * size);
+    std::vector<uint8_t> mip(std::max(size / 2, 1u) * std::max(size / 2, 1u) * 4);
+
+    const TextureChannelSet swizzle = {{
+        TEXTURE_CHANNEL_BLUE, TEXTURE_CHANNEL_GREEN, TEXTURE_CHANNEL_RED, TEXTURE_CHANNEL_ONE
+    }};
+
+    report("reference RGBA8888 -> RGBA4444", 3, pixels, [&]() {
+        reference_convert(&source[0], &packed[0], size * size);
+    });
+
+    report("convert RGBA8888 -> RGBA4444", 10, pixels, [&]() {
+        texels::convert(&source[0], TEXTURE_FORMAT_RGBA8888, (uint8_t*) &packed[0], TEXTURE_FORMAT_RGBA4444, size, size);
+    });
+
+    report("convert RGBA4444 -> RGBA8888", 10, pixels, [&]() {
+        texels::convert((uint8_t*) &packed[0], TEXTURE_FORMAT_RGBA4444, &rgba[0], TEXTURE_FORMAT_RGBA8888, size, size);
+    });
+
+    report("convert RGBA8888 -> RGB888", 10, pixels, [&]() {
+        texels::convert(&source[0], TEXTURE_FORMAT_RGBA8888, &rgb[0], TEXTURE_FORMAT_RGB888, size, size);
+    });
+
+    report("swizzle RGBA8888 (BGR1)", 10, pixels, [&]() {
+        texels::convert(&source[0], TEXTURE_FORMAT_RGBA8888, &rgba[0], TEXTURE_FORMAT_RGBA8888, size, size, swizzle);
+    });
+
+    report("flip_vertically", 10, pixels, [&]() {
+        texels::flip_vertically(&rgba[0], size * 4, size);
+    });
+
+    report("premultiply_alpha", 10, pixels, [&]() {
+        rgba = source;
+        texels::premultiply_alpha(&rgba[0], size, size);
+    });
+
+    report("downsample (box)", 10, pixels, [&]() {
+        texels::downsample(&source[0], size, size, 4, &mip[0], MIPMAP_FILTER_BOX);
+    });
+
+    report("downsample (kaiser)", 3, pixels, [&]() {
+        texels::downsample(&source[0], size, size, 4, &mip[0], MIPMAP_FILTER_KAISER);
+    });
+
+    return 0;
+}
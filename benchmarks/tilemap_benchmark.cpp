@@ -0,0 +1,142 @@
+/*
+ * A version of samples/2d_sample.cpp with a large generated tile map. The
+ * camera scrolls across the map while a few tiles are changed every frame.
+ * Renders a fixed number of frames and prints the frame time statistics, draw
+ * calls and the number of chunks rebuilt.
+ *
+ * Usage: tilemap_benchmark [map_size] [chunk_size] [frames]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+#include "simulant/simulant.h"
+#include "simulant/shortcuts.h"
+
+using namespace smlt;
+
+static uint32_t map_size = 1024;
+static uint32_t chunk_size = Tilemap::DEFAULT_CHUNK_SIZE;
+static uint32_t frames_to_run = 500;
+
+/* Tiles changed each frame */
+const static uint32_t EDITS_PER_FRAME = 8;
+
+class GameScene : public smlt::Scene<GameScene> {
+public:
+    GameScene(smlt::Window* window):
+        smlt::Scene<GameScene>(window) {}
+
+    void load() {
+        prepare_basic_scene(stage_, camera_);
+
+        render_height_ = 16.0;
+        render_width_ = camera_->set_orthographic_projection_from_height(
+            render_height_, float(window->width()) / float(window->height())
+        );
+
+        // The content of the tileset doesn't matter, only the size
+        auto texture = stage_->assets->new_texture();
+        texture.fetch()->resize(64, 64);
+
+        tilemap_ = stage_->tilemaps->new_tilemap();
+        tilemap_->set_chunk_size(chunk_size);
+
+        TileIndex first = tilemap_->add_tileset(texture, 16, 16);
+        tile_count_ = tilemap_->tileset(0).tile_count;
+
+        auto ground = tilemap_->new_layer("ground", map_size, map_size);
+        auto detail = tilemap_->new_layer("detail", map_size, map_size);
+
+        for(uint32_t y = 0; y < map_size; ++y) {
+            for(uint32_t x = 0; x < map_size; ++x) {
+                tilemap_->set_tile(ground, x, y, first + (std::rand() % tile_count_));
+
+                // The detail layer is sparse, like most upper layers
+                if(std::rand() % 8 == 0) {
+                    tilemap_->set_tile(detail, x, y, first + (std::rand() % tile_count_));
+                }
+            }
+        }
+
+        first_tile_ = first;
+
+        // Exclude the initial build from the rebuild count
+        tilemap_->rebuild_dirty_chunks();
+
+        camera_->move_to(render_width_ / 2, render_height_ / 2, 0);
+    }
+
+    void update(float dt) {
+        // Scroll diagonally across the map, wrapping back to the start
+        const float extent = map_size * tilemap_->tile_render_size();
+        float x = std::fmod(camera_->position().x + dt * 20.0f, extent - render_width_);
+        float y = std::fmod(camera_->position().y + dt * 10.0f, extent - render_height_);
+        camera_->move_to(std::max(x, render_width_ / 2), std::max(y, render_height_ / 2), 0);
+
+        // Change some tiles in view
+        for(uint32_t i = 0; i < EDITS_PER_FRAME; ++i) {
+            uint32_t tx = std::min<uint32_t>(map_size - 1, uint32_t(camera_->position().x) + (std::rand() % 8));
+            uint32_t ty = std::min<uint32_t>(map_size - 1, map_size - uint32_t(camera_->position().y) - 1 + (std::rand() % 8));
+            tilemap_->set_tile(1, tx, ty, first_tile_ + (std::rand() % tile_count_));
+        }
+
+        chunks_rebuilt_ += tilemap_->dirty_chunk_count();
+
+        if(++frames_ == frames_to_run) {
+            auto stats = window->stats->frame_time_stats();
+            std::printf("%dx%d tiles, 2 layers, %d tile chunks\n", map_size, map_size, chunk_size);
+            std::printf("%-40s %10.3f ms\n", "mean frame", stats.mean);
+            std::printf("%-40s %10.3f ms\n", "p95 frame", stats.p95);
+            std::printf("%-40s %10d\n", "draw calls", window->stats->draw_calls());
+            std::printf("%-40s %10d\n", "chunks", (int) tilemap_->chunk_count());
+            std::printf("%-40s %10d\n", "built chunks", (int) tilemap_->built_chunk_count());
+            std::printf("%-40s %10d\n", "chunks rebuilt", (int) chunks_rebuilt_);
+            window->stop_running();
+        }
+    }
+
+private:
+    StagePtr stage_;
+    CameraPtr camera_;
+    TilemapPtr tilemap_ = nullptr;
+
+    TileIndex first_tile_ = 1;
+    uint32_t tile_count_ = 0;
+
+    float render_width_ = 0.0f;
+    float render_height_ = 0.0f;
+    uint32_t frames_ = 0;
+    uint32_t chunks_rebuilt_ = 0;
+};
+
+
+class TilemapBenchmark: public smlt::Application {
+public:
+    TilemapBenchmark(const smlt::AppConfig& config):
+        smlt::Application(config) {}
+
+private:
+    bool init() {
+        scenes->register_scene<GameScene>("main");
+        return true;
+    }
+};
+
+
+int main(int argc, char* argv[]) {
+    if(argc > 1) map_size = std::atoi(argv[1]);
+    if(argc > 2) chunk_size = std::atoi(argv[2]);
+    if(argc > 3) frames_to_run = std::atoi(argv[3]);
+
+    smlt::AppConfig config;
+    config.title = "Tilemap Benchmark";
+    config.fullscreen = false;
+    config.width = 1280;
+    config.height = 960;
+
+    TilemapBenchmark app(config);
+    return app.run();
+}
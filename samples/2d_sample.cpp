@@ -23,16 +23,14 @@ public:
         );
 
         {
-            //Load a sprite grid, from the 'Layer 1' layer in a tmx file
-            smlt::MeshID mesh_id = stage_->assets->new_mesh_from_tmx_file(
-                "sample_data/tiled/example.tmx", "Layer 1"
+            //Load every layer of a tmx file into a tilemap, which is drawn in chunks
+            auto tilemap = stage_->tilemaps->new_tilemap_from_tmx_file(
+                "sample_data/tiled/example.tmx"
             );
 
-            stage_->new_geom_with_mesh(mesh_id);
+            auto bounds = tilemap->aabb();
 
-            auto bounds = stage_->assets->mesh(mesh_id)->aabb();
-
-            //Constrain the camera to the area where the sprite grid is rendered
+            //Constrain the camera to the area where the tilemap is rendered
             camera_->constrain_to_aabb(
                 AABB(
                     smlt::Vec3(render_width / 2, render_height / 2, 0),
@@ -8,32 +8,21 @@ inline T clamp(T x, T a = 0, T b = 1) {
     return x < a ? a : (x > b ? b : x);
 }
 
-void calculate_splat_map(int width, int length, TexturePtr texture, VertexData& vertices) {
-    auto lock = texture->lock();
+void calculate_splat_weights(float height, const Vec3& n, float& sand, float& grass, float& rock, float& snow) {
+    Degrees steepness = Radians(acos(n.dot(Vec3(0, 1, 0))));
+    height = (height + 64.0f) / 128.0f;
 
-    texture->resize(width, length);
+    rock = clamp(steepness.value / 45.0f);
+    sand = clamp(1.0 - (height * 4.0f));
+    grass = (sand > 0.5) ? 0.0 : 0.5f;
+    snow = height * clamp(n.z);
 
-    for(uint32_t i = 0; i < vertices.count(); ++i) {
-        Vec3 n;
-        vertices.normal_at(i, n);
-
-        Degrees steepness = Radians(acos(n.dot(Vec3(0, 1, 0))));
-        float height = (vertices.position_at<Vec3>(i).y + 64.0f) / 128.0f;
-
-        float rock = clamp(steepness.value / 45.0f);
-        float sand = clamp(1.0 - (height * 4.0f));
-        float grass = (sand > 0.5) ? 0.0 : 0.5f;
-        float snow = height * clamp(n.z);
-
-        float z = rock + sand + grass + snow;
-
-        texture->data()[i * 4] = 255.0f * (sand / z);
-        texture->data()[(i * 4) + 1] = 255.0f * (grass / z);
-        texture->data()[(i * 4) + 2] = 255.0f * (rock / z);
-        texture->data()[(i * 4) + 3] = 255.0f * (snow / z);
-    }
-    texture->mark_data_changed();
+    float z = rock + sand + grass + snow;
 
+    sand /= z;
+    grass /= z;
+    rock /= z;
+    snow /= z;
 }
 
 class Gamescene : public smlt::Scene<Gamescene> {
@@ -73,14 +62,7 @@ public:
         terrain_mesh_id_ = stage_->assets->new_mesh_from_heightmap("sample_data/terrain.png", spec);
         auto terrain_mesh = stage_->assets->mesh(terrain_mesh_id_);
 
-        auto terrain_data = terrain_mesh->data->get<smlt::TerrainData>("terrain_data");
-        smlt::TextureID terrain_splatmap = stage_->assets->new_texture();
-        calculate_splat_map(
-            terrain_data.x_size,
-            terrain_data.z_size,
-            stage_->assets->texture(terrain_splatmap),
-            terrain_mesh->vertex_data
-        );
+        smlt::TextureID terrain_splatmap = terrain::generate_alphamap(terrain_mesh, calculate_splat_weights);
 
         stage_->assets->material(terrain_material_id_)->first_pass()->set_texture_unit(4, terrain_splatmap);
 
@@ -0,0 +1,210 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "audio_streamer.h"
+
+namespace smlt {
+
+/* How often the thread tops up streams when nobody wakes it */
+const static std::chrono::milliseconds STREAMER_POLL_INTERVAL(20);
+
+PCMRingBuffer::PCMRingBuffer(std::size_t chunk_count, std::size_t chunk_samples):
+    chunk_samples_(chunk_samples),
+    data_(chunk_count * chunk_samples),
+    sizes_(chunk_count, 0),
+    read_(0),
+    write_(0) {
+
+    if(!chunk_count || !chunk_samples) {
+        throw std::logic_error("A PCM ring buffer needs at least one chunk of one sample");
+    }
+}
+
+int16_t* PCMRingBuffer::begin_write() {
+    const std::size_t write = write_.load(std::memory_order_relaxed);
+    if(write - read_.load(std::memory_order_acquire) == sizes_.size()) {
+        return nullptr;
+    }
+
+    return &data_[(write % sizes_.size()) * chunk_samples_];
+}
+
+void PCMRingBuffer::end_write(std::size_t samples) {
+    const std::size_t write = write_.load(std::memory_order_relaxed);
+    sizes_[write % sizes_.size()] = samples;
+    write_.store(write + 1, std::memory_order_release);
+}
+
+int16_t* PCMRingBuffer::begin_read(std::size_t* samples) {
+    const std::size_t read = read_.load(std::memory_order_relaxed);
+    if(read == write_.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+
+    const std::size_t slot = read % sizes_.size();
+    *samples = sizes_[slot];
+    return &data_[slot * chunk_samples_];
+}
+
+void PCMRingBuffer::end_read() {
+    read_.store(read_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+std::size_t PCMRingBuffer::ready_count() const {
+    return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+}
+
+AudioStream::AudioStream(DecodeFunc decode, std::size_t chunk_samples, std::size_t chunk_count):
+    decode_(decode),
+    buffer_(chunk_count, chunk_samples),
+    ended_(false),
+    finished_(false),
+    closed_(false) {
+
+}
+
+std::size_t AudioStream::decode_ahead(std::size_t max_chunks) {
+    std::size_t decoded = 0;
+
+    while(decoded < max_chunks && !finished_ && !closed_) {
+        int16_t* out = buffer_.begin_write();
+        if(!out) {
+            break;
+        }
+
+        /* Decoders can return short reads before the end of the stream, so
+         * keep going until the chunk is full or nothing comes back */
+        const std::size_t capacity = buffer_.chunk_samples();
+        std::size_t size = 0;
+        while(!ended_ && size < capacity) {
+            std::size_t read = decode_(out + size, capacity - size);
+            if(!read) {
+                ended_ = true;
+            }
+            size += read;
+        }
+
+        buffer_.end_write(size);
+        ++decoded;
+
+        if(!size) {
+            // That was the end marker
+            finished_ = true;
+        }
+    }
+
+    return decoded;
+}
+
+AudioStreamer& AudioStreamer::global() {
+    static AudioStreamer streamer;
+    return streamer;
+}
+
+AudioStreamer::AudioStreamer() {
+    thread_ = std::thread(&AudioStreamer::run, this);
+}
+
+AudioStreamer::~AudioStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    cv_.notify_one();
+    thread_.join();
+}
+
+void AudioStreamer::add_stream(AudioStream::ptr stream) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(stream);
+    }
+
+    cv_.notify_one();
+}
+
+void AudioStreamer::wake() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        woken_ = true;
+    }
+
+    cv_.notify_one();
+}
+
+void AudioStreamer::add_task(std::function<void ()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+    }
+
+    cv_.notify_one();
+}
+
+void AudioStreamer::run() {
+    /* Only ever touched by this thread */
+    std::vector<AudioStream::ptr> streams;
+    std::function<void ()> task;
+
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait_for(lock, STREAMER_POLL_INTERVAL, [this]() {
+                return stopping_ || woken_ || !pending_.empty() || !tasks_.empty();
+            });
+
+            if(stopping_) {
+                return;
+            }
+
+            woken_ = false;
+            streams.insert(streams.end(), pending_.begin(), pending_.end());
+            pending_.clear();
+
+            // One task at a time, so playing streams are topped up in between
+            if(!tasks_.empty()) {
+                task = tasks_.front();
+                tasks_.erase(tasks_.begin());
+            }
+        }
+
+        for(auto& stream: streams) {
+            stream->decode_ahead();
+        }
+
+        if(task) {
+            task();
+            task = std::function<void ()>();
+        }
+
+        streams.erase(
+            std::remove_if(streams.begin(), streams.end(), [](const AudioStream::ptr& stream) {
+                return stream->is_closed() || stream->finished_decoding();
+            }),
+            streams.end()
+        );
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace smlt {
+
+/* Writes up to max_samples interleaved samples to out and returns how many
+ * were written. Returning zero means the stream has ended. */
+typedef std::function<std::size_t (int16_t* out, std::size_t max_samples)> DecodeFunc;
+
+/*
+ * A fixed ring of PCM chunks with a single producer (the audio streaming
+ * thread) and a single consumer (the main thread). Nothing is allocated after
+ * construction and the only shared state is the pair of atomic positions.
+ *
+ * A chunk which is committed with zero samples marks the end of the stream.
+ */
+class PCMRingBuffer {
+public:
+    PCMRingBuffer(std::size_t chunk_count, std::size_t chunk_samples);
+
+    PCMRingBuffer(const PCMRingBuffer& rhs) = delete;
+    PCMRingBuffer& operator=(const PCMRingBuffer& rhs) = delete;
+
+    std::size_t chunk_count() const { return sizes_.size(); }
+    std::size_t chunk_samples() const { return chunk_samples_; }
+
+    /* Producer: returns the next free chunk, or nullptr if the ring is full */
+    int16_t* begin_write();
+    void end_write(std::size_t samples);
+
+    /* Consumer: returns the oldest filled chunk, or nullptr if the ring is empty */
+    int16_t* begin_read(std::size_t* samples);
+    void end_read();
+
+    std::size_t ready_count() const;
+
+private:
+    std::size_t chunk_samples_;
+    std::vector<int16_t> data_;
+
+    /* Written by the producer before write_ is published, so they don't need
+     * to be atomic themselves */
+    std::vector<std::size_t> sizes_;
+
+    /* Monotonic counters, the slot is the counter modulo the chunk count */
+    std::atomic<std::size_t> read_;
+    std::atomic<std::size_t> write_;
+};
+
+/*
+ * A stream being decoded ahead of playback. Shared between the SourceInstance
+ * which plays it and the streaming thread which fills it.
+ */
+class AudioStream {
+public:
+    typedef std::shared_ptr<AudioStream> ptr;
+
+    AudioStream(DecodeFunc decode, std::size_t chunk_samples, std::size_t chunk_count);
+
+    PCMRingBuffer& buffer() { return buffer_; }
+
+    /* Decodes into free chunks until the ring is full, the stream ends or
+     * max_chunks have been decoded. Returns the number of chunks written.
+     * Only one thread may call this at a time. */
+    std::size_t decode_ahead(std::size_t max_chunks=~std::size_t(0));
+
+    bool finished_decoding() const { return finished_; }
+
+    /* Called by the owner when it no longer wants the stream, the streaming
+     * thread then drops it */
+    void close() { closed_ = true; }
+    bool is_closed() const { return closed_; }
+
+private:
+    DecodeFunc decode_;
+    PCMRingBuffer buffer_;
+
+    /* The decoder has run dry (only touched by the decoding thread) */
+    bool ended_;
+
+    /* The end marker has been written to the ring */
+    std::atomic<bool> finished_;
+    std::atomic<bool> closed_;
+};
+
+/*
+ * Owns the thread which decodes every playing stream ahead of time, so
+ * the main thread only ever uploads PCM that is already waiting.
+ */
+class AudioStreamer {
+public:
+    static AudioStreamer& global();
+
+    AudioStreamer();
+    ~AudioStreamer();
+
+    AudioStreamer(const AudioStreamer& rhs) = delete;
+    AudioStreamer& operator=(const AudioStreamer& rhs) = delete;
+
+    /* Starts decoding the stream in the background until it finishes or is closed */
+    void add_stream(AudioStream::ptr stream);
+
+    /* Lets the thread know that chunks have been consumed */
+    void wake();
+
+    /* Runs a one-off job on the thread, between decoding streams. Jobs run
+     * one at a time in the order they were added. */
+    void add_task(std::function<void ()> task);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    /* Streams added since the thread last looked, protected by mutex_ */
+    std::vector<AudioStream::ptr> pending_;
+    std::vector<std::function<void ()>> tasks_;
+    bool woken_ = false;
+    bool stopping_ = false;
+
+    std::thread thread_;
+
+    void run();
+};
+
+}
@@ -16,16 +16,10 @@ namespace impl {
 Body::Body(RigidBodySimulation* simulation):
     simulation_(simulation->shared_from_this()) {
 
-    // Keep each body's last_state in sync when the simulation is stepped
-    simulation_stepped_connection_ = simulation->signal_simulation_pre_step().connect([this]() {
-        if(auto sim = simulation_.lock()) {
-            last_state_ = sim->body_transform(this);
-        }
-    });
 }
 
 Body::~Body() {
-    simulation_stepped_connection_.disconnect();
+
 }
 
 bool Body::init() {
@@ -88,12 +82,17 @@ void Body::update(float dt) {
         return;
     }
 
-    if(INTERPOLATION_ENABLED) {
-        auto prev_state = last_state_; // This is set by the signal connected in Body::Body()
-        auto next_state = sim->body_transform(this);
+    std::pair<Vec3, Quaternion> prev_state, next_state;
+
+    /* Read the states recorded by the last step, rather than the bodies
+     * themselves, so that this doesn't wait for a step on the physics thread */
+    if(!sim->interpolation_states(this, &prev_state, &next_state)) {
+        prev_state = next_state = sim->body_transform(this);
+    }
 
-        // Prevent a divide by zero.
-        float t = (dt == 0.0f) ? 0.0f : sim->time_keeper_->fixed_step_remainder() / dt;
+    if(INTERPOLATION_ENABLED) {
+        // How far through the next step this frame is
+        float t = sim->time_keeper_->fixed_step_alpha();
 
         auto new_pos = prev_state.first.lerp(next_state.first, t);
         auto new_rot = prev_state.second.slerp(next_state.second, t);
@@ -101,22 +100,23 @@ void Body::update(float dt) {
         stage_node->move_to_absolute(new_pos);
         stage_node->rotate_to_absolute(new_rot);
     } else {
-        auto state = sim->body_transform(this);
-        stage_node->move_to_absolute(state.first);
-        stage_node->rotate_to_absolute(state.second);
+        stage_node->move_to_absolute(next_state.first);
+        stage_node->rotate_to_absolute(next_state.second);
     }
 }
 
-void Body::store_collider(b3Shape *shape, const PhysicsMaterial &material) {
+ColliderID Body::store_collider(b3Shape *shape, const PhysicsMaterial &material) {
     // Store details about the collider so that when contacts
     // arise we can provide more detailed information to the user
     ColliderDetails details;
     details.material = material;
+    details.id = simulation_.lock()->next_collider_id_++;
 
     // Make sure the b3Shape has this body as its userData!
     shape->SetUserData(this);
 
     collider_details_.insert(std::make_pair(shape, details));
+    return details.id;
 }
 
 void Body::contact_started(const Collision &collision) {
@@ -125,6 +125,12 @@ void Body::contact_started(const Collision &collision) {
     }
 }
 
+void Body::contact_stayed(const Collision& collision) {
+    for(auto listener: listeners_) {
+        listener->on_collision_stay();
+    }
+}
+
 void Body::contact_finished(const Collision& collision) {
     for(auto listener: listeners_) {
         listener->on_collision_exit(collision);
@@ -141,10 +147,10 @@ void Body::on_behaviour_added(Organism *organism) {
     }
 }
 
-void Body::add_box_collider(const Vec3 &size, const PhysicsMaterial &properties, const Vec3 &offset, const Quaternion &rotation) {
+ColliderID Body::add_box_collider(const Vec3 &size, const PhysicsMaterial &properties, const Vec3 &offset, const Quaternion &rotation) {
     auto sim = simulation_.lock();
     if(!sim) {
-        return;
+        return 0;
     }
 
     b3Vec3 p;
@@ -173,13 +179,13 @@ void Body::add_box_collider(const Vec3 &size, const PhysicsMaterial &properties,
     sdef.friction = properties.friction;
     sdef.restitution = properties.bounciness;
 
-    store_collider(sim->bodies_.at(this)->CreateShape(sdef), properties);
+    return store_collider(sim->find_body(this)->CreateShape(sdef), properties);
 }
 
-void Body::add_sphere_collider(const float diameter, const PhysicsMaterial& properties, const Vec3& offset) {
+ColliderID Body::add_sphere_collider(const float diameter, const PhysicsMaterial& properties, const Vec3& offset) {
     auto sim = simulation_.lock();
     if(!sim) {
-        return;
+        return 0;
     }
 
     b3SphereShape sphere;
@@ -192,7 +198,7 @@ void Body::add_sphere_collider(const float diameter, const PhysicsMaterial& prop
     sdef.friction = properties.friction;
     sdef.restitution = properties.bounciness;
 
-    store_collider(sim->bodies_.at(this)->CreateShape(sdef), properties);
+    return store_collider(sim->find_body(this)->CreateShape(sdef), properties);
 }
 
 void Body::register_collision_listener(CollisionListener *listener) {
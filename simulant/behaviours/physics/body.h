@@ -43,16 +43,16 @@ struct ContactPoint {
     float separation = 0.0f;
 
     impl::Body* other_body = nullptr;
-    std::string other_collider;
+    ColliderID other_collider = 0;
 };
 
 struct Collision {
     impl::Body* other_body = nullptr; ///< Body which owns the collider we hit
-    std::string other_collider_name; ///< Name of the collider we hit
+    ColliderID other_collider = 0; ///< The collider we hit
     StageNode* other_stage_node = nullptr; ///< Pointer to the owning stage node of the other body
 
     impl::Body* this_body = nullptr; ///< This body
-    std::string this_collider_name; ///< The collider on this body which was hit
+    ColliderID this_collider = 0; ///< The collider on this body which was hit
     StageNode* this_stage_node = nullptr; ///< The owning stage node of this body
 
     std::vector<ContactPoint> contact_points; ///< List of contact points found during this collision
@@ -75,13 +75,13 @@ public:
     bool init();
     void cleanup();
 
-    void add_box_collider(
+    ColliderID add_box_collider(
         const Vec3& size,
         const PhysicsMaterial& properties,
         const Vec3& offset=Vec3(), const Quaternion& rotation=Quaternion()
     );
 
-    void add_sphere_collider(const float diameter,
+    ColliderID add_sphere_collider(const float diameter,
         const PhysicsMaterial& properties,
         const Vec3& offset=Vec3()
     );
@@ -95,6 +95,8 @@ public:
     void register_collision_listener(CollisionListener* listener);
     void unregister_collision_listener(CollisionListener* listener);
 
+    bool has_collision_listeners() const { return !listeners_.empty(); }
+
     RigidBodySimulation* _simulation_ptr() const {
         if(auto ret = simulation_.lock()) {
             return ret.get();
@@ -109,29 +111,27 @@ protected:
     b3Body* body_ = nullptr;
     std::weak_ptr<RigidBodySimulation> simulation_;
 
-    std::pair<Vec3, Quaternion> last_state_;
-
     void update(float dt) override;
 
     struct ColliderDetails {
         PhysicsMaterial material;
-        std::string name;
+        ColliderID id = 0;
     };
 
-    void store_collider(b3Shape* shape, const PhysicsMaterial& material);
+    ColliderID store_collider(b3Shape* shape, const PhysicsMaterial& material);
 
     std::unordered_map<b3Shape*, ColliderDetails> collider_details_;
 
 private:
     virtual bool is_dynamic() const { return true; }
 
-    sig::connection simulation_stepped_connection_;
     std::vector<std::shared_ptr<b3Hull>> hulls_;
     std::set<CollisionListener*> listeners_;
 
     friend class impl::ContactListener;
 
     void contact_started(const Collision& collision);
+    void contact_stayed(const Collision& collision);
     void contact_finished(const Collision &collision);
 
     void on_behaviour_added(Organism* organism) override;
@@ -6,6 +6,10 @@
 namespace smlt {
 namespace behaviours {
 
+/* Identifies a collider, returned by the add_X_collider methods and used in
+ * Collisions. Unique within a simulation, 0 is never used */
+typedef uint32_t ColliderID;
+
 // Colliders available to add_X_collider
 enum ColliderType {
     /* OOB collisiion detection */
@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <cmath>
+
 #include "simulation.h"
 #include "body.h"
 #include "../../nodes/stage_node.h"
+#include "../../generic/threading/thread_pool.h"
 #include "../../deps/bounce/bounce.h"
 
 
@@ -51,6 +55,14 @@ void to_quat(const b3Quat& rhs, Quaternion& out) {
 
 namespace impl {
 
+/*
+ * Keeps the touching contacts of the world in a dense array of pairs.
+ * Bounce reports contacts beginning and ending while stepping (which may be
+ * on the physics thread), and those are recorded into a buffer for the
+ * step. dispatch_events() then sends the enter, stay and exit events in bulk
+ * on the main thread, and only builds a Collision for bodies with
+ * listeners.
+ */
 class ContactListener : public b3ContactListener {
 public:
     ContactListener(RigidBodySimulation* simulation):
@@ -65,93 +77,157 @@ public:
         Body* bodyA = (Body*) shapeA->GetUserData();
         Body* bodyB = (Body*) shapeB->GetUserData();
 
-        if(simulation_->body_exists(bodyA) && simulation_->body_exists(bodyB)) {
-            auto coll_pair = build_collision_pair(contact);
-            auto& collA = coll_pair.first;
-            auto& collB = coll_pair.second;
+        if(!simulation_->body_exists(bodyA) || !simulation_->body_exists(bodyB)) {
+            return;
+        }
+
+        if(pair_lookup_.count(contact)) {
+            return;
+        }
 
-            bodyA->contact_started(collA);
-            bodyB->contact_started(collB);
+        ContactPair pair;
+        pair.contact = contact;
+        pair.body_a = bodyA;
+        pair.body_b = bodyB;
+        pair.collider_a = bodyA->collider_details_.at(shapeA).id;
+        pair.collider_b = bodyB->collider_details_.at(shapeB).id;
+        pair.began = step_;
 
-            // FIXME: Populate contact points
+        pair_lookup_.insert(std::make_pair(contact, pairs_.size()));
+        pairs_.push_back(pair);
 
-            active_contacts_.insert(contact);
-        }
+        // FIXME: Populate contact points
+        events_.push_back(std::make_pair(CONTACT_EVENT_ENTER, pair));
     }
 
     void EndContact(b3Contact* contact) {
-        if(active_contacts_.count(contact) == 0) {
+        auto it = pair_lookup_.find(contact);
+        if(it == pair_lookup_.end()) {
             // Already released
             return;
         }
 
-        b3Shape* shapeA = contact->GetShapeA();
-        b3Shape* shapeB = contact->GetShapeB();
-
-        Body* bodyA = (Body*) shapeA->GetUserData();
-        Body* bodyB = (Body*) shapeB->GetUserData();
-
-        if(simulation_->body_exists(bodyA) && simulation_->body_exists(bodyB)) {
-            auto coll_pair = build_collision_pair(contact);
-            auto& collA = coll_pair.first;
-            auto& collB = coll_pair.second;
+        const std::size_t index = it->second;
+        pair_lookup_.erase(it);
 
-            bodyA->contact_finished(collA);
-            bodyB->contact_finished(collB);
+        events_.push_back(std::make_pair(CONTACT_EVENT_EXIT, pairs_[index]));
 
-            active_contacts_.erase(contact);
-        } else {
-            // If they don't exist but we still find the contact, then that's a problem!
-            assert(!active_contacts_.count(contact));
+        // Move the last pair into the gap
+        if(index != pairs_.size() - 1) {
+            pairs_[index] = pairs_.back();
+            pair_lookup_[pairs_[index].contact] = index;
         }
+
+        pairs_.pop_back();
     }
 
     void PreSolve(b3Contact* contact) {
 
     }
 
-    std::vector<b3Contact*> ActiveContactsForBody(b3Body* body) {
-        std::vector<b3Contact*> ret;
-        for(auto contact: active_contacts_) {
+    std::size_t contact_count() const {
+        return pairs_.size();
+    }
 
-            if(contact->GetShapeA()->GetBody() == body || contact->GetShapeB()->GetBody() == body) {
-                ret.push_back(contact);
+    /* Sends the events recorded since the last call. Stay events are only
+     * sent if the world was stepped in between */
+    void dispatch_events(bool stepped) {
+        /* Listeners can release bodies, which dispatches again, so work on
+         * a copy of the buffer */
+        std::vector<std::pair<ContactEventType, ContactPair>> events;
+        events.swap(events_);
+
+        for(auto& event: events) {
+            if(event.first == CONTACT_EVENT_ENTER) {
+                notify(CONTACT_EVENT_ENTER, event.second);
             }
         }
 
-        return ret;
-    }
-
-private:
-    std::pair<Collision, Collision> build_collision_pair(b3Contact* contact) {
-        b3Shape* shapeA = contact->GetShapeA();
-        b3Shape* shapeB = contact->GetShapeB();
+        if(stepped) {
+            for(std::size_t i = 0; i < pairs_.size(); ++i) {
+                if(pairs_[i].began != step_) {
+                    ContactPair pair = pairs_[i];
+                    notify(CONTACT_EVENT_STAY, pair);
+                }
+            }
 
-        Body* bodyA = (Body*) shapeA->GetUserData();
-        Body* bodyB = (Body*) shapeB->GetUserData();
+            ++step_;
+        }
 
-        Collision collA, collB;
+        for(auto& event: events) {
+            if(event.first == CONTACT_EVENT_EXIT) {
+                notify(CONTACT_EVENT_EXIT, event.second);
+            }
+        }
 
-        collA.this_body = bodyA;
-        collA.this_collider_name = bodyA->collider_details_.at(shapeA).name;
-        collA.this_stage_node = bodyA->stage_node.get();
+        // Hand the capacity back
+        if(events_.empty()) {
+            events.clear();
+            events_.swap(events);
+        }
+    }
 
-        collA.other_body = bodyB;
-        collA.other_collider_name = bodyB->collider_details_.at(shapeB).name;
-        collA.other_stage_node = bodyB->stage_node.get();
+private:
+    enum ContactEventType {
+        CONTACT_EVENT_ENTER,
+        CONTACT_EVENT_STAY,
+        CONTACT_EVENT_EXIT
+    };
+
+    struct ContactPair {
+        b3Contact* contact;
+        Body* body_a;
+        Body* body_b;
+        ColliderID collider_a;
+        ColliderID collider_b;
+
+        /* The step the contact began in */
+        uint32_t began;
+    };
+
+    void notify(ContactEventType type, const ContactPair& pair) {
+        if(!simulation_->body_exists(pair.body_a) || !simulation_->body_exists(pair.body_b)) {
+            // Released since
+            return;
+        }
 
-        collB.other_body = bodyA;
-        collB.other_collider_name = bodyA->collider_details_.at(shapeA).name;
-        collB.other_stage_node = bodyA->stage_node.get();
+        if(pair.body_a->has_collision_listeners()) {
+            send(type, pair.body_a, pair.collider_a, pair.body_b, pair.collider_b);
+        }
 
-        collB.this_body = bodyB;
-        collB.this_collider_name = bodyB->collider_details_.at(shapeB).name;
-        collB.this_stage_node = bodyB->stage_node.get();
+        if(pair.body_b->has_collision_listeners()) {
+            send(type, pair.body_b, pair.collider_b, pair.body_a, pair.collider_a);
+        }
+    }
 
-        return std::make_pair(collA, collB);
+    void send(ContactEventType type, Body* this_body, ColliderID this_collider, Body* other_body, ColliderID other_collider) {
+        Collision collision;
+        collision.this_body = this_body;
+        collision.this_collider = this_collider;
+        collision.this_stage_node = this_body->stage_node.get();
+        collision.other_body = other_body;
+        collision.other_collider = other_collider;
+        collision.other_stage_node = other_body->stage_node.get();
+
+        switch(type) {
+            case CONTACT_EVENT_ENTER:
+                this_body->contact_started(collision);
+            break;
+            case CONTACT_EVENT_STAY:
+                this_body->contact_stayed(collision);
+            break;
+            case CONTACT_EVENT_EXIT:
+                this_body->contact_finished(collision);
+            break;
+        }
     }
 
-    std::set<b3Contact*> active_contacts_;
+    std::vector<ContactPair> pairs_;
+    std::unordered_map<b3Contact*, std::size_t> pair_lookup_;
+
+    std::vector<std::pair<ContactEventType, ContactPair>> events_;
+    uint32_t step_ = 0;
+
     RigidBodySimulation* simulation_;
 };
 
@@ -168,7 +244,162 @@ RigidBodySimulation::RigidBodySimulation(TimeKeeper *time_keeper):
     scene_->SetContactListener(contact_listener_.get());
 }
 
+RigidBodySimulation::~RigidBodySimulation() {
+    stop_thread();
+}
+
+void RigidBodySimulation::set_step_mode(PhysicsStepMode mode) {
+    if(mode == step_mode_) {
+        return;
+    }
+
+    wait_for_step();
+
+    if(queued_step_ > 0.0f) {
+        // Don't lose a step when switching
+        signal_simulation_pre_step_();
+        step(queued_step_);
+        publish();
+        queued_step_ = 0.0f;
+    }
+
+    if(step_mode_ == PHYSICS_STEP_MODE_THREADED) {
+        stop_thread();
+    }
+
+    step_mode_ = mode;
+
+    if(step_mode_ == PHYSICS_STEP_MODE_THREADED) {
+        stopping_ = false;
+        thread_ = std::thread(&RigidBodySimulation::thread_loop, this);
+    }
+}
+
+void RigidBodySimulation::thread_loop() {
+    while(true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || thread_step_ > 0.0f; });
+
+        if(stopping_) {
+            return;
+        }
+
+        float dt = thread_step_;
+        lock.unlock();
+
+        step(dt);
+
+        lock.lock();
+        thread_step_ = 0.0f;
+        lock.unlock();
+        cv_.notify_all();
+    }
+}
+
+void RigidBodySimulation::stop_thread() {
+    if(!thread_.joinable()) {
+        return;
+    }
+
+    wait_for_step();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    cv_.notify_all();
+    thread_.join();
+}
+
+void RigidBodySimulation::step(float dt) {
+    uint32_t velocity_iterations = 8;
+    uint32_t position_iterations = 2;
+
+    scene_->Step(dt, velocity_iterations, position_iterations);
+
+    next_states_.clear();
+    for(auto& p: bodies_) {
+        auto& state = next_states_[p.first];
+        to_vec3(p.second->GetWorldCenter(), state.first);
+        to_quat(p.second->GetOrientation(), state.second);
+    }
+}
+
+void RigidBodySimulation::publish() {
+    previous_states_.swap(current_states_);
+    current_states_.swap(next_states_);
+
+    contact_listener_->dispatch_events(true);
+}
+
+void RigidBodySimulation::wait_for_step() {
+    if(!step_in_flight_) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return thread_step_ == 0.0f; });
+    }
+
+    step_in_flight_ = false;
+    publish();
+}
+
+void RigidBodySimulation::begin_queued_step() {
+    if(queued_step_ == 0.0f) {
+        return;
+    }
+
+    wait_for_step();
+
+    float dt = queued_step_;
+    queued_step_ = 0.0f;
+
+    signal_simulation_pre_step_();
+
+    if(step_mode_ == PHYSICS_STEP_MODE_THREADED && thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            thread_step_ = dt;
+        }
+
+        step_in_flight_ = true;
+        cv_.notify_all();
+    } else {
+        step(dt);
+        publish();
+    }
+}
+
+bool RigidBodySimulation::interpolation_states(const impl::Body* body, std::pair<Vec3, Quaternion>* previous, std::pair<Vec3, Quaternion>* current) const {
+    auto it = current_states_.find(body);
+    if(it == current_states_.end()) {
+        return false;
+    }
+
+    *current = it->second;
+
+    // Bodies added since the step before last don't have a previous state
+    auto prev = previous_states_.find(body);
+    *previous = (prev == previous_states_.end()) ? it->second : prev->second;
+    return true;
+}
+
+std::size_t RigidBodySimulation::contact_count() {
+    wait_for_step();
+    return contact_listener_->contact_count();
+}
+
+b3Body* RigidBodySimulation::find_body(const impl::Body* body) {
+    wait_for_step();
+    return bodies_.at(body);
+}
+
 void RigidBodySimulation::set_gravity(const Vec3& gravity) {
+    wait_for_step();
+
     b3Vec3 g;
     to_b3vec3(gravity, g);
     scene_->SetGravity(g);
@@ -180,18 +411,30 @@ bool RigidBodySimulation::init() {
 }
 
 void RigidBodySimulation::cleanup() {
-
+    stop_thread();
 }
 
-void RigidBodySimulation::fixed_update(float step) {
-    uint32_t velocity_iterations = 8;
-    uint32_t position_iterations = 2;
+void RigidBodySimulation::fixed_update(float dt) {
+    if(step_mode_ == PHYSICS_STEP_MODE_IMMEDIATE) {
+        signal_simulation_pre_step_();
+        step(dt);
+        publish();
+        return;
+    }
 
-    signal_simulation_pre_step_();
-    scene_->Step(step, velocity_iterations, position_iterations);
+    /* If the last step wasn't started (e.g. there were several fixed updates
+     * this frame) then run it now */
+    if(queued_step_ > 0.0f) {
+        begin_queued_step();
+    }
+
+    wait_for_step();
+    queued_step_ = dt;
 }
 
 std::pair<Vec3, bool> RigidBodySimulation::intersect_ray(const Vec3& start, const Vec3& direction, float* distance, Vec3* normal) {
+    wait_for_step();
+
     b3RayCastSingleShapeOutput result;
     b3Vec3 s, d;
 
@@ -220,7 +463,409 @@ std::pair<Vec3, bool> RigidBodySimulation::intersect_ray(const Vec3& start, cons
     return std::make_pair(impact_point, hit);
 }
 
+/* Queries in a batch are sorted and grouped into packets of this size */
+const static uint32_t QUERY_PACKET_SIZE = 16;
+
+/* If a packet's bounds have a larger surface area than this many times the
+ * total of its queries, the queries are too spread out to share a walk of
+ * the broadphase and are run one at a time instead */
+const static float QUERY_PACKET_COHERENCE = 4.0f;
+
+namespace {
+
+class ShapeCollector : public b3QueryListener {
+public:
+    ShapeCollector(std::vector<b3Shape*>* shapes):
+        shapes_(shapes) {}
+
+    bool ReportShape(b3Shape* shape) override {
+        shapes_->push_back(shape);
+        return true;
+    }
+
+private:
+    std::vector<b3Shape*>* shapes_;
+};
+
+float surface_area(const Vec3& lower, const Vec3& upper) {
+    Vec3 d = upper - lower;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool overlaps(const Vec3& lower0, const Vec3& upper0, const Vec3& lower1, const Vec3& upper1) {
+    return lower0.x <= upper1.x && upper0.x >= lower1.x &&
+        lower0.y <= upper1.y && upper0.y >= lower1.y &&
+        lower0.z <= upper1.z && upper0.z >= lower1.z;
+}
+
+/* Spreads the lowest 10 bits of v so there are two zero bits between each */
+uint32_t spread_bits(uint32_t v) {
+    v = (v | (v << 16)) & 0x030000FF;
+    v = (v | (v << 8)) & 0x0300F00F;
+    v = (v | (v << 4)) & 0x030C30C3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+/* Intersects the segment p + d * t (0 <= t <= max_t) with a sphere */
+bool segment_sphere(const Vec3& p, const Vec3& d, const Vec3& centre, float radius, float max_t, float* t, Vec3* normal) {
+    Vec3 m = p - centre;
+    float c = m.dot(m) - radius * radius;
+
+    if(c <= 0.0f) {
+        // Starts inside
+        *t = 0.0f;
+        *normal = (m.length_squared() > 0.0f) ? m.normalized() : -d.normalized();
+        return true;
+    }
+
+    float a = d.dot(d);
+    float b = m.dot(d);
+    if(a == 0.0f || b > 0.0f) {
+        return false;
+    }
+
+    float discriminant = b * b - a * c;
+    if(discriminant < 0.0f) {
+        return false;
+    }
+
+    float hit = (-b - std::sqrt(discriminant)) / a;
+    if(hit > max_t) {
+        return false;
+    }
+
+    *t = hit;
+    *normal = (m + d * hit).normalized();
+    return true;
+}
+
+/* Intersects the segment p + d * t (0 <= t <= max_t) with the planes of a
+ * hull pushed out by radius */
+bool segment_hull(const Vec3& p, const Vec3& d, const b3Hull* hull, float radius, float max_t, float* t, Vec3* normal) {
+    float enter = 0.0f;
+    float exit = max_t;
+    Vec3 enter_normal = -d.normalized();
+
+    for(uint32_t i = 0; i < uint32_t(hull->faceCount); ++i) {
+        const b3Plane& plane = hull->planes[i];
+        Vec3 n;
+        to_vec3(plane.normal, n);
+
+        float distance = n.dot(p) - (plane.offset + radius);
+        float rate = n.dot(d);
+
+        if(rate == 0.0f) {
+            if(distance > 0.0f) {
+                return false;
+            }
+            continue;
+        }
+
+        float hit = -distance / rate;
+        if(rate < 0.0f) {
+            if(hit > enter) {
+                enter = hit;
+                enter_normal = n;
+            }
+        } else {
+            exit = std::min(exit, hit);
+        }
+
+        if(enter > exit) {
+            return false;
+        }
+    }
+
+    *t = enter;
+    *normal = enter_normal;
+    return true;
+}
+
+}
+
+void RigidBodySimulation::run_batch(const std::vector<QueryBounds>& bounds, bool parallel, const ShapeTest& test) {
+    const uint32_t count = bounds.size();
+    if(!count) {
+        return;
+    }
+
+    wait_for_step();
+
+    /* Sort the queries along a Morton curve through their centres, so that
+     * neighbouring queries end up in the same packet */
+    Vec3 lower = bounds[0].lower;
+    Vec3 upper = bounds[0].upper;
+    for(auto& b: bounds) {
+        lower = Vec3(std::min(lower.x, b.lower.x), std::min(lower.y, b.lower.y), std::min(lower.z, b.lower.z));
+        upper = Vec3(std::max(upper.x, b.upper.x), std::max(upper.y, b.upper.y), std::max(upper.z, b.upper.z));
+    }
+
+    Vec3 extent = upper - lower;
+    Vec3 scale(
+        (extent.x > 0.0f) ? 1023.0f / extent.x : 0.0f,
+        (extent.y > 0.0f) ? 1023.0f / extent.y : 0.0f,
+        (extent.z > 0.0f) ? 1023.0f / extent.z : 0.0f
+    );
+
+    std::vector<std::pair<uint32_t, uint32_t>> order(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        Vec3 c = ((bounds[i].lower + bounds[i].upper) * 0.5f) - lower;
+        uint32_t code = spread_bits(uint32_t(c.x * scale.x)) |
+            (spread_bits(uint32_t(c.y * scale.y)) << 1) |
+            (spread_bits(uint32_t(c.z * scale.z)) << 2);
+
+        order[i] = std::make_pair(code, i);
+    }
+
+    std::sort(order.begin(), order.end());
+
+    struct Candidate {
+        b3Shape* shape;
+        Vec3 lower;
+        Vec3 upper;
+    };
+
+    auto gather = [this](const Vec3& lower, const Vec3& upper, std::vector<b3Shape*>& shapes, std::vector<Candidate>& candidates) {
+        shapes.clear();
+        candidates.clear();
+
+        b3AABB3 aabb;
+        to_b3vec3(lower, aabb.m_lower);
+        to_b3vec3(upper, aabb.m_upper);
+
+        ShapeCollector collector(&shapes);
+        scene_->QueryAABB(&collector, aabb);
+
+        for(auto shape: shapes) {
+            if(!body_exists((impl::Body*) shape->GetUserData())) {
+                continue;
+            }
+
+            // The broadphase bounds are padded, so use the actual ones
+            b3AABB3 tight;
+            shape->ComputeAABB(&tight, shape->GetBody()->GetTransform());
+
+            Candidate candidate;
+            candidate.shape = shape;
+            to_vec3(tight.m_lower, candidate.lower);
+            to_vec3(tight.m_upper, candidate.upper);
+            candidates.push_back(candidate);
+        }
+    };
+
+    auto run_packets = [&](std::size_t first, std::size_t last) {
+        std::vector<b3Shape*> shapes;
+        std::vector<Candidate> candidates;
+
+        for(std::size_t packet = first; packet < last; ++packet) {
+            const uint32_t begin = packet * QUERY_PACKET_SIZE;
+            const uint32_t end = std::min(count, begin + QUERY_PACKET_SIZE);
+
+            Vec3 packet_lower = bounds[order[begin].second].lower;
+            Vec3 packet_upper = bounds[order[begin].second].upper;
+            float area = 0.0f;
+
+            for(uint32_t i = begin; i < end; ++i) {
+                auto& b = bounds[order[i].second];
+                packet_lower = Vec3(std::min(packet_lower.x, b.lower.x), std::min(packet_lower.y, b.lower.y), std::min(packet_lower.z, b.lower.z));
+                packet_upper = Vec3(std::max(packet_upper.x, b.upper.x), std::max(packet_upper.y, b.upper.y), std::max(packet_upper.z, b.upper.z));
+                area += surface_area(b.lower, b.upper);
+            }
+
+            const bool coherent = surface_area(packet_lower, packet_upper) <= area * QUERY_PACKET_COHERENCE;
+
+            if(coherent) {
+                gather(packet_lower, packet_upper, shapes, candidates);
+            }
+
+            for(uint32_t i = begin; i < end; ++i) {
+                const uint32_t query = order[i].second;
+                auto& b = bounds[query];
+
+                if(!coherent) {
+                    gather(b.lower, b.upper, shapes, candidates);
+                }
+
+                for(auto& candidate: candidates) {
+                    if(overlaps(b.lower, b.upper, candidate.lower, candidate.upper)) {
+                        test(query, candidate.shape);
+                    }
+                }
+            }
+        }
+    };
+
+    const std::size_t packets = (count + QUERY_PACKET_SIZE - 1) / QUERY_PACKET_SIZE;
+
+    if(parallel) {
+        thread::ThreadPool::global().parallel_for(0, packets, run_packets);
+    } else {
+        run_packets(0, packets);
+    }
+}
+
+std::size_t RigidBodySimulation::intersect_rays(const std::vector<RayQuery>& rays, std::vector<QueryHit>& results, bool parallel) {
+    results.assign(rays.size(), QueryHit());
+
+    std::vector<QueryBounds> bounds(rays.size());
+    for(std::size_t i = 0; i < rays.size(); ++i) {
+        Vec3 end = rays[i].start + rays[i].direction;
+        bounds[i].lower = Vec3(std::min(rays[i].start.x, end.x), std::min(rays[i].start.y, end.y), std::min(rays[i].start.z, end.z));
+        bounds[i].upper = Vec3(std::max(rays[i].start.x, end.x), std::max(rays[i].start.y, end.y), std::max(rays[i].start.z, end.z));
+    }
+
+    /* The closest fraction along each ray so far */
+    std::vector<float> fractions(rays.size(), 1.0f);
+
+    run_batch(bounds, parallel, [&](uint32_t query, b3Shape* shape) {
+        auto& ray = rays[query];
+
+        b3RayCastInput input;
+        to_b3vec3(ray.start, input.p1);
+        to_b3vec3(ray.start + ray.direction, input.p2);
+        input.maxFraction = fractions[query];
+
+        b3RayCastOutput output;
+        if(!shape->RayCast(&output, input, shape->GetBody()->GetTransform())) {
+            return;
+        }
+
+        if(output.fraction > fractions[query]) {
+            return;
+        }
+
+        fractions[query] = output.fraction;
+
+        auto& result = results[query];
+        result.hit = true;
+        result.point = ray.start + ray.direction * output.fraction;
+        result.distance = ray.direction.length() * output.fraction;
+        to_vec3(output.normal, result.normal);
+        result.body = (impl::Body*) shape->GetUserData();
+    });
+
+    return std::count_if(results.begin(), results.end(), [](const QueryHit& hit) { return hit.hit; });
+}
+
+std::size_t RigidBodySimulation::sweep_spheres(const std::vector<SphereSweepQuery>& sweeps, std::vector<QueryHit>& results, bool parallel) {
+    results.assign(sweeps.size(), QueryHit());
+
+    std::vector<QueryBounds> bounds(sweeps.size());
+    for(std::size_t i = 0; i < sweeps.size(); ++i) {
+        auto& sweep = sweeps[i];
+        Vec3 end = sweep.start + sweep.direction;
+        Vec3 r(sweep.radius, sweep.radius, sweep.radius);
+        bounds[i].lower = Vec3(std::min(sweep.start.x, end.x), std::min(sweep.start.y, end.y), std::min(sweep.start.z, end.z)) - r;
+        bounds[i].upper = Vec3(std::max(sweep.start.x, end.x), std::max(sweep.start.y, end.y), std::max(sweep.start.z, end.z)) + r;
+    }
+
+    std::vector<float> fractions(sweeps.size(), 1.0f);
+
+    run_batch(bounds, parallel, [&](uint32_t query, b3Shape* shape) {
+        auto& sweep = sweeps[query];
+        const b3Transform& xf = shape->GetBody()->GetTransform();
+
+        b3Vec3 start, end;
+        to_b3vec3(sweep.start, start);
+        to_b3vec3(sweep.start + sweep.direction, end);
+
+        // Work in the space of the shape
+        Vec3 p, d;
+        to_vec3(b3MulT(xf, start), p);
+        to_vec3(b3MulT(xf, end), d);
+        d = d - p;
+
+        float t = 0.0f;
+        Vec3 local_normal;
+        bool hit = false;
+
+        switch(shape->GetType()) {
+            case e_sphereShape: {
+                auto sphere = (b3SphereShape*) shape;
+                Vec3 centre;
+                to_vec3(sphere->m_center, centre);
+                hit = segment_sphere(p, d, centre, sphere->m_radius + sweep.radius, fractions[query], &t, &local_normal);
+            } break;
+            case e_hullShape: {
+                auto hull = ((b3HullShape*) shape)->m_hull;
+                hit = segment_hull(p, d, hull, sweep.radius, fractions[query], &t, &local_normal);
+            } break;
+            default: {
+                b3RayCastInput input;
+                input.p1 = start;
+                input.p2 = end;
+                input.maxFraction = fractions[query];
+
+                b3RayCastOutput output;
+                if(shape->RayCast(&output, input, xf)) {
+                    hit = true;
+                    t = output.fraction;
+
+                    // The normal is in world space, but the others aren't
+                    b3Vec3 n = b3MulT(xf.rotation, output.normal);
+                    to_vec3(n, local_normal);
+                }
+            }
+        }
+
+        if(!hit || t > fractions[query]) {
+            return;
+        }
+
+        fractions[query] = t;
+
+        b3Vec3 local, world;
+        to_b3vec3(local_normal, local);
+        world = b3Mul(xf.rotation, local);
+
+        auto& result = results[query];
+        result.hit = true;
+        to_vec3(world, result.normal);
+        result.point = sweep.start + sweep.direction * t - result.normal * sweep.radius;
+        result.distance = sweep.direction.length() * t;
+        result.body = (impl::Body*) shape->GetUserData();
+    });
+
+    return std::count_if(results.begin(), results.end(), [](const QueryHit& hit) { return hit.hit; });
+}
+
+std::size_t RigidBodySimulation::overlap_boxes(const std::vector<BoxOverlapQuery>& boxes, std::vector<OverlapHit>& results, bool parallel) {
+    results.clear();
+
+    std::vector<QueryBounds> bounds(boxes.size());
+    for(std::size_t i = 0; i < boxes.size(); ++i) {
+        bounds[i].lower = boxes[i].centre - boxes[i].half_extents;
+        bounds[i].upper = boxes[i].centre + boxes[i].half_extents;
+    }
+
+    /* Each query is only ever touched by one thread */
+    std::vector<std::vector<impl::Body*>> overlapping(boxes.size());
+
+    run_batch(bounds, parallel, [&](uint32_t query, b3Shape* shape) {
+        // run_batch has already checked the bounds
+        auto body = (impl::Body*) shape->GetUserData();
+        auto& bodies = overlapping[query];
+        if(std::find(bodies.begin(), bodies.end(), body) == bodies.end()) {
+            bodies.push_back(body);
+        }
+    });
+
+    for(uint32_t i = 0; i < overlapping.size(); ++i) {
+        for(auto body: overlapping[i]) {
+            OverlapHit hit;
+            hit.query = i;
+            hit.body = body;
+            results.push_back(hit);
+        }
+    }
+
+    return results.size();
+}
+
 b3Body *RigidBodySimulation::acquire_body(impl::Body *body) {
+    wait_for_step();
+
     b3BodyDef def;
 
     bool is_dynamic = body->is_dynamic();
@@ -237,17 +882,31 @@ b3Body *RigidBodySimulation::acquire_body(impl::Body *body) {
     }
 
     bodies_[body] = scene_->CreateBody(def);
+
+    // Until the next step the body stays where it was created
+    Vec3 p;
+    Quaternion r;
+    to_vec3(def.position, p);
+    to_quat(def.orientation, r);
+    current_states_[body] = std::make_pair(p, r);
+
     return bodies_[body];
 }
 
 void RigidBodySimulation::release_body(impl::Body *body) {
-    auto bbody = bodies_.at(body);
+    auto bbody = find_body(body);
     scene_->DestroyBody(bbody);
+
+    // Destroying the body ends its contacts
+    contact_listener_->dispatch_events(false);
+
     bodies_.erase(body);
+    previous_states_.erase(body);
+    current_states_.erase(body);
 }
 
 std::pair<Vec3, Quaternion> RigidBodySimulation::body_transform(const impl::Body *body) {
-    b3Body* b = bodies_.at(body);
+    b3Body* b = find_body(body);
 
     auto position = b->GetWorldCenter();
     auto rotation = b->GetOrientation();
@@ -262,7 +921,10 @@ std::pair<Vec3, Quaternion> RigidBodySimulation::body_transform(const impl::Body
 }
 
 void RigidBodySimulation::set_body_transform(impl::Body* body, const Vec3& position, const Quaternion& rotation) {
-    b3Body* b = bodies_.at(body);
+    b3Body* b = find_body(body);
+
+    // Moving a body shouldn't interpolate from where it was
+    previous_states_[body] = current_states_[body] = std::make_pair(position, rotation);
 
     auto axis_angle = rotation.to_axis_angle();
 
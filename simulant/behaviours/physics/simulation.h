@@ -1,5 +1,9 @@
 #pragma once
 
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
 #include "../../generic/managed.h"
 #include "../../deps/kazsignal/kazsignal.h"
 #include "../../types.h"
@@ -12,6 +16,7 @@ struct b3Vec3;
 struct b3Mat33;
 struct b3Quat;
 struct b3Body;
+struct b3Shape;
 
 namespace smlt {
 
@@ -26,6 +31,68 @@ namespace impl {
 
 typedef sig::signal<void ()> SimulationPreStepSignal;
 
+enum PhysicsStepMode {
+    /* Each fixed_update() steps the simulation there and then */
+    PHYSICS_STEP_MODE_IMMEDIATE,
+
+    /* Each fixed_update() queues a step which is run by the next
+     * fixed_update() or begin_queued_step(), whichever comes first. Gives
+     * exactly the same results as PHYSICS_STEP_MODE_THREADED, but on the
+     * calling thread */
+    PHYSICS_STEP_MODE_DEFERRED,
+
+    /* Like PHYSICS_STEP_MODE_DEFERRED, except that begin_queued_step() hands
+     * the step to the physics thread. It runs there until something needs
+     * the simulation again */
+    PHYSICS_STEP_MODE_THREADED
+};
+
+/* A ray from start to start + direction */
+struct RayQuery {
+    RayQuery() = default;
+    RayQuery(const Vec3& start, const Vec3& direction):
+        start(start), direction(direction) {}
+
+    Vec3 start;
+    Vec3 direction;
+};
+
+/* A sphere moving from start to start + direction */
+struct SphereSweepQuery {
+    SphereSweepQuery() = default;
+    SphereSweepQuery(const Vec3& start, const Vec3& direction, float radius):
+        start(start), direction(direction), radius(radius) {}
+
+    Vec3 start;
+    Vec3 direction;
+    float radius = 0.0f;
+};
+
+/* An axis-aligned box */
+struct BoxOverlapQuery {
+    BoxOverlapQuery() = default;
+    BoxOverlapQuery(const Vec3& centre, const Vec3& half_extents):
+        centre(centre), half_extents(half_extents) {}
+
+    Vec3 centre;
+    Vec3 half_extents;
+};
+
+/* The closest hit of a ray or sphere sweep */
+struct QueryHit {
+    bool hit = false;
+    Vec3 point;
+    Vec3 normal;
+    float distance = 0.0f;
+    impl::Body* body = nullptr;
+};
+
+/* A body overlapping a box, there is one of these for each body a box overlaps */
+struct OverlapHit {
+    uint32_t query = 0;
+    impl::Body* body = nullptr;
+};
+
 class RigidBodySimulation:
     public Managed<RigidBodySimulation> {
 
@@ -33,16 +100,54 @@ class RigidBodySimulation:
 
 public:
     RigidBodySimulation(TimeKeeper* time_keeper);
+    ~RigidBodySimulation();
+
     bool init() override;
     void cleanup() override;
 
     void fixed_update(float step);
 
+    void set_step_mode(PhysicsStepMode mode);
+    PhysicsStepMode step_mode() const { return step_mode_; }
+
+    /* Runs (or in threaded mode, starts) the step queued by the last
+     * fixed_update(). PhysicsScene calls this after the late update so the
+     * step overlaps with rendering */
+    void begin_queued_step();
+
+    /* Waits for a step running on the physics thread to finish, and
+     * publishes its results. Anything which touches the simulation does this
+     * first, so it's only needed when timing things */
+    void wait_for_step();
+
     std::pair<Vec3, bool> intersect_ray(const Vec3& start, const Vec3& direction, float* distance=nullptr, Vec3 *normal=nullptr);
 
+    /*
+     * Batched queries. Nearby queries are grouped into packets which share a
+     * single walk of the broadphase, and if parallel is true the packets are
+     * spread across the thread pool. Results are written to a flat array:
+     * one QueryHit per query for rays and sweeps (in the same order), and an
+     * OverlapHit for each overlapping body (ordered by query) for boxes.
+     *
+     * Each returns the number of hits. The simulation must not be stepped
+     * while a batch is running.
+     */
+    std::size_t intersect_rays(const std::vector<RayQuery>& rays, std::vector<QueryHit>& results, bool parallel=false);
+
+    /* Sphere sweeps are exact against sphere colliders. Against boxes the
+     * corners and edges are treated as sharp, and against mesh colliders
+     * only the centre of the sphere is traced */
+    std::size_t sweep_spheres(const std::vector<SphereSweepQuery>& sweeps, std::vector<QueryHit>& results, bool parallel=false);
+
+    /* Boxes are tested against the bounds of each collider */
+    std::size_t overlap_boxes(const std::vector<BoxOverlapQuery>& boxes, std::vector<OverlapHit>& results, bool parallel=false);
+
     void set_gravity(const Vec3& gravity);
 
     bool body_exists(const impl::Body* body) const { return bodies_.count(body); }
+
+    /* The number of pairs of colliders currently touching */
+    std::size_t contact_count();
 private:
     friend class impl::Body;
     friend class RigidBody;
@@ -52,6 +157,7 @@ private:
 
     std::shared_ptr<b3World> scene_;
     std::shared_ptr<impl::ContactListener> contact_listener_;
+    ColliderID next_collider_id_ = 1;
 
     // Used by the RigidBodyBehaviour on creation/destruction to register a body
     // in the simulation
@@ -60,7 +166,57 @@ private:
 
     std::unordered_map<const impl::Body*, b3Body*> bodies_;
 
+    /* Waits for any step in progress and returns the bounce body */
+    b3Body* find_body(const impl::Body* body);
+
     std::pair<Vec3, Quaternion> body_transform(const impl::Body *body);
+
+    /* The transform of every body before and after the last step. Written
+     * by whichever thread ran the step (into next_states_) and swapped in
+     * on the main thread, so bodies can interpolate without waiting */
+    typedef std::unordered_map<const impl::Body*, std::pair<Vec3, Quaternion>> BodyStates;
+
+    BodyStates previous_states_;
+    BodyStates current_states_;
+    BodyStates next_states_;
+
+    bool interpolation_states(const impl::Body* body, std::pair<Vec3, Quaternion>* previous, std::pair<Vec3, Quaternion>* current) const;
+
+    PhysicsStepMode step_mode_ = PHYSICS_STEP_MODE_IMMEDIATE;
+
+    /* The step queued by fixed_update() in deferred and threaded modes, 0 if
+     * there isn't one */
+    float queued_step_ = 0.0f;
+
+    /* Runs a step and records the new body states. Can be called on the physics thread */
+    void step(float dt);
+
+    /* Swaps in the states recorded by step() and sends contact events, on the main thread */
+    void publish();
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    bool stopping_ = false;
+    float thread_step_ = 0.0f;
+
+    /* Main thread only, true between handing a step to the physics thread and publishing it */
+    bool step_in_flight_ = false;
+
+    void thread_loop();
+    void stop_thread();
+
+    /* The bounds of each query, and the function which tests a query
+     * against a shape which may be near it */
+    struct QueryBounds {
+        Vec3 lower;
+        Vec3 upper;
+    };
+
+    typedef std::function<void (uint32_t, b3Shape*)> ShapeTest;
+
+    void run_batch(const std::vector<QueryBounds>& bounds, bool parallel, const ShapeTest& test);
     void set_body_transform(impl::Body *body, const Vec3& position, const Quaternion& rotation);    
 };
 
@@ -44,10 +44,10 @@ void StaticBody::b3MeshGenerator::append_triangle(const utils::Triangle& src) {
     mesh_->BuildTree(); // Rebuild the tree
 }
 
-void StaticBody::add_mesh_collider(const MeshID &mesh_id, const PhysicsMaterial &properties, const Vec3 &offset, const Quaternion &rotation) {
+ColliderID StaticBody::add_mesh_collider(const MeshID &mesh_id, const PhysicsMaterial &properties, const Vec3 &offset, const Quaternion &rotation) {
     auto sim = simulation_.lock();
     if(!sim) {
-        return;
+        return 0;
     }
 
     // If we haven't already seen this mesh, then create a new b3Mesh for it
@@ -79,7 +79,7 @@ void StaticBody::add_mesh_collider(const MeshID &mesh_id, const PhysicsMaterial
     sdef.friction = properties.friction;
     sdef.restitution = properties.bounciness;
 
-    store_collider(sim->bodies_.at(this)->CreateShape(sdef), properties);
+    return store_collider(sim->find_body(this)->CreateShape(sdef), properties);
 }
 
 
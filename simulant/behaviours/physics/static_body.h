@@ -21,7 +21,7 @@ public:
 
     const std::string name() const { return "Static Body"; }
 
-    void add_mesh_collider(
+    ColliderID add_mesh_collider(
         const MeshID& mesh,
         const PhysicsMaterial& properties,
         const Vec3& offset=Vec3(), const Quaternion& rotation=Quaternion()
@@ -1,6 +1,9 @@
+#include <algorithm>
+
 #include "font.h"
 #include "texture.h"
 #include "material.h"
+#include "resource_manager.h"
 
 #define STB_TRUETYPE_IMPLEMENTATION  // force following include to generate implementation
 #define STBTT_STATIC
@@ -11,6 +14,13 @@
 
 namespace smlt {
 
+const uint32_t Font::PAGE_WIDTH;
+const uint32_t Font::PAGE_HEIGHT;
+const uint32_t Font::DEFAULT_MAX_PAGES;
+
+/* Gap left around each glyph so that bilinear filtering doesn't bleed */
+const static uint16_t GLYPH_PADDING = 1;
+
 Font::Font(FontID id, ResourceManager *resource_manager):
     Resource(resource_manager),
     generic::Identifiable<FontID>(id) {
@@ -18,11 +28,15 @@ Font::Font(FontID id, ResourceManager *resource_manager):
 }
 
 TextureID Font::texture_id() const {
-    return texture_->id();
+    return pages_.at(0)->texture->id();
 }
 
 MaterialID Font::material_id() const {
-    return material_->id();
+    return page_material_id(0);
+}
+
+MaterialID Font::page_material_id(uint16_t page) const {
+    return pages_.at(page)->material->id();
 }
 
 bool Font::init() {
@@ -30,24 +44,211 @@ bool Font::init() {
     return true;
 }
 
-std::pair<Vec2, Vec2> Font::texture_coordinates_for_character(char32_t ch) {
-    if(info_) {
-        stbtt_aligned_quad q;
-        float x = 0, y = 0;
+uint16_t Font::character_page(char32_t ch) {
+    return glyph(ch).page;
+}
+
+const CharInfo& Font::glyph(char32_t ch) {
+    auto it = char_data_.find(ch);
+    if(it == char_data_.end()) {
+        if(info_ && rasterise(ch)) {
+            it = char_data_.find(ch);
+        } else if(ch != '?') {
+            return glyph('?');
+        } else {
+            const static CharInfo empty = CharInfo();
+            return empty;
+        }
+    }
+
+    if(it->second.page < pages_.size()) {
+        pages_[it->second.page]->last_used = ++use_counter_;
+    }
+
+    return it->second;
+}
+
+uint16_t Font::new_page() {
+    std::unique_ptr<Page> page(new Page());
+
+    auto texture = page->texture = resource_manager().new_texture().fetch();
+    texture->set_format(TEXTURE_FORMAT_RGBA8888); // Need to use GL_RGBA for Dreamcast
+
+    // Keep the data around so that glyphs can be added to the page later
+    texture->set_free_data_mode(TEXTURE_FREE_DATA_NEVER);
+    texture->resize(PAGE_WIDTH, PAGE_HEIGHT);
+
+    page->material = resource_manager().new_material_from_file(Material::BuiltIns::TEXTURE_ONLY).fetch();
+    page->material->first_pass()->set_blending(smlt::BLEND_ALPHA);
+    page->material->set_texture_unit_on_all_passes(0, texture->id());
+
+    page->nodes.resize(PAGE_WIDTH);
+    reset_page(page.get());
+
+    pages_.push_back(std::move(page));
+    return pages_.size() - 1;
+}
+
+void Font::reset_page(Page* page) {
+    stbrp_init_target(&page->packer, PAGE_WIDTH, PAGE_HEIGHT, &page->nodes[0], page->nodes.size());
+
+    auto texture = page->texture;
+    auto lock = texture->lock();
+
+    // White, fully transparent
+    auto data = &texture->data()[0];
+    for(uint32_t i = 0; i < PAGE_WIDTH * PAGE_HEIGHT; ++i) {
+        uint32_t idx = i * 4;
+        data[idx] = data[idx + 1] = data[idx + 2] = 255;
+        data[idx + 3] = 0;
+    }
+
+    texture->mark_data_changed();
+}
+
+uint16_t Font::evict_page() {
+    auto it = std::min_element(pages_.begin(), pages_.end(), [](const std::unique_ptr<Page>& lhs, const std::unique_ptr<Page>& rhs) {
+        return lhs->last_used < rhs->last_used;
+    });
+
+    uint16_t page = std::distance(pages_.begin(), it);
+
+    L_DEBUG(_F("Evicting page {0} of font glyphs").format(page));
+
+    for(auto ch = char_data_.begin(); ch != char_data_.end();) {
+        if(ch->second.page == page) {
+            ch = char_data_.erase(ch);
+        } else {
+            ++ch;
+        }
+    }
+
+    reset_page(it->get());
+
+    // Anything using texture coordinates from the page must be rebuilt
+    ++atlas_revision_;
+
+    return page;
+}
+
+bool Font::pack(uint16_t page, uint16_t width, uint16_t height, uint16_t& x, uint16_t& y) {
+    stbrp_rect rect;
+    rect.id = 0;
+    rect.w = width + GLYPH_PADDING;
+    rect.h = height + GLYPH_PADDING;
+
+    stbrp_pack_rects(&pages_[page]->packer, &rect, 1);
 
-        stbtt_bakedchar* tmp = (stbtt_bakedchar*) &char_data_[0];
+    if(!rect.was_packed) {
+        return false;
+    }
+
+    x = rect.x;
+    y = rect.y;
+    return true;
+}
+
+bool Font::rasterise(char32_t ch) {
+    stbtt_fontinfo* info = info_.get();
+
+    int glyph = stbtt_FindGlyphIndex(info, ch);
+    if(!glyph && ch != ' ') {
+        // Not in the font
+        return false;
+    }
+
+    int advance, lsb;
+    stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(info, glyph, scale_, scale_, &x0, &y0, &x1, &y1);
+
+    const int width = x1 - x0;
+    const int height = y1 - y0;
+
+    if(width + GLYPH_PADDING > int(PAGE_WIDTH) || height + GLYPH_PADDING > int(PAGE_HEIGHT)) {
+        L_WARN(_F("Glyph {0} is too large for the font texture").format(uint32_t(ch)));
+        return false;
+    }
+
+    CharInfo c;
+    c.xoff = x0;
+    c.yoff = y0;
+    c.xadvance = float(advance) * scale_;
+
+    if(!width || !height) {
+        // Nothing to draw (e.g. whitespace)
+        c.x0 = c.x1 = c.y0 = c.y1 = 0;
+        char_data_[ch] = c;
+        return true;
+    }
+
+    uint16_t x = 0, y = 0;
+    uint16_t page = pages_.size();
+
+    // Try the most recently added pages first, they are the least full
+    for(int i = int(pages_.size()) - 1; i >= 0; --i) {
+        if(pack(i, width, height, x, y)) {
+            page = i;
+            break;
+        }
+    }
+
+    if(page == pages_.size()) {
+        page = (pages_.size() < max_pages_) ? new_page() : evict_page();
+        if(!pack(page, width, height, x, y)) {
+            return false;
+        }
+    }
+
+    c.page = page;
+    c.x0 = x;
+    c.y0 = y;
+    c.x1 = x + width;
+    c.y1 = y + height;
+
+    /* Rasterise the coverage on its own, then expand only this rectangle into
+     * the RGBA page. */
+    std::vector<uint8_t> coverage(width * height);
+    stbtt_MakeGlyphBitmap(info, &coverage[0], width, height, width, scale_, scale_, glyph);
+
+    auto texture = pages_[page]->texture;
+    {
+        auto lock = texture->lock();
+        auto data = &texture->data()[0];
+
+        for(int row = 0; row < height; ++row) {
+            uint8_t* out = data + (((y + row) * PAGE_WIDTH) + x) * 4;
+            const uint8_t* in = &coverage[row * width];
+            for(int col = 0; col < width; ++col) {
+                out[col * 4 + 3] = in[col];
+            }
+        }
 
-        stbtt_GetBakedQuad(tmp, 512, 512, ch - 32, &x, &y, &q, 1);
+        TextureRegion region;
+        region.x = x;
+        region.y = y;
+        region.width = width;
+        region.height = height;
+        texture->mark_data_changed(region);
+    }
 
+    char_data_[ch] = c;
+    return true;
+}
+
+std::pair<Vec2, Vec2> Font::texture_coordinates_for_character(char32_t ch) {
+    auto& data = glyph(ch);
+    auto pw = float(page_width(data));
+    auto ph = float(page_height(data));
+
+    if(info_) {
+        // Equivalent to stbtt_GetBakedQuad with the OpenGL fill rule
         return std::make_pair(
-            Vec2(q.s0, q.t0),
-            Vec2(q.s1, q.t1)
+            Vec2(float(data.x0) / pw, float(data.y0) / ph),
+            Vec2(float(data.x1) / pw, float(data.y1) / ph)
         );
     } else {
-        auto data = char_data_[ch - 32];
-        auto pw = float(page_width(ch));
-        auto ph = float(page_height(ch));
-
         return std::make_pair(
             Vec2(float(data.x0) / pw, float(ph - data.y0) / ph),
             Vec2(float(data.x1) / pw, float(ph - data.y1) / ph)
@@ -56,27 +257,40 @@ std::pair<Vec2, Vec2> Font::texture_coordinates_for_character(char32_t ch) {
 }
 
 float Font::character_width(char32_t ch) {
-    auto *b = &char_data_.at(ch - 32);
-    return b->x1 - b->x0;
+    auto& b = glyph(ch);
+    return b.x1 - b.x0;
 }
 
-float Font::character_height(char32_t ch) {    
-    auto *b = &char_data_.at(ch - 32);
-    return b->y1 - b->y0;
+float Font::character_height(char32_t ch) {
+    auto& b = glyph(ch);
+    return b.y1 - b.y0;
 }
 
 float Font::character_advance(char32_t ch, char32_t next) {
-    // FIXME: Kerning!
-    auto *b = &char_data_.at(ch - 32);
-    return b->xadvance;
+    float advance = glyph(ch).xadvance;
+
+    if(!next) {
+        return advance;
+    }
+
+    if(info_) {
+        advance += float(stbtt_GetCodepointKernAdvance(info_.get(), ch, next)) * scale_;
+    } else if(!kerning_.empty()) {
+        auto it = kerning_.find((uint64_t(ch) << 32) | uint64_t(next));
+        if(it != kerning_.end()) {
+            advance += it->second;
+        }
+    }
+
+    return advance;
 }
 
 std::pair<float, float> Font::character_offset(char32_t ch) {
-    auto *b = &char_data_.at(ch - 32);
+    auto& b = glyph(ch);
 
     return std::make_pair(
-        b->xoff,
-        -b->yoff
+        b.xoff,
+        -b.yoff
     );
 }
 
@@ -88,13 +302,12 @@ float Font::descent() const {
     return descent_;
 }
 
-uint16_t Font::page_width(char ch) {
-    // FIXME: This will need to change when we support multiple pages
-    return page_width_;
+uint16_t Font::page_width(const CharInfo& info) const {
+    return (info.page < pages_.size()) ? pages_[info.page]->texture->width() : PAGE_WIDTH;
 }
 
-uint16_t Font::page_height(char ch) {
-    return page_height_;
+uint16_t Font::page_height(const CharInfo& info) const {
+    return (info.page < pages_.size()) ? pages_[info.page]->texture->height() : PAGE_HEIGHT;
 }
 
 
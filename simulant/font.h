@@ -1,11 +1,15 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "deps/stb_truetype/stb_truetype.h"
+#include "utils/rect_pack.h"
 #include "types.h"
 #include "generic/managed.h"
 #include "generic/identifiable.h"
 #include "loadable.h"
 #include "resource.h"
+#include "utils/file_view.h"
 
 struct stbtt_fontinfo;
 
@@ -23,8 +27,20 @@ enum CharacterSet {
 struct CharInfo{
    uint16_t x0, y0, x1, y1; // Coordinates in the bitmap
    float xoff, yoff, xadvance; // Offsets and advance
+   uint16_t page = 0;
 };
 
+/*
+ * Bitmap fonts (.fnt) have their glyphs baked into a single page. TrueType
+ * fonts are rasterised a glyph at a time the first time each character is
+ * used, and packed into pages of PAGE_WIDTH x PAGE_HEIGHT. Only the region a
+ * new glyph covers is uploaded.
+ *
+ * When all max_pages() pages are full, the least recently used page is
+ * cleared and reused. Text built with glyphs from the evicted page is now
+ * wrong, so atlas_revision() is incremented and anything which cached texture
+ * coordinates must lay its text out again (widgets do this automatically).
+ */
 class Font:
     public Managed<Font>,
     public Resource,
@@ -32,14 +48,26 @@ class Font:
     public generic::Identifiable<FontID> {
 
 public:
+    const static uint32_t PAGE_WIDTH = 512;
+    const static uint32_t PAGE_HEIGHT = 512;
+    const static uint32_t DEFAULT_MAX_PAGES = 4;
+
     Font(FontID id, ResourceManager* resource_manager);
 
     bool init() override;
 
-    bool is_valid() const { return bool(info_) && texture_; }
+    bool is_valid() const { return bool(info_) && !pages_.empty(); }
+
+    /* The texture and material of the first page */
     TextureID texture_id() const;
     MaterialID material_id() const;
 
+    uint32_t page_count() const { return pages_.size(); }
+    MaterialID page_material_id(uint16_t page) const;
+
+    /* Returns the page the character is on, rasterising it if necessary */
+    uint16_t character_page(char32_t ch);
+
     std::pair<Vec2, Vec2> texture_coordinates_for_character(char32_t c);
     float character_width(char32_t ch);
     float character_height(char32_t ch);
@@ -51,10 +79,42 @@ public:
     float ascent() const;
     float descent() const;
 
+    void set_max_pages(uint32_t pages) { max_pages_ = std::max(pages, 1u); }
+    uint32_t max_pages() const { return max_pages_; }
+
+    /* Incremented each time a page is evicted */
+    uint32_t atlas_revision() const { return atlas_revision_; }
+
+    /* The number of glyphs currently in the pages */
+    std::size_t glyph_count() const { return char_data_.size(); }
+
 private:
+    struct Page {
+        TexturePtr texture;
+        MaterialPtr material;
+
+        /* The packer holds a pointer to nodes, so pages aren't copied */
+        stbrp_context packer;
+        std::vector<stbrp_node> nodes;
+
+        /* Stamp of the last glyph lookup on this page */
+        uint64_t last_used = 0;
+    };
+
+    /* Returns the character's glyph, rasterising it if necessary. Characters
+     * the font can't provide fall back to '?' */
+    const CharInfo& glyph(char32_t ch);
+
+    /* Rasterises a TrueType glyph into a page */
+    bool rasterise(char32_t ch);
+    bool pack(uint16_t page, uint16_t width, uint16_t height, uint16_t& x, uint16_t& y);
+    uint16_t new_page();
+    uint16_t evict_page();
+    void reset_page(Page* page);
+
     /* Given a character, return the width/height of the page it's on */
-    uint16_t page_width(char ch);
-    uint16_t page_height(char ch);
+    uint16_t page_width(const CharInfo& info) const;
+    uint16_t page_height(const CharInfo& info) const;
 
     uint32_t font_size_ = 0;
     float ascent_ = 0;
@@ -62,16 +122,20 @@ private:
     float line_gap_ = 0;
     float scale_ = 0;
 
-    // FIXME: This should be replaced when multiple page
-    // support happens
-    float page_width_ = 0;
-    float page_height_ = 0;
-
     std::unique_ptr<stbtt_fontinfo> info_;
-    std::vector<CharInfo> char_data_;
 
-    TexturePtr texture_;
-    MaterialPtr material_;
+    /* stbtt_fontinfo points into this, so it must live as long as the font */
+    FileView::ptr ttf_data_;
+    std::unordered_map<char32_t, CharInfo> char_data_;
+
+    /* Bitmap font kerning pairs, (first << 32 | second) -> amount. TrueType
+     * fonts read their kerning table directly */
+    std::unordered_map<uint64_t, float> kerning_;
+
+    std::vector<std::unique_ptr<Page>> pages_;
+    uint32_t max_pages_ = DEFAULT_MAX_PAGES;
+    uint32_t atlas_revision_ = 0;
+    uint64_t use_counter_ = 0;
 
     friend class ui::Widget;
     friend class loaders::TTFLoader;
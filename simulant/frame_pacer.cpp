@@ -0,0 +1,90 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <string>
+#include <algorithm>
+#include <limits>
+
+#include "frame_pacer.h"
+#include "time_keeper.h"
+#include "platform.h"
+
+namespace smlt {
+
+FramePacer::FramePacer(const TimeKeeper* time_keeper, const Platform* platform):
+    time_keeper_(time_keeper),
+    platform_(platform) {
+
+}
+
+void FramePacer::set_target_frame_time(float ms) {
+    target_us_ = (ms > 0.0f) ? uint64_t(ms * 1000.0f) : 0;
+    deadline_us_ = 0;
+}
+
+void FramePacer::wait() {
+    uint64_t now = time_keeper_->current_time_us();
+
+    if(!target_us_ || !deadline_us_) {
+        // Nothing to wait for, or the first frame
+        deadline_us_ = now + target_us_;
+        last_error_us_ = 0;
+        return;
+    }
+
+    /* Sleep while there's comfortably more time left than a sleep overshoots
+     * by. Each sleep stops short by the margin so waking late still lands
+     * before the deadline */
+    while(deadline_us_ > now && deadline_us_ - now > uint64_t(sleep_margin_us_) + 1000) {
+        const uint32_t ms = uint32_t((deadline_us_ - now - sleep_margin_us_) / 1000);
+
+        platform_->sleep_ms(ms);
+
+        const uint64_t after = time_keeper_->current_time_us();
+        const uint64_t slept = after - now;
+        slept_us_ += slept;
+        now = after;
+
+        /* Jump straight up to a bigger overshoot so the next sleep doesn't
+         * miss the deadline, and ease back down when they get smaller */
+        const uint32_t overshoot = uint32_t(std::min<uint64_t>(
+            (slept > ms * 1000u) ? slept - ms * 1000u : 0,
+            target_us_
+        ));
+
+        sleep_margin_us_ = (overshoot > sleep_margin_us_) ?
+            overshoot : (sleep_margin_us_ * 7 + overshoot) / 8;
+    }
+
+    // Spin out the rest
+    const uint64_t spin_start = now;
+    while(now < deadline_us_) {
+        platform_->sleep_ms(0);
+        now = time_keeper_->current_time_us();
+    }
+    spun_us_ += now - spin_start;
+
+    const uint64_t late = now - deadline_us_;
+    last_error_us_ = uint32_t(std::min<uint64_t>(late, std::numeric_limits<uint32_t>::max()));
+
+    // Schedule against the deadline so the average rate holds, unless we've fallen a whole frame behind
+    deadline_us_ = (late > target_us_) ? now + target_us_ : deadline_us_ + target_us_;
+}
+
+}
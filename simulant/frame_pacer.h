@@ -0,0 +1,79 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace smlt {
+
+class TimeKeeper;
+class Platform;
+
+/*
+ * Holds each frame back until the requested frame time has passed.
+ *
+ * Sleeping is cheap but the OS may wake us late, spinning is exact but keeps
+ * a core busy. So the wait is split in two: sleep while there's more time
+ * left than a sleep has recently overshot by, then spin (yielding) for the
+ * rest.
+ *
+ * Frames are scheduled against a deadline rather than the time the last wait
+ * ended, so a late frame is made up on the next one instead of the frame
+ * rate drifting. If a frame runs more than a whole frame late the schedule
+ * starts again from now rather than rushing to catch up.
+ */
+class FramePacer {
+public:
+    /* What a sleep is assumed to overshoot by before any have been measured */
+    const static uint32_t DEFAULT_SLEEP_MARGIN_US = 1000;
+
+    FramePacer(const TimeKeeper* time_keeper, const Platform* platform);
+
+    /* 0 to not wait at all */
+    void set_target_frame_time(float ms);
+    float target_frame_time() const { return target_us_ * 0.001f; }
+
+    /* Blocks until the next frame is due */
+    void wait();
+
+    /* How late the last wait() returned, in microseconds */
+    uint32_t last_error_us() const { return last_error_us_; }
+
+    /* The current estimate of how much a sleep overshoots by */
+    uint32_t sleep_margin_us() const { return sleep_margin_us_; }
+
+    /* Totals since construction, to see how much of the waiting burnt CPU */
+    uint64_t slept_us() const { return slept_us_; }
+    uint64_t spun_us() const { return spun_us_; }
+
+private:
+    const TimeKeeper* time_keeper_ = nullptr;
+    const Platform* platform_ = nullptr;
+
+    uint64_t target_us_ = 0;
+    uint64_t deadline_us_ = 0;
+
+    uint32_t sleep_margin_us_ = DEFAULT_SLEEP_MARGIN_US;
+    uint32_t last_error_us_ = 0;
+
+    uint64_t slept_us_ = 0;
+    uint64_t spun_us_ = 0;
+};
+
+}
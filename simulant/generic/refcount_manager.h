@@ -21,6 +21,11 @@
 
 #include <set>
 #include <list>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <limits>
+#include <algorithm>
 #include "../deps/kazsignal/kazsignal.h"
 #include "../deps/kazlog/kazlog.h"
 
@@ -34,8 +39,45 @@ enum GarbageCollectMethod {
     GARBAGE_COLLECT_PERIODIC
 };
 
+struct GarbageCollectionStats {
+    uint64_t objects_examined = 0;
+    uint64_t objects_collected = 0;
+    uint64_t objects_destroyed = 0;
+
+    /* Estimated, from memory_usage() if the object type provides it */
+    uint64_t bytes_collected = 0;
+
+    /* Collected, but not yet destroyed */
+    uint32_t pending_destruction = 0;
+
+    GarbageCollectionStats& operator+=(const GarbageCollectionStats& rhs) {
+        objects_examined += rhs.objects_examined;
+        objects_collected += rhs.objects_collected;
+        objects_destroyed += rhs.objects_destroyed;
+        bytes_collected += rhs.bytes_collected;
+        pending_destruction += rhs.pending_destruction;
+        return *this;
+    }
+};
+
+typedef std::chrono::steady_clock gc_clock;
+
 namespace generic {
 
+namespace _refcount_manager {
+
+template<typename T>
+auto memory_usage(const T* obj, int) -> decltype(std::size_t(obj->memory_usage())) {
+    return obj->memory_usage();
+}
+
+template<typename T>
+std::size_t memory_usage(const T*, long) {
+    return sizeof(T);
+}
+
+}
+
 template<
     typename ObjectType,
     typename ObjectIDType,
@@ -97,8 +139,9 @@ public:
             /* Update the containers within a lock */
             std::lock_guard<std::mutex> lock(manager_lock_);
             objects_.insert(std::make_pair(id, obj));
-            creation_times_.insert(std::make_pair(id, std::chrono::system_clock::now()));
+            creation_times_.insert(std::make_pair(id, gc_clock::now()));
             uncollected_.insert(id);
+            gc_order_.push_back(id);
         }
 
         signal_post_create_(*obj, id);
@@ -177,65 +220,96 @@ public:
         }
     }
 
-    void garbage_collect() {
-        const uint32_t MAX_COLLECTIONS = 16;
+    /*
+     * Incremental garbage collection. Each call examines up to
+     * max_examined objects, carrying on from where the last call stopped, so
+     * every object is eventually looked at no matter how many there are.
+     *
+     * Collected objects are removed from the manager immediately, but their
+     * destruction (which can mean freeing GPU resources) is spread across
+     * calls, at most max_destroyed per call, and happens outside the manager
+     * lock.
+     *
+     * Stops early if the deadline passes. Returns the number of objects
+     * collected.
+     */
+    uint32_t garbage_collect(gc_clock::time_point deadline=gc_clock::time_point::max()) {
+        uint32_t collected = 0;
 
-        std::lock_guard<std::mutex> lock(manager_lock_);
+        {
+            std::lock_guard<std::mutex> lock(manager_lock_);
 
-        auto i = 0u;
-        auto deleted = 0u;
-        for(auto obj_it = objects_.begin(); obj_it != objects_.end(); ++i) {
-            if(i == MAX_COLLECTIONS) {
-                break;
-            }
+            auto now = gc_clock::now();
+            const std::size_t to_examine = std::min<std::size_t>(max_examined_, gc_order_.size());
 
-            auto key = obj_it->first;
-            assert(key);
+            for(std::size_t i = 0; i < to_examine; ++i) {
+                /* Checking the clock isn't free, so only do it occasionally */
+                if(i && (i % 8) == 0) {
+                    now = gc_clock::now();
+                    if(now >= deadline) {
+                        break;
+                    }
+                }
 
+                if(gc_cursor_ >= gc_order_.size()) {
+                    gc_cursor_ = 0;
+                }
 
-            bool pointer_is_unique = obj_it->second.unique();
-            ObjectType* obj = obj_it->second.get();
+                auto key = gc_order_[gc_cursor_];
+                assert(key);
 
-            assert(obj);
+                auto obj_it = objects_.find(key);
+                assert(obj_it != objects_.end());
 
-            if(pointer_is_unique && obj->uses_gc()) {
-                auto it = uncollected_.find(key);
-                bool ok_to_delete = false;
+                stats_.objects_examined++;
 
-                if(it == uncollected_.end()) {
-                    //If the object has been accessed, then we can assume
-                    //that it's been used and no longer needed
-                    ok_to_delete = true;
-                } else {
-                    //Otherwise, if the object hasn't been accessed after 10 seconds
-                    //of being alive then delete it.
-                    date_time now = std::chrono::system_clock::now();
+                if(is_collectable(obj_it->first, obj_it->second, now)) {
+                    stats_.objects_collected++;
+                    stats_.bytes_collected += _refcount_manager::memory_usage(obj_it->second.get(), 0);
 
-                    int lifetime_in_seconds = std::chrono::duration_cast<std::chrono::seconds>(
-                        now - creation_times_.at(key)
-                    ).count();
+                    pending_destruction_.push_back(std::move(obj_it->second));
+                    objects_.erase(obj_it);
+                    creation_times_.erase(key);
+                    uncollected_.erase(key);
 
-                    ok_to_delete = lifetime_in_seconds > 5;
+                    /* Swap-remove, the cursor now points at the moved object
+                     * so don't advance it */
+                    gc_order_[gc_cursor_] = gc_order_.back();
+                    gc_order_.pop_back();
 
-                    if(ok_to_delete) {
-                        L_WARN("Deleting unclaimed resource");
-                    }
+                    ++collected;
+                    continue;
                 }
 
-                if(ok_to_delete) {
-                    ++deleted;
-                    obj_it = objects_.erase(obj_it);
-                    creation_times_.erase(key);
-                    continue; // Don't increment the iterator
-                }
+                ++gc_cursor_;
             }
-
-            ++obj_it;
         }
 
-        if(deleted) {
-            L_DEBUG(_F("Garbage collected {0} objects of type {1}").format(deleted, typeid(ObjectIDType).name()));
+        destroy_pending(deadline);
+
+        if(collected) {
+            L_DEBUG(_F("Garbage collected {0} objects of type {1}").format(collected, typeid(ObjectIDType).name()));
         }
+
+        return collected;
+    }
+
+    /* Destroys everything that's been collected but not destroyed yet */
+    void flush_pending_destruction() {
+        destroy_pending(gc_clock::time_point::max(), std::numeric_limits<uint32_t>::max());
+    }
+
+    void set_garbage_collection_budget(uint32_t max_examined, uint32_t max_destroyed) {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        max_examined_ = max_examined;
+        max_destroyed_ = max_destroyed;
+    }
+
+    GarbageCollectionStats garbage_collection_stats() const {
+        std::lock_guard<std::mutex> lock(manager_lock_);
+        GarbageCollectionStats result = stats_;
+        result.pending_destruction = pending_destruction_.size();
+        return result;
     }
 
     typedef std::unordered_map<ObjectIDType, std::shared_ptr<ObjectType>> ObjectMap;
@@ -270,12 +344,69 @@ public:
     }
 
 private:
-    typedef std::chrono::time_point<std::chrono::system_clock> date_time;
+    bool is_collectable(const ObjectIDType& key, const std::shared_ptr<ObjectType>& obj, gc_clock::time_point now) {
+        if(!obj.unique() || !obj->uses_gc()) {
+            return false;
+        }
+
+        if(uncollected_.find(key) == uncollected_.end()) {
+            //If the object has been accessed, then we can assume
+            //that it's been used and no longer needed
+            return true;
+        }
+
+        //Otherwise, if the object hasn't been accessed after 5 seconds
+        //of being alive then delete it.
+        if(now - creation_times_.at(key) > std::chrono::seconds(5)) {
+            L_WARN("Deleting unclaimed resource");
+            return true;
+        }
+
+        return false;
+    }
+
+    void destroy_pending(gc_clock::time_point deadline) {
+        destroy_pending(deadline, max_destroyed_);
+    }
+
+    void destroy_pending(gc_clock::time_point deadline, uint32_t max_destroyed) {
+        for(uint32_t i = 0; i < max_destroyed; ++i) {
+            std::shared_ptr<ObjectType> doomed;
+
+            {
+                std::lock_guard<std::mutex> lock(manager_lock_);
+                if(pending_destruction_.empty()) {
+                    break;
+                }
+
+                doomed = std::move(pending_destruction_.front());
+                pending_destruction_.pop_front();
+                stats_.objects_destroyed++;
+            }
+
+            /* Destroyed here, outside the lock */
+            doomed.reset();
+
+            if(gc_clock::now() >= deadline) {
+                break;
+            }
+        }
+    }
 
     ObjectMap objects_;
-    std::unordered_map<ObjectIDType, date_time> creation_times_;
+    std::unordered_map<ObjectIDType, gc_clock::time_point> creation_times_;
     mutable std::set<ObjectIDType> uncollected_;
 
+    /* Every object in objects_, in the order the collector visits them */
+    std::vector<ObjectIDType> gc_order_;
+    std::size_t gc_cursor_ = 0;
+
+    std::deque<std::shared_ptr<ObjectType>> pending_destruction_;
+
+    uint32_t max_examined_ = 64;
+    uint32_t max_destroyed_ = 8;
+    GarbageCollectionStats stats_;
+
     sig::signal<void (ObjectType&, ObjectIDType)> signal_post_create_;
     sig::signal<void (ObjectType&, ObjectIDType)> signal_pre_delete_;
 
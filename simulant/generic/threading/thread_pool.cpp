@@ -0,0 +1,176 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <memory>
+
+#include "thread_pool.h"
+#include "../exception_ptr_lite.hpp"
+
+namespace smlt {
+namespace thread {
+
+ThreadPool& ThreadPool::global() {
+#ifdef _arch_dreamcast
+    // Single core, don't bother spawning anything
+    static ThreadPool pool(0);
+#else
+    // The calling thread always participates, so leave a core for it
+    static ThreadPool pool(
+        std::max(std::thread::hardware_concurrency(), 1u) - 1
+    );
+#endif
+    return pool;
+}
+
+ThreadPool::ThreadPool(std::size_t worker_count) {
+    for(std::size_t i = 0; i < worker_count; ++i) {
+        workers_.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+
+    cv_.notify_all();
+
+    for(auto& worker: workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::worker_loop() {
+    while(true) {
+        Task task;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if(tasks_.empty()) {
+                // Only reachable when stopping
+                return;
+            }
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+bool ThreadPool::run_pending_task() {
+    Task task;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(tasks_.empty()) {
+            return false;
+        }
+
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+    }
+
+    task();
+    return true;
+}
+
+void ThreadPool::parallel_for(std::size_t begin, std::size_t end, RangeFunc func, std::size_t grain) {
+    if(end <= begin) {
+        return;
+    }
+
+    grain = std::max<std::size_t>(grain, 1);
+
+    const std::size_t total = end - begin;
+
+    /* A few chunks per thread gives reasonable load balancing when
+     * rows (or whatever) take uneven amounts of time */
+    const std::size_t max_chunks = (workers_.size() + 1) * 4;
+    const std::size_t chunk_size = std::max(grain, (total + max_chunks - 1) / max_chunks);
+
+    if(workers_.empty() || chunk_size >= total) {
+        func(begin, end);
+        return;
+    }
+
+    struct Batch {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::size_t remaining = 0;
+        stdX::exception_ptr error;
+    };
+
+    auto batch = std::make_shared<Batch>();
+    batch->remaining = (total + chunk_size - 1) / chunk_size;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for(std::size_t first = begin; first < end; first += chunk_size) {
+            std::size_t last = std::min(end, first + chunk_size);
+
+            tasks_.push_back([batch, func, first, last]() {
+                try {
+                    func(first, last);
+                } catch(...) {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    if(!batch->error) {
+                        batch->error = stdX::current_exception();
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                if(--batch->remaining == 0) {
+                    batch->cv.notify_all();
+                }
+            });
+        }
+    }
+
+    cv_.notify_all();
+
+    /* Help out rather than sitting idle, this also means nested calls
+     * to parallel_for from inside a worker can't deadlock the pool */
+    while(true) {
+        {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            if(!batch->remaining) {
+                break;
+            }
+        }
+
+        if(!run_pending_task()) {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->cv.wait(lock, [&batch]() { return batch->remaining == 0; });
+            break;
+        }
+    }
+
+    if(batch->error) {
+        stdX::rethrow_exception(batch->error);
+    }
+}
+
+}
+}
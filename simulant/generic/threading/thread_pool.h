@@ -0,0 +1,85 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace smlt {
+namespace thread {
+
+/*
+ * A small fixed-size pool of worker threads for data-parallel work
+ * (terrain generation, mesh processing and the like).
+ *
+ * Usage:
+ *
+ * ThreadPool::global().parallel_for(0, rows, [&](std::size_t first, std::size_t last) {
+ *     for(auto i = first; i < last; ++i) {
+ *         ... process row i ...
+ *     }
+ * });
+ *
+ * The calling thread takes part in the work, so a pool with zero workers
+ * (e.g. on the Dreamcast) simply runs everything inline.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void (std::size_t, std::size_t)> RangeFunc;
+
+    /* A process-wide pool sized to the number of hardware threads */
+    static ThreadPool& global();
+
+    ThreadPool(std::size_t worker_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+    std::size_t worker_count() const { return workers_.size(); }
+
+    /*
+     * Splits [begin, end) into chunks of at least `grain` items and calls
+     * func(chunk_begin, chunk_end) for each of them across the pool. Blocks
+     * until every chunk has been processed. If any chunk throws, the first
+     * exception is rethrown here once the rest have finished.
+     */
+    void parallel_for(std::size_t begin, std::size_t end, RangeFunc func, std::size_t grain=1);
+
+private:
+    typedef std::function<void ()> Task;
+
+    std::vector<std::thread> workers_;
+    std::deque<Task> tasks_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void worker_loop();
+    bool run_pending_task();
+};
+
+}
+}
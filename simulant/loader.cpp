@@ -27,6 +27,15 @@ Loader::~Loader() {
 
 }
 
+FileView::ptr Loader::file_view() {
+    if(!file_view_) {
+        auto stream = std::dynamic_pointer_cast<FileViewStream>(data_);
+        file_view_ = (stream) ? stream->view() : FileView::from_stream(*data_);
+    }
+
+    return file_view_;
+}
+
 namespace loaders {
 
 void BaseTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
@@ -34,12 +43,8 @@ void BaseTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
     Texture* tex = dynamic_cast<Texture*>(res_ptr);
     assert(tex && "You passed a Resource that is not a texture to the texture loader");
 
-    std::vector<unsigned char> buffer(
-        (std::istreambuf_iterator<char>(*this->data_)),
-        std::istreambuf_iterator<char>()
-    );
-
-    auto result = do_load(buffer);
+    auto view = file_view();
+    auto result = do_load(view->data(), view->size());
 
     /* Respect the auto_upload option if it exists*/
     bool auto_upload = true;
@@ -54,7 +59,7 @@ void BaseTextureLoader::into(Loadable& resource, const LoaderOptions& options) {
         tex->set_source(filename_);
         tex->set_format(result.format, result.texel_type);
         tex->resize(result.width, result.height);
-        tex->data().assign(result.data.begin(), result.data.end());
+        tex->data().swap(result.data);
         tex->set_auto_upload(auto_upload);
 
         if(format_stored_upside_down()) {
@@ -34,6 +34,7 @@
 #include "types.h"
 
 #include "texture.h"
+#include "utils/file_view.h"
 
 namespace smlt {
 
@@ -85,6 +86,11 @@ protected:
     unicode filename_;
     std::shared_ptr<std::istream> data_;
 
+    /* The whole file as contiguous bytes. If the loader was given a
+     * FileViewStream this is the underlying view (no copy is made), otherwise
+     * the stream is read into a buffer the first time this is called */
+    FileView::ptr file_view();
+
     template<typename T>
     T* loadable_to(Loadable& loadable) {
         T* thing = dynamic_cast<T*>(&loadable);
@@ -98,6 +104,8 @@ protected:
 
 private:
     ResourceLocator* locator_ = nullptr;
+    FileView::ptr file_view_;
+
     virtual void into(Loadable& resource, const LoaderOptions& options = LoaderOptions()) = 0;
 };
 
@@ -144,7 +152,7 @@ public:
 
 private:
     virtual bool format_stored_upside_down() const { return true; }
-    virtual TextureLoadResult do_load(const std::vector<uint8_t>& buffer) = 0;
+    virtual TextureLoadResult do_load(const uint8_t* data, std::size_t size) = 0;
 };
 
 }
@@ -3,7 +3,7 @@
 namespace smlt {
 namespace loaders {
 
-TextureLoadResult DDSTextureLoader::do_load(const std::vector<uint8_t> &buffer) {
+TextureLoadResult DDSTextureLoader::do_load(const uint8_t* data, std::size_t size) {
     throw std::logic_error("Not yet implemented");
 }
 
@@ -63,6 +63,12 @@ struct Char {
     uint8_t page;
     uint8_t channel;
 };
+
+struct KerningPair {
+    uint32_t first;
+    uint32_t second;
+    int16_t amount;
+};
 #pragma pack()
 
 
@@ -107,9 +113,7 @@ void FNTLoader::read_text(Font* font, std::istream& data, const LoaderOptions &o
         } else if(type == "chars") {
 
         } else if(type == "char") {
-            auto id = std::stoi(line_settings["id"]) - 32;
-
-            assert(id >= 0);
+            char32_t id = std::stoi(line_settings["id"]);
 
             CharInfo c;
             c.x0 = std::stof(line_settings["x"]);
@@ -121,14 +125,13 @@ void FNTLoader::read_text(Font* font, std::istream& data, const LoaderOptions &o
             c.yoff = std::stoi(line_settings["yoffset"]);
             c.xadvance = std::stoi(line_settings["xadvance"]);
 
-            // Make sure we can contain this character and
-            // assign to the right place
-            font->char_data_.resize(id + 1);
             font->char_data_[id] = c;
         } else if(type == "kernings") {
 
         } else if(type == "kerning") {
-
+            uint64_t first = std::stoi(line_settings["first"]);
+            uint64_t second = std::stoi(line_settings["second"]);
+            font->kerning_[(first << 32) | second] = std::stoi(line_settings["amount"]);
         } else {
             L_WARN("Unexpected line type while parsing FNT");
         }
@@ -155,6 +158,7 @@ void FNTLoader::read_binary(Font* font, std::istream& data, const LoaderOptions&
     Common common;
     std::vector<std::string> pages;
     std::vector<Char> chars;
+    std::vector<KerningPair> kerning;
 
     std::memset(info.name, 0, 256);
 
@@ -202,20 +206,20 @@ void FNTLoader::read_binary(Font* font, std::istream& data, const LoaderOptions&
                 data.read((char*) &chars[0], sizeof(Char) * char_count);
             } break;
             case KERNING_PAIRS: {
-                // Do nothing with this for now, just skip to the end of the file
-                char buffer[header.size];
-                data.read(buffer, header.size);
+                auto pair_count = header.size / sizeof(KerningPair);
+                if(pair_count) {
+                    kerning.resize(pair_count);
+                    data.read((char*) &kerning[0], sizeof(KerningPair) * pair_count);
+                }
             } break;
         }
     }
 
     font->line_gap_ = common.line_height;
-    font->char_data_.resize(chars.size());
     font->font_size_ = info.font_size;
 
-    uint32_t i = 0;;
     for(auto& ch: chars) {
-        auto& dst = font->char_data_[i];
+        auto& dst = font->char_data_[ch.id];
         dst.x0 = ch.x;
         dst.x1 = ch.x + ch.width;
         dst.y0 = ch.y;
@@ -223,7 +227,10 @@ void FNTLoader::read_binary(Font* font, std::istream& data, const LoaderOptions&
         dst.xoff = ch.xoffset;
         dst.yoff = ch.yoffset;
         dst.xadvance = ch.xadvance;
-        ++i;
+    }
+
+    for(auto& pair: kerning) {
+        font->kerning_[(uint64_t(pair.first) << 32) | pair.second] = pair.amount;
     }
 
     prepare_texture(font, pages[0]);
@@ -240,32 +247,30 @@ void FNTLoader::prepare_texture(Font* font, const std::string& texture_file) {
     flags.auto_upload = false;
     flags.filter = TEXTURE_FILTER_BILINEAR;
 
-    font->texture_ = font->resource_manager().new_texture_from_file(texture_path, flags).fetch();
+    std::unique_ptr<Font::Page> page(new Font::Page());
 
-    font->material_ = font->resource_manager().new_material_from_file(Material::BuiltIns::TEXTURE_ONLY).fetch();
-    font->material_->set_texture_unit_on_all_passes(0, font->texture_id());
+    auto texture = page->texture = font->resource_manager().new_texture_from_file(texture_path, flags).fetch();
 
-    // Set the page dimensions
-    // FIXME: Multiple pages
-    font->page_height_ = font->texture_->height();
-    font->page_width_ = font->texture_->width();
+    page->material = font->resource_manager().new_material_from_file(Material::BuiltIns::TEXTURE_ONLY).fetch();
+    page->material->set_texture_unit_on_all_passes(0, texture->id());
+    page->material->first_pass()->set_blending(BLEND_ALPHA);
 
-    font->material_->first_pass()->set_blending(BLEND_ALPHA);
+    font->pages_.push_back(std::move(page));
 
-    if(font->texture_->channels() == 1) {
+    if(texture->channels() == 1) {
         /*
          * Convert 1 channel textures to 4 channel, 16 bits-per-pixel textures
          * which are the most compressed format we can send the Dreamcast without
          * getting bogged down with VQ compression or paletted textures
          */
-        font->texture_->convert(
+        texture->convert(
             TEXTURE_FORMAT_RGBA4444,
             {{TEXTURE_CHANNEL_ONE, TEXTURE_CHANNEL_ONE, TEXTURE_CHANNEL_ONE, TEXTURE_CHANNEL_RED}}
         );
     }
 
     // OK, it's fine to upload now
-    font->texture_->set_auto_upload(true);
+    texture->set_auto_upload(true);
 }
 
 void FNTLoader::into(Loadable& resource, const LoaderOptions& options) {
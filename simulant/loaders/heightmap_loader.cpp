@@ -21,6 +21,8 @@
 #include "../meshes/mesh.h"
 #include "../resource_manager.h"
 #include "texture_loader.h"
+#include "../utils/terrain_kernels.h"
+#include "../generic/threading/thread_pool.h"
 
 namespace smlt {
 
@@ -107,122 +109,129 @@ std::vector<Vec3> get_surrounding_vertices(MeshPtr terrain, int x, int z) {
 }
 
 
-static void _smooth_terrain_iteration(Mesh* mesh, int width, int height) {
-    VertexData& vertex_data = mesh->vertex_data;
+static void _read_heights(Mesh* terrain, std::vector<float>& heights) {
+    VertexData& vertex_data = terrain->vertex_data;
 
-    vertex_data.move_to_start();
+    const uint32_t count = vertex_data.count();
+    const uint32_t stride = vertex_data.stride();
+    const uint32_t offset = vertex_data.specification().position_offset() + sizeof(float);
+    const uint8_t* data = vertex_data.data();
 
-    for(uint32_t i = 0; i < mesh->vertex_data->count(); ++i) {
-        auto this_pos = vertex_data.position_at<Vec3>(i);
-        auto vertices = _get_surrounding_vertices_from_index(mesh, i);
+    heights.resize(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        heights[i] = *((const float*) (data + (i * stride) + offset));
+    }
+}
 
-        float total_height = this_pos.y;
-        for(auto& vert: vertices) {
-            total_height += vert.y;
-        }
+static void _write_heights(Mesh* terrain, const std::vector<float>& heights) {
+    VertexData& vertex_data = terrain->vertex_data;
 
-        // http://nic-gamedev.blogspot.co.uk/2013/02/simple-terrain-smoothing.html
+    const uint32_t stride = vertex_data.stride();
+    const uint32_t offset = vertex_data.specification().position_offset() + sizeof(float);
+    uint8_t* data = vertex_data.data();
 
-        float new_height = total_height / float(vertices.size() + 1);
-        vertex_data.position(this_pos.x, new_height, this_pos.z);
-        vertex_data.move_next();
+    for(uint32_t i = 0; i < heights.size(); ++i) {
+        *((float*) (data + (i * stride) + offset)) = heights[i];
     }
 }
 
-void smooth_terrain_iteration(MeshPtr mesh, int width, int height) {
-    _smooth_terrain_iteration(mesh.get(), width, height);
+static void _write_normals(Mesh* terrain, const std::vector<Vec3>& normals) {
+    VertexData& vertex_data = terrain->vertex_data;
+
+    assert(vertex_data.specification().normal_attribute == VERTEX_ATTRIBUTE_3F);
+
+    const uint32_t stride = vertex_data.stride();
+    const uint32_t offset = vertex_data.specification().normal_offset();
+    uint8_t* data = vertex_data.data();
+
+    for(uint32_t i = 0; i < normals.size(); ++i) {
+        *((Vec3*) (data + (i * stride) + offset)) = normals[i];
+    }
 }
 
 static void _smooth_terrain(Mesh* terrain, uint32_t iterations) {
     TerrainData data = terrain->data->get<TerrainData>("terrain_data");
 
-    for(uint32_t i = 0; i < iterations; ++i) {
-        _smooth_terrain_iteration(terrain, data.x_size, data.z_size);
-    }
+    std::vector<float> heights;
+    _read_heights(terrain, heights);
+    smooth_heights(&heights[0], data.x_size, data.z_size, iterations);
+    _write_heights(terrain, heights);
+
+    terrain->vertex_data->done();
 }
 
 void smooth_terrain(MeshPtr terrain, uint32_t iterations) {
     _smooth_terrain(terrain.get(), iterations);
 }
 
-}
+void recalculate_terrain_normals(MeshPtr terrain) {
+    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
 
+    std::vector<float> heights;
+    _read_heights(terrain.get(), heights);
 
-namespace loaders {
+    std::vector<Vec3> normals(heights.size());
+    calculate_normals(&heights[0], data.x_size, data.z_size, data.grid_spacing, &normals[0]);
+    _write_normals(terrain.get(), normals);
 
-inline float clamp(float x, float a, float b) {
-    return x < a ? a : (x > b ? b : x);
+    terrain->vertex_data->done();
 }
 
-smlt::Colour colour_for_vertex(const smlt::Vec3& point, const smlt::Vec3& normal, const std::vector<Vec3>& surrounding_points) {
-    // FIXME: Replace with some kind of decent ambient occlusion
-    float sum = 0.0f;
-
-    for(auto& neighbour_pos: surrounding_points) {
-        auto neighbour_offset = (neighbour_pos - point).normalized();
-        sum += acos(normal.dot(neighbour_offset));
-    }
+TextureID generate_alphamap(MeshPtr terrain, AlphaMapWeightFunc func) {
+    TerrainData data = terrain->data->get<TerrainData>("terrain_data");
 
-    float v = sum / float(surrounding_points.size());
+    std::vector<float> heights;
+    _read_heights(terrain.get(), heights);
 
-    // If the average angle > 90 degrees, then we are white
-    if(v > 3.142f / 2.0) {
-        return smlt::Colour::WHITE;
+    std::vector<Vec3> normals(heights.size());
+    if(terrain->vertex_data->specification().has_normals()) {
+        for(uint32_t i = 0; i < normals.size(); ++i) {
+            terrain->vertex_data->normal_at(i, normals[i]);
+        }
     } else {
-        v /= (3.142 / 2.0);
+        calculate_normals(&heights[0], data.x_size, data.z_size, data.grid_spacing, &normals[0]);
     }
 
-    return smlt::Colour(v, v, v, 1.0);
-}
+    TextureID tid = terrain->resource_manager().new_texture();
+    auto tex = tid.fetch();
+    auto lock = tex->lock();
 
-std::vector<Vec3> gather_surrounding_points(VertexData* data, int width, int height, uint32_t i) {
-    int32_t vertex_count = (width * height);
+    tex->set_format(TEXTURE_FORMAT_RGBA8888);
+    tex->resize(data.x_size, data.z_size);
 
-    std::vector<uint32_t> surrounding_indexes;
+    uint8_t* out = &tex->data()[0];
+    const uint32_t width = data.x_size;
 
-    bool can_left = i % (uint32_t)width > 1;
-    bool can_up = i > (uint32_t)width;
-    bool can_right = i % (uint32_t)width < ((uint32_t)width - 1);
-    bool can_down = i < vertex_count - (uint32_t)width;
+    auto to_byte = [](float v) -> uint8_t {
+        return uint8_t(std::min(1.0f, std::max(0.0f, v)) * 255.0f);
+    };
 
-    if(can_up) {
-        surrounding_indexes.push_back(i - width);
-        if(can_left) {
-            surrounding_indexes.push_back(i - width - 1);
-        }
-        if(can_right) {
-            surrounding_indexes.push_back(i - width + 1);
-        }
-    }
+    /* Rows are independent, so func must be safe to call from multiple threads */
+    thread::ThreadPool::global().parallel_for(0, data.z_size, [&](std::size_t first, std::size_t last) {
+        for(auto z = first; z < last; ++z) {
+            for(uint32_t x = 0; x < width; ++x) {
+                uint32_t idx = (z * width) + x;
 
-    if(can_left) {
-        surrounding_indexes.push_back(i - 1);
-    }
+                float w1 = 0.0f, w2 = 0.0f, w3 = 0.0f, w4 = 0.0f;
+                func(heights[idx], normals[idx], w1, w2, w3, w4);
 
-    if(can_right) {
-        surrounding_indexes.push_back(i + 1);
-    }
-
-    if(can_down) {
-        surrounding_indexes.push_back(i + width);
-        if(can_left) {
-            surrounding_indexes.push_back(i + width - 1);
-        }
-        if(can_right) {
-            surrounding_indexes.push_back(i + width + 1);
+                uint8_t* texel = out + (idx * 4);
+                texel[0] = to_byte(w1);
+                texel[1] = to_byte(w2);
+                texel[2] = to_byte(w3);
+                texel[3] = to_byte(w4);
+            }
         }
-    }
+    }, 16);
 
-    std::vector<Vec3> results;
-    for(auto& idx: surrounding_indexes) {
-        results.push_back(data->position_at<Vec3>(idx));
-    }
-
-    return results;
+    tex->mark_data_changed();
+    return tid;
 }
 
+}
 
 
+namespace loaders {
 
 void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     Loadable* res_ptr = &resource;
@@ -285,7 +294,8 @@ void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     auto& tex_data = tex->data();
     auto stride = tex->bytes_per_pixel();
     for(int32_t i = 0; i < total; i++) {
-        heights[i] = float(tex_data[i * stride]) / 256.0f;
+        float normalized_height = float(tex_data[i * stride]) / 256.0f;
+        heights[i] = spec.min_height + (range * normalized_height);
     }
 
     // Add some properties for the user to access if they need to
@@ -297,96 +307,119 @@ void HeightmapLoader::into(Loadable &resource, const LoaderOptions &options) {
     data.grid_spacing = spec.spacing;
     mesh->data->stash(data, "terrain_data");
 
-    // Generate the vertices from the heightmap
-    for(int32_t z = 0; z < height; ++z) {
-        for(int32_t x = 0; x < width; ++x) {
-            int32_t idx = (z * width) + x;
-
-            float normalized_height = heights[idx];
-            float depth = range * normalized_height;
-            float final_pos = spec.min_height + depth;
-
-            Vec3 pos = Vec3(
-                (float(x) * spec.spacing) - x_offset,
-                final_pos,
-                (float(z) * spec.spacing) - z_offset
-            );
-            mesh->vertex_data->position(pos);
-            mesh->vertex_data->normal(Vec3(0, 1, 0));
-
-            mesh->vertex_data->diffuse(smlt::Colour::WHITE);
-
-            // First texture coordinate takes into account texture_repeat setting
-            mesh->vertex_data->tex_coord0(
-                (spec.texcoord0_repeat / float(largest)) * float(x),
-                (spec.texcoord0_repeat / float(largest)) * float(z)
-            );
-
-            // Second texture coordinate makes the texture span the entire terrain
-            mesh->vertex_data->tex_coord1(
-                (1.0 / float(width)) * float(x),
-                (1.0 / float(height)) * float(z)
-            );
-
-            mesh->vertex_data->move_next();
-
-            if(z < (height - 1) && x < (width - 1)) {
-                int patch_x = (x / float(patch_size));
-                int patch_z = (z / float(patch_size));
-                int patch_idx = (patch_z * patches_across) + patch_x;
-
-                auto sm = submeshes.at(patch_idx);
-                sm->index_data->index(idx);
-                sm->index_data->index(idx + width);
-                sm->index_data->index(idx + 1);
-
-                sm->index_data->index(idx + 1);
-                sm->index_data->index(idx + width);
-                sm->index_data->index(idx + width + 1);
-            }
-        }
-    }
-
+    /* Smoothing and normal generation work on the raw height grid rather than
+     * the vertex data, which lets them run as row-parallel kernels */
     if(spec.smooth_iterations) {
-        terrain::_smooth_terrain(mesh, spec.smooth_iterations);
+        terrain::smooth_heights(&heights[0], width, height, spec.smooth_iterations);
     }
 
-    if(spec.calculate_normals) {
-        // The mesh don't have any normals, let's generate some!
-        std::unordered_map<int, smlt::Vec3> index_to_normal;
-
-        for(auto sm: submeshes) {
-            // Go through all the triangles, add the face normal to all the vertices
-            for(uint32_t i = 0; i < sm->index_data->count(); i+=3) {
-                Index idx1 = sm->index_data->at(i);
-                Index idx2 = sm->index_data->at(i+1);
-                Index idx3 = sm->index_data->at(i+2);
-
-                smlt::Vec3 v1, v2, v3;
-                v1 = sm->vertex_data->position_at<Vec3>(idx1);
-                v2 = sm->vertex_data->position_at<Vec3>(idx2);
-                v3 = sm->vertex_data->position_at<Vec3>(idx3);
+    std::vector<Vec3> normals;
+    if(spec.calculate_normals || spec.calculate_occlusion) {
+        normals.resize(total);
+        terrain::calculate_normals(&heights[0], width, height, spec.spacing, &normals[0]);
+    }
 
-                smlt::Vec3 normal = (v2 - v1).normalized().cross((v3 - v1).normalized()).normalized();
+    std::vector<float> occlusion;
+    if(spec.calculate_occlusion) {
+        occlusion.resize(total);
+        terrain::calculate_occlusion(&heights[0], &normals[0], width, height, spec.spacing, &occlusion[0]);
+    }
 
-                index_to_normal[idx1] += normal;
-                index_to_normal[idx2] += normal;
-                index_to_normal[idx3] += normal;
+    // Generate the vertices from the heightmap
+    VertexData& vertex_data = mesh->vertex_data;
+    const VertexSpecification& vspec = vertex_data.specification();
+
+    assert(vspec.position_attribute == VERTEX_ATTRIBUTE_3F);
+    assert(!vspec.has_normals() || vspec.normal_attribute == VERTEX_ATTRIBUTE_3F);
+    assert(!vspec.has_texcoord0() || vspec.texcoord0_attribute == VERTEX_ATTRIBUTE_2F);
+    assert(!vspec.has_texcoord1() || vspec.texcoord1_attribute == VERTEX_ATTRIBUTE_2F);
+    assert(!vspec.has_diffuse() || vspec.diffuse_attribute == VERTEX_ATTRIBUTE_4F);
+
+    vertex_data.resize(total);
+
+    uint8_t* vertices = vertex_data.data();
+    const uint32_t vertex_stride = vertex_data.stride();
+
+    thread::ThreadPool::global().parallel_for(0, height, [&](std::size_t first, std::size_t last) {
+        for(int32_t z = first; z < (int32_t) last; ++z) {
+            for(int32_t x = 0; x < width; ++x) {
+                int32_t idx = (z * width) + x;
+                uint8_t* vertex = vertices + (idx * vertex_stride);
+
+                *((Vec3*) (vertex + vspec.position_offset())) = Vec3(
+                    (float(x) * spec.spacing) - x_offset,
+                    heights[idx],
+                    (float(z) * spec.spacing) - z_offset
+                );
+
+                if(vspec.has_normals()) {
+                    *((Vec3*) (vertex + vspec.normal_offset())) = (spec.calculate_normals) ?
+                        normals[idx] : Vec3(0, 1, 0);
+                }
+
+                if(vspec.has_diffuse()) {
+                    const float o = (occlusion.empty()) ? 1.0f : occlusion[idx];
+                    *((Vec4*) (vertex + vspec.diffuse_offset())) = Vec4(o, o, o, 1.0f);
+                }
+
+                // First texture coordinate takes into account texture_repeat setting
+                if(vspec.has_texcoord0()) {
+                    *((Vec2*) (vertex + vspec.texcoord0_offset())) = Vec2(
+                        (spec.texcoord0_repeat / float(largest)) * float(x),
+                        (spec.texcoord0_repeat / float(largest)) * float(z)
+                    );
+                }
+
+                // Second texture coordinate makes the texture span the entire terrain
+                if(vspec.has_texcoord1()) {
+                    *((Vec2*) (vertex + vspec.texcoord1_offset())) = Vec2(
+                        (1.0 / float(width)) * float(x),
+                        (1.0 / float(height)) * float(z)
+                    );
+                }
             }
         }
+    }, 16);
+
+    // Each patch writes to its own submesh, so they can be built in parallel
+    thread::ThreadPool::global().parallel_for(0, total_patches, [&](std::size_t first, std::size_t last) {
+        std::vector<uint32_t> indexes;
+        indexes.reserve(patch_size * patch_size * 6);
+
+        for(auto patch_idx = first; patch_idx < last; ++patch_idx) {
+            int32_t patch_x = patch_idx % patches_across;
+            int32_t patch_z = patch_idx / patches_across;
+
+            int32_t start_x = patch_x * patch_size;
+            int32_t start_z = patch_z * patch_size;
+            int32_t end_x = std::min(start_x + patch_size, width - 1);
+            int32_t end_z = std::min(start_z + patch_size, height - 1);
+
+            indexes.clear();
+            for(int32_t z = start_z; z < end_z; ++z) {
+                for(int32_t x = start_x; x < end_x; ++x) {
+                    uint32_t idx = (z * width) + x;
+
+                    indexes.push_back(idx);
+                    indexes.push_back(idx + width);
+                    indexes.push_back(idx + 1);
+
+                    indexes.push_back(idx + 1);
+                    indexes.push_back(idx + width);
+                    indexes.push_back(idx + width + 1);
+                }
+            }
 
-        // Now set the normal on the vertex data
-        for(auto p: index_to_normal) {
-            mesh->vertex_data->move_to(p.first);
-            auto n = p.second.normalized();
-            mesh->vertex_data->normal(n);
+            if(!indexes.empty()) {
+                submeshes[patch_idx]->index_data->index(&indexes[0], indexes.size());
+            }
         }
-    }
+    });
 
     for(auto sm: submeshes) {
         sm->index_data->done();
     }
-    mesh->vertex_data->done();
+    vertex_data.done();
 
     mesh->resource_manager().delete_texture(tid); //Finally delete the texture
 
@@ -41,6 +41,12 @@ typedef std::function<void (float height, const Vec3&, float& weight1, float& we
 
 void recalculate_terrain_normals(smlt::MeshPtr terrain);
 void smooth_terrain(smlt::MeshPtr terrain, uint32_t iterations=20);
+
+/*
+ * Generates an RGBA texture the same size as the terrain grid, each texel
+ * containing the four weights returned by func. Rows are generated in
+ * parallel so func must be safe to call from multiple threads.
+ */
 TextureID generate_alphamap(smlt::MeshPtr terrain, AlphaMapWeightFunc func);
 
 }
@@ -52,6 +58,10 @@ struct HeightmapSpecification {
     uint32_t smooth_iterations = 0;
     bool calculate_normals = true;
     float texcoord0_repeat = 4.0f;
+
+    /* Darken the vertex colours in creases and valleys with a cheap ambient
+     * occlusion term. Otherwise the vertex colours are white */
+    bool calculate_occlusion = false;
 };
 
 namespace loaders {
@@ -62,9 +72,6 @@ public:
         Loader(filename, data) {}
 
     void into(Loadable& resource, const LoaderOptions& options = LoaderOptions());
-
-private:
-    void smooth_terrain_iteration(Mesh *mesh, int width, int height);
 };
 
 class HeightmapLoaderType : public LoaderType {
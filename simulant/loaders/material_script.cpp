@@ -204,6 +204,8 @@ void MaterialScript::handle_pass_set_command(Material& mat, const std::vector<un
             pass->uniforms->register_auto(SP_AUTO_MATERIAL_SPECULAR, variable_name);
         } else if(arg_1 == "ACTIVE_TEXTURE_UNITS") {
             pass->uniforms->register_auto(SP_AUTO_MATERIAL_ACTIVE_TEXTURE_UNITS, variable_name);
+        } else if(arg_1 == "VIEWPORT_HEIGHT") {
+            pass->uniforms->register_auto(SP_AUTO_VIEWPORT_HEIGHT, variable_name);
         } else {
             throw SyntaxError(_u("Unhandled auto-uniform: {0}").format(arg_1));
         }
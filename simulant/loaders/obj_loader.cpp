@@ -17,8 +17,11 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <string>
+#include <limits>
+#include <stdexcept>
 
 #include "obj_loader.h"
+#include "obj_parser.h"
 
 #include "../meshes/mesh.h"
 #include "../resource_manager.h"
@@ -39,40 +42,69 @@ void parse_face(const std::string& input, int32_t& vertex_index, int32_t& tex_in
      *  and outputs to the passed references. The index will equal -1 if it wasn't in the input
      */
 
-    auto parts = split(input, "/");
-    auto slash_count = count(input, "/");
-
-    if(slash_count == 0 || ends_with(input, "//")) {
-        tex_index = -1;
-        normal_index = -1;
-        vertex_index = std::stoi(parts[0]);
-    } else if(slash_count == 1) {
-        normal_index = -1;
-        vertex_index = std::stoi(parts[0]);
-        tex_index = std::stoi(parts[1]);
-    } else if(slash_count == 2) {
-        if(contains(input, "//")) {
-            tex_index = -1;
-        } else {
-            tex_index = std::stoi(parts[1]);
-        }
+    const char* first = input.c_str();
+    const char* last = first + input.size();
 
-        vertex_index = std::stoi(parts[0]);
-        normal_index = std::stoi(parts[parts.size() - 1]);
+    if(parse_corner(first, last, vertex_index, tex_index, normal_index) == first) {
+        throw std::invalid_argument("Malformed face: " + input);
     }
 
     //Handle the 1-based indexing
-    if(vertex_index > -1) {
-        vertex_index -= 1;
+    vertex_index -= 1;
+    tex_index -= 1;
+    normal_index -= 1;
+}
+
+static MaterialPtr create_material(Mesh* mesh, const MTLMaterial& desc, const unicode& obj_filename) {
+    // Clone the default material
+    auto mat = mesh->resource_manager().clone_default_material().fetch();
+
+    if(desc.has_shininess) {
+        mat->pass(0)->set_shininess(desc.shininess);
+    }
+
+    if(desc.has_ambient) {
+        mat->pass(0)->set_ambient(smlt::Colour(desc.ambient.x, desc.ambient.y, desc.ambient.z, 1.0));
     }
 
-    if(tex_index > -1) {
-        tex_index -= 1;
+    if(desc.has_diffuse) {
+        mat->pass(0)->set_diffuse(smlt::Colour(desc.diffuse.x, desc.diffuse.y, desc.diffuse.z, 1.0));
     }
 
-    if(normal_index > -1) {
-        normal_index -= 1;
+    if(desc.has_specular) {
+        mat->pass(0)->set_specular(smlt::Colour(desc.specular.x, desc.specular.y, desc.specular.z, 1.0));
+    }
+
+    if(!desc.diffuse_map.empty()) {
+        std::vector<std::string> possible_locations;
+
+        // Check relative texture file first
+        possible_locations.push_back(
+            kfs::path::join(
+                kfs::path::dir_name(obj_filename.encode()),
+                desc.diffuse_map
+            )
+        );
+
+        // Check potentially absolute file path
+        possible_locations.push_back(desc.diffuse_map);
+
+        bool found = false;
+        for(auto& texture_file: possible_locations) {
+            if(kfs::path::exists(texture_file)) {
+                auto tex_id = mesh->resource_manager().new_texture_from_file(texture_file);
+                mat->set_texture_unit_on_all_passes(0, tex_id);
+                found = true;
+                break;
+            }
+        }
+
+        if(!found) {
+            L_WARN(_F("Unable to locate texture {0}").format(desc.diffuse_map));
+        }
     }
+
+    return mat;
 }
 
 void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
@@ -80,14 +112,38 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
 
     L_DEBUG(_F("Loading mesh from {0}").format(filename_));
 
-    std::vector<Vec3> vertices;
-    std::vector<Vec2> tex_coords;
-    std::vector<Vec3> normals;
+    /* The file is parsed straight out of the mapped view, so nothing the size
+     * of the file is copied */
+    OBJData obj;
+    {
+        auto view = file_view();
+        const char* text = (const char*) view->data();
+        parse_obj(text, text + view->size(), obj);
+    }
 
     std::unordered_map<std::string, smlt::MaterialPtr> materials;
-    SubMesh* sm = nullptr;
+    bool has_materials = false;
 
-    std::string current_material;
+    std::vector<MTLMaterial> descs;
+    for(auto& library: obj.material_libraries) {
+        unicode filename = kfs::path::join(kfs::path::dir_name(filename_.encode()), library);
+
+        descs.clear();
+
+        try {
+            auto view = locator->map_file(filename);
+            const char* text = (const char*) view->data();
+            parse_mtl(text, text + view->size(), descs);
+        } catch(ResourceMissingError& e) {
+            L_DEBUG(_F("mtllib {0} not found. Skipping.").format(filename));
+            continue;
+        }
+
+        for(auto& desc: descs) {
+            materials[desc.name] = create_material(mesh, desc, filename_);
+            has_materials = true;
+        }
+    }
 
     VertexSpecification spec;
     spec.position_attribute = VERTEX_ATTRIBUTE_3F;
@@ -96,291 +152,93 @@ void OBJLoader::into(Loadable &resource, const LoaderOptions &options) {
     spec.diffuse_attribute = VERTEX_ATTRIBUTE_4F;
     mesh->reset(spec);
 
-    SubMesh* default_submesh = nullptr;
+    auto& corners = obj.cache.vertices();
 
-    bool has_materials = false;
+    // Large meshes need 32 bit indices once the corners have been shared
+    const IndexType index_type = (corners.size() > std::numeric_limits<uint16_t>::max()) ?
+        INDEX_TYPE_32_BIT : INDEX_TYPE_16_BIT;
 
-    auto process_mtllib = [&](std::istream& data) {
-        std::string line;
-        while(std::getline(data, line)) {
-            line = strip(line);
-            auto parts = split(line);
-            if(line.empty() || parts.empty()) continue;
-            if(parts[0][0] == '#') continue;
-
-            if(parts[0] == "usemtl") {
-                current_material = parts[1];
-            } else if(parts[0] == "newmtl") {
-                auto material_name = parts[1];
-
-                // Clone the default material
-                materials[material_name] = mesh->resource_manager().clone_default_material().fetch();
-                current_material = material_name;
-
-                has_materials = true;
-            } else if(parts[0] == "Ns") {
-                auto mat = materials.at(current_material);
-                mat->pass(0)->set_shininess(std::stof(parts[1]));
-            } else if(parts[0] == "Ka") {
-                auto mat = materials.at(current_material);
-
-                float r = std::stof(parts[1]);
-                float g = std::stof(parts[2]);
-                float b = std::stof(parts[3]);
-
-                mat->pass(0)->set_ambient(smlt::Colour(r, g, b, 1.0));
-            } else if(parts[0] == "Kd") {
-                auto mat = materials.at(current_material);
-
-                float r = std::stof(parts[1]);
-                float g = std::stof(parts[2]);
-                float b = std::stof(parts[3]);
-
-                mat->pass(0)->set_diffuse(smlt::Colour(r, g, b, 1.0));
-            } else if(parts[0] == "Ks") {
-                auto mat = materials.at(current_material);
-
-                float r = std::stof(parts[1]);
-                float g = std::stof(parts[2]);
-                float b = std::stof(parts[3]);
-
-                mat->pass(0)->set_specular(smlt::Colour(r, g, b, 1.0));
-            } else if(parts[0] == "Ni") {
-
-            } else if(parts[0] == "d") {
-                // Dissolved == Transparency... apparently
-            } else if(parts[0] == "illum") {
-
-            } else if(parts[0] == "map_Kd") {
-                // The path may have spaces in, so we have to recombine everything
-                unicode texture_name = parts[1];
-                for(std::size_t i = 2; i < parts.size(); ++i) {
-                    texture_name += " " + parts[i];
-                }
-
-    #ifndef __WIN32__ 
-                std::string current_sep = "\\";
-                std::string new_sep = "/";
-                std::string str = texture_name.encode();
-                size_t start_pos = 0;
-                while((start_pos = str.find(current_sep), start_pos)) != std::string::npos) {
-                    str.replace(start_pos, 1, new_sep);
-                    start_pos += 1; // Handles case where 'to' is a substring of 'from'
-                }
-                texture_name = str;
-    #endif
-                
-                auto mat = materials.at(current_material);
-
-                std::vector<std::string> possible_locations;
-
-                // Check relative texture file first
-                possible_locations.push_back(
-                    kfs::path::join(
-                        kfs::path::dir_name(filename_.encode()),
-                        texture_name.encode()
-                    )
-                );
+    SubMesh* sm = nullptr;
+    SubMesh* default_submesh = nullptr;
 
-                // Check potentially absolute file path
-                possible_locations.push_back(texture_name.encode());
-
-                bool found = false;
-                for(auto& texture_file: possible_locations) {
-                    if(kfs::path::exists(texture_file)) {
-                        auto tex_id = mesh->resource_manager().new_texture_from_file(texture_file);
-                        mat->set_texture_unit_on_all_passes(0, tex_id);
-                        found = true;
-                        break;
-                    }
-                }
-
-                if(!found) {
-                    L_WARN(_F("Unable to locate texture {0}").format(texture_name.encode()));
-                }
-            }
+    for(auto& group: obj.groups) {
+        if(group.indices.empty()) {
+            continue;
         }
-    };
-
-
-    std::string line;
-    for(uint32_t l = 0; std::getline(*data_, line); ++l) {
-        line = strip(line);
 
-        auto parts = split(line); //Split on whitespace
+        auto it = materials.find(group.material);
+        if(it != materials.end()) {
+            sm = mesh->new_submesh_with_material(
+                group.material, it->second->id(), MESH_ARRANGEMENT_TRIANGLES, index_type
+            );
+        } else {
+            if(!group.material.empty()) {
+                L_WARN(_F("Ignoring non-existant material ({0}) while loading {1}").format(
+                    group.material,
+                    filename_
+                ));
+            }
 
-        if(line.empty() || parts.empty()) {
-            continue;
-        }
+            if(!default_submesh) {
+                default_submesh = mesh->new_submesh("default", MESH_ARRANGEMENT_TRIANGLES, index_type);
+            }
 
-        //Ignore comments
-        if(parts[0][0] == '#') {
-            continue;
+            sm = default_submesh;
         }
 
-        if(parts[0] == "v") {
-            if(parts.size() != 4) {
-                throw std::runtime_error(_F("Found {0} components for vertex, expected 3").format(parts.size()));
-            }
+        sm->index_data->reserve(sm->index_data->count() + group.indices.size());
+        sm->index_data->index(&group.indices[0], group.indices.size());
+    }
 
-            float x = std::stof(parts[1]);
-            float y = std::stof(parts[2]);
-            float z = std::stof(parts[3]);
+    std::vector<Vec3> generated_normals;
+    if(obj.normals.empty()) {
+        // The mesh didn't have any normals, let's generate some!
+        generated_normals.resize(corners.size());
 
-            vertices.push_back(Vec3(x, y, z));
-        } else if(parts[0] == "vt") {
-            if(parts.size() < 3) {
-                throw std::runtime_error(_F("Found {0} components for texture coordinate, expected 2").format(parts.size() - 1));
-            }
+        // Go through all the triangles, add the face normal to all the vertices
+        for(auto& group: obj.groups) {
+            for(std::size_t i = 0; i + 2 < group.indices.size(); i += 3) {
+                uint32_t idx1 = group.indices[i];
+                uint32_t idx2 = group.indices[i + 1];
+                uint32_t idx3 = group.indices[i + 2];
 
-            float x = std::stof(parts[1]);
-            float y = std::stof(parts[2]);
+                const Vec3& v1 = obj.positions[corners[idx1].position];
+                const Vec3& v2 = obj.positions[corners[idx2].position];
+                const Vec3& v3 = obj.positions[corners[idx3].position];
 
-            tex_coords.push_back(Vec2(x, y));
-        } else if(parts[0] == "vn") {
-            if(parts.size() != 4) {
-                throw std::runtime_error(_F("Found {0} components for vertex, expected 3").format(parts.size() - 1));
-            }
+                smlt::Vec3 normal = (v2 - v1).normalized().cross((v3 - v1).normalized()).normalized();
 
-            float x = std::stof(parts[1]);
-            float y = std::stof(parts[2]);
-            float z = std::stof(parts[3]);
-
-            Vec3 n(x, y, z);
-            normals.push_back(n.normalized());
-        } else if(parts[0] == "f") {
-            std::string smi;
-            if(current_material.empty()) {
-                if(!default_submesh) {
-                    default_submesh = mesh->new_submesh("default");
-                }
-                smi = "default";
-            } else {
-                if(materials.count(current_material)) {
-                    auto mat_id = materials.at(current_material)->id();
-                    if(mesh->has_submesh(current_material)) {
-                        smi = current_material;
-                    } else {
-                        mesh->new_submesh_with_material(current_material, mat_id);
-                        smi = current_material;
-                    }
-                } else {
-                    L_WARN(_F("Ignoring non-existant material ({0}) while loading {1}").format(
-                        current_material,
-                        filename_
-                    ));
-                    if(sm) {
-                        smi = sm->name(); // Just stick with the current submesh, don't change it
-                    } else {
-                        if(!default_submesh) {
-                            default_submesh = mesh->new_submesh("default");
-                        }
-                        smi = "default";
-                    }
-                }
-            }
-            sm = mesh->submesh(smi);
-
-            VertexData* vertex_data = sm->vertex_data.get();
-            IndexData* index_data = sm->index_data.get();
-
-            //Faces are a pain in the arse to parse
-            parts = std::vector<std::string>(parts.begin() + 1, parts.end()); //Strip off the first bit
-
-            /*
-             * This loop looks weird because it builds a triangle fan
-             * from the face indexes, as there could be more than 3. It goes
-             * (0, 2, 1), (0, 3, 2) etc.
-             */
-            uint32_t first_index = 0;
-            uint32_t i = 0;
-            for(auto& part: parts) {
-                int32_t v, tc, n;
-                parse_face(part, v, tc, n);
-
-                vertex_data->position(vertices[v]);
-
-                if(tc != -1) {
-                    vertex_data->tex_coord0(tex_coords[tc]);
-                }
-
-                if(n != -1) {
-                    vertex_data->normal(normals[n]);
-                }
-                vertex_data->diffuse(smlt::Colour::WHITE);
-                vertex_data->move_next();
-
-                if(i == 2) {
-                    first_index = vertex_data->count() - 3;
-                }
-
-                if(i >= 2) {
-                    index_data->index(first_index);
-                    index_data->index(vertex_data->count() - 2);
-                    index_data->index(vertex_data->count() - 1);
-                }
-
-                ++i;
+                generated_normals[idx1] += normal;
+                generated_normals[idx2] += normal;
+                generated_normals[idx3] += normal;
             }
-        } else if(parts[0] == "usemtl") {
-            current_material = parts[1];
-        } else if(parts[0] == "mtllib") {
-            /*
-             * If we find a mtllib command, we load the material file and insert its
-             * lines into this position. This makes it so it's like the materials are embedded
-             * in the current file which makes parsing the same as if they were!
-             */
-
-             // We need to re-get the filename because mtllib paths may have spaces and the existing 'parts'
-             // variable would have split it to pieces.
-             unicode filename = split(line, " ", 1).back();
-             filename = kfs::path::join(kfs::path::dir_name(filename_.encode()), filename.encode());
-
-             try {
-                 auto stream = locator->open_file(filename);
-                 process_mtllib(*stream);
-             } catch(ResourceMissingError& e) {
-                 L_DEBUG(_F("mtllib {0} not found. Skipping.").format(filename));
-             }
         }
     }
 
+    VertexData* vertex_data = mesh->vertex_data.get();
+    vertex_data->resize(corners.size());
+    vertex_data->move_to_start();
 
-    if(normals.empty()) {
-        mesh->each([&](const std::string& name, SubMesh* submesh) {
-            VertexData* vertex_data = submesh->vertex_data.get();
-            IndexData* index_data = submesh->index_data.get();
-
-            // The mesh didn't have any normals, let's generate some!
-            std::unordered_map<int, smlt::Vec3> index_to_normal;
+    for(std::size_t i = 0; i < corners.size(); ++i) {
+        auto& corner = corners[i];
 
-            // Go through all the triangles, add the face normal to all the vertices
-            for(uint16_t i = 0; i < index_data->count(); i+=3) {
-                uint16_t idx1 = index_data->at(i);
-                uint16_t idx2 = index_data->at(i+1);
-                uint16_t idx3 = index_data->at(i+2);
+        vertex_data->position(obj.positions[corner.position]);
 
-                smlt::Vec3 v1, v2, v3;
-                v1 = vertex_data->position_at<Vec3>(idx1);
-                v2 = vertex_data->position_at<Vec3>(idx2);
-                v3 = vertex_data->position_at<Vec3>(idx3);
-
-                smlt::Vec3 normal = (v2 - v1).normalized().cross((v3 - v1).normalized()).normalized();
+        if(corner.tex_coord != -1) {
+            vertex_data->tex_coord0(obj.tex_coords[corner.tex_coord]);
+        }
 
-                index_to_normal[idx1] += normal;
-                index_to_normal[idx2] += normal;
-                index_to_normal[idx3] += normal;
-            }
+        if(corner.normal != -1) {
+            vertex_data->normal(obj.normals[corner.normal]);
+        } else if(!generated_normals.empty()) {
+            vertex_data->normal(generated_normals[i].normalized());
+        }
 
-            // Now set the normal on the vertex data
-            for(auto p: index_to_normal) {
-                vertex_data->move_to(p.first);
-                vertex_data->normal(p.second.normalized());
-            }
-        });
+        vertex_data->diffuse(smlt::Colour::WHITE);
+        vertex_data->move_next();
     }
 
-    if(!has_materials) {
+    if(!has_materials && sm) {
         //If the OBJ file has no materials, have a look around for textures in the same directory
 
         auto parts = kfs::path::split_ext(filename_.encode());
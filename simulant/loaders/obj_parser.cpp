@@ -0,0 +1,434 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "obj_parser.h"
+
+namespace smlt {
+namespace loaders {
+
+static const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Digits beyond this can't change a float */
+static const int MAX_MANTISSA_DIGITS = 19;
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+const char* parse_int(const char* first, const char* last, int32_t& out) {
+    const char* p = first;
+
+    bool negative = false;
+    if(p < last && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    const char* digits = p;
+    int64_t value = 0;
+    while(p < last && is_digit(*p)) {
+        if(value <= std::numeric_limits<int32_t>::max()) {
+            value = (value * 10) + (*p - '0');
+        }
+        ++p;
+    }
+
+    if(p == digits) {
+        return first;
+    }
+
+    value = std::min<int64_t>(value, std::numeric_limits<int32_t>::max());
+    out = int32_t(negative ? -value : value);
+    return p;
+}
+
+const char* parse_float(const char* first, const char* last, float& out) {
+    const char* p = first;
+
+    bool negative = false;
+    if(p < last && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool found = false;
+
+    while(p < last && is_digit(*p)) {
+        if(digits < MAX_MANTISSA_DIGITS) {
+            mantissa = (mantissa * 10) + (*p - '0');
+            digits += (mantissa != 0);
+        } else {
+            ++exponent;
+        }
+        found = true;
+        ++p;
+    }
+
+    if(p < last && *p == '.') {
+        ++p;
+        while(p < last && is_digit(*p)) {
+            if(digits < MAX_MANTISSA_DIGITS) {
+                mantissa = (mantissa * 10) + (*p - '0');
+                digits += (mantissa != 0);
+                --exponent;
+            }
+            found = true;
+            ++p;
+        }
+    }
+
+    if(!found) {
+        return first;
+    }
+
+    if(p < last && (*p == 'e' || *p == 'E')) {
+        int32_t e = 0;
+        const char* end = parse_int(p + 1, last, e);
+        if(end != p + 1) {
+            exponent += std::max(std::min(e, 1000), -1000);
+            p = end;
+        }
+    }
+
+    double value = double(mantissa);
+    if(exponent < 0) {
+        value = (exponent >= -22) ? value / POWERS_OF_TEN[-exponent] : value * std::pow(10.0, exponent);
+    } else if(exponent > 0) {
+        value = (exponent <= 22) ? value * POWERS_OF_TEN[exponent] : value * std::pow(10.0, exponent);
+    }
+
+    out = float(negative ? -value : value);
+    return p;
+}
+
+const char* parse_corner(const char* first, const char* last, int32_t& position, int32_t& tex_coord, int32_t& normal) {
+    position = tex_coord = normal = 0;
+
+    const char* p = parse_int(first, last, position);
+    if(p == first) {
+        return first;
+    }
+
+    if(p < last && *p == '/') {
+        ++p;
+        p = parse_int(p, last, tex_coord);
+
+        if(p < last && *p == '/') {
+            ++p;
+            p = parse_int(p, last, normal);
+        }
+    }
+
+    return p;
+}
+
+static inline uint32_t hash_corner(const OBJCorner& corner) {
+    uint32_t h = uint32_t(corner.position) * 0x9E3779B1u;
+    h ^= uint32_t(corner.tex_coord) * 0x85EBCA77u;
+    h ^= uint32_t(corner.normal) * 0xC2B2AE3Du;
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+    return h;
+}
+
+const uint32_t OBJVertexCache::EMPTY;
+
+OBJVertexCache::OBJVertexCache() {
+    clear();
+}
+
+void OBJVertexCache::clear() {
+    vertices_.clear();
+    slots_.assign(1024, EMPTY);
+    mask_ = slots_.size() - 1;
+}
+
+void OBJVertexCache::grow() {
+    slots_.assign(slots_.size() * 2, EMPTY);
+    mask_ = slots_.size() - 1;
+
+    for(uint32_t i = 0; i < vertices_.size(); ++i) {
+        uint32_t slot = hash_corner(vertices_[i]) & mask_;
+        while(slots_[slot] != EMPTY) {
+            slot = (slot + 1) & mask_;
+        }
+        slots_[slot] = i;
+    }
+}
+
+uint32_t OBJVertexCache::insert(const OBJCorner& corner) {
+    // Keep at most half full so probe sequences stay short
+    if((vertices_.size() + 1) * 2 > slots_.size()) {
+        grow();
+    }
+
+    uint32_t slot = hash_corner(corner) & mask_;
+    while(slots_[slot] != EMPTY) {
+        if(vertices_[slots_[slot]] == corner) {
+            return slots_[slot];
+        }
+        slot = (slot + 1) & mask_;
+    }
+
+    const uint32_t index = vertices_.size();
+    slots_[slot] = index;
+    vertices_.push_back(corner);
+    return index;
+}
+
+namespace {
+
+/* A line of text, consumed a token at a time */
+struct Line {
+    const char* p;
+    const char* end;
+    uint32_t line_number;
+
+    void skip_space() {
+        while(p < end && is_space(*p)) {
+            ++p;
+        }
+    }
+
+    /* The next whitespace separated token, empty at the end of the line */
+    bool token(const char*& first, const char*& last) {
+        skip_space();
+        first = p;
+        while(p < end && !is_space(*p)) {
+            ++p;
+        }
+        last = p;
+        return first != last;
+    }
+
+    /* Everything left on the line, without surrounding whitespace */
+    std::string rest() {
+        skip_space();
+        const char* last = end;
+        while(last > p && is_space(*(last - 1))) {
+            --last;
+        }
+        return std::string(p, last);
+    }
+
+    bool number(float& out) {
+        skip_space();
+        const char* next = parse_float(p, end, out);
+        if(next == p) {
+            return false;
+        }
+        p = next;
+        return true;
+    }
+
+    [[noreturn]] void error(const std::string& message) const {
+        throw std::runtime_error(message + " on line " + std::to_string(line_number));
+    }
+};
+
+bool keyword_is(const char* first, const char* last, const char* keyword) {
+    const std::size_t length = std::strlen(keyword);
+    return std::size_t(last - first) == length && std::memcmp(first, keyword, length) == 0;
+}
+
+/* Calls func(line) for each line in [first, last) */
+template<typename Func>
+void each_line(const char* first, const char* last, Func func) {
+    uint32_t number = 0;
+
+    while(first < last) {
+        const char* end = (const char*) std::memchr(first, '\n', last - first);
+        if(!end) {
+            end = last;
+        }
+
+        Line line = {first, end, ++number};
+        func(line);
+
+        first = end + 1;
+    }
+}
+
+int32_t resolve_index(int32_t index, std::size_t count, const Line& line) {
+    // Negative indices count back from the most recent element
+    const int64_t resolved = (index > 0) ? int64_t(index) - 1 : int64_t(count) + index;
+    if(index == 0 || resolved < 0 || resolved >= int64_t(count)) {
+        line.error("Face index " + std::to_string(index) + " is out of range");
+    }
+    return int32_t(resolved);
+}
+
+}
+
+void parse_obj(const char* first, const char* last, OBJData& out) {
+    int32_t group = -1;
+
+    // Reused for every face, so only allocated once
+    std::vector<uint32_t> face;
+
+    auto use_material = [&](const std::string& material) {
+        for(uint32_t i = 0; i < out.groups.size(); ++i) {
+            if(out.groups[i].material == material) {
+                group = i;
+                return;
+            }
+        }
+
+        out.groups.push_back(OBJGroup());
+        out.groups.back().material = material;
+        group = out.groups.size() - 1;
+    };
+
+    each_line(first, last, [&](Line& line) {
+        const char* kw;
+        const char* kw_end;
+        if(!line.token(kw, kw_end) || *kw == '#') {
+            return;
+        }
+
+        if(keyword_is(kw, kw_end, "v")) {
+            Vec3 v;
+            if(!line.number(v.x) || !line.number(v.y) || !line.number(v.z)) {
+                line.error("Expected 3 components for vertex");
+            }
+            out.positions.push_back(v);
+        } else if(keyword_is(kw, kw_end, "vt")) {
+            Vec2 t;
+            if(!line.number(t.x) || !line.number(t.y)) {
+                line.error("Expected 2 components for texture coordinate");
+            }
+            out.tex_coords.push_back(t);
+        } else if(keyword_is(kw, kw_end, "vn")) {
+            Vec3 n;
+            if(!line.number(n.x) || !line.number(n.y) || !line.number(n.z)) {
+                line.error("Expected 3 components for normal");
+            }
+            out.normals.push_back(n.normalized());
+        } else if(keyword_is(kw, kw_end, "f")) {
+            if(group < 0) {
+                use_material(std::string());
+            }
+
+            face.clear();
+
+            const char* token;
+            const char* token_end;
+            while(line.token(token, token_end)) {
+                int32_t v, vt, vn;
+                if(parse_corner(token, token_end, v, vt, vn) != token_end) {
+                    line.error("Malformed face");
+                }
+
+                OBJCorner corner;
+                corner.position = resolve_index(v, out.positions.size(), line);
+                corner.tex_coord = (vt) ? resolve_index(vt, out.tex_coords.size(), line) : -1;
+                corner.normal = (vn) ? resolve_index(vn, out.normals.size(), line) : -1;
+
+                face.push_back(out.cache.insert(corner));
+            }
+
+            /* Faces with more than 3 corners become a triangle fan:
+             * (0, 1, 2), (0, 2, 3) etc. */
+            auto& indices = out.groups[group].indices;
+            for(std::size_t i = 2; i < face.size(); ++i) {
+                indices.push_back(face[0]);
+                indices.push_back(face[i - 1]);
+                indices.push_back(face[i]);
+            }
+        } else if(keyword_is(kw, kw_end, "usemtl")) {
+            // Read the same way as newmtl, so names with spaces in still match
+            use_material(line.rest());
+        } else if(keyword_is(kw, kw_end, "mtllib")) {
+            // The path may have spaces in
+            out.material_libraries.push_back(line.rest());
+        }
+    });
+}
+
+void parse_mtl(const char* first, const char* last, std::vector<MTLMaterial>& out) {
+    MTLMaterial* material = nullptr;
+
+    auto colour = [](Line& line, Vec3& out) {
+        if(!line.number(out.x) || !line.number(out.y) || !line.number(out.z)) {
+            line.error("Expected 3 components for colour");
+        }
+    };
+
+    each_line(first, last, [&](Line& line) {
+        const char* kw;
+        const char* kw_end;
+        if(!line.token(kw, kw_end) || *kw == '#') {
+            return;
+        }
+
+        if(keyword_is(kw, kw_end, "newmtl")) {
+            out.push_back(MTLMaterial());
+            material = &out.back();
+            material->name = line.rest();
+            return;
+        }
+
+        if(!material) {
+            // Nothing to apply it to
+            return;
+        }
+
+        if(keyword_is(kw, kw_end, "Ns")) {
+            if(!line.number(material->shininess)) {
+                line.error("Expected a value for Ns");
+            }
+            material->has_shininess = true;
+        } else if(keyword_is(kw, kw_end, "Ka")) {
+            colour(line, material->ambient);
+            material->has_ambient = true;
+        } else if(keyword_is(kw, kw_end, "Kd")) {
+            colour(line, material->diffuse);
+            material->has_diffuse = true;
+        } else if(keyword_is(kw, kw_end, "Ks")) {
+            colour(line, material->specular);
+            material->has_specular = true;
+        } else if(keyword_is(kw, kw_end, "map_Kd")) {
+            material->diffuse_map = line.rest();
+            for(auto& c: material->diffuse_map) {
+                if(c == '\\') {
+                    c = '/';
+                }
+            }
+        }
+    });
+}
+
+}
+}
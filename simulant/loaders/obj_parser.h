@@ -0,0 +1,146 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../math/vec2.h"
+#include "../math/vec3.h"
+
+namespace smlt {
+namespace loaders {
+
+/*
+ * The text side of the Wavefront loader, kept separate from Mesh so it can
+ * be tested and benchmarked on its own.
+ *
+ * Everything works on a [first, last) range of characters, usually a
+ * memory-mapped FileView. Lines and tokens are pointers into that range,
+ * so nothing is allocated per line or per vertex beyond growing the output
+ * arrays.
+ */
+
+/*
+ * Numeric conversion along the lines of std::from_chars (which C++11
+ * doesn't have): no locale, no allocation and no exceptions. Returns the
+ * position after the number, or `first` if there wasn't one.
+ */
+const char* parse_float(const char* first, const char* last, float& out);
+const char* parse_int(const char* first, const char* last, int32_t& out);
+
+/*
+ * Reads one face corner: "v", "v/vt", "v//vn" or "v/vt/vn". The indices are
+ * as written (one-based, or negative to count back), 0 where missing.
+ * Returns the position after the corner, or `first` if there wasn't one.
+ */
+const char* parse_corner(const char* first, const char* last, int32_t& position, int32_t& tex_coord, int32_t& normal);
+
+/* One corner of a face, as zero-based indices. -1 where the corner doesn't
+ * reference a texture coordinate or normal */
+struct OBJCorner {
+    int32_t position = -1;
+    int32_t tex_coord = -1;
+    int32_t normal = -1;
+
+    bool operator==(const OBJCorner& rhs) const {
+        return position == rhs.position && tex_coord == rhs.tex_coord && normal == rhs.normal;
+    }
+};
+
+/*
+ * Gives each distinct corner an output vertex index, so corners shared
+ * between faces share a vertex. This is an open addressing hash table over
+ * the index triples, which unlike std::unordered_map doesn't allocate a node
+ * per vertex.
+ */
+class OBJVertexCache {
+public:
+    OBJVertexCache();
+
+    /* Returns the vertex index for the corner, adding it if it's new */
+    uint32_t insert(const OBJCorner& corner);
+
+    /* The distinct corners, in the order they were first seen */
+    const std::vector<OBJCorner>& vertices() const { return vertices_; }
+    std::size_t size() const { return vertices_.size(); }
+
+    void clear();
+
+private:
+    const static uint32_t EMPTY = ~0u;
+
+    std::vector<uint32_t> slots_;
+    std::vector<OBJCorner> vertices_;
+    uint32_t mask_ = 0;
+
+    void grow();
+};
+
+/* The faces which use one material */
+struct OBJGroup {
+    std::string material;
+    std::vector<uint32_t> indices;
+};
+
+/* Everything read from an OBJ file */
+struct OBJData {
+    std::vector<Vec3> positions;
+    std::vector<Vec2> tex_coords;
+    std::vector<Vec3> normals;
+
+    /* Triangles index into cache.vertices() */
+    OBJVertexCache cache;
+    std::vector<OBJGroup> groups;
+
+    std::vector<std::string> material_libraries;
+};
+
+/*
+ * Reads vertices, texture coordinates, normals and faces. Faces with more
+ * than three corners are split into a triangle fan. Throws std::runtime_error
+ * for malformed vertices and out of range indices.
+ */
+void parse_obj(const char* first, const char* last, OBJData& out);
+
+struct MTLMaterial {
+    std::string name;
+
+    bool has_shininess = false;
+    float shininess = 0.0f;
+
+    bool has_ambient = false;
+    Vec3 ambient;
+
+    bool has_diffuse = false;
+    Vec3 diffuse;
+
+    bool has_specular = false;
+    Vec3 specular;
+
+    /* As written in the file, with any backslashes turned into slashes */
+    std::string diffuse_map;
+};
+
+/* Reads the materials from an MTL file, appending them to `out` */
+void parse_mtl(const char* first, const char* last, std::vector<MTLMaterial>& out);
+
+}
+}
@@ -42,49 +42,34 @@ private:
     stb_vorbis* vorbis_;
 };
 
-int32_t queue_buffer(std::weak_ptr<Sound> sound, StreamWrapper::ptr stream, AudioBufferID buffer) {
-    std::shared_ptr<Sound> self = sound.lock();
-    if(!self) {
-        // The sound was destroyed, we can't stream without a sound so just bail
-        return 0;
-    }
-
-    std::vector<int16_t> pcm;
-    int s = self->buffer_size();
-    pcm.resize(s);
-
-    size_t size = 0;
-    int result = 0;
-
-    while(size < self->buffer_size()) {
-        result = stb_vorbis_get_samples_short_interleaved(stream->get(), self->channels(), &pcm[0] + size, self->buffer_size() - size);
-        if(result > 0)  {
-            size += result * self->channels();
-        } else {
-            break;
-        }
-    }
-
-    if(size == 0) {
-        return 0;
-    }
+std::size_t decode_samples(StreamWrapper::ptr stream, int channels, int16_t* out, std::size_t max_samples, FileView::ptr) {
+    /* Runs on the audio streaming thread, so this mustn't touch the Sound */
+    int result = stb_vorbis_get_samples_short_interleaved(stream->get(), channels, out, max_samples);
+    return (result > 0) ? std::size_t(result * channels) : 0;
+}
 
-    self->_driver()->upload_buffer_data(buffer, self->format(), &pcm[0], size * sizeof(int16_t), self->sample_rate());
-    return size;
+DecodeFunc new_decoder(FileView::ptr data, int channels) {
+    /* The compressed data is decoded straight from the file view, which the
+     * decode function keeps alive */
+    StreamWrapper::ptr stream(new StreamWrapper(stb_vorbis_open_memory(data->data(), data->size(), nullptr, nullptr)));
+    return std::bind(&decode_samples, stream, channels, std::placeholders::_1, std::placeholders::_2, data);
 }
 
 void init_source(Sound* self, SourceInstance& source) {
     /*
      *  This is either smart or crazy and I haven't worked out which yet...
      *
-     *  Create a new stream from the supplied sound, wrap it in a smart pointer and bind it to the Source's stream function.
+     *  Create a new stream from the supplied sound, wrap it in a smart pointer and bind it to the Source's decode function.
      *
      *  This means the source knows nothing about the sound or the stream, and we don't need to store any stb_vorbis specific
      *  data on the Source, well, not explicitly.
      */
-
-    StreamWrapper::ptr stream(new StreamWrapper(stb_vorbis_open_memory(&self->data()[0], self->data().size(), nullptr, nullptr)));
-    source.set_stream_func(std::bind(&queue_buffer, self->shared_from_this(), stream, std::placeholders::_1));
+    source.set_decode_func(
+        self->new_decoder(),
+        self->format(),
+        self->sample_rate(),
+        self->buffer_size()
+    );
 }
 
 
@@ -93,11 +78,10 @@ void OGGLoader::into(Loadable& resource, const LoaderOptions& options) {
     Sound* sound = dynamic_cast<Sound*>(res_ptr);
     assert(sound && "You passed a Resource that is not a Sound to the OGG loader");
 
-    std::vector<uint8_t> data((std::istreambuf_iterator<char>(*this->data_)),
-                              std::istreambuf_iterator<char>());
+    auto data = file_view();
 
-    L_DEBUG(_F("Stream size: {0}").format(data.size()));
-    StreamWrapper stream(stb_vorbis_open_memory(&data[0], data.size(),nullptr, nullptr));
+    L_DEBUG(_F("Stream size: {0}").format(data->size()));
+    StreamWrapper stream(stb_vorbis_open_memory(data->data(), data->size(), nullptr, nullptr));
 
     if(!stream.get()) {
         throw std::runtime_error("Unable to load the OGG file");
@@ -107,9 +91,11 @@ void OGGLoader::into(Loadable& resource, const LoaderOptions& options) {
 
     sound->set_sample_rate(info.sample_rate);
     sound->set_buffer_size(4096 * 8);
-    sound->set_data(data);
     sound->set_channels(info.channels);
     sound->set_format((info.channels == 2) ? AUDIO_DATA_FORMAT_STEREO16 : AUDIO_DATA_FORMAT_MONO16);
+    sound->set_sample_count(stb_vorbis_stream_length_in_samples(stream.get()) * info.channels);
+    sound->set_file_view(data);
+    sound->set_decoder_factory(std::bind(&new_decoder, data, info.channels));
     sound->set_source_init_function(std::bind(&init_source, sound, std::placeholders::_1));
 }
 
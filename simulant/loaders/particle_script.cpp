@@ -53,6 +53,9 @@ void KGLPLoader::into(Loadable &resource, const LoaderOptions &options) {
     if(js.has_key("cull_each")) ps->set_cull_each((bool) js["cull_each"]);
     L_DEBUG(_F("    Cull Each: {0}").format(ps->cull_each()));
 
+    if(js.has_key("depth_sorted")) ps->set_depth_sorted((bool) js["depth_sorted"]);
+    L_DEBUG(_F("    Depth Sorted: {0}").format(ps->depth_sorted()));
+
     if(js.has_key("material")) {
         std::string material = js["material"];
 
@@ -63,6 +66,13 @@ void KGLPLoader::into(Loadable &resource, const LoaderOptions &options) {
         ps->set_material_id(ps->stage->assets->new_material_from_file(material));
     }
 
+    // This must come after the material, so its textures are kept
+    if(js.has_key("render_mode")) {
+        std::string mode = js["render_mode"];
+        ps->set_render_mode((mode == "points") ? PARTICLE_RENDER_MODE_POINTS : PARTICLE_RENDER_MODE_QUADS);
+    }
+    L_DEBUG(_F("    Render Mode: {0}").format((ps->render_mode() == PARTICLE_RENDER_MODE_POINTS) ? "points" : "quads"));
+
 
     if(js.has_key("emitters")) {
         L_DEBUG("Loading emitters");
@@ -49,10 +49,14 @@ struct Header {
 
 #pragma pack(pop)
 
-TextureLoadResult PCXLoader::do_load(const std::vector<uint8_t> &buffer) {
+TextureLoadResult PCXLoader::do_load(const uint8_t* buffer, std::size_t size) {
     TextureLoadResult result;
 
-    Header* header = (Header*)&buffer[0];
+    if(size < sizeof(Header)) {
+        throw std::runtime_error("PCX file is too small");
+    }
+
+    const Header* header = (const Header*) buffer;
 
     if(header->manufacturer != 0x0a) {
         throw std::runtime_error("Unsupported PCX manufacturer");
@@ -70,9 +74,9 @@ TextureLoadResult PCXLoader::do_load(const std::vector<uint8_t> &buffer) {
         throw std::runtime_error("Unsupported PCX bitcount");
     }
 
-    uint8_t palette_marker = buffer[buffer.size() - 769];
+    uint8_t palette_marker = (size >= 769) ? buffer[size - 769] : 0;
 
-    const uint8_t* palette = (palette_marker == 12) ? &buffer[buffer.size() - 768] : header->palette;
+    const uint8_t* palette = (palette_marker == 12) ? &buffer[size - 768] : header->palette;
 
     int32_t rle_count = 0;
     int32_t rle_value = 0;
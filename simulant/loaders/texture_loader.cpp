@@ -30,13 +30,13 @@
 namespace smlt {
 namespace loaders {
 
-TextureLoadResult TextureLoader::do_load(const std::vector<uint8_t> &buffer) {
+TextureLoadResult TextureLoader::do_load(const uint8_t* buffer, std::size_t size) {
     TextureLoadResult result;
 
     int width, height, channels;
     unsigned char* data = SOIL_load_image_from_memory(
-        &buffer[0],
-        buffer.size(),
+        buffer,
+        size,
         &width,
         &height,
         &channels,
@@ -30,7 +30,7 @@ public:
         BaseTextureLoader(filename, data) {}
 
 private:
-    TextureLoadResult do_load(const std::vector<uint8_t> &buffer) override;
+    TextureLoadResult do_load(const uint8_t* data, std::size_t size) override;
 };
 
 class TextureLoaderType : public LoaderType {
@@ -22,6 +22,8 @@
 #include "../types.h"
 #include "../extra/tiled/TmxParser/Tmx.h"
 #include "../resource_manager.h"
+#include "../stage.h"
+#include "../managers/tilemap_manager.h"
 
 namespace smlt {
 namespace loaders {
@@ -45,12 +47,71 @@ struct TilesetInfo {
     }
 };
 
+/*
+ * Loads every tileset and tile layer of the map into a Tilemap. Unlike the
+ * mesh path each tile is just a TileIndex, the tilemap builds the geometry
+ * itself a chunk at a time.
+ */
+static void load_into_tilemap(const unicode& filename, Tilemap* tilemap) {
+    Tmx::Map map;
+
+    map.ParseFile(filename.encode());
+
+    auto parent_dir = kfs::path::abs_path(kfs::path::dir_name(filename.encode()));
+    auto& assets = tilemap->stage->assets;
+
+    std::vector<TileIndex> first_tiles;
+
+    for(int32_t i = 0; i < map.GetNumTilesets(); ++i) {
+        const Tmx::Tileset* tileset = map.GetTileset(i);
+        const Tmx::Image* image = tileset->GetImage();
+
+        auto final_path = kfs::path::join(parent_dir, image->GetSource());
+        L_DEBUG(_F("Loading tileset from: {0}").format(final_path));
+
+        TextureID tid = assets->new_texture_from_file(
+            final_path,
+            TextureFlags(MIPMAP_GENERATE_NONE, TEXTURE_WRAP_CLAMP_TO_EDGE, TEXTURE_FILTER_POINT)
+        );
+
+        first_tiles.push_back(tilemap->add_tileset(
+            tid,
+            tileset->GetTileWidth(),
+            tileset->GetTileHeight(),
+            tileset->GetMargin(),
+            tileset->GetSpacing()
+        ));
+    }
+
+    for(Tmx::Layer* layer: map.GetLayers()) {
+        uint32_t index = tilemap->new_layer(layer->GetName(), layer->GetWidth(), layer->GetHeight());
+
+        for(int32_t y = 0; y < layer->GetHeight(); ++y) {
+            for(int32_t x = 0; x < layer->GetWidth(); ++x) {
+                int32_t tileset_index = layer->GetTileTilesetIndex(x, y);
+                if(tileset_index < 0) {
+                    continue;
+                }
+
+                tilemap->set_tile(index, x, y, first_tiles.at(tileset_index) + layer->GetTileId(x, y));
+            }
+        }
+    }
+}
+
 void TiledLoader::into(Loadable &resource, const LoaderOptions &options) {
     Loadable* res_ptr = &resource;
+
+    Tilemap* tilemap = dynamic_cast<Tilemap*>(res_ptr);
+    if(tilemap) {
+        load_into_tilemap(filename_, tilemap);
+        return;
+    }
+
     Mesh* mesh = dynamic_cast<Mesh*>(res_ptr);
 
     if(!mesh) {
-        throw std::runtime_error("Tried to load a TMX file into something that wasn't a mesh");
+        throw std::runtime_error("Tried to load a TMX file into something that wasn't a mesh or tilemap");
     }
 
     Tmx::Map map;
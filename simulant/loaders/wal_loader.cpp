@@ -80,12 +80,24 @@ const uint8_t PALETTE[768] = {
     87, 159, 91, 83
 };
 
-TextureLoadResult WALLoader::do_load(const std::vector<uint8_t> &buffer) {
+TextureLoadResult WALLoader::do_load(const uint8_t* buffer, std::size_t size) {
     TextureLoadResult result;
 
+    if(size < sizeof(Header)) {
+        throw std::runtime_error("WAL file is too small");
+    }
+
     // The file starts with the header, so we can just cast directly to a pointer
     // and read the memory directly
-    Header* header = (Header*)&buffer[0];
+    const Header* header = (const Header*) buffer;
+
+    // Each mipmap level halves the size of the one before
+    for(uint32_t level = 0; level < 4; ++level) {
+        const uint64_t level_size = uint64_t(header->width >> level) * (header->height >> level);
+        if(header->offset[level] < 0 || uint64_t(header->offset[level]) + level_size > size) {
+            throw std::runtime_error("WAL mipmap level is outside the file");
+        }
+    }
 
     result.width = header->width;
     result.height = header->height;
@@ -93,8 +105,7 @@ TextureLoadResult WALLoader::do_load(const std::vector<uint8_t> &buffer) {
     result.format = TEXTURE_FORMAT_RGBA8888;
     result.texel_type = TEXTURE_TEXEL_TYPE_UNSIGNED_BYTE;
 
-    uint8_t* data = (uint8_t*) &buffer[0];
-    data += header->offset[0];
+    const uint8_t* data = buffer + header->offset[0];
 
     result.data.resize(result.width * result.height * 4);
 
@@ -0,0 +1,298 @@
+#include <algorithm>
+
+#include "sprite_batcher.h"
+#include "sprite_manager.h"
+
+#include "../stage.h"
+#include "../material.h"
+#include "../hardware_buffer.h"
+#include "../renderers/renderer.h"
+#include "../profiler.h"
+
+namespace smlt {
+
+const static VertexSpecification SPRITE_VERTEX_SPEC(
+        smlt::VERTEX_ATTRIBUTE_3F, // Position
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_4F // Diffuse
+);
+
+SpriteBatch::SpriteBatch(MaterialID material_id, RenderPriority priority):
+    material_id_(material_id),
+    priority_(priority),
+    vertex_data_(SPRITE_VERTEX_SPEC),
+    index_data_(INDEX_TYPE_16_BIT) {
+
+}
+
+void SpriteBatch::prepare_buffers(Renderer* renderer) {
+    const std::size_t vertex_size = vertex_data_.stride() * index_capacity_ * 4;
+    const std::size_t index_size = index_data_.stride() * index_capacity_ * 6;
+
+    if(!vertex_buffer_) {
+        vertex_buffer_ = renderer->hardware_buffers->allocate(
+            vertex_size,
+            HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
+            SHADOW_BUFFER_DISABLED,
+            HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING
+        );
+    } else if(vertex_buffer_->size() < vertex_size) {
+        vertex_buffer_->resize(vertex_size);
+    }
+
+    if(!index_buffer_) {
+        index_buffer_ = renderer->hardware_buffers->allocate(
+            index_size,
+            HARDWARE_BUFFER_VERTEX_ARRAY_INDICES,
+            SHADOW_BUFFER_DISABLED
+        );
+    } else if(index_buffer_->size() < index_size) {
+        index_buffer_->resize(index_size);
+    }
+
+    if(indices_dirty_) {
+        index_buffer_->upload(index_data_);
+        indices_dirty_ = false;
+    }
+
+    if(vertices_dirty_) {
+        vertex_buffer_->upload(vertex_data_);
+        vertices_dirty_ = false;
+    }
+}
+
+SpriteBatcher::SpriteBatcher(Stage* stage, SpriteManager* manager):
+    stage_(stage),
+    manager_(manager) {
+
+}
+
+SpriteBatcher::~SpriteBatcher() {
+    for(auto& p: buckets_) {
+        release(p.second);
+    }
+}
+
+std::size_t SpriteBatcher::batch_count() const {
+    std::size_t count = 0;
+    for(auto& p: buckets_) {
+        for(auto& batch: p.second.batches) {
+            if(batch->sprite_count()) {
+                ++count;
+            }
+        }
+    }
+
+    return count;
+}
+
+void SpriteBatcher::release(Bucket& bucket) {
+    for(auto& batch: bucket.batches) {
+        stage_->render_queue->remove_renderable(batch.get());
+    }
+
+    bucket.batches.clear();
+}
+
+RenderableList SpriteBatcher::_get_renderables(const Frustum& frustum) {
+    S_PROFILE_SCOPE("SpriteBatcher::_get_renderables");
+
+    for(auto& p: buckets_) {
+        p.second.entries.clear();
+        p.second.in_use = false;
+    }
+
+    const Vec3 view_direction = frustum.plane(FRUSTUM_PLANE_NEAR).normal();
+
+    /* Gather the visible sprites into buckets. Sprites that aren't visible
+     * still mark their bucket as used, so its batch isn't thrown away */
+    for(auto& p: manager_->__objects()) {
+        Sprite* sprite = p.second.get();
+
+        if(!sprite->is_batched() || !sprite->material_id()) {
+            continue;
+        }
+
+        Key key = {sprite->material_id(), sprite->render_priority()};
+        auto& bucket = buckets_[key];
+        bucket.in_use = true;
+
+        if(!sprite->is_visible()) {
+            continue;
+        }
+
+        const Vec3 position = sprite->absolute_position();
+        const Quaternion rotation = sprite->absolute_rotation();
+        const Vec3 scale = sprite->absolute_scaling();
+
+        const Vec3 right = Vec3(sprite->render_width_ * scale.x * 0.5f, 0, 0).rotated_by(rotation);
+        const Vec3 up = Vec3(0, sprite->render_height_ * scale.y * 0.5f, 0).rotated_by(rotation);
+
+        Entry entry;
+        entry.corners[0] = position - right - up;
+        entry.corners[1] = position + right - up;
+        entry.corners[2] = position + right + up;
+        entry.corners[3] = position - right + up;
+
+        if(!frustum.intersects_aabb(AABB(entry.corners, 4))) {
+            continue;
+        }
+
+        entry.depth = position.dot(view_direction);
+        entry.id = sprite->id().value();
+        entry.sprite = sprite;
+
+        bucket.entries.push_back(entry);
+    }
+
+    RenderableList result;
+
+    for(auto it = buckets_.begin(); it != buckets_.end();) {
+        auto& key = it->first;
+        auto& bucket = it->second;
+
+        if(!bucket.in_use) {
+            release(bucket);
+            it = buckets_.erase(it);
+            continue;
+        }
+
+        auto& entries = bucket.entries;
+
+        // Back-to-front, like depth sorted particles
+        std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+            if(lhs.depth != rhs.depth) {
+                return lhs.depth > rhs.depth;
+            }
+
+            return lhs.id < rhs.id;
+        });
+
+        const uint32_t batches_needed = (entries.size() + SpriteBatch::MAX_SPRITES - 1) / SpriteBatch::MAX_SPRITES;
+
+        /* Batches are added to the render queue in order, and render groups
+         * draw their renderables in insertion order, so overflow batches are
+         * drawn after the ones before them */
+        while(bucket.batches.size() < batches_needed) {
+            auto batch = std::make_shared<SpriteBatch>(key.material_id, key.priority);
+            stage_->render_queue->insert_renderable(batch.get());
+            bucket.batches.push_back(batch);
+        }
+
+        for(uint32_t i = 0; i < bucket.batches.size(); ++i) {
+            auto& batch = bucket.batches[i];
+
+            const uint32_t first = i * SpriteBatch::MAX_SPRITES;
+            const uint32_t count = (first < entries.size()) ?
+                std::min<uint32_t>(entries.size() - first, SpriteBatch::MAX_SPRITES) : 0;
+
+            build_batch(batch.get(), (count) ? &entries[first] : nullptr, count);
+
+            if(count) {
+                result.push_back(batch);
+            }
+        }
+
+        ++it;
+    }
+
+    return result;
+}
+
+void SpriteBatcher::build_batch(SpriteBatch* batch, const Entry* entries, uint32_t count) {
+    batch->sprite_count_ = count;
+
+    if(!count) {
+        return;
+    }
+
+    if(count > batch->index_capacity_) {
+        /* Grow geometrically so that a slowly growing number of sprites
+         * doesn't rebuild the indices every frame */
+        const uint32_t capacity = std::max(
+            count, std::min(batch->index_capacity_ * 2, SpriteBatch::MAX_SPRITES)
+        );
+
+        batch->index_data_.resize(capacity * 6);
+        uint16_t* indices = (uint16_t*) batch->index_data_.data();
+        for(uint32_t i = 0; i < capacity; ++i) {
+            const uint16_t start = uint16_t(i * 4);
+            *indices++ = start + 0;
+            *indices++ = start + 1;
+            *indices++ = start + 2;
+
+            *indices++ = start + 0;
+            *indices++ = start + 2;
+            *indices++ = start + 3;
+        }
+
+        batch->index_data_.done();
+        batch->index_capacity_ = capacity;
+        batch->indices_dirty_ = true;
+    }
+
+    auto& vertex_data = batch->vertex_data_;
+    vertex_data.resize(count * 4);
+
+    const auto& spec = vertex_data.specification();
+    const uint32_t stride = vertex_data.stride();
+    const uint32_t position_offset = spec.position_offset();
+    const uint32_t texcoord_offset = spec.texcoord0_offset();
+    const uint32_t colour_offset = spec.diffuse_offset();
+
+    Vec3 min = entries[0].corners[0];
+    Vec3 max = min;
+
+    uint8_t* out = vertex_data.data();
+    for(uint32_t i = 0; i < count; ++i) {
+        const Entry& entry = entries[i];
+        const float* tc = entry.sprite->texture_coordinates_;
+        const float alpha = entry.sprite->alpha();
+
+        // Same winding and texture coordinates as the mesh of an unbatched sprite
+        const float uvs[4][2] = {
+            {tc[0], tc[1]}, {tc[2], tc[1]}, {tc[2], tc[3]}, {tc[0], tc[3]}
+        };
+
+        for(uint32_t j = 0; j < 4; ++j) {
+            const Vec3& corner = entry.corners[j];
+
+            float* pos = (float*) (out + position_offset);
+            pos[0] = corner.x;
+            pos[1] = corner.y;
+            pos[2] = corner.z;
+
+            float* uv = (float*) (out + texcoord_offset);
+            uv[0] = uvs[j][0];
+            uv[1] = uvs[j][1];
+
+            float* diffuse = (float*) (out + colour_offset);
+            diffuse[0] = diffuse[1] = diffuse[2] = 1.0f;
+            diffuse[3] = alpha;
+
+            min.x = std::min(min.x, corner.x);
+            min.y = std::min(min.y, corner.y);
+            min.z = std::min(min.z, corner.z);
+            max.x = std::max(max.x, corner.x);
+            max.y = std::max(max.y, corner.y);
+            max.z = std::max(max.z, corner.z);
+
+            out += stride;
+        }
+    }
+
+    vertex_data.done();
+
+    batch->aabb_ = AABB(min, max);
+    batch->vertices_dirty_ = true;
+}
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "../types.h"
+#include "../vertex_data.h"
+#include "../frustum.h"
+#include "../nodes/stage_node.h"
+#include "../renderers/batching/renderable.h"
+
+namespace smlt {
+
+class Stage;
+class Sprite;
+class SpriteManager;
+class HardwareBuffer;
+
+/*
+ * A streaming vertex buffer holding the quads of every visible sprite that
+ * shares a material and render priority. Rebuilt by the SpriteBatcher each
+ * time a camera renders the stage.
+ */
+class SpriteBatch:
+    public Renderable {
+
+public:
+    /* Each sprite is 4 vertices, and indices are 16 bit */
+    const static uint32_t MAX_SPRITES = 65535 / 4;
+
+    SpriteBatch(MaterialID material_id, RenderPriority priority);
+
+    const AABB& aabb() const override { return aabb_; }
+    const AABB transformed_aabb() const override { return aabb_; }
+
+    const MeshArrangement arrangement() const override { return MESH_ARRANGEMENT_TRIANGLES; }
+
+    void prepare_buffers(Renderer* renderer) override;
+
+    VertexSpecification vertex_attribute_specification() const override {
+        return vertex_data_.specification();
+    }
+
+    HardwareBuffer* vertex_attribute_buffer() const override { return vertex_buffer_.get(); }
+    HardwareBuffer* index_buffer() const override { return index_buffer_.get(); }
+
+    std::size_t index_element_count() const override { return sprite_count_ * 6; }
+    IndexType index_type() const override { return INDEX_TYPE_16_BIT; }
+
+    RenderPriority render_priority() const override { return priority_; }
+
+    Mat4 final_transformation() const override {
+        return Mat4(); // Vertices are built in world space
+    }
+
+    const MaterialID material_id() const override { return material_id_; }
+    const bool is_visible() const override { return true; }
+
+    uint32_t sprite_count() const { return sprite_count_; }
+
+private:
+    friend class SpriteBatcher;
+
+    MaterialID material_id_;
+    RenderPriority priority_;
+
+    VertexData vertex_data_;
+    IndexData index_data_;
+
+    std::unique_ptr<HardwareBuffer> vertex_buffer_;
+    std::unique_ptr<HardwareBuffer> index_buffer_;
+
+    uint32_t sprite_count_ = 0;
+
+    /* The number of sprites the index data covers, indices only change when
+     * this grows */
+    uint32_t index_capacity_ = 0;
+    bool indices_dirty_ = false;
+    bool vertices_dirty_ = false;
+
+    AABB aabb_;
+};
+
+typedef std::shared_ptr<SpriteBatch> SpriteBatchPtr;
+
+/*
+ * Packs batched sprites into one SpriteBatch per material and render
+ * priority (split further if there are more than SpriteBatch::MAX_SPRITES),
+ * so a 2D scene costs a draw call per texture rather than one per sprite.
+ *
+ * Within a batch, sprites are drawn back-to-front along the camera's view
+ * direction so alpha blending works. Render priority is respected because
+ * it's part of the batch key, but sprites with different materials and the
+ * same priority can't interleave - keep overlapping sprites on a shared
+ * spritesheet, or give them different priorities.
+ */
+class SpriteBatcher {
+public:
+    SpriteBatcher(Stage* stage, SpriteManager* manager);
+    ~SpriteBatcher();
+
+    /* Culls the sprites against the frustum and rebuilds the batches */
+    RenderableList _get_renderables(const Frustum& frustum);
+
+    std::size_t batch_count() const;
+
+private:
+    struct Key {
+        MaterialID material_id;
+        RenderPriority priority;
+
+        bool operator<(const Key& rhs) const {
+            if(priority != rhs.priority) {
+                return priority < rhs.priority;
+            }
+
+            return material_id < rhs.material_id;
+        }
+    };
+
+    struct Entry {
+        float depth;
+        uint32_t id; // Tie-breaker, so that equal depths don't flicker
+        Vec3 corners[4];
+        Sprite* sprite;
+    };
+
+    struct Bucket {
+        std::vector<SpriteBatchPtr> batches;
+        std::vector<Entry> entries;
+        bool in_use = false;
+    };
+
+    Stage* stage_;
+    SpriteManager* manager_;
+
+    std::map<Key, Bucket> buckets_;
+
+    /* Writes the quads for `count` entries, which must already be in draw order */
+    void build_batch(SpriteBatch* batch, const Entry* entries, uint32_t count);
+    void release(Bucket& bucket);
+};
+
+}
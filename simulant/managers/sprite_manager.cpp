@@ -2,6 +2,7 @@
 #include "../texture.h"
 #include "../window.h"
 #include "../stage.h"
+#include "../material.h"
 
 namespace smlt {
 
@@ -64,4 +65,46 @@ std::size_t SpriteManager::sprite_count() const {
     return TemplatedSpriteManager::count();
 }
 
+void SpriteManager::set_batching_enabled(bool value) {
+    if(value == batching_enabled()) {
+        return;
+    }
+
+    if(sprite_count()) {
+        throw std::logic_error("Sprite batching can only be changed before any sprites are created");
+    }
+
+    if(value) {
+        batcher_.reset(new SpriteBatcher(stage_, this));
+    } else {
+        batcher_.reset();
+        batch_materials_.clear();
+    }
+}
+
+std::size_t SpriteManager::batch_count() const {
+    return (batcher_) ? batcher_->batch_count() : 0;
+}
+
+RenderableList SpriteManager::_get_renderables(const Frustum& frustum) {
+    if(!batcher_) {
+        return RenderableList();
+    }
+
+    return batcher_->_get_renderables(frustum);
+}
+
+MaterialID SpriteManager::_batch_material(TextureID texture_id) {
+    auto it = batch_materials_.find(texture_id);
+    if(it != batch_materials_.end() && stage_->assets->has_material(it->second)) {
+        return it->second;
+    }
+
+    auto material_id = stage_->assets->new_material_from_texture(texture_id);
+    stage_->assets->material(material_id)->first_pass()->set_blending(smlt::BLEND_ALPHA);
+
+    batch_materials_[texture_id] = material_id;
+    return material_id;
+}
+
 }
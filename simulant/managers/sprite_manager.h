@@ -1,8 +1,12 @@
 #pragma once
 
+#include <memory>
+#include <unordered_map>
+
 #include "../generic/manager.h"
 #include "../nodes/sprite.h"
 #include "./window_holder.h"
+#include "./sprite_batcher.h"
 
 namespace smlt {
 
@@ -40,9 +44,29 @@ public:
     std::size_t sprite_count() const;
     void delete_all();
 
+    /* When enabled, sprites don't get their own mesh and actor. Instead, all
+     * sprites sharing a texture and render priority are drawn together from
+     * a single vertex buffer which is rebuilt each frame (see SpriteBatcher).
+     * Sprites created from the same texture share a material. This can only be
+     * changed while the manager has no sprites. */
+    void set_batching_enabled(bool value=true);
+    bool batching_enabled() const { return bool(batcher_); }
+
+    /* The number of batches drawn by the last camera to render the stage */
+    std::size_t batch_count() const;
+
+    /* Called by the render pipeline, returns nothing if batching is disabled */
+    RenderableList _get_renderables(const Frustum& frustum);
+
+    /* Returns the material shared by every batched sprite using this texture */
+    MaterialID _batch_material(TextureID texture_id);
+
     Property<SpriteManager, Stage> stage = { this, &SpriteManager::stage_ };
 private:
     Stage* stage_ = nullptr;
+
+    std::unique_ptr<SpriteBatcher> batcher_;
+    std::unordered_map<TextureID, MaterialID> batch_materials_;
 };
 
 }
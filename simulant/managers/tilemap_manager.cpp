@@ -0,0 +1,480 @@
+#include "../window.h"
+#include "../loader.h"
+#include "../stage.h"
+#include "../material.h"
+#include "../texture.h"
+#include "../nodes/actor.h"
+#include "../meshes/mesh.h"
+#include "../profiler.h"
+
+#include "tilemap_manager.h"
+
+namespace smlt {
+
+const static VertexSpecification TILEMAP_VERTEX_SPEC(
+        smlt::VERTEX_ATTRIBUTE_3F, // Position
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_4F // Diffuse
+);
+
+/* The distance between layers along Z */
+const static float LAYER_SPACING = 0.01f;
+
+Tilemap::Tilemap(TilemapID id, TilemapManager* manager):
+    generic::Identifiable<TilemapID>(id),
+    ContainerNode(&(Stage&)manager->stage),
+    manager_(manager) {
+
+}
+
+bool Tilemap::init() {
+    return true;
+}
+
+void Tilemap::cleanup() {
+    for(auto& layer: layers_) {
+        for(auto& chunk: layer.chunks) {
+            destroy_chunk(chunk);
+        }
+    }
+
+    layers_.clear();
+}
+
+void Tilemap::ask_owner_for_destruction() {
+    manager_->delete_tilemap(id());
+}
+
+const AABB& Tilemap::aabb() const {
+    return aabb_;
+}
+
+void Tilemap::update(float dt) {
+    rebuild_dirty_chunks();
+}
+
+TileIndex Tilemap::add_tileset(TextureID texture_id, uint32_t tile_width, uint32_t tile_height, uint32_t margin, uint32_t spacing) {
+    if(!tile_width || !tile_height) {
+        throw std::logic_error("Tileset tiles must have a non-zero size");
+    }
+
+    auto stage = get_stage();
+    auto texture = stage->assets->texture(texture_id);
+
+    Tileset tileset;
+    tileset.texture_id = texture_id;
+    tileset.tile_width = tile_width;
+    tileset.tile_height = tile_height;
+    tileset.margin = margin;
+    tileset.spacing = spacing;
+    tileset.image_width = texture->width();
+    tileset.image_height = texture->height();
+    tileset.tile_count = tileset.tiles_wide() * tileset.tiles_high();
+    tileset.first_tile = (tilesets_.empty()) ? 1 : tilesets_.back().first_tile + tilesets_.back().tile_count;
+
+    if(tileset.first_tile + tileset.tile_count > std::numeric_limits<TileIndex>::max()) {
+        throw std::out_of_range("Too many tiles in the tilemap's tilesets");
+    }
+
+    // One material per tileset, shared by the chunks of every layer
+    tileset.material_id = stage->assets->new_material_from_texture(texture_id);
+    auto material = stage->assets->material(tileset.material_id);
+    material->first_pass()->set_blending(smlt::BLEND_ALPHA);
+
+    tilesets_.push_back(tileset);
+    tileset_materials_.push_back(material);
+
+    // Existing tiles may refer to the new tileset
+    for(auto& layer: layers_) {
+        for(auto& chunk: layer.chunks) {
+            chunk.dirty = true;
+        }
+    }
+
+    return tileset.first_tile;
+}
+
+void Tilemap::set_chunk_size(uint32_t tiles) {
+    if(!layers_.empty()) {
+        throw std::logic_error("The chunk size can't be changed after layers have been added");
+    }
+
+    if(!tiles || tiles > MAX_CHUNK_SIZE) {
+        throw std::out_of_range("Invalid tilemap chunk size");
+    }
+
+    chunk_size_ = tiles;
+}
+
+void Tilemap::set_tile_render_size(float size) {
+    if(!layers_.empty()) {
+        throw std::logic_error("The tile size can't be changed after layers have been added");
+    }
+
+    tile_render_size_ = size;
+}
+
+uint32_t Tilemap::new_layer(const std::string& name, uint32_t width, uint32_t height) {
+    Layer layer;
+    layer.name = name;
+    layer.width = width;
+    layer.height = height;
+    layer.chunks_wide = (width + chunk_size_ - 1) / chunk_size_;
+    layer.chunks_high = (height + chunk_size_ - 1) / chunk_size_;
+    layer.tiles.resize(width * height, 0);
+    layer.chunks.resize(layer.chunks_wide * layer.chunks_high);
+
+    layers_.push_back(std::move(layer));
+
+    /* The bounds cover every layer, whether or not it has any tiles */
+    float max_width = 0.0f, max_height = 0.0f;
+    for(auto& l: layers_) {
+        max_width = std::max(max_width, l.width * tile_render_size_);
+        max_height = std::max(max_height, l.height * tile_render_size_);
+    }
+
+    aabb_ = AABB(Vec3(), Vec3(max_width, max_height, (layers_.size() - 1) * LAYER_SPACING));
+
+    return layers_.size() - 1;
+}
+
+int32_t Tilemap::find_layer(const std::string& name) const {
+    for(uint32_t i = 0; i < layers_.size(); ++i) {
+        if(layers_[i].name == name) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void Tilemap::set_tile(uint32_t layer_index, uint32_t x, uint32_t y, TileIndex tile) {
+    auto& layer = layers_.at(layer_index);
+
+    if(x >= layer.width || y >= layer.height) {
+        throw std::out_of_range("Tile coordinate is outside the layer");
+    }
+
+    auto& current = layer.tiles[(y * layer.width) + x];
+    if(current == tile) {
+        return;
+    }
+
+    current = tile;
+
+    const uint32_t chunk_x = x / chunk_size_;
+    const uint32_t chunk_y = y / chunk_size_;
+    layer.chunks[(chunk_y * layer.chunks_wide) + chunk_x].dirty = true;
+}
+
+TileIndex Tilemap::tile(uint32_t layer_index, uint32_t x, uint32_t y) const {
+    auto& layer = layers_.at(layer_index);
+
+    if(x >= layer.width || y >= layer.height) {
+        throw std::out_of_range("Tile coordinate is outside the layer");
+    }
+
+    return layer.tiles[(y * layer.width) + x];
+}
+
+uint32_t Tilemap::chunk_count() const {
+    uint32_t count = 0;
+    for(auto& layer: layers_) {
+        count += layer.chunks.size();
+    }
+    return count;
+}
+
+uint32_t Tilemap::dirty_chunk_count() const {
+    uint32_t count = 0;
+    for(auto& layer: layers_) {
+        for(auto& chunk: layer.chunks) {
+            count += (chunk.dirty) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+uint32_t Tilemap::built_chunk_count() const {
+    uint32_t count = 0;
+    for(auto& layer: layers_) {
+        for(auto& chunk: layer.chunks) {
+            count += (chunk.actor_id) ? 1 : 0;
+        }
+    }
+    return count;
+}
+
+uint32_t Tilemap::rebuild_dirty_chunks() {
+    uint32_t rebuilt = 0;
+
+    for(uint32_t i = 0; i < layers_.size(); ++i) {
+        auto& layer = layers_[i];
+
+        for(uint32_t cy = 0; cy < layer.chunks_high; ++cy) {
+            for(uint32_t cx = 0; cx < layer.chunks_wide; ++cx) {
+                if(layer.chunks[(cy * layer.chunks_wide) + cx].dirty) {
+                    rebuild_chunk(i, cx, cy);
+                    ++rebuilt;
+                }
+            }
+        }
+    }
+
+    return rebuilt;
+}
+
+const Tileset* Tilemap::tileset_for(TileIndex tile) const {
+    for(auto& tileset: tilesets_) {
+        if(tile >= tileset.first_tile && tile < tileset.first_tile + tileset.tile_count) {
+            return &tileset;
+        }
+    }
+
+    return nullptr;
+}
+
+void Tilemap::destroy_chunk(Chunk& chunk) {
+    auto stage = get_stage();
+
+    /* The stage may already have destroyed the actor, as it destroys
+     * children before their parents */
+    if(chunk.actor_id && stage->has_actor(chunk.actor_id)) {
+        stage->delete_actor(chunk.actor_id);
+    }
+
+    chunk.actor_id = ActorID();
+
+    if(chunk.mesh_id && stage->assets->has_mesh(chunk.mesh_id)) {
+        stage->assets->delete_mesh(chunk.mesh_id);
+    }
+
+    chunk.mesh_id = MeshID();
+}
+
+void Tilemap::rebuild_chunk(uint32_t layer_index, uint32_t chunk_x, uint32_t chunk_y) {
+    S_PROFILE_SCOPE("Tilemap::rebuild_chunk");
+
+    auto& layer = layers_[layer_index];
+    auto& chunk = layer.chunks[(chunk_y * layer.chunks_wide) + chunk_x];
+    chunk.dirty = false;
+
+    const uint32_t x_begin = chunk_x * chunk_size_;
+    const uint32_t x_end = std::min(x_begin + chunk_size_, layer.width);
+    const uint32_t y_begin = chunk_y * chunk_size_;
+    const uint32_t y_end = std::min(y_begin + chunk_size_, layer.height);
+
+    /* First pass, count the tiles using each tileset so everything can be
+     * sized up front */
+    std::vector<uint32_t> tile_counts(tilesets_.size(), 0);
+    uint32_t total = 0;
+
+    for(uint32_t y = y_begin; y < y_end; ++y) {
+        for(uint32_t x = x_begin; x < x_end; ++x) {
+            TileIndex tile = layer.tiles[(y * layer.width) + x];
+            auto tileset = (tile) ? tileset_for(tile) : nullptr;
+            if(tileset) {
+                tile_counts[tileset - &tilesets_[0]]++;
+                ++total;
+            }
+        }
+    }
+
+    if(!total) {
+        destroy_chunk(chunk);
+        return;
+    }
+
+    auto stage = get_stage();
+
+    if(!chunk.mesh_id) {
+        chunk.mesh_id = stage->assets->new_mesh(TILEMAP_VERTEX_SPEC, GARBAGE_COLLECT_NEVER);
+    }
+
+    auto mesh = stage->assets->mesh(chunk.mesh_id);
+    const AABB old_bounds = mesh->aabb();
+
+    /* One submesh per tileset, indexing into the shared vertex data. Each
+     * submesh gets a range of the vertices so they can be written in a single
+     * pass over the tiles */
+    std::vector<uint16_t*> indices(tilesets_.size(), nullptr);
+    std::vector<uint32_t> next_vertex(tilesets_.size(), 0);
+
+    uint32_t first_vertex = 0;
+    for(uint32_t i = 0; i < tilesets_.size(); ++i) {
+        const std::string name = "tileset " + std::to_string(i);
+
+        if(!tile_counts[i]) {
+            // Empty submeshes would still contribute to the mesh bounds
+            if(mesh->has_submesh(name)) {
+                mesh->delete_submesh(name);
+            }
+            continue;
+        }
+
+        SubMesh* submesh = (mesh->has_submesh(name)) ?
+            mesh->submesh(name) : mesh->new_submesh_with_material(name, tilesets_[i].material_id);
+
+        submesh->index_data->resize(tile_counts[i] * 6);
+        indices[i] = (uint16_t*) submesh->index_data->data();
+        next_vertex[i] = first_vertex;
+        first_vertex += tile_counts[i] * 4;
+    }
+
+    auto& vertex_data = mesh->vertex_data;
+    vertex_data->resize(total * 4);
+
+    const auto& spec = vertex_data->specification();
+    const uint32_t stride = vertex_data->stride();
+    uint8_t* data = vertex_data->data();
+
+    const float size = tile_render_size_;
+    const float z = layer_index * LAYER_SPACING;
+
+    for(uint32_t y = y_begin; y < y_end; ++y) {
+        for(uint32_t x = x_begin; x < x_end; ++x) {
+            TileIndex tile = layer.tiles[(y * layer.width) + x];
+            auto tileset = (tile) ? tileset_for(tile) : nullptr;
+            if(!tileset) {
+                continue;
+            }
+
+            const uint32_t ts = tileset - &tilesets_[0];
+            const uint32_t local = tile - tileset->first_tile;
+            const uint32_t across = tileset->tiles_wide();
+
+            const uint32_t x_offset = local % across;
+            const uint32_t y_offset = local / across;
+
+            const float iw = float(tileset->image_width);
+            const float ih = float(tileset->image_height);
+
+            float x0 = x_offset * (tileset->tile_width + tileset->spacing) + tileset->margin;
+            float y0 = ih - y_offset * (tileset->tile_height + tileset->spacing) - tileset->margin;
+            float x1 = x0 + tileset->tile_width;
+            float y1 = y0 - tileset->tile_height;
+
+            // Same half-texel inset as the TMX mesh loader, to avoid bleeding
+            const float tx0 = x0 / iw + (0.5f / iw);
+            const float ty0 = y0 / ih - (0.5f / ih);
+            const float tx1 = x1 / iw - (0.5f / iw);
+            const float ty1 = y1 / ih + (0.5f / ih);
+
+            const float px0 = x * size;
+            const float px1 = px0 + size;
+            const float py1 = (layer.height - y) * size;
+            const float py0 = py1 - size;
+
+            const float corners[4][4] = {
+                {px0, py0, tx0, ty1},
+                {px1, py0, tx1, ty1},
+                {px1, py1, tx1, ty0},
+                {px0, py1, tx0, ty0}
+            };
+
+            const uint32_t base = next_vertex[ts];
+            next_vertex[ts] += 4;
+
+            uint8_t* out = data + (base * stride);
+            for(uint32_t j = 0; j < 4; ++j) {
+                float* pos = (float*) (out + spec.position_offset());
+                pos[0] = corners[j][0];
+                pos[1] = corners[j][1];
+                pos[2] = z;
+
+                float* uv = (float*) (out + spec.texcoord0_offset());
+                uv[0] = corners[j][2];
+                uv[1] = corners[j][3];
+
+                float* diffuse = (float*) (out + spec.diffuse_offset());
+                diffuse[0] = diffuse[1] = diffuse[2] = diffuse[3] = 1.0f;
+
+                out += stride;
+            }
+
+            uint16_t*& idx = indices[ts];
+            *idx++ = base + 0;
+            *idx++ = base + 1;
+            *idx++ = base + 2;
+            *idx++ = base + 0;
+            *idx++ = base + 2;
+            *idx++ = base + 3;
+        }
+    }
+
+    vertex_data->done();
+    mesh->each_submesh([](const std::string&, SubMesh* submesh) {
+        submesh->index_data->done();
+    });
+
+    if(chunk.actor_id && (mesh->aabb().min() != old_bounds.min() || mesh->aabb().max() != old_bounds.max())) {
+        /* The partitioner only learns an actor's bounds when it moves, so if
+         * the chunk's bounds changed the actor is replaced. This only happens
+         * when tiles are added to the edge of a chunk's existing area */
+        stage->delete_actor(chunk.actor_id);
+        chunk.actor_id = ActorID();
+    }
+
+    if(!chunk.actor_id) {
+        auto actor = stage->new_actor_with_mesh(chunk.mesh_id);
+        actor->set_parent(this);
+        chunk.actor_id = actor->id();
+    }
+}
+
+
+TilemapManager::TilemapManager(Window* window, Stage* stage):
+    WindowHolder(window),
+    stage_(stage) {
+
+}
+
+TilemapPtr TilemapManager::new_tilemap() {
+    assert(stage_);
+
+    TilemapID tid = TemplatedTilemapManager::make(this);
+
+    auto map = tilemap(tid);
+    map->set_parent(stage_->id());
+    return map;
+}
+
+TilemapPtr TilemapManager::new_tilemap_from_tmx_file(const unicode& filename, float tile_render_size) {
+    auto map = new_tilemap();
+
+    try {
+        map->set_tile_render_size(tile_render_size);
+        window->loader_for(filename.encode())->into(map);
+    } catch(...) {
+        delete_tilemap(map->id());
+        throw;
+    }
+
+    return map;
+}
+
+TilemapPtr TilemapManager::tilemap(TilemapID tilemap_id) {
+    return TemplatedTilemapManager::get(tilemap_id).lock().get();
+}
+
+bool TilemapManager::has_tilemap(TilemapID tilemap_id) const {
+    return TemplatedTilemapManager::contains(tilemap_id);
+}
+
+void TilemapManager::delete_tilemap(TilemapID tilemap_id) {
+    TemplatedTilemapManager::destroy(tilemap_id);
+}
+
+std::size_t TilemapManager::tilemap_count() const {
+    return TemplatedTilemapManager::count();
+}
+
+}
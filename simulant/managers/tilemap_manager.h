@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include "../generic/managed.h"
+#include "../generic/identifiable.h"
+#include "../nodes/stage_node.h"
+#include "../loadable.h"
+#include "../types.h"
+
+#include "./window_holder.h"
+
+namespace smlt {
+
+class TilemapManager;
+
+/* 0 means "no tile", tileset tiles are numbered from 1 in the order the
+ * tilesets were added (like Tiled's global tile IDs) */
+typedef uint16_t TileIndex;
+
+struct Tileset {
+    TextureID texture_id;
+    MaterialID material_id;
+
+    uint32_t first_tile = 1;
+    uint32_t tile_count = 0;
+
+    uint32_t tile_width = 0;
+    uint32_t tile_height = 0;
+    uint32_t margin = 0;
+    uint32_t spacing = 0;
+
+    uint32_t image_width = 0;
+    uint32_t image_height = 0;
+
+    uint32_t tiles_wide() const {
+        return (image_width - (margin * 2) + spacing) / (tile_width + spacing);
+    }
+
+    uint32_t tiles_high() const {
+        return (image_height - (margin * 2) + spacing) / (tile_height + spacing);
+    }
+};
+
+/*
+ * A 2D tile map made of one or more layers. Each layer stores its tiles as a
+ * grid of TileIndex values, split into square chunks. Every chunk that has
+ * tiles is an actor with its own mesh (one submesh per tileset it uses), so
+ * chunks are culled by the stage's partitioner like anything else.
+ *
+ * Changing a tile only marks its chunk as dirty, dirty chunks are rebuilt in
+ * update() (or by calling rebuild_dirty_chunks()).
+ *
+ * Tile (0, 0) is the top-left of the map, as in Tiled. The map extends along
+ * +X and +Y from the tilemap's position, each tile being tile_render_size
+ * units square. Layers are stacked towards +Z in the order they were created.
+ */
+class Tilemap :
+    public Managed<Tilemap>,
+    public generic::Identifiable<TilemapID>,
+    public ContainerNode,
+    public Loadable {
+
+public:
+    const static uint32_t DEFAULT_CHUNK_SIZE = 16;
+
+    /* Keeps a chunk's vertices within the range of 16-bit indices */
+    const static uint32_t MAX_CHUNK_SIZE = 64;
+
+    Tilemap(TilemapID id, TilemapManager* manager);
+
+    bool init() override;
+    void cleanup() override;
+    void update(float dt) override;
+
+    void ask_owner_for_destruction() override;
+
+    const AABB& aabb() const override;
+
+    /* Adds a tileset image, returns the index of its first tile. Tilesets are
+     * shared by every layer */
+    TileIndex add_tileset(
+        TextureID texture_id,
+        uint32_t tile_width,
+        uint32_t tile_height,
+        uint32_t margin=0,
+        uint32_t spacing=0
+    );
+
+    uint32_t tileset_count() const { return tilesets_.size(); }
+    const Tileset& tileset(uint32_t i) const { return tilesets_.at(i); }
+
+    /* Chunk size and tile size can only be changed before the first layer is added */
+    void set_chunk_size(uint32_t tiles);
+    uint32_t chunk_size() const { return chunk_size_; }
+
+    void set_tile_render_size(float size);
+    float tile_render_size() const { return tile_render_size_; }
+
+    /* Returns the index of the new layer */
+    uint32_t new_layer(const std::string& name, uint32_t width, uint32_t height);
+    uint32_t layer_count() const { return layers_.size(); }
+
+    /* Returns -1 if there is no layer with that name */
+    int32_t find_layer(const std::string& name) const;
+
+    uint32_t layer_width(uint32_t layer) const { return layers_.at(layer).width; }
+    uint32_t layer_height(uint32_t layer) const { return layers_.at(layer).height; }
+
+    void set_tile(uint32_t layer, uint32_t x, uint32_t y, TileIndex tile);
+    TileIndex tile(uint32_t layer, uint32_t x, uint32_t y) const;
+
+    /* Returns the number of chunks rebuilt */
+    uint32_t rebuild_dirty_chunks();
+
+    uint32_t chunk_count() const;
+    uint32_t dirty_chunk_count() const;
+
+    /* The number of chunks which have geometry, and so an actor */
+    uint32_t built_chunk_count() const;
+
+private:
+    struct Chunk {
+        ActorID actor_id;
+        MeshID mesh_id;
+        bool dirty = false;
+    };
+
+    struct Layer {
+        std::string name;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t chunks_wide = 0;
+        uint32_t chunks_high = 0;
+
+        std::vector<TileIndex> tiles;
+        std::vector<Chunk> chunks;
+    };
+
+    TilemapManager* manager_ = nullptr;
+
+    uint32_t chunk_size_ = DEFAULT_CHUNK_SIZE;
+    float tile_render_size_ = 1.0f;
+
+    std::vector<Tileset> tilesets_;
+
+    /* Keep the tileset materials alive while the map exists */
+    std::vector<MaterialPtr> tileset_materials_;
+
+    std::vector<Layer> layers_;
+
+    AABB aabb_;
+
+    const Tileset* tileset_for(TileIndex tile) const;
+    void rebuild_chunk(uint32_t layer_index, uint32_t chunk_x, uint32_t chunk_y);
+    void destroy_chunk(Chunk& chunk);
+};
+
+typedef generic::TemplatedManager<Tilemap, TilemapID> TemplatedTilemapManager;
+
+class TilemapManager :
+    public TemplatedTilemapManager,
+    public virtual WindowHolder {
+
+public:
+    TilemapManager(Window* window, Stage* stage);
+
+    TilemapManager(const TilemapManager& rhs) = delete;
+    TilemapManager& operator=(const TilemapManager&) = delete;
+
+    TilemapPtr new_tilemap();
+
+    /* Loads every tile layer and tileset from a Tiled (.tmx) map */
+    TilemapPtr new_tilemap_from_tmx_file(const unicode& filename, float tile_render_size=1.0f);
+
+    TilemapPtr tilemap(TilemapID tilemap_id);
+    bool has_tilemap(TilemapID tilemap_id) const;
+    void delete_tilemap(TilemapID tilemap_id);
+    std::size_t tilemap_count() const;
+
+    Property<TilemapManager, Stage> stage = { this, &TilemapManager::stage_ };
+private:
+    Stage* stage_ = nullptr;
+};
+
+}
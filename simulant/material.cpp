@@ -40,6 +40,7 @@ const std::string Material::BuiltIns::MULTITEXTURE2_MODULATE_WITH_LIGHTING = "si
 const std::string Material::BuiltIns::SKYBOX = "simulant/materials/${RENDERER}/skybox.kglm";
 const std::string Material::BuiltIns::TEXTURED_PARTICLE = "simulant/materials/${RENDERER}/textured_particle.kglm";
 const std::string Material::BuiltIns::DIFFUSE_PARTICLE = "simulant/materials/${RENDERER}/diffuse_particle.kglm";
+const std::string Material::BuiltIns::BILLBOARD_PARTICLE = "simulant/materials/${RENDERER}/billboard_particle.kglm";
 
 /* This list is used by the particle script loader to determine if a specified material
  * is a built-in or not. Please keep this up-to-date when changing the above materials!
@@ -56,7 +57,8 @@ const std::map<std::string, std::string> Material::BUILT_IN_NAMES = {
     {"MULTITEXTURE2_MODULATE_WITH_LIGHTING", Material::BuiltIns::MULTITEXTURE2_MODULATE_WITH_LIGHTING},
     {"SKYBOX", Material::BuiltIns::SKYBOX},
     {"TEXTURED_PARTICLE", Material::BuiltIns::TEXTURED_PARTICLE},
-    {"DIFFUSE_PARTICLE", Material::BuiltIns::DIFFUSE_PARTICLE}
+    {"DIFFUSE_PARTICLE", Material::BuiltIns::DIFFUSE_PARTICLE},
+    {"BILLBOARD_PARTICLE", Material::BuiltIns::BILLBOARD_PARTICLE}
 };
 
 static const std::string DEFAULT_VERT_SHADER = R"(
@@ -122,6 +124,10 @@ TextureID TextureUnit::texture_id() const {
     }
 }
 
+const TexturePtr& TextureUnit::texture() const {
+    return (is_animated()) ? animated_texture_units_[current_texture_] : texture_unit_;
+}
+
 Material::Material(MaterialID mat_id, ResourceManager *resource_manager):
     Resource(resource_manager),
     generic::Identifiable<MaterialID>(mat_id) {
@@ -203,6 +209,19 @@ void MaterialPass::set_animated_texture_unit(uint32_t texture_unit_id, const std
     material->on_pass_changed(this);
 }
 
+void MaterialPass::set_texture_units_from(const MaterialPass& other) {
+    if(!allow_textures_) {
+        throw std::logic_error("Attempted to set a texture on a pass which prevents them");
+    }
+
+    texture_units_.clear();
+    for(auto& unit: other.texture_units_) {
+        texture_units_.push_back(unit.new_clone(*this));
+    }
+
+    material->on_pass_changed(this);
+}
+
 void MaterialPass::set_iteration(IterationType iter_type, uint32_t max) {
     iteration_ = iter_type;
     max_iterations_ = max;
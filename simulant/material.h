@@ -64,6 +64,9 @@ public:
 
     TextureID texture_id() const;
 
+    /* The current texture, which may be null if none was set */
+    const TexturePtr& texture() const;
+
     void update(float dt) {
         if(!is_animated()) return;
 
@@ -157,6 +160,10 @@ public:
     void set_texture_unit(uint32_t texture_unit_id, TextureID tex);
     void set_animated_texture_unit(uint32_t texture_unit_id, const std::vector<TextureID> textures, double duration);
 
+    /* Replaces the texture units with copies of those on another pass,
+     * including animation and texture matrices */
+    void set_texture_units_from(const MaterialPass& other);
+
     const Colour& diffuse() const { return diffuse_; }
     const Colour& ambient() const { return ambient_; }
     const Colour& specular() const { return specular_; }
@@ -309,6 +316,7 @@ public:
         static const std::string SKYBOX;
         static const std::string TEXTURED_PARTICLE;
         static const std::string DIFFUSE_PARTICLE;
+        static const std::string BILLBOARD_PARTICLE; ///< Point sprites, only available on renderers with GPU programs
     };
 
     static const std::map<std::string, std::string> BUILT_IN_NAMES;
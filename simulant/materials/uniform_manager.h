@@ -50,7 +50,10 @@ enum ShaderAvailableAuto {
     SP_AUTO_LIGHTS_CONSTANT_ATTENUATION,
     SP_AUTO_LIGHTS_LINEAR_ATTENUATION,
     SP_AUTO_LIGHTS_QUADRATIC_ATTENUATION,
-    SP_AUTO_LIGHT_COUNT
+    SP_AUTO_LIGHT_COUNT,
+
+    /* Height of the current viewport in pixels, for sizing point sprites */
+    SP_AUTO_VIEWPORT_HEIGHT
     //TODO: cameras(?)
 };
 
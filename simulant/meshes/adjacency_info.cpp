@@ -1,32 +1,179 @@
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+
 #include "adjacency_info.h"
 
 #include "mesh.h"
 #include "submesh.h"
+#include "../generic/threading/thread_pool.h"
 
 namespace smlt {
 
+static std::atomic<uint64_t> revision_counter(0);
+
+/* Below this, std::stable_sort is quicker than clearing the buckets */
+static const std::size_t RADIX_SORT_THRESHOLD = 256;
+
+/*
+ * Stable LSD radix sort of items on the lowest key_bits bits of key(item).
+ * Passes where every item has the same digit are skipped.
+ */
+template<typename T, typename KeyFunc>
+static void radix_sort(std::vector<T>& items, uint32_t key_bits, KeyFunc key) {
+    if(items.size() < RADIX_SORT_THRESHOLD) {
+        std::stable_sort(items.begin(), items.end(), [&key](const T& lhs, const T& rhs) {
+            return key(lhs) < key(rhs);
+        });
+        return;
+    }
+
+    const uint32_t DIGIT_BITS = 11;
+    const uint64_t MASK = (1 << DIGIT_BITS) - 1;
+
+    std::vector<T> scratch(items.size());
+    std::vector<uint32_t> counts(MASK + 1);
+
+    for(uint32_t shift = 0; shift < key_bits; shift += DIGIT_BITS) {
+        std::fill(counts.begin(), counts.end(), 0);
+
+        for(auto& item: items) {
+            ++counts[(key(item) >> shift) & MASK];
+        }
+
+        if(counts[(key(items[0]) >> shift) & MASK] == items.size()) {
+            continue;
+        }
+
+        uint32_t total = 0;
+        for(auto& count: counts) {
+            auto n = count;
+            count = total;
+            total += n;
+        }
+
+        for(auto& item: items) {
+            scratch[counts[(key(item) >> shift) & MASK]++] = item;
+        }
+
+        items.swap(scratch);
+    }
+}
+
+/* The number of bits needed to store values up to max_value */
+static uint32_t bits_for(uint64_t max_value) {
+    uint32_t bits = 1;
+    while(bits < 64 && (max_value >> bits)) {
+        ++bits;
+    }
+    return bits;
+}
+
+static uint32_t float_bits(float f) {
+    // -0.0 and 0.0 are the same position
+    if(f == 0.0f) {
+        f = 0.0f;
+    }
+
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(float));
+    return bits;
+}
+
 AdjacencyInfo::AdjacencyInfo(Mesh* mesh):
     mesh_(mesh) {
 
 }
 
-void AdjacencyInfo::rebuild() {
-    L_DEBUG("Generating adjacency info");
+void AdjacencyInfo::weld_vertices() {
+    struct WeldKey {
+        uint32_t x, y, z;
+        uint32_t index;
+    };
+
+    auto vertices = mesh_->vertex_data.get();
+    const uint32_t count = vertices->count();
 
-    auto to_tuple = [](const Vec3& v) {
-        return std::make_tuple(v.x, v.y, v.z);
+    std::vector<WeldKey> keys(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        auto p = vertices->position_at<Vec3>(i);
+        keys[i].x = float_bits(p.x);
+        keys[i].y = float_bits(p.y);
+        keys[i].z = float_bits(p.z);
+        keys[i].index = i;
+    }
+
+    // Sort by z, then by x and y. The sorts are stable, so it ends up ordered by x, y, z
+    radix_sort(keys, 32, [](const WeldKey& k) -> uint64_t { return k.z; });
+    radix_sort(keys, 64, [](const WeldKey& k) -> uint64_t { return (uint64_t(k.x) << 32) | k.y; });
+
+    welded_.resize(count);
+
+    // Each run of the same position is in index order, the first is the one we keep
+    for(uint32_t i = 0; i < count;) {
+        uint32_t j = i;
+        while(j < count && keys[j].x == keys[i].x && keys[j].y == keys[i].y && keys[j].z == keys[i].z) {
+            welded_[keys[j].index] = keys[i].index;
+            ++j;
+        }
+        i = j;
+    }
+}
+
+void AdjacencyInfo::collect_half_edges(SubMesh* submesh, SubMeshEdges& out) const {
+    auto& half_edges = out.half_edges;
+    half_edges.clear();
+    half_edges.reserve(submesh->index_data->count());
+
+    const uint32_t size = welded_.size();
+
+    auto add = [&half_edges](uint32_t from, uint32_t to, uint32_t opposite) {
+        if(from == to) {
+            // Degenerate, e.g. two vertices welded together
+            return;
+        }
+
+        HalfEdge edge;
+        edge.key = (from < to) ? (uint64_t(from) << 32) | to : (uint64_t(to) << 32) | from;
+        edge.opposite = opposite;
+        edge.reversed = (from > to);
+        half_edges.push_back(edge);
     };
 
+    submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
+        // FIXME: What if it's a vec2?
+        assert(a < size);
+        assert(b < size);
+        assert(c < size);
+        (void) size;
+
+        a = welded_[a];
+        b = welded_[b];
+        c = welded_[c];
+
+        add(a, b, c);
+        add(b, c, a);
+        add(c, a, b);
+    });
+
+    /* Sort on the key with the two indexes packed as tightly as they will go
+     * to keep the number of passes down */
+    const uint32_t bits = bits_for(std::max<uint32_t>(size, 1) - 1);
+    radix_sort(half_edges, bits * 2, [bits](const HalfEdge& e) -> uint64_t {
+        return ((e.key >> 32) << bits) | (e.key & 0xFFFFFFFF);
+    });
+}
+
+void AdjacencyInfo::rebuild() {
+    L_DEBUG("Generating adjacency info");
+
     if(!mesh_) {
         return;
     }
 
     edges_.clear();
-
-    typedef std::tuple<uint32_t, uint32_t> edge_pair;
-    typedef std::tuple<float, float, float> vec_tuple;
-    std::unordered_map<vec_tuple, uint32_t> position_map;
-    std::unordered_map<edge_pair, uint32_t> edge_triangles;
+    revision_ = ++revision_counter;
 
     // FIXME: handle other types
     if(mesh_->vertex_data->specification().position_attribute != VERTEX_ATTRIBUTE_3F) {
@@ -35,16 +182,18 @@ void AdjacencyInfo::rebuild() {
     }
 
     auto vertices = mesh_->vertex_data.get();
-    auto calculate_normal = [&vertices](uint32_t a, uint32_t b, uint32_t c) -> smlt::Vec3 {
-        auto va = vertices->position_at<smlt::Vec3>(a);
-        auto vb = vertices->position_at<smlt::Vec3>(b);
-        auto vc = vertices->position_at<smlt::Vec3>(c);
-        auto v1 = vb - va;
-        auto v2 = vc - va;
-        return v1.cross(v2).normalized();
-    };
 
-    auto size = mesh_->vertex_data->count();
+    if(vertices->revision() != vertex_revision_ || welded_.size() != vertices->count()) {
+        weld_vertices();
+        vertex_revision_ = vertices->revision();
+
+        // Every half edge refers to welded indexes
+        submesh_edges_.clear();
+    }
+
+    std::vector<SubMeshEdges*> lists;
+    std::vector<std::pair<SubMesh*, SubMeshEdges*>> dirty;
+    std::unordered_set<const SubMesh*> seen;
 
     mesh_->each([&](const std::string&, SubMeshPtr submesh) {
         if(!submesh->contributes_to_edge_list()) {
@@ -52,72 +201,110 @@ void AdjacencyInfo::rebuild() {
             return;
         }
 
-        submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
-            // FIXME: What if it's a vec2?
-            assert(a < size);
-            assert(b < size);
-            assert(c < size);
-
-            auto v1 = to_tuple(vertices->position_at<smlt::Vec3>(a));
-            auto v2 = to_tuple(vertices->position_at<smlt::Vec3>(b));
-            auto v3 = to_tuple(vertices->position_at<smlt::Vec3>(c));
+        seen.insert(submesh);
 
-            // If this vertex already exist, use the first known index (or insert this as the first known index)
-            a = (position_map.count(v1)) ? position_map[v1] : position_map.insert(std::make_pair(v1, a)).first->second;
-            b = (position_map.count(v2)) ? position_map[v2] : position_map.insert(std::make_pair(v2, b)).first->second;
-            c = (position_map.count(v3)) ? position_map[v3] : position_map.insert(std::make_pair(v3, c)).first->second;
+        auto& state = submesh_edges_[submesh];
+        if(state.index_revision != submesh->index_data->revision() || state.half_edges.empty()) {
+            dirty.push_back(std::make_pair(submesh, &state));
+        }
 
-            edge_triangles.insert(std::make_pair(std::make_pair(a, b), c));
-            edge_triangles.insert(std::make_pair(std::make_pair(b, c), a));
-            edge_triangles.insert(std::make_pair(std::make_pair(c, a), b));
-        });
+        lists.push_back(&state);
     });
 
-    /*
-       (0, 1) -> 2
-       (1, 2) -> 3,
-       (1, 0) -> 4
-    */
+    for(auto it = submesh_edges_.begin(); it != submesh_edges_.end();) {
+        if(!seen.count(it->first)) {
+            it = submesh_edges_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    thread::ThreadPool::global().parallel_for(0, dirty.size(), [this, &dirty](std::size_t first, std::size_t last) {
+        for(auto i = first; i < last; ++i) {
+            collect_half_edges(dirty[i].first, *dirty[i].second);
+            dirty[i].second->index_revision = dirty[i].first->index_data->revision();
+        }
+    });
 
-    // For performance
-    edges_.reserve(edge_triangles.size());
+    last_rebuild_submesh_count_ = dirty.size();
 
-    std::unordered_map<std::tuple<uint32_t, uint32_t>, std::size_t> edge_lookup;
+    /* Merge the sorted submesh lists pairwise so that the two sides of each
+     * edge are next to each other. std::merge is stable, so ties stay in
+     * submesh order */
+    std::vector<std::vector<HalfEdge>> merged;
+    merged.reserve(lists.size());
+    for(auto list: lists) {
+        merged.push_back(list->half_edges);
+    }
 
-    for(auto& p: edge_triangles) {
-        /* Checking only for reversed is intentional because of polygon winding
-         * an edge can only be shared if it's in the opposite direction */
-        auto i0 = std::get<0>(p.first);
-        auto i1 = std::get<1>(p.first);
+    auto by_key = [](const HalfEdge& lhs, const HalfEdge& rhs) {
+        return lhs.key < rhs.key;
+    };
 
-        auto reversed = std::make_tuple(i1, i0);
+    while(merged.size() > 1) {
+        std::vector<std::vector<HalfEdge>> next((merged.size() + 1) / 2);
 
-        /* If the edge exists in reversed order, then update that */
-        auto existing = edge_lookup.find(reversed);
+        for(std::size_t i = 0; i < merged.size(); i += 2) {
+            auto& out = next[i / 2];
+            if(i + 1 == merged.size()) {
+                out.swap(merged[i]);
+                continue;
+            }
 
-        if(existing != edge_lookup.end()) {
-            auto& existing_edge = edges_[existing->second];
-            existing_edge.triangle_indexes[1] = p.second;
-            existing_edge.triangle_count = 2;
-            existing_edge.normals[1] = calculate_normal(
-                existing_edge.indexes[1],
-                existing_edge.indexes[0],
-                existing_edge.triangle_indexes[1]
+            out.resize(merged[i].size() + merged[i + 1].size());
+            std::merge(
+                merged[i].begin(), merged[i].end(),
+                merged[i + 1].begin(), merged[i + 1].end(),
+                out.begin(), by_key
             );
-        } else {
-            // Add the new edge
-            EdgeInfo new_info;
-            new_info.indexes[0] = i0;
-            new_info.indexes[1] = i1;
-            new_info.triangle_indexes[0] = p.second;
-            new_info.triangle_count = 1;
-            new_info.normals[0] = calculate_normal(new_info.indexes[0], new_info.indexes[1], new_info.triangle_indexes[0]);
-
-            edges_.push_back(new_info);
-
-            auto t = std::make_tuple(new_info.indexes[0], new_info.indexes[1]);
-            edge_lookup.insert(std::make_pair(t, edges_.size() - 1));
         }
+
+        merged.swap(next);
+    }
+
+    if(merged.empty()) {
+        return;
+    }
+
+    auto& half_edges = merged[0];
+
+    auto calculate_normal = [&vertices](uint32_t a, uint32_t b, uint32_t c) -> smlt::Vec3 {
+        auto va = vertices->position_at<smlt::Vec3>(a);
+        auto vb = vertices->position_at<smlt::Vec3>(b);
+        auto vc = vertices->position_at<smlt::Vec3>(c);
+        auto v1 = vb - va;
+        auto v2 = vc - va;
+        return v1.cross(v2).normalized();
+    };
+
+    /* Each run of the same key is one edge. The first half edge decides the
+     * edge's direction, and the first one going the other way is the triangle
+     * on the other side */
+    for(std::size_t i = 0; i < half_edges.size();) {
+        const HalfEdge& first = half_edges[i];
+
+        const uint32_t low = uint32_t(first.key >> 32);
+        const uint32_t high = uint32_t(first.key & 0xFFFFFFFF);
+
+        EdgeInfo edge;
+        edge.indexes[0] = (first.reversed) ? high : low;
+        edge.indexes[1] = (first.reversed) ? low : high;
+        edge.triangle_indexes[0] = first.opposite;
+        edge.triangle_indexes[1] = 0;
+        edge.triangle_count = 1;
+        edge.normals[0] = calculate_normal(edge.indexes[0], edge.indexes[1], edge.triangle_indexes[0]);
+
+        std::size_t j = i + 1;
+        for(; j < half_edges.size() && half_edges[j].key == first.key; ++j) {
+            if(edge.triangle_count == 1 && half_edges[j].reversed != first.reversed) {
+                edge.triangle_indexes[1] = half_edges[j].opposite;
+                edge.triangle_count = 2;
+                edge.normals[1] = calculate_normal(edge.indexes[1], edge.indexes[0], edge.triangle_indexes[1]);
+            }
+        }
+
+        edges_.push_back(edge);
+        i = j;
     }
 }
 
@@ -2,11 +2,13 @@
 
 #include <vector>
 #include <functional>
+#include <unordered_map>
 #include "../math/vec3.h"
 
 namespace smlt {
 
 class Mesh;
+class SubMesh;
 
 
 /*
@@ -22,6 +24,15 @@ struct EdgeInfo {
     smlt::Vec3 normals[2]; // Triangle normals
 };
 
+/*
+ * Vertices with the same position are welded together by sorting their
+ * positions, then each triangle's edges are turned into 64-bit keys which are
+ * sorted so that the two sides of a shared edge end up next to each other.
+ *
+ * The sorted edges of each submesh are kept between rebuilds, so only
+ * submeshes whose indexes changed (after IndexData::done()) are processed
+ * again, in parallel. Changing the vertex data rebuilds everything.
+ */
 class AdjacencyInfo {
 public:
     AdjacencyInfo(Mesh* mesh);
@@ -29,10 +40,49 @@ public:
 
     uint32_t edge_count() const { return edges_.size(); }
     void each_edge(const std::function<void (std::size_t, const EdgeInfo &)> &cb);
+
+    const std::vector<EdgeInfo>& edges() const { return edges_; }
+
+    /* Unique across all adjacency info, changes each time it's rebuilt. Lets
+     * anything derived from the edges know when it's out of date */
+    uint64_t revision() const { return revision_; }
+
+    /* The number of submeshes processed by the last rebuild() */
+    uint32_t last_rebuild_submesh_count() const { return last_rebuild_submesh_count_; }
+
+    /* One side of an edge, as it appears in a triangle */
+    struct HalfEdge {
+        /* (lowest index << 32) | highest index */
+        uint64_t key;
+
+        /* The third vertex of the triangle */
+        uint32_t opposite;
+
+        /* Whether the triangle has the edge going from the highest index to the lowest */
+        uint32_t reversed;
+    };
+
 private:
+    struct SubMeshEdges {
+        uint64_t index_revision = 0;
+
+        /* Sorted by key */
+        std::vector<HalfEdge> half_edges;
+    };
+
     Mesh* mesh_ = nullptr;
     std::vector<EdgeInfo> edges_;
+    uint64_t revision_ = 0;
+
+    /* Vertex -> the lowest vertex with the same position */
+    std::vector<uint32_t> welded_;
+    uint64_t vertex_revision_ = 0;
+
+    std::unordered_map<const SubMesh*, SubMeshEdges> submesh_edges_;
+    uint32_t last_rebuild_submesh_count_ = 0;
 
+    void weld_vertices();
+    void collect_half_edges(SubMesh* submesh, SubMeshEdges& out) const;
 };
 
 }
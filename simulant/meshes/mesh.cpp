@@ -151,6 +151,16 @@ const AABB &Mesh::aabb() const {
     return aabb_;
 }
 
+std::size_t Mesh::memory_usage() const {
+    std::size_t total = (vertex_data_) ? vertex_data_->data_size() : 0;
+
+    for(auto submesh: ordered_submeshes_) {
+        total += submesh->index_data->data_size();
+    }
+
+    return total;
+}
+
 SubMesh* Mesh::new_submesh_with_material(
     const std::string& name,
     MaterialID material,
@@ -528,7 +538,11 @@ void Mesh::prepare_buffers(Renderer* renderer) {
 }
 
 void Mesh::generate_adjacency_info() {
-    adjacency_.reset(new AdjacencyInfo(this));
+    if(!adjacency_) {
+        adjacency_.reset(new AdjacencyInfo(this));
+    }
+
+    // Only the submeshes which changed since the last time are processed
     adjacency_->rebuild();
 }
 
@@ -138,6 +138,10 @@ public:
     void set_texture_on_material(uint8_t unit, TextureID tex, uint8_t pass=0); ///< Replace the texture unit on all submesh materials
 
     const AABB& aabb() const;
+
+    /* Size of the vertex and index data, in bytes */
+    std::size_t memory_usage() const;
+
     void normalize(); //Scales the mesh so it has a radius of 1.0
     void transform_vertices(const smlt::Mat4& transform);
 
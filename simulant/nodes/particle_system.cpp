@@ -1,8 +1,12 @@
 #include "particle_system.h"
 
+#include <random>
+
 #include "particles/emitter.h"
 
 #include "../stage.h"
+#include "../material.h"
+#include "../window.h"
 #include "../types.h"
 #include "../hardware_buffer.h"
 
@@ -18,7 +22,7 @@ using smlt::particles::PARTICLE_EMITTER_POINT;
 const static VertexSpecification PS_VERTEX_SPEC(
         smlt::VERTEX_ATTRIBUTE_3F, // Position
         smlt::VERTEX_ATTRIBUTE_NONE,
-        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0
+        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0 (the particle size in points mode)
         smlt::VERTEX_ATTRIBUTE_NONE,
         smlt::VERTEX_ATTRIBUTE_NONE,
         smlt::VERTEX_ATTRIBUTE_NONE,
@@ -38,6 +42,9 @@ ParticleSystem::ParticleSystem(ParticleSystemID id, Stage* stage, SoundDriver* s
 
     set_quota(INITIAL_QUOTA); // Force hardware buffer initialization
     set_material_id(stage->assets->clone_default_material());
+
+    std::random_device rd;
+    random_seed_ = rd();
 }
 
 ParticleSystem::~ParticleSystem() {
@@ -64,12 +71,20 @@ void ParticleSystem::set_material_id(MaterialID mat_id) {
 }
 
 EmitterPtr ParticleSystem::push_emitter() {
-    auto new_emitter = std::make_shared<Emitter>(*this);
+    auto new_emitter = std::make_shared<Emitter>(*this, random_seed_ + emitters_.size());
     emitters_.push_back(new_emitter);
     calc_aabb();
     return new_emitter;
 }
 
+void ParticleSystem::set_random_seed(uint32_t seed) {
+    random_seed_ = seed;
+
+    for(uint32_t i = 0; i < emitters_.size(); ++i) {
+        emitters_[i]->set_seed(random_seed_ + i);
+    }
+}
+
 void ParticleSystem::pop_emitter() {
     emitters_.pop_back();
     calc_aabb();
@@ -128,44 +143,104 @@ const AABB &ParticleSystem::aabb() const {
     return aabb_;
 }
 
+void ParticleSystem::rebuild_indices() {
+    if(render_mode_ == PARTICLE_RENDER_MODE_POINTS) {
+        index_data_->resize(quota_);
+        auto indices = (uint16_t*) index_data_->data();
+        for(uint32_t i = 0; i < quota_; ++i) {
+            indices[i] = i;
+        }
+    } else {
+        index_data_->resize(quota_ * 6);
+        particles::write_quad_indices((uint16_t*) index_data_->data(), quota_);
+    }
+
+    index_data_->done();
+}
+
 void ParticleSystem::prepare_buffers(Renderer *renderer) {
 
-    // Only resize the hardware buffers if someone called set_quota()
+    // Only resize the hardware buffers if someone called set_quota() or set_render_mode()
     if(resize_buffers_) {
+        const std::size_t vertex_size = vertex_data_->stride() * quota_ * vertices_per_particle();
+        const std::size_t index_count = (render_mode_ == PARTICLE_RENDER_MODE_POINTS) ? quota_ : quota_ * 6;
+        const std::size_t index_size = index_data_->stride() * index_count;
+
         if(!vertex_buffer_) {
             vertex_buffer_ = renderer->hardware_buffers->allocate(
-                vertex_data_->stride() * quota_ * 4,
+                vertex_size,
                 HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
                 SHADOW_BUFFER_DISABLED
             );
         } else {
-            vertex_buffer_->resize(vertex_data_->stride() * quota_ * 4);
+            vertex_buffer_->resize(vertex_size);
         }
 
         if(!index_buffer_) {
             index_buffer_ = renderer->hardware_buffers->allocate(
-                sizeof(Index) * quota_ * 6,
+                index_size,
                 HARDWARE_BUFFER_VERTEX_ARRAY_INDICES,
                 SHADOW_BUFFER_DISABLED
             );
         } else {
-            index_buffer_->resize(sizeof(Index) * quota_ * 6);
+            index_buffer_->resize(index_size);
         }
 
         resize_buffers_ = false;
     }
 
+    if(rebuild_indices_) {
+        rebuild_indices();
+        index_buffer_->upload(*index_data_);
+        rebuild_indices_ = false;
+    }
+
     if(vertex_buffer_dirty_) {
         vertex_buffer_->upload(*vertex_data_);
         vertex_buffer_dirty_ = false;
     }
+}
 
-    if(index_buffer_dirty_) {
-        index_buffer_->upload(*index_data_);
-        index_buffer_dirty_ = false;
+void ParticleSystem::set_render_mode(ParticleRenderMode mode) {
+    if(mode == render_mode_) {
+        return;
+    }
+
+    if(mode == PARTICLE_RENDER_MODE_POINTS) {
+        if(!stage->window->renderer->supports_gpu_programs()) {
+            L_WARN("Point particles need GPU programs, falling back to quads");
+            return;
+        }
+
+        auto mat_id = stage->assets->new_material_from_file(Material::BuiltIns::BILLBOARD_PARTICLE);
+        auto points = stage->assets->material(mat_id);
+
+        // Keep the textures from the current material
+        for(uint32_t i = 0; i < points->pass_count(); ++i) {
+            if(i < material_ref_->pass_count() && material_ref_->pass(i)->texture_unit_count()) {
+                points->pass(i)->set_texture_units_from(*material_ref_->pass(i));
+            } else {
+                points->pass(i)->set_texture_unit(0, stage->assets->default_texture_id());
+            }
+        }
+
+        quad_material_ref_ = material_ref_;
+        set_material_id(mat_id);
+    } else if(quad_material_ref_) {
+        set_material_id(quad_material_ref_->id());
+        quad_material_ref_.reset();
+    } else {
+        set_material_id(stage->assets->clone_default_material());
     }
-}
 
+    render_mode_ = mode;
+
+    // The existing vertices are in the wrong format
+    vertex_data_->resize(0);
+    rendered_particle_count_ = 0;
+
+    resize_buffers_ = rebuild_indices_ = true;
+}
 
 bool ParticleSystem::has_repeating_emitters() const {
     for(auto e: emitters_) {
@@ -197,6 +272,10 @@ void ParticleSystem::set_quota(std::size_t quota) {
         return;
     }
 
+    if(quota > MAX_QUOTA) {
+        throw std::logic_error("Particle quota exceeds the limit of 16-bit indices");
+    }
+
     // if the quota changed, then the hardware buffers will need resizing
     resize_buffers_ = true;
 
@@ -204,30 +283,35 @@ void ParticleSystem::set_quota(std::size_t quota) {
 
     // Shrink if necessary
     if(particles_.size() > quota) {
-        particles_.resize(quota);
+        particles_.truncate(quota);
         particles_.shrink_to_fit();
     } else {
         // Reserve space for all the particles
         particles_.reserve(quota);
     }
 
-    vertex_buffer_dirty_ = index_buffer_dirty_ = true;
+    vertex_buffer_dirty_ = rebuild_indices_ = true;
 }
 
 void ParticleSystem::update(float dt) {
     update_source(dt); //Update any sounds attached to this particle system
 
-    // Update existing particles, erase any that are dead
-    for(auto& particle: particles_) {
-        particle.position += particle.velocity * dt;
-        particle.ttl -= dt;
+    // Emitter timers can schedule idle tasks, so they're updated here rather
+    // than in _simulate()
+    for(auto emitter: emitters_) {
+        emitter->update(dt);
     }
 
-    // Erase dead particles
-    particles_.erase(
-        std::remove_if(particles_.begin(), particles_.end(), [](const Particle& p) -> bool { return p.ttl <= 0.0f; }),
-        particles_.end()
-    );
+    pending_dt_ = dt;
+    stage->_queue_particle_simulation(id());
+}
+
+void ParticleSystem::_simulate() {
+    const float dt = pending_dt_;
+
+    // Update existing particles, erase any that are dead
+    particles_.integrate(dt);
+    particles_.remove_dead();
 
     // Run any manipulations on the particles, we do this before
     // we add new particles - otherwise they get manipulated before they're
@@ -237,8 +321,6 @@ void ParticleSystem::update(float dt) {
     }
 
     for(auto emitter: emitters_) {
-        emitter->update(dt);
-
         if(!emitter->is_active()) {
             continue;
         }
@@ -252,69 +334,44 @@ void ParticleSystem::update(float dt) {
         emitter->do_emit(dt, max_can_emit, particles_);
     }
 
-    if(particles_.empty() && !has_repeating_emitters() && !has_active_emitters()) {
-        // If the particles are gone, and we don't have repeating emitters and all the emitters are inactive
-        // Then destroy the particle system if that's what we've been told to do
-        if(destroy_on_completion()) {
-            ask_owner_for_destruction();
-            // No point doing anything else!
-            return;
-        }
+    // If the particles are gone, and we don't have repeating emitters and all the emitters are inactive
+    // then we're done. Destruction (if requested) happens in _finish_simulation
+    finished_ = particles_.empty() && !has_repeating_emitters() && !has_active_emitters();
+    if(finished_ && destroy_on_completion()) {
+        // No point doing anything else!
+        return;
     }
 
-    const static auto v1n = Vec3(-0.5, -0.5, 0.0);
-    const static auto v2n = Vec3( 0.5, -0.5, 0.0);
-    const static auto v3n = Vec3( 0.5,  0.5, 0.0);
-    const static auto v4n = Vec3(-0.5,  0.5, 0.0);
-
-    vertex_data_->move_to_start();
-    vertex_data_->resize(particles_.size() * 4);
-    for(auto& particle: particles_) {
-        auto scale = Vec3(particle.dimensions.x, particle.dimensions.y, 0);
-        auto v1 = particle.position + (v1n * scale);
-        auto v2 = particle.position + (v2n * scale);
-        auto v3 = particle.position + (v3n * scale);
-        auto v4 = particle.position + (v4n * scale);
-
-        vertex_data_->position(v1);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(0, 0);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v2);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(1, 0);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v3);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(1, 1);
-        vertex_data_->move_next();
-
-        vertex_data_->position(v4);
-        vertex_data_->diffuse(particle.colour);
-        vertex_data_->tex_coord0(0, 1);
-        vertex_data_->move_next();
+    if(depth_sorted_ && has_sort_direction_) {
+        particles_.sort_back_to_front(sort_direction_);
     }
 
-    index_data_->clear();
+    const auto& spec = vertex_data_->specification();
+    const particles::VertexLayout layout = {
+        vertex_data_->stride(),
+        spec.position_offset(),
+        spec.texcoord0_offset(),
+        spec.diffuse_offset()
+    };
 
-    for(uint32_t i = 0; i < particles_.size(); ++i) {
-        auto new_start = (i * 4);
-        index_data_->index(new_start + 0);
-        index_data_->index(new_start + 1);
-        index_data_->index(new_start + 2);
+    vertex_data_->resize(particles_.size() * vertices_per_particle());
 
-        index_data_->index(new_start + 0);
-        index_data_->index(new_start + 2);
-        index_data_->index(new_start + 3);
+    if(render_mode_ == PARTICLE_RENDER_MODE_POINTS) {
+        particles::write_points(particles_, vertex_data_->data(), layout);
+    } else {
+        particles::write_quads(particles_, vertex_data_->data(), layout);
     }
 
+    rendered_particle_count_ = particles_.size();
+
     vertex_buffer_dirty_ = true;
     vertex_data_->done();
+}
 
-    index_buffer_dirty_ = true;
-    index_data_->done();
+void ParticleSystem::_finish_simulation() {
+    if(finished_ && destroy_on_completion()) {
+        ask_owner_for_destruction();
+    }
 }
 
 void ParticleSystem::set_particle_width(float width) {
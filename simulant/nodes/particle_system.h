@@ -12,15 +12,22 @@
 #include "../interfaces.h"
 #include "../types.h"
 #include "../vertex_data.h"
+#include "../frustum.h"
 
 #include "particles/emitter.h"
 #include "particles/manipulator.h"
+#include "particles/particle_store.h"
 
 namespace smlt {
 
 
 class ParticleSystem;
 
+enum ParticleRenderMode {
+    PARTICLE_RENDER_MODE_QUADS, ///< 4 vertices per particle, built on the CPU
+    PARTICLE_RENDER_MODE_POINTS ///< 1 vertex per particle, expanded to a billboard by the shader
+};
+
 typedef sig::signal<void (ParticleSystem*, MaterialID, MaterialID)> ParticleSystemMaterialChangedSignal;
 
 class ParticleSystem :
@@ -55,6 +62,22 @@ public:
     void set_cull_each(bool val=true) { cull_each_ = val; }
     bool cull_each() const { return cull_each_; }
 
+    /* Switching to PARTICLE_RENDER_MODE_POINTS replaces the material with
+     * Material::BuiltIns::BILLBOARD_PARTICLE, carrying over the texture units
+     * of the current material, which is restored when switching back to
+     * quads. A material set while in points mode must expand points in its
+     * shader. Renderers without GPU programs stay on quads. */
+    void set_render_mode(ParticleRenderMode mode);
+    ParticleRenderMode render_mode() const { return render_mode_; }
+
+    /* If true, particles are sorted back-to-front before their vertices are
+     * built. Only needed for alpha blended particles. The sort uses the camera
+     * from the previous frame. */
+    void set_depth_sorted(bool value=true) { depth_sorted_ = value; }
+    bool depth_sorted() const { return depth_sorted_; }
+
+    const particles::ParticleStore& particles() const { return particles_; }
+
     int32_t emitter_count() const { return emitters_.size(); }
     particles::EmitterPtr emitter(int32_t i) { return emitters_.at(i); }
     particles::EmitterPtr push_emitter();
@@ -62,9 +85,26 @@ public:
 
     void ask_owner_for_destruction() override;
 
+    /* Each emitter gets its own random stream derived from this seed, so
+     * emission is reproducible however the simulation is scheduled. By
+     * default the seed is random. */
+    void set_random_seed(uint32_t seed);
+    uint32_t random_seed() const { return random_seed_; }
+
+    /* Runs the deferred part of update(): integration, manipulators, emission
+     * and vertex building. Called by the Stage after the scene update, in
+     * parallel with other particle systems, so it must not touch anything
+     * outside of this system. */
+    void _simulate();
+
+    /* Called on the main thread once every system has finished _simulate() */
+    void _finish_simulation();
+
     //Renderable stuff
 
-    const MeshArrangement arrangement() const override { return MESH_ARRANGEMENT_TRIANGLES; }
+    const MeshArrangement arrangement() const override {
+        return (render_mode_ == PARTICLE_RENDER_MODE_POINTS) ? MESH_ARRANGEMENT_POINTS : MESH_ARRANGEMENT_TRIANGLES;
+    }
     virtual Mat4 final_transformation() const override {
         return Mat4(); //Particles are absolutely positioned in the world
     }
@@ -95,7 +135,8 @@ public:
     }
 
     std::size_t index_element_count() const override {
-        return index_data_->count();
+        // The index buffer covers the whole quota, only draw the live particles
+        return rendered_particle_count_ * ((render_mode_ == PARTICLE_RENDER_MODE_POINTS) ? 1 : 6);
     }
 
     IndexType index_type() const override {
@@ -122,6 +163,11 @@ public:
     }
 
     RenderableList _get_renderables(const Frustum &frustum) const {
+        if(depth_sorted_) {
+            sort_direction_ = frustum.plane(FRUSTUM_PLANE_NEAR).normal();
+            has_sort_direction_ = true;
+        }
+
         auto ret = RenderableList();
         std::shared_ptr<Renderable> sptr = std::const_pointer_cast<ParticleSystem>(shared_from_this());
         ret.push_back(sptr);
@@ -131,6 +177,9 @@ public:
 private:
     const static int32_t INITIAL_QUOTA = 10;
 
+    /* Each particle is 4 vertices, and indices are 16 bit */
+    const static std::size_t MAX_QUOTA = 65535 / 4;
+
     AABB aabb_;
     void calc_aabb();
 
@@ -139,7 +188,15 @@ private:
     bool resize_buffers_ = false;
 
     bool vertex_buffer_dirty_ = false;
-    bool index_buffer_dirty_ = false;
+
+    /* The indices never change unless the quota or render mode do, so
+     * they're only rebuilt (for the whole quota) in prepare_buffers */
+    bool rebuild_indices_ = false;
+    void rebuild_indices();
+
+    uint32_t vertices_per_particle() const {
+        return (render_mode_ == PARTICLE_RENDER_MODE_POINTS) ? 1 : 4;
+    }
 
     inline VertexData* get_vertex_data() const {
         return vertex_data_;
@@ -155,11 +212,20 @@ private:
     float particle_height_ = 100.0f;
     bool cull_each_ = false;
 
+    ParticleRenderMode render_mode_ = PARTICLE_RENDER_MODE_QUADS;
+
+    bool depth_sorted_ = false;
+    mutable bool has_sort_direction_ = false;
+    mutable Vec3 sort_direction_;
+
     MaterialID material_id_;
     MaterialPtr material_ref_;
 
+    /* The material in use before switching to points */
+    MaterialPtr quad_material_ref_;
+
     std::vector<particles::EmitterPtr> emitters_;
-    std::vector<particles::Particle> particles_;
+    particles::ParticleStore particles_;
     std::vector<particles::ManipulatorPtr> manipulators_;
 
     void update(float dt) override;
@@ -167,7 +233,16 @@ private:
     VertexData* vertex_data_ = nullptr;
     IndexData* index_data_ = nullptr;
 
+    /* The number of particles in the vertex data */
+    std::size_t rendered_particle_count_ = 0;
+
     bool destroy_on_completion_ = false;
+
+    uint32_t random_seed_ = 0;
+
+    /* Set by update(), consumed by _simulate() */
+    float pending_dt_ = 0.0f;
+    bool finished_ = false;
 };
 
 }
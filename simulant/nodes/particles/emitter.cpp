@@ -28,7 +28,7 @@ void Emitter::update(float dt) {
     }
 }
 
-void Emitter::do_emit(float dt, uint32_t max, std::vector<Particle> &particles) {
+void Emitter::do_emit(float dt, uint32_t max, ParticleStore &particles) {
     if(!max) {
         return; //Do nothing
     }
@@ -75,7 +75,7 @@ void Emitter::do_emit(float dt, uint32_t max, std::vector<Particle> &particles)
         p.dimensions = smlt::Vec2(system().particle_width(), system().particle_height());
 
         //FIXME: Initialize other properties
-        particles.push_back(p);
+        particles.push(p);
 
         emission_accumulator_ -= decrement; //Decrement the accumulator while we can
         to_emit--;
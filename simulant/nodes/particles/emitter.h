@@ -6,7 +6,7 @@
 #include <vector>
 #include <memory>
 
-#include "particle.h"
+#include "particle_store.h"
 #include "../../math/vec3.h"
 #include "../../math/degrees.h"
 #include "../../colour.h"
@@ -30,8 +30,9 @@ const std::unordered_map<std::string, EmitterType> EMITTER_LOOKUP = {
 
 class Emitter {
 public:
-    Emitter(ParticleSystem& system):
-        system_(system) {}
+    Emitter(ParticleSystem& system, uint32_t seed):
+        system_(system),
+        rgen_(seed) {}
 
     void set_type(EmitterType type) { type_ = type; }
     EmitterType type() const { return type_; }
@@ -85,7 +86,12 @@ public:
     void set_duration_range(float min_seconds, float max_seconds);
     std::pair<float, float> duration_range() const;
 
-    void do_emit(float dt, uint32_t max_to_emit, std::vector<Particle>& particles);
+    /* Only touches this emitter and `particles`, so emitters of different
+     * systems can run concurrently */
+    void do_emit(float dt, uint32_t max_to_emit, ParticleStore& particles);
+
+    /* Restarts this emitter's random sequence */
+    void set_seed(uint32_t seed) { rgen_ = RandomGenerator(seed); }
 
     ParticleSystem& system() { return system_; }
 
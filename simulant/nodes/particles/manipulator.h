@@ -2,7 +2,7 @@
 
 #include <list>
 #include <string>
-#include "particle.h"
+#include "particle_store.h"
 
 
 namespace smlt {
@@ -16,13 +16,16 @@ public:
     virtual void set_property(const std::string& name, int32_t value) {}
     virtual void set_property(const std::string& name, float value) {}
 
-    void manipulate(std::vector<Particle>& particles, float dt) {
+    void manipulate(ParticleStore& particles, float dt) {
         do_manipulate(particles, dt);
     }
 
 private:
     std::string name_;
-    virtual void do_manipulate(std::vector<Particle>& particles, float dt) = 0;
+
+    /* Implementations should work a whole channel at a time rather than
+     * per-particle, see scale_clamped() */
+    virtual void do_manipulate(ParticleStore& particles, float dt) = 0;
 };
 
 typedef std::shared_ptr<Manipulator> ManipulatorPtr;
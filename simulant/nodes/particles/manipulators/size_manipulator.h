@@ -22,12 +22,10 @@ public:
 private:
     float rate_ = 0.1f;
 
-    void do_manipulate(std::vector<Particle>& particles, float dt) {
+    void do_manipulate(ParticleStore& particles, float dt) {
         auto rate_diff = 1.0f + (rate_ * dt);
-        for(auto& particle: particles) {
-            particle.dimensions.x = std::max(0.0f, particle.dimensions.x * rate_diff);
-            particle.dimensions.y = std::max(0.0f, particle.dimensions.y * rate_diff);
-        }
+        scale_clamped(particles.channel(PARTICLE_CHANNEL_WIDTH), particles.size(), rate_diff, 0.0f);
+        scale_clamped(particles.channel(PARTICLE_CHANNEL_HEIGHT), particles.size(), rate_diff, 0.0f);
     }
 };
 
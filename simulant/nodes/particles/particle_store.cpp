@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <numeric>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "particle_store.h"
+
+namespace smlt {
+namespace particles {
+
+void ParticleStore::reserve(std::size_t capacity) {
+    for(auto& c: channels_) {
+        c.reserve(capacity);
+    }
+}
+
+void ParticleStore::truncate(std::size_t count) {
+    if(count >= count_) {
+        return;
+    }
+
+    for(auto& c: channels_) {
+        c.resize(count);
+    }
+
+    count_ = count;
+}
+
+void ParticleStore::shrink_to_fit() {
+    for(auto& c: channels_) {
+        c.shrink_to_fit();
+    }
+}
+
+void ParticleStore::push(const Particle& particle) {
+    const float values[PARTICLE_CHANNEL_MAX] = {
+        particle.position.x, particle.position.y, particle.position.z,
+        particle.velocity.x, particle.velocity.y, particle.velocity.z,
+        particle.ttl,
+        particle.dimensions.x, particle.dimensions.y,
+        particle.colour.r, particle.colour.g, particle.colour.b, particle.colour.a
+    };
+
+    for(uint32_t i = 0; i < PARTICLE_CHANNEL_MAX; ++i) {
+        channels_[i].push_back(values[i]);
+    }
+
+    ++count_;
+}
+
+Particle ParticleStore::particle(std::size_t i) const {
+    auto v = [this, i](ParticleChannel c) { return channels_[c][i]; };
+
+    Particle p;
+    p.position = Vec3(v(PARTICLE_CHANNEL_POSITION_X), v(PARTICLE_CHANNEL_POSITION_Y), v(PARTICLE_CHANNEL_POSITION_Z));
+    p.velocity = Vec3(v(PARTICLE_CHANNEL_VELOCITY_X), v(PARTICLE_CHANNEL_VELOCITY_Y), v(PARTICLE_CHANNEL_VELOCITY_Z));
+    p.ttl = v(PARTICLE_CHANNEL_TTL);
+    p.dimensions = Vec2(v(PARTICLE_CHANNEL_WIDTH), v(PARTICLE_CHANNEL_HEIGHT));
+    p.colour = Colour(v(PARTICLE_CHANNEL_RED), v(PARTICLE_CHANNEL_GREEN), v(PARTICLE_CHANNEL_BLUE), v(PARTICLE_CHANNEL_ALPHA));
+    return p;
+}
+
+void ParticleStore::swap_remove(std::size_t i) {
+    const std::size_t last = count_ - 1;
+
+    for(auto& c: channels_) {
+        c[i] = c[last];
+        c.pop_back();
+    }
+
+    --count_;
+}
+
+/* out[i] += in[i] * s */
+static void multiply_add(float* out, const float* in, float s, std::size_t count) {
+    std::size_t i = 0;
+
+#ifdef __SSE__
+    const __m128 vs = _mm_set1_ps(s);
+    for(; i + 4 <= count; i += 4) {
+        __m128 o = _mm_loadu_ps(out + i);
+        __m128 v = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(o, _mm_mul_ps(v, vs)));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        out[i] += in[i] * s;
+    }
+}
+
+void ParticleStore::integrate(float dt) {
+    if(!count_) {
+        return;
+    }
+
+    multiply_add(channel(PARTICLE_CHANNEL_POSITION_X), channel(PARTICLE_CHANNEL_VELOCITY_X), dt, count_);
+    multiply_add(channel(PARTICLE_CHANNEL_POSITION_Y), channel(PARTICLE_CHANNEL_VELOCITY_Y), dt, count_);
+    multiply_add(channel(PARTICLE_CHANNEL_POSITION_Z), channel(PARTICLE_CHANNEL_VELOCITY_Z), dt, count_);
+
+    float* ttl = channel(PARTICLE_CHANNEL_TTL);
+    std::size_t i = 0;
+
+#ifdef __SSE__
+    const __m128 vdt = _mm_set1_ps(dt);
+    for(; i + 4 <= count_; i += 4) {
+        _mm_storeu_ps(ttl + i, _mm_sub_ps(_mm_loadu_ps(ttl + i), vdt));
+    }
+#endif
+
+    for(; i < count_; ++i) {
+        ttl[i] -= dt;
+    }
+}
+
+std::size_t ParticleStore::remove_dead() {
+    const std::size_t before = count_;
+
+    std::size_t i = 0;
+    while(i < count_) {
+        if(channels_[PARTICLE_CHANNEL_TTL][i] <= 0.0f) {
+            // Don't advance, the particle swapped in needs checking too
+            swap_remove(i);
+        } else {
+            ++i;
+        }
+    }
+
+    return before - count_;
+}
+
+void ParticleStore::sort_back_to_front(const Vec3& view_direction) {
+    if(count_ < 2) {
+        return;
+    }
+
+    const float* px = channel(PARTICLE_CHANNEL_POSITION_X);
+    const float* py = channel(PARTICLE_CHANNEL_POSITION_Y);
+    const float* pz = channel(PARTICLE_CHANNEL_POSITION_Z);
+
+    sort_keys_.resize(count_);
+    for(std::size_t i = 0; i < count_; ++i) {
+        sort_keys_[i] = (px[i] * view_direction.x) + (py[i] * view_direction.y) + (pz[i] * view_direction.z);
+    }
+
+    sort_order_.resize(count_);
+    std::iota(sort_order_.begin(), sort_order_.end(), 0);
+
+    const float* keys = &sort_keys_[0];
+    std::sort(sort_order_.begin(), sort_order_.end(), [keys](uint32_t lhs, uint32_t rhs) {
+        return keys[lhs] > keys[rhs];
+    });
+
+    sort_scratch_.resize(count_);
+    for(auto& c: channels_) {
+        for(std::size_t i = 0; i < count_; ++i) {
+            sort_scratch_[i] = c[sort_order_[i]];
+        }
+        std::swap(c, sort_scratch_);
+    }
+}
+
+void scale_clamped(float* values, std::size_t count, float factor, float min_value) {
+    std::size_t i = 0;
+
+#ifdef __SSE__
+    const __m128 vf = _mm_set1_ps(factor);
+    const __m128 vmin = _mm_set1_ps(min_value);
+    for(; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(values + i, _mm_max_ps(vmin, _mm_mul_ps(_mm_loadu_ps(values + i), vf)));
+    }
+#endif
+
+    for(; i < count; ++i) {
+        values[i] = std::max(min_value, values[i] * factor);
+    }
+}
+
+void write_quads(const ParticleStore& particles, uint8_t* out, const VertexLayout& layout) {
+    const std::size_t count = particles.size();
+    if(!count) {
+        return;
+    }
+
+    const float* px = particles.channel(PARTICLE_CHANNEL_POSITION_X);
+    const float* py = particles.channel(PARTICLE_CHANNEL_POSITION_Y);
+    const float* pz = particles.channel(PARTICLE_CHANNEL_POSITION_Z);
+    const float* w = particles.channel(PARTICLE_CHANNEL_WIDTH);
+    const float* h = particles.channel(PARTICLE_CHANNEL_HEIGHT);
+    const float* r = particles.channel(PARTICLE_CHANNEL_RED);
+    const float* g = particles.channel(PARTICLE_CHANNEL_GREEN);
+    const float* b = particles.channel(PARTICLE_CHANNEL_BLUE);
+    const float* a = particles.channel(PARTICLE_CHANNEL_ALPHA);
+
+    // Corner offsets (as a fraction of the particle size) and texture coordinates
+    const static float corners[4][4] = {
+        {-0.5f, -0.5f, 0.0f, 0.0f},
+        { 0.5f, -0.5f, 1.0f, 0.0f},
+        { 0.5f,  0.5f, 1.0f, 1.0f},
+        {-0.5f,  0.5f, 0.0f, 1.0f}
+    };
+
+    for(std::size_t i = 0; i < count; ++i) {
+        /* Copy everything to locals first, otherwise the compiler has to
+         * assume that writing to `out` could change the source arrays */
+        const float x = px[i], y = py[i], z = pz[i];
+        const float pw = w[i], ph = h[i];
+        const float colour[4] = {r[i], g[i], b[i], a[i]};
+
+        for(uint32_t j = 0; j < 4; ++j) {
+            float* pos = (float*) (out + layout.position_offset);
+            pos[0] = x + (corners[j][0] * pw);
+            pos[1] = y + (corners[j][1] * ph);
+            pos[2] = z;
+
+            float* uv = (float*) (out + layout.texcoord_offset);
+            uv[0] = corners[j][2];
+            uv[1] = corners[j][3];
+
+            float* diffuse = (float*) (out + layout.colour_offset);
+            diffuse[0] = colour[0];
+            diffuse[1] = colour[1];
+            diffuse[2] = colour[2];
+            diffuse[3] = colour[3];
+
+            out += layout.stride;
+        }
+    }
+}
+
+void write_points(const ParticleStore& particles, uint8_t* out, const VertexLayout& layout) {
+    const std::size_t count = particles.size();
+    if(!count) {
+        return;
+    }
+
+    const float* channels[PARTICLE_CHANNEL_MAX];
+    for(uint32_t i = 0; i < PARTICLE_CHANNEL_MAX; ++i) {
+        channels[i] = particles.channel(ParticleChannel(i));
+    }
+
+    for(std::size_t i = 0; i < count; ++i) {
+        float* pos = (float*) (out + layout.position_offset);
+        pos[0] = channels[PARTICLE_CHANNEL_POSITION_X][i];
+        pos[1] = channels[PARTICLE_CHANNEL_POSITION_Y][i];
+        pos[2] = channels[PARTICLE_CHANNEL_POSITION_Z][i];
+
+        float* size = (float*) (out + layout.texcoord_offset);
+        size[0] = channels[PARTICLE_CHANNEL_WIDTH][i];
+        size[1] = channels[PARTICLE_CHANNEL_HEIGHT][i];
+
+        float* diffuse = (float*) (out + layout.colour_offset);
+        diffuse[0] = channels[PARTICLE_CHANNEL_RED][i];
+        diffuse[1] = channels[PARTICLE_CHANNEL_GREEN][i];
+        diffuse[2] = channels[PARTICLE_CHANNEL_BLUE][i];
+        diffuse[3] = channels[PARTICLE_CHANNEL_ALPHA][i];
+
+        out += layout.stride;
+    }
+}
+
+void write_quad_indices(uint16_t* out, std::size_t quad_count) {
+    for(std::size_t i = 0; i < quad_count; ++i) {
+        const uint16_t start = uint16_t(i * 4);
+        *out++ = start + 0;
+        *out++ = start + 1;
+        *out++ = start + 2;
+
+        *out++ = start + 0;
+        *out++ = start + 2;
+        *out++ = start + 3;
+    }
+}
+
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "particle.h"
+
+namespace smlt {
+namespace particles {
+
+enum ParticleChannel {
+    PARTICLE_CHANNEL_POSITION_X,
+    PARTICLE_CHANNEL_POSITION_Y,
+    PARTICLE_CHANNEL_POSITION_Z,
+    PARTICLE_CHANNEL_VELOCITY_X,
+    PARTICLE_CHANNEL_VELOCITY_Y,
+    PARTICLE_CHANNEL_VELOCITY_Z,
+    PARTICLE_CHANNEL_TTL,
+    PARTICLE_CHANNEL_WIDTH,
+    PARTICLE_CHANNEL_HEIGHT,
+    PARTICLE_CHANNEL_RED,
+    PARTICLE_CHANNEL_GREEN,
+    PARTICLE_CHANNEL_BLUE,
+    PARTICLE_CHANNEL_ALPHA,
+    PARTICLE_CHANNEL_MAX
+};
+
+/*
+ * Structure-of-arrays storage for live particles. Each property lives in its
+ * own contiguous float array so that the update kernels (and manipulators)
+ * can stream through just the data they need. Particle order is not stable,
+ * dead particles are removed by swapping the last particle into their slot.
+ */
+class ParticleStore {
+public:
+    void reserve(std::size_t capacity);
+
+    /* Drops particles from the end until there are at most `count` left */
+    void truncate(std::size_t count);
+    void shrink_to_fit();
+    void clear() { truncate(0); }
+
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    void push(const Particle& particle);
+
+    /* Reassembles the particle at index `i`, mainly for debugging and tests */
+    Particle particle(std::size_t i) const;
+
+    void swap_remove(std::size_t i);
+
+    /* Advances positions by velocity and counts down the time-to-live */
+    void integrate(float dt);
+
+    /* Removes any particles whose time-to-live has run out, returns the number removed */
+    std::size_t remove_dead();
+
+    /* Reorders the particles so that those furthest along `view_direction`
+     * come first, for back-to-front blending */
+    void sort_back_to_front(const Vec3& view_direction);
+
+    float* channel(ParticleChannel c) { return (count_) ? &channels_[c][0] : nullptr; }
+    const float* channel(ParticleChannel c) const { return (count_) ? &channels_[c][0] : nullptr; }
+
+private:
+    std::vector<float> channels_[PARTICLE_CHANNEL_MAX];
+    std::size_t count_ = 0;
+
+    /* Kept between sorts to avoid reallocating each frame */
+    std::vector<float> sort_keys_;
+    std::vector<uint32_t> sort_order_;
+    std::vector<float> sort_scratch_;
+};
+
+/* values[i] = max(min_value, values[i] * factor) */
+void scale_clamped(float* values, std::size_t count, float factor, float min_value);
+
+/* Where each attribute lives within a vertex, in bytes */
+struct VertexLayout {
+    uint32_t stride;
+    uint32_t position_offset;
+    uint32_t texcoord_offset;
+    uint32_t colour_offset;
+};
+
+/*
+ * Expands every particle into a camera-independent quad of 4 vertices
+ * (3F position, 2F texcoord, 4F colour) written straight to `out`, which must
+ * have room for `particles.size() * 4` vertices.
+ */
+void write_quads(const ParticleStore& particles, uint8_t* out, const VertexLayout& layout);
+
+/*
+ * Writes a single vertex per particle for point sprite rendering. The
+ * texcoord holds the particle's width and height, the shader is expected to
+ * do the expansion (see Material::BuiltIns::BILLBOARD_PARTICLE)
+ */
+void write_points(const ParticleStore& particles, uint8_t* out, const VertexLayout& layout);
+
+/* Writes 6 indices (two triangles) per quad, for `quad_count` quads */
+void write_quad_indices(uint16_t* out, std::size_t quad_count);
+
+}
+}
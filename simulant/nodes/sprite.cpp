@@ -38,12 +38,16 @@ Sprite::Sprite(SpriteID id, SpriteManager *manager, SoundDriver* sound_driver):
 }
 
 bool Sprite::init() {
-    mesh_id_ = stage->assets->new_mesh_as_rectangle(1.0, 1.0);
+    batched_ = manager_->batching_enabled();
 
-    //Annoyingly, we can't use new_actor_with_parent_and_mesh here, because that looks
-    //up our ID in the stage, which doesn't exist until this function returns
-    actor_ = stage->new_actor_with_mesh(mesh_id_);
-    actor_->set_parent(this);
+    if(!batched_) {
+        mesh_id_ = stage->assets->new_mesh_as_rectangle(1.0, 1.0);
+
+        //Annoyingly, we can't use new_actor_with_parent_and_mesh here, because that looks
+        //up our ID in the stage, which doesn't exist until this function returns
+        actor_ = stage->new_actor_with_mesh(mesh_id_);
+        actor_->set_parent(this);
+    }
 
     set_render_dimensions(1.0f, 1.0f);
 
@@ -85,7 +89,11 @@ void Sprite::flip_horizontally(bool value) {
 }
 
 const AABB& Sprite::aabb() const {
-    return actor_->aabb();
+    return (actor_) ? actor_->aabb() : aabb_;
+}
+
+void Sprite::update_aabb() {
+    aabb_ = AABB(Vec3(), render_width_, render_height_, 0.0f);
 }
 
 void Sprite::flip_vertically(bool value) {
@@ -126,7 +134,12 @@ void Sprite::update_texture_coordinates() {
         std::swap(y0, y1);
     }
 
-    {
+    texture_coordinates_[0] = x0;
+    texture_coordinates_[1] = y0;
+    texture_coordinates_[2] = x1;
+    texture_coordinates_[3] = y1;
+
+    if(!batched_) {
         auto mesh = stage->assets->mesh(mesh_id_);
 
         mesh->vertex_data->move_to_start();
@@ -155,10 +168,16 @@ void Sprite::set_spritesheet(TextureID texture_id, uint32_t frame_width, uint32_
     image_width_ = stage->assets->texture(texture_id)->width();
     image_height_ = stage->assets->texture(texture_id)->height();
 
-    //Hold a reference to the new material
-    material_id_ = stage->assets->new_material_from_texture(texture_id);
-    stage->assets->mesh(mesh_id_)->set_material_id(material_id_);
-    material_id_.fetch()->first_pass()->set_blending(smlt::BLEND_ALPHA);
+    if(batched_) {
+        // Batched sprites must share materials, or they couldn't be drawn together
+        material_id_ = manager_->_batch_material(texture_id);
+        material_ref_ = stage->assets->material(material_id_);
+    } else {
+        //Hold a reference to the new material
+        material_id_ = stage->assets->new_material_from_texture(texture_id);
+        stage->assets->mesh(mesh_id_)->set_material_id(material_id_);
+        material_id_.fetch()->first_pass()->set_blending(smlt::BLEND_ALPHA);
+    }
 
     update_texture_coordinates();
 }
@@ -168,13 +187,20 @@ void Sprite::set_render_dimensions_from_height(float height) {
 }
 
 void Sprite::set_render_priority(RenderPriority priority) {
-    actor_->set_render_priority(priority);
+    render_priority_ = priority;
+
+    if(actor_) {
+        actor_->set_render_priority(priority);
+    }
 }
 
 void Sprite::set_alpha(float alpha) {
     alpha_ = alpha;
-    auto mesh = mesh_id_.fetch();
-    mesh->set_diffuse(smlt::Colour(1.0f, 1.0f, 1.0f, alpha_));
+
+    if(!batched_) {
+        auto mesh = mesh_id_.fetch();
+        mesh->set_diffuse(smlt::Colour(1.0f, 1.0f, 1.0f, alpha_));
+    }
 }
 
 void Sprite::set_render_dimensions_from_width(float width) {
@@ -201,6 +227,13 @@ void Sprite::set_render_dimensions(float width, float height) {
     render_width_ = width;
     render_height_ = height;
 
+    update_aabb();
+
+    if(batched_) {
+        // The batcher builds the vertices from the render dimensions each frame
+        return;
+    }
+
     //Rebuild the mesh
     auto mesh = stage->assets->mesh(mesh_id_);
 
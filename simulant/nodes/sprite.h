@@ -64,12 +64,17 @@ public:
     void set_render_dimensions_from_height(float height);
 
     void set_render_priority(smlt::RenderPriority priority);
+    RenderPriority render_priority() const { return render_priority_; }
 
     void set_alpha(float alpha);
 
     float alpha() const { return alpha_; }
     MaterialID material_id() const { return material_id_; }
 
+    /* True if this sprite is drawn by its SpriteManager's batcher, rather
+     * than through its own actor (which will be null) */
+    bool is_batched() const { return batched_; }
+
     void set_spritesheet(
         TextureID texture_id,
         uint32_t frame_width,
@@ -85,7 +90,10 @@ public:
     Property<Sprite, Actor> actor = {this, &Sprite::actor_};
     Property<Sprite, KeyFrameAnimationState> animations = {this, &Sprite::animation_state_};
 private:
+    friend class SpriteBatcher;
+
     SpriteManager* manager_;
+    bool batched_ = false;
 
     float frame_width_ = 0;
     float frame_height_ = 0;
@@ -99,12 +107,23 @@ private:
     MeshID mesh_id_;
     MaterialID material_id_;
 
+    /* Batched sprites have no mesh to hold on to their material */
+    MaterialPtr material_ref_;
+
+    RenderPriority render_priority_ = RENDER_PRIORITY_MAIN;
+
+    /* The current frame's texture coordinates (x0, y0, x1, y1), after flipping */
+    float texture_coordinates_[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+
+    AABB aabb_;
+
     float image_width_ = 0;
     float image_height_ = 0;
 
     float alpha_ = 1.0f;
 
     void update_texture_coordinates();
+    void update_aabb();
 
     bool flipped_vertically_ = false;
     bool flipped_horizontally_ = false;
@@ -0,0 +1,234 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include "text_layout.h"
+#include "../../font.h"
+#include "../../profiler.h"
+
+namespace smlt {
+namespace ui {
+
+const std::size_t TextLayoutCache::DEFAULT_CAPACITY;
+
+TextLayout::TextLayout(Font* font, const unicode& text, float width, float line_height) {
+    atlas_revision_ = font->atlas_revision();
+    build(font, text, width, line_height);
+
+    if(font->atlas_revision() != atlas_revision_) {
+        /* The font evicted a page while we were laying out, the glyphs
+         * we placed first might have been on it */
+        atlas_revision_ = font->atlas_revision();
+        build(font, text, width, line_height);
+    }
+}
+
+void TextLayout::build(Font* font, const unicode& text, float width, float line_height) {
+    glyphs_.clear();
+    lines_.clear();
+    pages_.clear();
+
+    const std::size_t length = text.length();
+    glyphs_.reserve(length);
+
+    TextLine line;
+    line.baseline = line_height / 2.0f;
+
+    float pen = 0.0f;
+
+    /* The current word, which moves to the next line as a whole if it
+     * overflows the width */
+    uint32_t word_start = 0;
+    float word_pen = 0.0f;
+
+    auto end_line = [&](uint32_t next_glyph, float line_width) {
+        line.glyph_count = next_glyph - line.first_glyph;
+        line.width = line_width;
+        lines_.push_back(line);
+
+        line.first_glyph = next_glyph;
+        line.baseline -= line_height;
+    };
+
+    for(std::size_t i = 0; i < length; ++i) {
+        const char32_t ch = text[i];
+
+        if(ch == '\n') {
+            end_line(glyphs_.size(), pen);
+            pen = word_pen = 0.0f;
+            word_start = glyphs_.size();
+            continue;
+        }
+
+        const uint16_t page = font->character_page(ch);
+        const float ch_width = font->character_width(ch);
+        const float ch_height = font->character_height(ch);
+        const auto off = font->character_offset(ch);
+        const auto coords = font->texture_coordinates_for_character(ch);
+
+        TextGlyph glyph;
+        glyph.x0 = off.first + pen;
+        glyph.y0 = off.second + line.baseline;
+        glyph.x1 = glyph.x0 + ch_width;
+        glyph.y1 = glyph.y0 - ch_height;
+        glyph.s0 = coords.first.x;
+        glyph.t0 = coords.first.y;
+        glyph.s1 = coords.second.x;
+        glyph.t1 = coords.second.y;
+        glyph.page = page;
+        glyph.line = lines_.size();
+        glyphs_.push_back(glyph);
+
+        const bool last = (i == length - 1);
+        pen += font->character_advance(ch, (last) ? 0 : text[i + 1]);
+
+        if(ch != ' ' && !last) {
+            continue;
+        }
+
+        // End of a word. Wrap it, but only if that would help
+        const float word_length = pen - word_pen;
+        if(pen > width && word_pen > 0.0f && word_length < width) {
+            end_line(word_start, word_pen);
+
+            for(uint32_t j = word_start; j < glyphs_.size(); ++j) {
+                auto& g = glyphs_[j];
+                g.x0 -= word_pen;
+                g.x1 -= word_pen;
+                g.y0 -= line_height;
+                g.y1 -= line_height;
+                g.line = lines_.size();
+            }
+
+            pen = word_length;
+        }
+
+        word_start = glyphs_.size();
+        word_pen = pen;
+    }
+
+    end_line(glyphs_.size(), pen);
+
+    if(glyphs_.empty()) {
+        min_x_ = max_x_ = min_y_ = max_y_ = 0.0f;
+        return;
+    }
+
+    min_x_ = min_y_ = std::numeric_limits<float>::max();
+    max_x_ = max_y_ = std::numeric_limits<float>::lowest();
+
+    for(auto& g: glyphs_) {
+        min_x_ = std::min(min_x_, g.x0);
+        max_x_ = std::max(max_x_, g.x1);
+        min_y_ = std::min(min_y_, g.y1);
+        max_y_ = std::max(max_y_, g.y0);
+
+        if(std::find(pages_.begin(), pages_.end(), g.page) == pages_.end()) {
+            pages_.push_back(g.page);
+        }
+    }
+
+    // Move the text so it's centred on the widget, or on the width if that's wider
+    const float shift_x = ::round(std::max(max_x_ - min_x_, width) / 2.0f);
+
+    // FIXME: I can't for the life of me figure out why this works - it's almost definitely wrong
+    const float shift_y = ::round(-font->descent());
+
+    for(auto& g: glyphs_) {
+        g.x0 -= shift_x;
+        g.x1 -= shift_x;
+        g.y0 -= shift_y;
+        g.y1 -= shift_y;
+    }
+
+    for(auto& l: lines_) {
+        l.baseline -= shift_y;
+    }
+
+    min_x_ -= shift_x;
+    max_x_ -= shift_x;
+    min_y_ -= shift_y;
+    max_y_ -= shift_y;
+}
+
+std::size_t TextLayoutCache::KeyHash::operator()(const Key& key) const {
+    uint32_t width_bits, line_height_bits;
+    std::memcpy(&width_bits, &key.width, sizeof(float));
+    std::memcpy(&line_height_bits, &key.line_height, sizeof(float));
+
+    std::size_t seed = std::hash<unicode>()(key.text);
+
+    auto combine = [&seed](std::size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
+
+    combine(std::hash<FontID>()(key.font_id));
+    combine(width_bits);
+    combine(line_height_bits);
+    return seed;
+}
+
+TextLayoutCache::TextLayoutCache(std::size_t capacity):
+    capacity_(std::max<std::size_t>(capacity, 1)) {
+
+}
+
+void TextLayoutCache::set_capacity(std::size_t capacity) {
+    capacity_ = std::max<std::size_t>(capacity, 1);
+    trim();
+}
+
+void TextLayoutCache::clear() {
+    lru_.clear();
+    entries_.clear();
+}
+
+void TextLayoutCache::trim() {
+    while(entries_.size() > capacity_) {
+        auto key = lru_.back();
+        lru_.pop_back();
+        entries_.erase(*key);
+    }
+}
+
+TextLayoutPtr TextLayoutCache::layout(Font* font, const unicode& text, float width, float line_height) {
+    Key key;
+    key.font_id = font->id();
+    key.width = width;
+    key.line_height = line_height;
+    key.text = text;
+
+    auto it = entries_.find(key);
+    if(it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+
+        if(it->second.layout->atlas_revision() == font->atlas_revision()) {
+            ++hits_;
+            return it->second.layout;
+        }
+
+        // Stale texture coordinates, lay it out again
+        ++misses_;
+        it->second.layout = std::make_shared<TextLayout>(font, text, width, line_height);
+        return it->second.layout;
+    }
+
+    ++misses_;
+
+    S_PROFILE_SCOPE("TextLayoutCache::layout");
+
+    auto layout = std::make_shared<TextLayout>(font, text, width, line_height);
+
+    auto inserted = entries_.insert(std::make_pair(std::move(key), Entry())).first;
+    lru_.push_front(&inserted->first);
+    inserted->second.layout = layout;
+    inserted->second.lru_position = lru_.begin();
+
+    trim();
+
+    return layout;
+}
+
+}
+}
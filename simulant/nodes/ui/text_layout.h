@@ -0,0 +1,135 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "../../types.h"
+
+namespace smlt {
+namespace ui {
+
+/* A single positioned character quad */
+struct TextGlyph {
+    /* Top-left and bottom-right corners */
+    float x0, y0;
+    float x1, y1;
+
+    /* Texture coordinates of the same corners */
+    float s0, t0;
+    float s1, t1;
+
+    uint16_t page;
+    uint16_t line;
+};
+
+struct TextLine {
+    uint32_t first_glyph = 0;
+    uint32_t glyph_count = 0;
+
+    /* The advance width of the line, and the y coordinate it sits on */
+    float width = 0.0f;
+    float baseline = 0.0f;
+};
+
+/*
+ * The glyph quads of a string laid out with a font, wrapped to a width. The
+ * text is centred horizontally around zero (on "width" if that is larger than
+ * the text) in the same way widgets position their content.
+ *
+ * Layouts are immutable once built, so they can be shared between widgets
+ * through a TextLayoutCache.
+ */
+class TextLayout {
+public:
+    TextLayout(Font* font, const unicode& text, float width, float line_height);
+
+    const std::vector<TextGlyph>& glyphs() const { return glyphs_; }
+    const std::vector<TextLine>& lines() const { return lines_; }
+
+    /* The distinct font pages the glyphs use */
+    const std::vector<uint16_t>& pages() const { return pages_; }
+
+    float width() const { return max_x_ - min_x_; }
+    float height() const { return max_y_ - min_y_; }
+
+    /* The font's atlas revision when this was laid out, the texture
+     * coordinates are only valid while the font still has this revision */
+    uint32_t atlas_revision() const { return atlas_revision_; }
+
+private:
+    void build(Font* font, const unicode& text, float width, float line_height);
+
+    std::vector<TextGlyph> glyphs_;
+    std::vector<TextLine> lines_;
+    std::vector<uint16_t> pages_;
+
+    float min_x_ = 0.0f;
+    float max_x_ = 0.0f;
+    float min_y_ = 0.0f;
+    float max_y_ = 0.0f;
+
+    uint32_t atlas_revision_ = 0;
+};
+
+typedef std::shared_ptr<const TextLayout> TextLayoutPtr;
+
+/*
+ * Keeps the most recently used layouts, keyed by font, wrap width, line
+ * height and content. Layouts whose font has since evicted glyphs are laid
+ * out again on their next lookup.
+ */
+class TextLayoutCache {
+public:
+    const static std::size_t DEFAULT_CAPACITY = 1024;
+
+    TextLayoutCache(std::size_t capacity=DEFAULT_CAPACITY);
+
+    TextLayoutPtr layout(Font* font, const unicode& text, float width, float line_height);
+
+    void set_capacity(std::size_t capacity);
+    std::size_t capacity() const { return capacity_; }
+
+    std::size_t size() const { return entries_.size(); }
+    void clear();
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+private:
+    struct Key {
+        FontID font_id;
+        float width;
+        float line_height;
+        unicode text;
+
+        bool operator==(const Key& rhs) const {
+            return font_id == rhs.font_id && width == rhs.width &&
+                line_height == rhs.line_height && text == rhs.text;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        TextLayoutPtr layout;
+        std::list<const Key*>::iterator lru_position;
+    };
+
+    std::size_t capacity_;
+
+    /* Most recently used first, pointing at the keys in entries_ */
+    std::list<const Key*> lru_;
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    void trim();
+};
+
+}
+}
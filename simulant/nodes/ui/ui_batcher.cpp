@@ -0,0 +1,525 @@
+#include <algorithm>
+#include <cstring>
+
+#include "ui_batcher.h"
+#include "widget.h"
+
+#include "../../stage.h"
+#include "../../hardware_buffer.h"
+#include "../../meshes/mesh.h"
+#include "../../renderers/renderer.h"
+#include "../../profiler.h"
+
+namespace smlt {
+namespace ui {
+
+const static VertexSpecification UI_VERTEX_SPEC(
+        smlt::VERTEX_ATTRIBUTE_3F, // Position
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_2F, // Texcoord 0
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_NONE,
+        smlt::VERTEX_ATTRIBUTE_4F // Diffuse
+);
+
+UIBatch::UIBatch(MaterialID material_id, RenderPriority priority):
+    material_id_(material_id),
+    render_priority_(priority),
+    vertex_data_(UI_VERTEX_SPEC),
+    index_data_(INDEX_TYPE_32_BIT) {
+
+}
+
+void UIBatch::prepare_buffers(Renderer* renderer) {
+    const std::size_t vertex_size = vertex_data_.stride() * vertex_data_.count();
+    const std::size_t index_size = index_data_.stride() * index_data_.count();
+
+    if(!vertex_buffer_) {
+        vertex_buffer_ = renderer->hardware_buffers->allocate(
+            vertex_size,
+            HARDWARE_BUFFER_VERTEX_ATTRIBUTES,
+            SHADOW_BUFFER_DISABLED,
+            HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING
+        );
+    } else if(vertex_buffer_->size() < vertex_size) {
+        vertex_buffer_->resize(vertex_size);
+    }
+
+    if(!index_buffer_) {
+        index_buffer_ = renderer->hardware_buffers->allocate(
+            index_size,
+            HARDWARE_BUFFER_VERTEX_ARRAY_INDICES,
+            SHADOW_BUFFER_DISABLED,
+            HARDWARE_BUFFER_MODIFY_REPEATEDLY_USED_FOR_RENDERING
+        );
+    } else if(index_buffer_->size() < index_size) {
+        index_buffer_->resize(index_size);
+    }
+
+    if(dirty_) {
+        vertex_buffer_->upload(vertex_data_);
+        index_buffer_->upload(index_data_);
+        dirty_ = false;
+    }
+}
+
+UIBatcher::UIBatcher(Stage* stage):
+    stage_(stage) {
+
+}
+
+UIBatcher::~UIBatcher() {
+    for(auto& p: buckets_) {
+        release(p.second);
+    }
+}
+
+std::size_t UIBatcher::batch_count() const {
+    std::size_t count = 0;
+    for(auto& p: buckets_) {
+        if(p.second.batch && p.second.batch->index_element_count()) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+void UIBatcher::release(Bucket& bucket) {
+    if(bucket.batch) {
+        stage_->render_queue->remove_renderable(bucket.batch.get());
+        bucket.batch.reset();
+    }
+
+    bucket.ranges.clear();
+}
+
+void UIBatcher::mark_for_repack(const WidgetState& state) {
+    for(auto& p: state.layers) {
+        buckets_[BucketKey(p.second, p.first)].needs_repack = true;
+    }
+}
+
+void UIBatcher::remove_widget(WidgetID widget_id) {
+    auto it = widgets_.find(widget_id);
+    if(it == widgets_.end()) {
+        return;
+    }
+
+    mark_for_repack(it->second);
+    widgets_.erase(it);
+    layers_dirty_ = true;
+}
+
+void UIBatcher::measure(Widget* widget, WidgetState& state) {
+    state.geometry.clear();
+
+    auto mesh = widget->_mesh();
+    if(!widget->is_visible() || !mesh) {
+        return;
+    }
+
+    auto source = mesh->vertex_data.get();
+    const uint32_t vertex_count = source->count();
+
+    std::map<MaterialID, std::vector<SubMesh*>> by_material;
+    mesh->each_submesh([&](const std::string&, SubMeshPtr submesh) {
+        if(submesh->index_data->count()) {
+            by_material[submesh->material_id()].push_back(submesh);
+        }
+    });
+
+    const Mat4 transform = widget->absolute_transformation();
+    bool first = true;
+
+    for(auto& p: by_material) {
+        auto& geometry = state.geometry[p.first];
+
+        /* Only the vertices the material's submeshes use are copied, text
+         * reuses freed vertices so these needn't be contiguous */
+        used_.assign(vertex_count, 0);
+        for(auto submesh: p.second) {
+            geometry.index_count += submesh->index_data->count();
+            submesh->index_data->each([&](uint32_t idx) {
+                used_[idx] = 1;
+            });
+        }
+
+        for(uint32_t i = 0; i < vertex_count; ++i) {
+            if(!used_[i]) {
+                continue;
+            }
+
+            if(geometry.spans.empty() || geometry.spans.back().first + geometry.spans.back().count != i) {
+                Span span;
+                span.first = i;
+                geometry.spans.push_back(span);
+            }
+
+            geometry.spans.back().count++;
+
+            const Vec3 local = source->position_at<Vec3>(i);
+            geometry.depth = (geometry.vertex_count) ? std::min(geometry.depth, local.z) : local.z;
+            geometry.vertex_count++;
+
+            const Vec3 v = local.transformed_by(transform);
+            if(first) {
+                state.bounds.min_x = state.bounds.max_x = v.x;
+                state.bounds.min_y = state.bounds.max_y = v.y;
+                first = false;
+            } else {
+                state.bounds.min_x = std::min(state.bounds.min_x, v.x);
+                state.bounds.min_y = std::min(state.bounds.min_y, v.y);
+                state.bounds.max_x = std::max(state.bounds.max_x, v.x);
+                state.bounds.max_y = std::max(state.bounds.max_y, v.y);
+            }
+        }
+    }
+}
+
+void UIBatcher::assign_layers(const std::vector<Widget*>& ordered) {
+    S_PROFILE_SCOPE("UIBatcher::assign_layers");
+
+    struct Placed {
+        Bounds bounds;
+        MaterialID material_id;
+    };
+
+    std::vector<std::vector<Placed>> layers;
+    std::vector<Bounds> layer_bounds;
+
+    std::vector<std::pair<float, MaterialID>> materials;
+    std::map<MaterialID, uint32_t> assigned;
+
+    for(auto widget: ordered) {
+        auto& state = widgets_.at(widget->id());
+
+        // Back to front within the widget
+        materials.clear();
+        for(auto& p: state.geometry) {
+            materials.push_back(std::make_pair(p.second.depth, p.first));
+        }
+        std::sort(materials.begin(), materials.end());
+
+        assigned.clear();
+        for(auto& material: materials) {
+            /* Find the topmost layer with anything this overlaps. Anything
+             * lower down is drawn first whichever layer this goes in */
+            uint32_t layer = 0;
+            for(uint32_t l = layers.size(); l--;) {
+                if(!layer_bounds[l].overlaps(state.bounds)) {
+                    continue;
+                }
+
+                bool overlaps = false;
+                bool other_material = false;
+                for(auto& placed: layers[l]) {
+                    if(placed.bounds.overlaps(state.bounds)) {
+                        overlaps = true;
+                        if(placed.material_id != material.second) {
+                            other_material = true;
+                            break;
+                        }
+                    }
+                }
+
+                if(overlaps) {
+                    layer = (other_material) ? l + 1 : l;
+                    break;
+                }
+            }
+
+            if(layer == layers.size()) {
+                layers.emplace_back();
+                layer_bounds.push_back(state.bounds);
+            } else {
+                layer_bounds[layer].expand(state.bounds);
+            }
+
+            Placed placed;
+            placed.bounds = state.bounds;
+            placed.material_id = material.second;
+            layers[layer].push_back(placed);
+
+            assigned[material.second] = layer;
+        }
+
+        if(assigned != state.layers) {
+            mark_for_repack(state);
+            state.layers.swap(assigned);
+            mark_for_repack(state);
+        }
+    }
+}
+
+uint32_t UIBatcher::sync(const std::vector<Widget*>& widgets) {
+    S_PROFILE_SCOPE("UIBatcher::sync");
+
+    /* Widgets which still fit their existing ranges */
+    std::vector<Widget*> rewrite;
+
+    /* Widgets whose ranges need to change size */
+    std::vector<Widget*> resized;
+
+    for(auto widget: widgets) {
+        auto it = widgets_.find(widget->id());
+        const bool is_new = (it == widgets_.end());
+
+        WidgetState& state = (is_new) ? widgets_[widget->id()] : it->second;
+
+        const uint32_t revision = widget->_geometry_revision();
+        const Vec3 position = widget->absolute_position();
+        const Quaternion rotation = widget->absolute_rotation();
+        const Vec3 scale = widget->absolute_scaling();
+        const bool visible = widget->is_visible();
+
+        if(!is_new && state.revision == revision && state.visible == visible &&
+            state.position == position && state.rotation == rotation && state.scale == scale) {
+            continue;
+        }
+
+        if(!is_new && state.position.z != position.z) {
+            // The widget moves in the draw order
+            mark_for_repack(state);
+        }
+
+        state.revision = revision;
+        state.position = position;
+        state.rotation = rotation;
+        state.scale = scale;
+        state.visible = visible;
+
+        auto old_geometry = std::move(state.geometry);
+        measure(widget, state);
+
+        bool same_size = !is_new && old_geometry.size() == state.geometry.size();
+        for(auto& p: state.geometry) {
+            if(!same_size) {
+                break;
+            }
+
+            auto old = old_geometry.find(p.first);
+            same_size = old != old_geometry.end() &&
+                old->second.vertex_count == p.second.vertex_count &&
+                old->second.index_count == p.second.index_count;
+        }
+
+        if(same_size) {
+            rewrite.push_back(widget);
+        } else {
+            mark_for_repack(state);
+            resized.push_back(widget);
+        }
+    }
+
+    if(rewrite.empty() && resized.empty() && !layers_dirty_) {
+        return 0;
+    }
+
+    layers_dirty_ = false;
+
+    // Widgets are drawn in depth order, then in creation order
+    std::vector<Widget*> ordered = widgets;
+    std::sort(ordered.begin(), ordered.end(), [this](Widget* lhs, Widget* rhs) {
+        const float lz = widgets_.at(lhs->id()).position.z;
+        const float rz = widgets_.at(rhs->id()).position.z;
+        return (lz != rz) ? lz < rz : lhs->id().value() < rhs->id().value();
+    });
+
+    // Any change can move widgets between layers, which repacks their buckets
+    assign_layers(ordered);
+
+    for(auto widget: resized) {
+        mark_for_repack(widgets_.at(widget->id()));
+    }
+
+    uint32_t written = 0;
+
+    for(auto& p: buckets_) {
+        if(p.second.needs_repack) {
+            repack(p.first, p.second, ordered);
+            written += p.second.ranges.size();
+        }
+    }
+
+    for(auto widget: rewrite) {
+        auto& state = widgets_.at(widget->id());
+        for(auto& p: state.geometry) {
+            auto& bucket = buckets_.at(BucketKey(state.layers.at(p.first), p.first));
+            if(bucket.needs_repack) {
+                // Already written
+                continue;
+            }
+
+            write_range(bucket.batch.get(), bucket.ranges.at(widget->id()), widget, p.second);
+            bucket.batch->dirty_ = true;
+            ++written;
+        }
+    }
+
+    for(auto it = buckets_.begin(); it != buckets_.end();) {
+        auto& bucket = it->second;
+        bucket.needs_repack = false;
+
+        if(bucket.ranges.empty()) {
+            release(bucket);
+            it = buckets_.erase(it);
+            continue;
+        }
+
+        auto batch = bucket.batch.get();
+        if(batch->dirty_) {
+            auto& vertices = batch->vertex_data_;
+
+            Vec3 min = vertices.position_at<Vec3>(0);
+            Vec3 max = min;
+            for(uint32_t i = 1; i < vertices.count(); ++i) {
+                Vec3 v = vertices.position_at<Vec3>(i);
+                min.x = std::min(min.x, v.x);
+                min.y = std::min(min.y, v.y);
+                min.z = std::min(min.z, v.z);
+                max.x = std::max(max.x, v.x);
+                max.y = std::max(max.y, v.y);
+                max.z = std::max(max.z, v.z);
+            }
+
+            batch->aabb_ = AABB(min, max);
+        }
+
+        ++it;
+    }
+
+    return written;
+}
+
+void UIBatcher::repack(const BucketKey& key, Bucket& bucket, const std::vector<Widget*>& widgets) {
+    bucket.ranges.clear();
+
+    const uint32_t layer = key.first;
+    const MaterialID material_id = key.second;
+
+    uint32_t vertex_count = 0;
+    uint32_t index_count = 0;
+
+    for(auto widget: widgets) {
+        auto& state = widgets_.at(widget->id());
+        auto it = state.layers.find(material_id);
+        if(it == state.layers.end() || it->second != layer) {
+            continue;
+        }
+
+        auto& geometry = state.geometry.at(material_id);
+
+        Range range;
+        range.first_vertex = vertex_count;
+        range.vertex_count = geometry.vertex_count;
+        range.first_index = index_count;
+        range.index_count = geometry.index_count;
+
+        vertex_count += range.vertex_count;
+        index_count += range.index_count;
+
+        bucket.ranges[widget->id()] = range;
+    }
+
+    if(bucket.ranges.empty()) {
+        return;
+    }
+
+    if(!bucket.batch) {
+        bucket.batch = std::make_shared<UIBatch>(material_id, RENDER_PRIORITY_MAIN + RenderPriority(layer));
+        stage_->render_queue->insert_renderable(bucket.batch.get());
+    }
+
+    auto batch = bucket.batch.get();
+    batch->vertex_data_.resize(vertex_count);
+    batch->index_data_.resize(index_count);
+
+    for(auto widget: widgets) {
+        auto it = bucket.ranges.find(widget->id());
+        if(it != bucket.ranges.end()) {
+            write_range(batch, it->second, widget, widgets_.at(widget->id()).geometry.at(material_id));
+        }
+    }
+
+    batch->dirty_ = true;
+}
+
+void UIBatcher::write_range(UIBatch* batch, const Range& range, Widget* widget, const Geometry& geometry) {
+    auto mesh = widget->_mesh();
+    auto source = mesh->vertex_data.get();
+
+    const auto& source_spec = source->specification();
+    const uint32_t source_stride = source->stride();
+
+    auto& vertices = batch->vertex_data_;
+    const auto& spec = vertices.specification();
+    const uint32_t stride = vertices.stride();
+    uint8_t* out = vertices.data() + (range.first_vertex * stride);
+
+    const Mat4 transform = widget->absolute_transformation();
+
+    // Where each source vertex ends up in the batch
+    if(remap_.size() < source->count()) {
+        remap_.resize(source->count());
+    }
+
+    uint32_t next = range.first_vertex;
+    for(auto& span: geometry.spans) {
+        const uint8_t* in = source->data() + (span.first * source_stride);
+
+        for(uint32_t i = span.first; i < span.first + span.count; ++i) {
+            Vec3 position = source->position_at<Vec3>(i).transformed_by(transform);
+
+            float* pos = (float*) (out + spec.position_offset());
+            pos[0] = position.x;
+            pos[1] = position.y;
+            pos[2] = position.z;
+
+            std::memcpy(out + spec.texcoord0_offset(), in + source_spec.texcoord0_offset(), sizeof(float) * 2);
+            std::memcpy(out + spec.diffuse_offset(), in + source_spec.diffuse_offset(), sizeof(float) * 4);
+
+            remap_[i] = next++;
+
+            in += source_stride;
+            out += stride;
+        }
+    }
+
+    uint32_t* indices = ((uint32_t*) batch->index_data_.data()) + range.first_index;
+
+    mesh->each_submesh([&](const std::string&, SubMeshPtr submesh) {
+        if(submesh->material_id() != batch->material_id_) {
+            return;
+        }
+
+        submesh->index_data->each([&](uint32_t idx) {
+            *indices++ = remap_[idx];
+        });
+    });
+}
+
+RenderableList UIBatcher::_get_renderables(const Frustum& frustum) const {
+    RenderableList result;
+
+    for(auto& p: buckets_) {
+        auto& batch = p.second.batch;
+        if(!batch || !batch->index_element_count()) {
+            continue;
+        }
+
+        if(frustum.intersects_aabb(batch->aabb())) {
+            result.push_back(batch);
+        }
+    }
+
+    return result;
+}
+
+}
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "../../types.h"
+#include "../../vertex_data.h"
+#include "../../frustum.h"
+#include "../stage_node.h"
+#include "../../renderers/batching/renderable.h"
+
+namespace smlt {
+
+class HardwareBuffer;
+
+namespace ui {
+
+class Widget;
+
+/*
+ * A dynamic vertex buffer holding the geometry of every widget in a stage
+ * which uses a particular material in a particular layer. Each widget owns a
+ * contiguous range of the vertices and indices.
+ */
+class UIBatch:
+    public Renderable {
+
+public:
+    UIBatch(MaterialID material_id, RenderPriority priority);
+
+    const AABB& aabb() const override { return aabb_; }
+    const AABB transformed_aabb() const override { return aabb_; }
+
+    const MeshArrangement arrangement() const override { return MESH_ARRANGEMENT_TRIANGLES; }
+
+    void prepare_buffers(Renderer* renderer) override;
+
+    VertexSpecification vertex_attribute_specification() const override {
+        return vertex_data_.specification();
+    }
+
+    HardwareBuffer* vertex_attribute_buffer() const override { return vertex_buffer_.get(); }
+    HardwareBuffer* index_buffer() const override { return index_buffer_.get(); }
+
+    std::size_t index_element_count() const override { return index_data_.count(); }
+    IndexType index_type() const override { return INDEX_TYPE_32_BIT; }
+
+    RenderPriority render_priority() const override { return render_priority_; }
+
+    Mat4 final_transformation() const override {
+        return Mat4(); // Vertices are written in world space
+    }
+
+    const MaterialID material_id() const override { return material_id_; }
+    const bool is_visible() const override { return true; }
+
+private:
+    friend class UIBatcher;
+
+    MaterialID material_id_;
+    RenderPriority render_priority_;
+
+    VertexData vertex_data_;
+    IndexData index_data_;
+
+    std::unique_ptr<HardwareBuffer> vertex_buffer_;
+    std::unique_ptr<HardwareBuffer> index_buffer_;
+
+    bool dirty_ = false;
+
+    AABB aabb_;
+};
+
+typedef std::shared_ptr<UIBatch> UIBatchPtr;
+
+/*
+ * Keeps the UIBatches of a stage up to date with its widgets.
+ *
+ * Widgets are drawn in depth order (then creation order), and the materials
+ * of a widget from back to front. Overlapping geometry which uses different
+ * materials has to keep that order, so the batches are split into layers:
+ * each material of a widget goes in the layer of the topmost geometry it
+ * overlaps, or the layer above if that uses another material. Each layer is
+ * drawn at a higher render priority than the one below it.
+ *
+ * A widget whose mesh, transform or visibility changed has its ranges
+ * rewritten in place. If that changes the number of vertices or indices it
+ * needs in a batch, moves it to another layer or changes its depth, the
+ * batches involved are repacked from scratch. Batches are only uploaded when
+ * something in them changed.
+ */
+class UIBatcher {
+public:
+    UIBatcher(Stage* stage);
+    ~UIBatcher();
+
+    /* Brings the batches up to date, returns the number of widget ranges that
+     * were written */
+    uint32_t sync(const std::vector<Widget*>& widgets);
+
+    void remove_widget(WidgetID widget_id);
+
+    RenderableList _get_renderables(const Frustum& frustum) const;
+
+    std::size_t batch_count() const;
+
+private:
+    struct Range {
+        uint32_t first_vertex = 0;
+        uint32_t vertex_count = 0;
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+    };
+
+    /* A run of a widget's vertices used by one of its materials */
+    struct Span {
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    /* The part of a widget's mesh which uses one material */
+    struct Geometry {
+        std::vector<Span> spans;
+        uint32_t vertex_count = 0;
+        uint32_t index_count = 0;
+
+        /* The lowest z of the vertices, orders the materials of a widget */
+        float depth = 0.0f;
+    };
+
+    /* The area a widget covers, in world space */
+    struct Bounds {
+        float min_x = 0.0f;
+        float min_y = 0.0f;
+        float max_x = 0.0f;
+        float max_y = 0.0f;
+
+        bool overlaps(const Bounds& rhs) const {
+            return min_x < rhs.max_x && rhs.min_x < max_x &&
+                min_y < rhs.max_y && rhs.min_y < max_y;
+        }
+
+        void expand(const Bounds& rhs) {
+            min_x = std::min(min_x, rhs.min_x);
+            min_y = std::min(min_y, rhs.min_y);
+            max_x = std::max(max_x, rhs.max_x);
+            max_y = std::max(max_y, rhs.max_y);
+        }
+    };
+
+    /* (layer, material) */
+    typedef std::pair<uint32_t, MaterialID> BucketKey;
+
+    struct Bucket {
+        UIBatchPtr batch;
+        std::unordered_map<WidgetID, Range> ranges;
+        bool needs_repack = false;
+    };
+
+    /* What the batches currently hold for each widget */
+    struct WidgetState {
+        uint32_t revision = 0;
+        Vec3 position;
+        Quaternion rotation;
+        Vec3 scale;
+        bool visible = false;
+
+        Bounds bounds;
+        std::map<MaterialID, Geometry> geometry;
+
+        /* Material -> the layer of the bucket holding its range */
+        std::map<MaterialID, uint32_t> layers;
+    };
+
+    Stage* stage_ = nullptr;
+
+    std::map<BucketKey, Bucket> buckets_;
+    std::unordered_map<WidgetID, WidgetState> widgets_;
+
+    /* Set when a widget is removed, the others may move down a layer */
+    bool layers_dirty_ = false;
+
+    /* Scratch space, reused between widgets */
+    std::vector<uint8_t> used_;
+    std::vector<uint32_t> remap_;
+
+    void mark_for_repack(const WidgetState& state);
+    void measure(Widget* widget, WidgetState& state);
+    void assign_layers(const std::vector<Widget*>& ordered);
+    void write_range(UIBatch* batch, const Range& range, Widget* widget, const Geometry& geometry);
+    void repack(const BucketKey& key, Bucket& bucket, const std::vector<Widget*>& widgets);
+    void release(Bucket& bucket);
+};
+
+}
+}
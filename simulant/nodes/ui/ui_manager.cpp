@@ -18,7 +18,9 @@
 #include "progress_bar.h"
 #include "image.h"
 #include "../../stage.h"
+#include "../../material.h"
 #include "../camera.h"
+#include "../../profiler.h"
 
 namespace smlt {
 namespace ui {
@@ -30,23 +32,33 @@ UIManager::UIManager(Stage *stage):
     window_(stage->window.get()){
 
     manager_.reset(new WidgetManager());
+    batcher_.reset(new UIBatcher(stage_));
 
     window_->register_event_listener(this);
 
     /* Each time the stage is rendered with a camera and viewport, we need to process any queued events
-     * so that (for example) we can interact with the same widget rendered to different viewports */
+     * so that (for example) we can interact with the same widget rendered to different viewports.
+     * Layout has to be up to date first, both for the hit tests and the batches */
     pre_render_connection_ = stage_->signal_stage_pre_render().connect([this](CameraID cam_id, Viewport viewport) {
+        if(!synced_this_frame_) {
+            this->_sync_batches();
+            synced_this_frame_ = true;
+        }
+
         this->process_event_queue(cam_id.fetch(), viewport);
     });
 
     /* We clear queued events at the end of each frame */
     frame_finished_connection_ = window_->signal_frame_finished().connect([this]() {
         this->clear_event_queue();
+        synced_this_frame_ = false;
     });
 }
 
 UIManager::~UIManager() {
+    // Widgets remove themselves from the batcher as they're destroyed
     manager_.reset();
+    batcher_.reset();
 
     pre_render_connection_.disconnect();
     frame_finished_connection_.disconnect();
@@ -97,9 +109,45 @@ void UIManager::delete_widget(WidgetID widget) {
         return;
     }
 
+    batcher_->remove_widget(widget);
     manager_->destroy(widget);
 }
 
+uint32_t UIManager::_sync_batches() {
+    S_PROFILE_SCOPE("UIManager::_sync_batches");
+
+    std::vector<Widget*> widgets;
+    widgets.reserve(manager_->count());
+
+    manager_->each([&](uint32_t, WidgetPtr widget) {
+        widget->_update_layout();
+        widgets.push_back(widget);
+    });
+
+    return batcher_->sync(widgets);
+}
+
+RenderableList UIManager::_get_renderables(const Frustum& frustum) const {
+    return batcher_->_get_renderables(frustum);
+}
+
+MaterialID UIManager::_material_for(TextureID texture_id) {
+    auto it = materials_.find(texture_id);
+    if(it != materials_.end()) {
+        return it->second->id();
+    }
+
+    auto material = stage_->assets->new_material_from_file(Material::BuiltIns::TEXTURE_ONLY).fetch();
+    material->first_pass()->set_blending(BLEND_ALPHA);
+
+    if(texture_id) {
+        material->first_pass()->set_texture_unit(0, texture_id);
+    }
+
+    materials_[texture_id] = material;
+    return material->id();
+}
+
 void UIManager::on_touch_begin(const TouchEvent &evt) {
     queue_event(evt);
 }
@@ -5,6 +5,7 @@
 #include <queue>
 #include "../../types.h"
 #include "widget.h"
+#include "ui_batcher.h"
 #include "../../event_listener.h"
 
 namespace smlt {
@@ -49,13 +50,34 @@ public:
 
     Stage* stage() const { return stage_; }
 
+    /* Lays out any dirty widgets and updates the batches. This happens once a
+     * frame before the stage is rendered, returns the number of widget ranges
+     * written to the batches */
+    uint32_t _sync_batches();
+
+    RenderableList _get_renderables(const Frustum& frustum) const;
+    std::size_t batch_count() const { return batcher_->batch_count(); }
+
+    /* The material shared by all widgets showing this texture, pass
+     * TextureID() for untextured widgets */
+    MaterialID _material_for(TextureID texture_id);
+
+    /* Text layouts shared by the widgets of this stage */
+    TextLayoutCache* _text_layouts() { return &text_layouts_; }
+
 private:    
     Stage* stage_ = nullptr;
     Window* window_ = nullptr;
 
     std::unique_ptr<WidgetManager> manager_;
+    std::unique_ptr<UIBatcher> batcher_;
     UIConfig config_;
 
+    std::unordered_map<TextureID, MaterialPtr> materials_;
+    TextLayoutCache text_layouts_;
+
+    bool synced_this_frame_ = false;
+
     void on_touch_begin(const TouchEvent &evt) override;
     void on_touch_end(const TouchEvent &evt) override;
     void on_touch_move(const TouchEvent &evt) override;
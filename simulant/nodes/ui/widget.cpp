@@ -1,8 +1,9 @@
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 #include "widget.h"
 #include "ui_manager.h"
-#include "../actor.h"
 #include "../../stage.h"
 #include "../../material.h"
 
@@ -27,18 +28,15 @@ Widget::~Widget() {
 }
 
 bool Widget::init() {
-    actor_ = stage->new_actor();
-    actor_->set_parent(this);
-
-    material_ = stage->assets->new_material_from_file(Material::BuiltIns::TEXTURE_ONLY).fetch();
-    material_->first_pass()->set_blending(BLEND_ALPHA);
-
     // Assign the default font as default
     set_font(stage->assets->default_font_id());
 
-    mesh_ = construct_widget(0, 0);
-
     initialized_ = true;
+
+    /* Widgets have no actor, the UIManager copies the mesh into its batches */
+    mesh_ = construct_widget(width_, height_);
+    layout_dirty_ = false;
+
     return true;
 }
 
@@ -52,6 +50,8 @@ void Widget::cleanup() {
         fingerup(finger_id);
     }
 
+    mesh_.reset();
+
     StageNode::cleanup();
 }
 
@@ -77,11 +77,32 @@ void Widget::resize(float width, float height) {
 }
 
 void Widget::rebuild() {
+    // Deferred until the next _update_layout()
+    layout_dirty_ = true;
+}
+
+bool Widget::_update_layout() {
+    if(font_ && font_->atlas_revision() != font_revision_) {
+        // The font evicted glyphs, our texture coordinates may be stale
+        layout_dirty_ = true;
+    }
+
     // If we aren't initialized, don't do anything yet
-    if(!is_initialized()) return;
+    if(!layout_dirty_ || !is_initialized()) {
+        return false;
+    }
 
+    layout_dirty_ = false;
     mesh_ = construct_widget(width_, height_);
-    actor_->set_mesh(mesh_->id());
+    ++geometry_revision_;
+
+    return true;
+}
+
+void Widget::ensure_layout() const {
+    if(layout_dirty_) {
+        const_cast<Widget*>(this)->_update_layout();
+    }
 }
 
 void Widget::set_border_width(float x) {
@@ -142,7 +163,19 @@ void Widget::ask_owner_for_destruction() {
 }
 
 const AABB &Widget::aabb() const {
-    return actor_->aabb();
+    ensure_layout();
+    return mesh_->aabb();
+}
+
+const AABB Widget::transformed_aabb() const {
+    auto corners = aabb().corners();
+    auto transform = absolute_transformation();
+
+    for(auto& corner: corners) {
+        corner = corner.transformed_by(transform);
+    }
+
+    return AABB(corners.data(), corners.size());
 }
 
 void Widget::set_background_image(TextureID texture) {
@@ -225,199 +258,126 @@ void Widget::set_text_colour(const Colour &colour) {
     rebuild();
 }
 
+static std::string text_submesh_name(const std::string& base, uint16_t page) {
+    // The first page keeps the plain name
+    return (page) ? _F("{0}:{1}").format(base, page) : base;
+}
+
+static bool is_text_submesh(const std::string& base, const std::string& name) {
+    return name == base || (
+        name.size() > base.size() &&
+        name.compare(0, base.size(), base) == 0 &&
+        name[base.size()] == ':'
+    );
+}
+
 void Widget::render_text(MeshPtr mesh, const std::string& submesh_name, const unicode& text, float width, float left_margin, float top_margin) {
-    if(mesh->has_submesh(submesh_name)) {
+    /* Glyphs can be on any of the font's pages, so there is a submesh per
+     * page in use. Free the vertices of all of them first. */
+    mesh->each_submesh([&](const std::string& name, SubMeshPtr sm) {
+        if(!is_text_submesh(submesh_name, name)) {
+            return;
+        }
+
         // Save these vertices as free
-        auto sm = mesh->submesh(submesh_name);
         sm->index_data->each([&](uint32_t idx) {
             available_indexes_.insert(idx);
         });
 
         sm->index_data->clear();
+        sm->index_data->done();
+    });
+
+    auto submesh_for_page = [&](uint16_t page) -> SubMeshPtr {
+        auto name = text_submesh_name(submesh_name, page);
+        auto sm = (mesh->has_submesh(name)) ?
+            mesh->submesh(name) : mesh->new_submesh(name, MESH_ARRANGEMENT_TRIANGLES);
 
         // Make sure we maintain the correct material
-        sm->set_material_id(font_->material_id());
-    } else {
-        // Create a new submesh for the text
-        auto sm = mesh->new_submesh(submesh_name, MESH_ARRANGEMENT_TRIANGLES);
-        sm->set_material_id(font_->material_id());
-    }
+        sm->set_material_id(font_->page_material_id(page));
+        return sm;
+    };
 
-    auto submesh = mesh->submesh(submesh_name);
+    // There's always a text submesh, even if it's got nothing in it
+    submesh_for_page(0);
 
-    // We return here so there's always a text mesh even if it's got nothing in it
-    // FIXME: although totally not thread or exception safe :/
-    if(text.empty()) {
+    text_layout_ = owner_->_text_layouts()->layout(font_.get(), text, width, line_height_);
+    font_revision_ = text_layout_->atlas_revision();
+
+    auto& glyphs = text_layout_->glyphs();
+    if(glyphs.empty()) {
         return;
     }
 
-    struct WordVertex {
-        Vec3 position;
-        Vec2 texcoord;
-    };
+    // Reuse free vertices first, then add the rest to the end
+    auto vertices = mesh->vertex_data.get();
+    const uint32_t needed = glyphs.size() * 4;
+
+    std::vector<uint32_t> slots;
+    slots.reserve(needed);
 
-    std::vector<WordVertex> word_vertices;
-    float word_length = .0f;
-    float longest_line = .0f;
-    float line_length = .0f;
+    while(slots.size() < needed && !available_indexes_.empty()) {
+        slots.push_back(*available_indexes_.begin());
+        available_indexes_.erase(available_indexes_.begin());
+    }
 
-    // We use the font-size as the default height, but then add line-height for each subsequent
-    // line. That's because the line height might be less than the font size (causing overlapping)
-    // but we want the total visible height... I think this makes sense!
-    float min_height = std::numeric_limits<float>::max();
-    float max_height = std::numeric_limits<float>::lowest();
+    const uint32_t first_new = vertices->count();
+    vertices->resize(first_new + (needed - slots.size()));
 
-    float xoffset = 0;
-    float yoffset = line_height_ / 2.0f;
+    for(uint32_t i = first_new; i < vertices->count(); ++i) {
+        slots.push_back(i);
+    }
 
+    const auto& spec = vertices->specification();
+    const uint32_t stride = vertices->stride();
+    uint8_t* data = vertices->data();
 
-    for(std::size_t i = 0; i < text.length(); ++i) {
-        bool word_ended = text[i] == U' ' || i == text.length() - 1;
-        bool word_wrap = false;
+    const float colour[] = {text_colour_.r, text_colour_.g, text_colour_.b, text_colour_.a};
 
-        if(text[i] == '\n') {
-            xoffset = 0;
-            yoffset -= line_height_;
+    auto write = [&](uint32_t idx, float x, float y, float s, float t) {
+        uint8_t* out = data + (idx * stride);
 
-            if(line_length > longest_line) {
-                longest_line = line_length;
-            }
-            line_length = .0f;
-        } else {
-            auto ch = text[i];
-            auto ch_width = font_->character_width(ch);
-            auto ch_height = font_->character_height(ch);
-            auto coords = font_->texture_coordinates_for_character(ch);
-            auto min = coords.first;
-            auto max = coords.second;
-
-            auto off = font_->character_offset(ch);
-
-            WordVertex v1, v2, v3, v4;
-
-            v1.position.x = off.first + xoffset;
-            v1.position.y = off.second + yoffset;
-            v1.texcoord.x = min.x;
-            v1.texcoord.y = min.y;
-            word_vertices.push_back(v1);
-
-            v2.position.x = off.first + xoffset;
-            v2.position.y = off.second + yoffset - ch_height;
-            v2.texcoord.x = min.x;
-            v2.texcoord.y = max.y;
-            word_vertices.push_back(v2);
-
-            v3.position.x = off.first + xoffset + ch_width;
-            v3.position.y = off.second + yoffset - ch_height;
-            v3.texcoord.x = max.x;
-            v3.texcoord.y = max.y;
-            word_vertices.push_back(v3);
-
-            v4.position.x = off.first + xoffset + ch_width;
-            v4.position.y = off.second + yoffset;
-            v4.texcoord.x = max.x;
-            v4.texcoord.y = min.y;
-            word_vertices.push_back(v4);
-
-            if(i != text.length() - 1) {
-                float advance = font_->character_advance(ch, text[i + 1]);
-                xoffset += advance;
-                line_length += advance + ch_width;
-            } else {
-                line_length += ch_width;
-            }
-
-            // If the xoffset is greater than the width then we should word wrap
-            if(xoffset > width) {
-                word_wrap = true;
-            }
-        }
+        float* pos = (float*) (out + spec.position_offset());
+        pos[0] = x;
+        pos[1] = y;
+        pos[2] = text_depth_bias_;
 
-        if(word_ended) {
-            float xshift = 0;
-            float yshift = 0;
-
-            // If we need to wrap the word, then do so but only if the word
-            // would actually fit. We don't even try otherwise (but it would be nice to
-            // hyphenate)
-            if(word_wrap && word_length < width) {
-                xshift = -xoffset;
-                yshift = line_height_;
-
-                xoffset = word_length;
-                yoffset -= line_height_;
-            }
-
-            std::vector<uint32_t> used_indexes;
-
-            // We're at the end of the word, time to commit to the mesh
-            for(auto& v: word_vertices) {
-                auto pos = v.position + Vec3(xshift, yshift, text_depth_bias_);
-                if(pos.y < min_height) min_height = pos.y;
-                if(pos.y > max_height) max_height = pos.y;
-
-                if(!available_indexes_.empty()) {
-                    auto it = available_indexes_.begin();
-                    auto idx = *it;
-                    available_indexes_.erase(it);
-
-                    // Use an existing slot
-                    submesh->vertex_data->move_to(idx);
-                    used_indexes.push_back(idx);
-                } else {
-                    // Move to the end to create a new vertex
-                    used_indexes.push_back(submesh->vertex_data->count());
-                    submesh->vertex_data->move_to_end();
-                }
-
-                submesh->vertex_data->position(pos);
-                submesh->vertex_data->tex_coord0(v.texcoord);
-                submesh->vertex_data->diffuse(text_colour_);
-            }
-
-            assert(used_indexes.size() == word_vertices.size());
-
-            for(std::size_t k = 0; k < word_vertices.size(); k += 4) {
-                submesh->index_data->index(used_indexes[k]);
-                submesh->index_data->index(used_indexes[k + 1]);
-                submesh->index_data->index(used_indexes[k + 2]);
-
-                submesh->index_data->index(used_indexes[k]);
-                submesh->index_data->index(used_indexes[k + 2]);
-                submesh->index_data->index(used_indexes[k + 3]);
-            }
-
-            word_vertices.clear();
-            used_indexes.clear();
-            word_length = .0f;
-            word_wrap = false;
-            if(line_length > longest_line) {
-                longest_line = line_length;
-            }
-            line_length = .0f;
+        float* uv = (float*) (out + spec.texcoord0_offset());
+        uv[0] = s;
+        uv[1] = t;
 
-        }
-    }
+        std::memcpy(out + spec.diffuse_offset(), colour, sizeof(colour));
+    };
 
-    // Everything was positioned with the starting X being at the
-    // the center of the widget, so now we move the text to the left by whatever its width was
-    // or half of "width" if that was specified
-    float shiftX = ::round(std::max(submesh->aabb().width(), width) / 2.0);
-    float descent = font_->descent();
+    // Indices for each page's submesh
+    auto& pages = text_layout_->pages();
+    std::vector<std::vector<uint32_t>> indices(pages.size());
+
+    auto* slot = &slots[0];
+    for(auto& g: glyphs) {
+        write(slot[0], g.x0, g.y0, g.s0, g.t0);
+        write(slot[1], g.x0, g.y1, g.s0, g.t1);
+        write(slot[2], g.x1, g.y1, g.s1, g.t1);
+        write(slot[3], g.x1, g.y0, g.s1, g.t0);
+
+        auto& target = indices[std::find(pages.begin(), pages.end(), g.page) - pages.begin()];
+        target.insert(target.end(), {
+            slot[0], slot[1], slot[2],
+            slot[0], slot[2], slot[3]
+        });
 
-    // FIXME: I can't for the life of me figure out why this works - it's almost definitely wrong
-    float shiftY = ::round(-descent);
+        slot += 4;
+    }
 
-    for(uint32_t i = 0; i < submesh->vertex_data->count(); ++i) {
-        submesh->vertex_data->move_to(i);
-        auto pos = submesh->vertex_data->position_at<Vec3>(i);
-        submesh->vertex_data->position(
-            pos + Vec3(-shiftX, -shiftY, 0)
-        );
+    for(std::size_t i = 0; i < pages.size(); ++i) {
+        auto sm = submesh_for_page(pages[i]);
+        sm->index_data->index(&indices[i][0], indices[i].size());
+        sm->index_data->done();
     }
 
     mesh->vertex_data->done();
-    submesh->index_data->done();
+
+    ++geometry_revision_;
 }
 
 MeshPtr Widget::construct_widget(float requested_width, float requested_height) {
@@ -439,12 +399,12 @@ MeshPtr Widget::construct_widget(float requested_width, float requested_height)
 
     if(resize_mode_ == RESIZE_MODE_FIXED_WIDTH) {
         height = std::max(
-            mesh->submesh("text")->aabb().height() + padding_.top + padding_.bottom,
+            text_layout_->height() + padding_.top + padding_.bottom,
             height
         );
     } else if(resize_mode_ == RESIZE_MODE_FIXED_HEIGHT) {
         width = std::max(
-            mesh->submesh("text")->aabb().width() + padding_.left + padding_.right,
+            text_layout_->width() + padding_.left + padding_.right,
             width
         );
 
@@ -452,9 +412,8 @@ MeshPtr Widget::construct_widget(float requested_width, float requested_height)
         height = (height == 0.0f) ? font_->size() + padding_.top + padding_.bottom : height;
 
     } else if(resize_mode_ == RESIZE_MODE_FIT_CONTENT) {
-        auto aabb = mesh->submesh("text")->aabb();
-        width = aabb.width() + padding_.left + padding_.right;
-        height = aabb.height() + padding_.top + padding_.bottom;
+        width = text_layout_->width() + padding_.left + padding_.right;
+        height = text_layout_->height() + padding_.top + padding_.bottom;
     } else {
         // Clip the content?
     }
@@ -479,6 +438,7 @@ void Widget::set_padding(float left, float right, float bottom, float top) {
     padding_.right = right;
     padding_.bottom = bottom;
     padding_.top = top;
+    rebuild();
 }
 
 void generate_or_resize_rectangle(MeshPtr mesh, MaterialID material_id, const std::string& submesh_name, float width, float height, float xoffset, float yoffset, float zoffset) {
@@ -505,17 +465,21 @@ void generate_or_resize_rectangle(MeshPtr mesh, MaterialID material_id, const st
 }
 
 void Widget::resize_or_generate_border(MeshPtr mesh, float width, float height, float xoffset, float yoffset) {
-    generate_or_resize_rectangle(mesh, material_->id(), "border", width, height, xoffset, yoffset, 0);
+    generate_or_resize_rectangle(mesh, owner_->_material_for(TextureID()), "border", width, height, xoffset, yoffset, 0);
     mesh->submesh("border")->set_diffuse(border_colour_);
+    ++geometry_revision_;
 }
 
 void Widget::resize_or_generate_background(MeshPtr mesh, float width, float height, float xoffset, float yoffset) {
-    generate_or_resize_rectangle(mesh, material_->id(), "background", width, height, xoffset, yoffset, background_depth_bias_);
+    /* Images use a material shared by every widget showing that texture, so
+     * that they can be batched together */
+    generate_or_resize_rectangle(mesh, owner_->_material_for(background_image_), "background", width, height, xoffset, yoffset, background_depth_bias_);
+    mesh->submesh("background")->set_material_id(owner_->_material_for(background_image_));
     mesh->submesh("background")->set_diffuse(background_colour_);
+    ++geometry_revision_;
 
     if(has_background_image()) {
         auto submesh = mesh->submesh("background");
-        submesh->set_texture_on_material(0, background_image_);
 
         auto& vertices = mesh->vertex_data;
         auto& indices = submesh->index_data;
@@ -546,12 +510,15 @@ void Widget::resize_or_generate_background(MeshPtr mesh, float width, float heig
 }
 
 void Widget::resize_or_generate_foreground(MeshPtr mesh, float width, float height, float xoffset, float yoffset) {
-    generate_or_resize_rectangle(mesh, material_->id(), "foreground", width, height, xoffset, yoffset, foreground_depth_bias_);
+    /* Images use a material shared by every widget showing that texture, so
+     * that they can be batched together */
+    generate_or_resize_rectangle(mesh, owner_->_material_for(foreground_image_), "foreground", width, height, xoffset, yoffset, foreground_depth_bias_);
+    mesh->submesh("foreground")->set_material_id(owner_->_material_for(foreground_image_));
     mesh->submesh("foreground")->set_diffuse(foreground_colour_);
+    ++geometry_revision_;
 
     if(has_foreground_image()) {
         auto submesh = mesh->submesh("foreground");
-        submesh->set_texture_on_material(0, foreground_image_);
 
         auto& vertices = mesh->vertex_data;
         auto& indices = submesh->index_data;
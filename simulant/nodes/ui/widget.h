@@ -4,6 +4,7 @@
 #include "../../generic/optional.h"
 #include "../../generic/identifiable.h"
 #include "../../generic/managed.h"
+#include "text_layout.h"
 
 namespace smlt {
 namespace ui {
@@ -168,8 +169,8 @@ public:
     float requested_width() const { return width_; }
     float requested_height() const { return height_; }
 
-    float content_width() const { return content_width_; } // Content area
-    float content_height() const { return content_height_; }
+    float content_width() const { ensure_layout(); return content_width_; } // Content area
+    float content_height() const { ensure_layout(); return content_height_; }
 
     float outer_width() const { return content_width() + (border_width_ * 2); }
     float outer_height() const { return content_height() + (border_width_ * 2); }
@@ -195,6 +196,9 @@ public:
     void ask_owner_for_destruction();
     const AABB& aabb() const;
 
+    /* Widgets aren't in the partitioner, so the bounds are transformed on demand */
+    const AABB transformed_aabb() const override;
+
     const unicode& text() const { return text_; }
 
     // Probably shouldn't use these directly (designed for UIManager)
@@ -205,13 +209,36 @@ public:
     void fingerleave(uint32_t finger_id);
     bool is_pressed_by_finger(uint32_t finger_id);
 
+    /* Changing a widget only flags its layout as dirty. The UIManager lays
+     * out dirty widgets once per frame before rendering, and reading anything
+     * that depends on the layout (sizes, bounds) lays the widget out early. */
+    bool is_layout_dirty() const { return layout_dirty_; }
+
+    /* Lays out the widget if it's dirty, returns true if it was */
+    bool _update_layout();
+
+    /* Incremented each time the mesh is changed, so the UI batcher knows when
+     * to rewrite this widget's part of the batches */
+    uint32_t _geometry_revision() const { return geometry_revision_; }
+
+    MeshPtr _mesh() const { return mesh_; }
+
 private:
     bool initialized_ = false;
+    bool layout_dirty_ = false;
+    uint32_t geometry_revision_ = 0;
+
+    /* The font's atlas revision when the text was last laid out */
+    uint32_t font_revision_ = 0;
+
+    /* The layout of the text currently in the mesh */
+    TextLayoutPtr text_layout_;
+
     UIManager* owner_ = nullptr;
-    ActorPtr actor_ = nullptr;
     MeshPtr mesh_ = nullptr;
     FontPtr font_ = nullptr;
-    MaterialPtr material_ = nullptr;
+
+    void ensure_layout() const;
 
     virtual MeshPtr construct_widget(float requested_width, float requested_height);
 
@@ -0,0 +1,122 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "profiler_panel.h"
+#include "../window.h"
+#include "../stage.h"
+#include "../profiler.h"
+#include "../nodes/ui/ui_manager.h"
+#include "../render_sequence.h"
+#include "../nodes/ui/label.h"
+
+namespace smlt {
+
+static const uint32_t MAX_ZONES_SHOWN = 10;
+static const float UPDATE_INTERVAL = 0.5f;
+
+ProfilerPanel::ProfilerPanel(Window *window):
+    window_(window) {
+
+}
+
+void ProfilerPanel::initialize() {
+    if(initialized_) return;
+
+    stage_ = window_->new_stage();
+
+    ui_camera_ = stage_->new_camera_with_orthographic_projection(0, 640, 0, 480);
+    pipeline_ = window_->render(stage_, ui_camera_).with_priority(smlt::RENDER_PRIORITY_ABSOLUTE_FOREGROUND);
+    pipeline_->deactivate();
+
+    float vheight = 460;
+    const float diff = 32;
+
+    heading_ = stage_->ui->new_widget_as_label("Profiler");
+    heading_->move_to(320, vheight);
+    vheight -= diff;
+
+    for(uint32_t i = 0; i < MAX_ZONES_SHOWN; ++i) {
+        auto label = stage_->ui->new_widget_as_label("");
+        label->move_to(320, vheight);
+        vheight -= diff;
+
+        zones_.push_back(label);
+    }
+
+    window_->signal_frame_started().connect(std::bind(&ProfilerPanel::update, this));
+
+    initialized_ = true;
+}
+
+void ProfilerPanel::update() {
+    if(!is_active()) {
+        return;
+    }
+
+    last_update_ += window_->time_keeper->delta_time();
+    if(last_update_ < UPDATE_INTERVAL) {
+        return;
+    }
+
+    last_update_ = 0.0f;
+
+    if(!profiler::is_enabled()) {
+        heading_->set_text("Profiler (compiled out)");
+        return;
+    }
+
+    auto stats = profiler::last_frame_stats();
+
+    for(uint32_t i = 0; i < zones_.size(); ++i) {
+        if(i < stats.size()) {
+            auto& zone = stats[i];
+            zones_[i]->set_text(
+                _F("{0}: {1}ms ({2})").format(
+                    zone.zone->name,
+                    float(zone.total_ns) / 1000000.0f,
+                    zone.calls
+                )
+            );
+        } else {
+            zones_[i]->set_text("");
+        }
+    }
+}
+
+void ProfilerPanel::do_activate() {
+    initialize();
+
+    was_enabled_ = profiler::is_enabled();
+    profiler::set_enabled(true);
+
+    /* Show something on the first frame */
+    last_update_ = UPDATE_INTERVAL;
+
+    pipeline_->activate();
+    L_DEBUG("Activating profiler panel");
+}
+
+void ProfilerPanel::do_deactivate() {
+    profiler::set_enabled(was_enabled_);
+
+    pipeline_->deactivate();
+    L_DEBUG("Deactivating profiler panel");
+}
+
+}
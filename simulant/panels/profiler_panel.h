@@ -0,0 +1,57 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "panel.h"
+#include "../types.h"
+
+namespace smlt {
+
+class Window;
+
+/* Shows the most expensive profiler zones of the last frame. Recording is
+ * switched on while the panel is visible. */
+class ProfilerPanel : public Panel {
+public:
+    ProfilerPanel(Window* window);
+
+private:
+    Window* window_ = nullptr;
+
+    void do_activate() override;
+    void do_deactivate() override;
+    void initialize();
+    bool initialized_ = false;
+    bool was_enabled_ = false;
+
+    StagePtr stage_;
+    CameraPtr ui_camera_;
+    PipelinePtr pipeline_;
+
+    void update();
+
+    float last_update_ = 0.0f;
+
+    ui::WidgetPtr heading_;
+    std::vector<ui::WidgetPtr> zones_;
+};
+
+}
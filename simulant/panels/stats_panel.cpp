@@ -69,6 +69,10 @@ void StatsPanel::initialize() {
     polygons_rendered_->move_to(320, vheight);
     vheight -= diff;
 
+    draw_calls_ = overlay->ui->new_widget_as_label("Draw Calls: 0");
+    draw_calls_->move_to(320, vheight);
+    vheight -= diff;
+
     window_->signal_frame_started().connect(std::bind(&StatsPanel::update, this));
 
     initialized_ = true;
@@ -108,6 +112,7 @@ void StatsPanel::update() {
         ram_usage_->set_text(_u("RAM: {0} MB").format(mem_usage));
         actors_rendered_->set_text(_u("Renderables Visible: {0}").format(actors_rendered));
         polygons_rendered_->set_text(_u("Polygons Rendered: {0}").format(window_->stats->polygons_rendered()));
+        draw_calls_->set_text(_u("Draw Calls: {0}").format(window_->stats->draw_calls()));
 
         last_update = 0.0f;
         first_update = false;
@@ -50,6 +50,7 @@ private:
     ui::WidgetPtr ram_usage_;
     ui::WidgetPtr actors_rendered_;
     ui::WidgetPtr polygons_rendered_;
+    ui::WidgetPtr draw_calls_;
 };
 
 }
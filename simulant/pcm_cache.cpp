@@ -0,0 +1,224 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+
+#include "pcm_cache.h"
+#include "audio_streamer.h"
+#include "sound.h"
+#include "stats_recorder.h"
+
+namespace smlt {
+
+CachedPCM::CachedPCM(std::weak_ptr<SoundDriver> driver, std::weak_ptr<Sound> sound):
+    driver_(driver),
+    sound_(sound) {
+
+}
+
+CachedPCM::~CachedPCM() {
+    auto driver = driver_.lock();
+    if(driver && !buffers_.empty()) {
+        driver->delete_buffers(buffers_);
+    }
+}
+
+PCMCache::PCMCache(std::shared_ptr<SoundDriver> driver, StatsRecorder* stats):
+    driver_(driver),
+    stats_(stats) {
+
+}
+
+bool PCMCache::is_cacheable(const Sound* sound) const {
+    if(driver_.expired() || !sound->has_decoder()) {
+        return false;
+    }
+
+    const std::size_t bytes = sound->sample_count() * sizeof(int16_t);
+    return bytes && bytes <= std::min(max_sound_bytes_, budget_);
+}
+
+bool PCMCache::contains(const Sound* sound) const {
+    return entries_.count(sound) > 0;
+}
+
+bool PCMCache::is_decoding(const Sound* sound) const {
+    return decoding_.count(sound) > 0;
+}
+
+CachedPCM::ptr PCMCache::fetch(Sound* sound) {
+    auto it = entries_.find(sound);
+    if(it != entries_.end()) {
+        // A new sound could have been allocated where a deleted one was
+        if(it->second.pcm->sound_.lock().get() == sound) {
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+
+            ++hits_;
+            update_stats();
+            return it->second.pcm;
+        }
+
+        erase(it);
+    }
+
+    if(!is_cacheable(sound)) {
+        return CachedPCM::ptr();
+    }
+
+    auto pending = decoding_.find(sound);
+    if(pending != decoding_.end() && pending->second->sound.lock().get() == sound) {
+        // Still being decoded, so stream this one too
+        return CachedPCM::ptr();
+    }
+
+    ++misses_;
+    update_stats();
+
+    start_decode(sound);
+    return CachedPCM::ptr();
+}
+
+void PCMCache::start_decode(Sound* sound) {
+    auto pending = std::make_shared<PendingDecode>();
+    pending->sound = sound->shared_from_this();
+    pending->format = sound->format();
+    pending->sample_rate = sound->sample_rate();
+    pending->chunk_samples = std::max<std::size_t>(sound->buffer_size(), 1);
+
+    decoding_[sound] = pending;
+
+    /* sample_count() is only an estimate, so stop once it's clear the sound
+     * is too big rather than decoding all of it */
+    const std::size_t max_samples = std::min(max_sound_bytes_, budget_) / sizeof(int16_t);
+
+    auto decoder = sound->new_decoder();
+    AudioStreamer::global().add_task([pending, decoder, max_samples]() mutable {
+        auto& samples = pending->samples;
+
+        std::size_t size = 0;
+        while(true) {
+            samples.resize(size + pending->chunk_samples);
+
+            std::size_t read = decoder(&samples[size], pending->chunk_samples);
+            if(!read) {
+                break;
+            }
+
+            size += read;
+            if(size > max_samples) {
+                pending->too_big = true;
+                break;
+            }
+        }
+
+        samples.resize(size);
+        pending->done = true;
+    });
+}
+
+void PCMCache::update() {
+    if(decoding_.empty()) {
+        return;
+    }
+
+    for(auto it = decoding_.begin(); it != decoding_.end();) {
+        auto& pending = *it->second;
+        if(!pending.done) {
+            ++it;
+            continue;
+        }
+
+        auto sound = pending.sound.lock();
+        if(sound && sound.get() == it->first && !pending.too_big && !driver_.expired()) {
+            auto pcm = upload(pending);
+
+            // The budget may have changed while it was decoding
+            if(pcm && pcm->bytes() <= std::min(max_sound_bytes_, budget_)) {
+                evict_to(budget_ - pcm->bytes());
+
+                lru_.push_front(it->first);
+
+                Entry entry;
+                entry.pcm = pcm;
+                entry.lru = lru_.begin();
+                entries_[it->first] = entry;
+
+                used_ += pcm->bytes();
+            }
+        }
+
+        it = decoding_.erase(it);
+    }
+
+    update_stats();
+}
+
+CachedPCM::ptr PCMCache::upload(const PendingDecode& decoded) {
+    auto driver = driver_.lock();
+    auto pcm = std::make_shared<CachedPCM>(driver_, decoded.sound);
+
+    for(std::size_t offset = 0; offset < decoded.samples.size(); offset += decoded.chunk_samples) {
+        const std::size_t size = std::min(decoded.chunk_samples, decoded.samples.size() - offset);
+
+        AudioBufferID buffer = driver->generate_buffers(1).back();
+        pcm->buffers_.push_back(buffer);
+
+        driver->upload_buffer_data(
+            buffer, decoded.format, const_cast<int16_t*>(&decoded.samples[offset]),
+            size * sizeof(int16_t), decoded.sample_rate
+        );
+        pcm->bytes_ += size * sizeof(int16_t);
+    }
+
+    return (pcm->buffers_.empty()) ? CachedPCM::ptr() : pcm;
+}
+
+void PCMCache::erase(std::unordered_map<const Sound*, Entry>::iterator it) {
+    used_ -= it->second.pcm->bytes();
+    lru_.erase(it->second.lru);
+
+    // Sources still playing it keep the buffers alive until they finish
+    entries_.erase(it);
+}
+
+void PCMCache::evict_to(std::size_t bytes) {
+    while(used_ > bytes && !lru_.empty()) {
+        erase(entries_.find(lru_.back()));
+        ++evictions_;
+    }
+}
+
+void PCMCache::set_budget(std::size_t bytes) {
+    budget_ = bytes;
+    evict_to(budget_);
+    update_stats();
+}
+
+void PCMCache::clear() {
+    evict_to(0);
+    update_stats();
+}
+
+void PCMCache::update_stats() {
+    if(stats_) {
+        stats_->set_pcm_cache_stats(hits_, misses_, used_);
+    }
+}
+
+}
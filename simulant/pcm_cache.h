@@ -0,0 +1,146 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "sound_driver.h"
+
+namespace smlt {
+
+class Sound;
+class StatsRecorder;
+
+/* A sound decoded in full into driver buffers. Sources playing it hold a
+ * reference, the buffers are deleted once the last one lets go. */
+class CachedPCM {
+public:
+    typedef std::shared_ptr<CachedPCM> ptr;
+
+    CachedPCM(std::weak_ptr<SoundDriver> driver, std::weak_ptr<Sound> sound);
+    ~CachedPCM();
+
+    CachedPCM(const CachedPCM& rhs) = delete;
+    CachedPCM& operator=(const CachedPCM& rhs) = delete;
+
+    const std::vector<AudioBufferID>& buffers() const { return buffers_; }
+    std::size_t bytes() const { return bytes_; }
+
+private:
+    friend class PCMCache;
+
+    std::weak_ptr<SoundDriver> driver_;
+    std::weak_ptr<Sound> sound_;
+
+    std::vector<AudioBufferID> buffers_;
+    std::size_t bytes_ = 0;
+};
+
+/*
+ * Keeps short sounds decoded so that playing them again doesn't decode or
+ * upload anything, every source just queues the same driver buffers.
+ *
+ * Sounds are only cached if their length is known and no bigger than
+ * max_sound_bytes. The least recently played sounds are evicted to stay
+ * within the budget.
+ *
+ * Nothing is decoded on the calling thread. The first time a sound is
+ * played it streams as usual while the AudioStreamer thread decodes it in
+ * full, and update() uploads it once that's done.
+ */
+class PCMCache {
+public:
+    const static std::size_t DEFAULT_BUDGET = 4 * 1024 * 1024;
+    const static std::size_t DEFAULT_MAX_SOUND_BYTES = 512 * 1024;
+
+    PCMCache(std::shared_ptr<SoundDriver> driver, StatsRecorder* stats=nullptr);
+
+    /* Returns the decoded sound if it's cached. Otherwise returns null, and
+     * the sound should be streamed instead. If it can be cached, it starts
+     * decoding in the background. */
+    CachedPCM::ptr fetch(Sound* sound);
+
+    /* Called once a frame, caches the sounds which have finished decoding */
+    void update();
+
+    bool is_cacheable(const Sound* sound) const;
+    bool contains(const Sound* sound) const;
+    bool is_decoding(const Sound* sound) const;
+
+    void set_budget(std::size_t bytes);
+    std::size_t budget() const { return budget_; }
+
+    void set_max_sound_bytes(std::size_t bytes) { max_sound_bytes_ = bytes; }
+    std::size_t max_sound_bytes() const { return max_sound_bytes_; }
+
+    std::size_t used_bytes() const { return used_; }
+    std::size_t entry_count() const { return entries_.size(); }
+
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+    uint64_t evictions() const { return evictions_; }
+
+    void clear();
+
+private:
+    struct Entry {
+        CachedPCM::ptr pcm;
+        std::list<const Sound*>::iterator lru;
+    };
+
+    /* Filled in by the streaming thread, done is set last */
+    struct PendingDecode {
+        std::weak_ptr<Sound> sound;
+        AudioDataFormat format;
+        uint32_t sample_rate = 0;
+        std::size_t chunk_samples = 0;
+
+        std::vector<int16_t> samples;
+        bool too_big = false;
+        std::atomic<bool> done{false};
+    };
+
+    std::weak_ptr<SoundDriver> driver_;
+    StatsRecorder* stats_ = nullptr;
+
+    std::size_t budget_ = DEFAULT_BUDGET;
+    std::size_t max_sound_bytes_ = DEFAULT_MAX_SOUND_BYTES;
+    std::size_t used_ = 0;
+
+    /* Most recently used at the front */
+    std::list<const Sound*> lru_;
+    std::unordered_map<const Sound*, Entry> entries_;
+    std::unordered_map<const Sound*, std::shared_ptr<PendingDecode>> decoding_;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+
+    void start_decode(Sound* sound);
+    CachedPCM::ptr upload(const PendingDecode& decoded);
+    void erase(std::unordered_map<const Sound*, Entry>::iterator it);
+    void evict_to(std::size_t bytes);
+    void update_stats();
+};
+
+}
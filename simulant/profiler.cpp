@@ -4,80 +4,415 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#ifdef SIMULANT_PROFILING
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#endif
 
 #include "profiler.h"
 
-namespace smlt {
+#ifdef SIMULANT_PROFILE_ALLOCATIONS
 
-RootProfiler* Profiler::root_ = nullptr;
+/* Replacing the global allocation functions is the only way to see every
+ * allocation. This is opt-in because it affects the whole process */
 
-Profiler::Profiler(const std::string& name):
-    name_(name) {
+static std::atomic<uint64_t> allocation_counter(0);
 
-    init_root();
+void* operator new(std::size_t size) {
+    allocation_counter.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = std::malloc(size ? size : 1);
+    if(!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
 
-    root_->stack_.push_back(this);
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
 
-    start_time_ = current_time_in_us();
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
 }
 
-void Profiler::init_root() {
-    if(!Profiler::root_) {
-        Profiler::root_ = new RootProfiler();
-    }
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
 }
 
-uint64_t Profiler::current_time_in_us() const {
+#endif
+
+namespace smlt {
+namespace profiler {
+
+uint64_t _impl::now_in_ns() {
 #ifdef _arch_dreamcast
-    return timer_us_gettime64();
+    return timer_us_gettime64() * 1000;
+#else
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+uint64_t allocation_count() {
+#ifdef SIMULANT_PROFILE_ALLOCATIONS
+    return allocation_counter.load(std::memory_order_relaxed);
 #else
-    auto now = std::chrono::high_resolution_clock::now().time_since_epoch();
-    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+    return 0;
+#endif
+}
+
+static void sort_stats(std::vector<ZoneStats>& stats) {
+    std::sort(stats.begin(), stats.end(), [](const ZoneStats& lhs, const ZoneStats& rhs) {
+        return lhs.total_ns > rhs.total_ns;
+    });
+}
+
+#ifdef SIMULANT_PROFILING
+
+std::atomic<bool> _impl::enabled(false);
+
+/* Must be a power of two */
+static const uint64_t RING_CAPACITY = 1 << 14;
+
+/*
+ * Single-producer/single-consumer ring. Only the owning thread pushes, and
+ * only the collector (with its mutex held) drains, so no locking is needed
+ * on the recording path.
+ */
+class EventRing {
+public:
+    EventRing(uint32_t thread_index):
+        thread_index_(thread_index),
+        events_(RING_CAPACITY) {}
+
+    uint32_t thread_index() const { return thread_index_; }
+
+    bool push(const Event& evt) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_.load(std::memory_order_acquire);
+
+        if(head - tail >= RING_CAPACITY) {
+            return false;
+        }
+
+        events_[head & (RING_CAPACITY - 1)] = evt;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<typename Func>
+    void drain(Func func) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const uint64_t head = head_.load(std::memory_order_acquire);
+
+        for(; tail != head; ++tail) {
+            func(events_[tail & (RING_CAPACITY - 1)]);
+        }
+
+        tail_.store(tail, std::memory_order_release);
+    }
+
+private:
+    uint32_t thread_index_;
+    std::vector<Event> events_;
+
+    std::atomic<uint64_t> head_ = {0};
+    std::atomic<uint64_t> tail_ = {0};
+};
+
+typedef std::unordered_map<const ZoneInfo*, ZoneStats> ZoneTotals;
+
+struct Collector {
+    std::mutex mutex;
+
+    /* Rings are never removed so that events from finished threads
+     * can still be collected */
+    std::vector<std::unique_ptr<EventRing>> rings;
+
+    std::deque<Event> captured;
+    std::size_t capture_limit = 1000000;
+
+    ZoneTotals current_frame;
+    ZoneTotals last_frame;
+    ZoneTotals session;
+
+    uint64_t frame_number = 0;
+    uint64_t last_allocation_count = 0;
+
+    std::atomic<uint64_t> dropped = {0};
+};
+
+static Collector& collector() {
+    static Collector* collector = new Collector();
+    return *collector;
+}
+
+static EventRing* this_thread_ring() {
+    static thread_local EventRing* ring = nullptr;
+
+    if(!ring) {
+        auto& c = collector();
+        std::lock_guard<std::mutex> lock(c.mutex);
+        c.rings.push_back(std::unique_ptr<EventRing>(new EventRing(c.rings.size())));
+        ring = c.rings.back().get();
+    }
+
+    return ring;
+}
+
+static void push_event(Event& evt) {
+    auto ring = this_thread_ring();
+    evt.thread_index = ring->thread_index();
+
+    if(!ring->push(evt)) {
+        collector().dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void _impl::record_zone(const ZoneInfo* zone, uint64_t start_ns, uint64_t end_ns) {
+    Event evt;
+    evt.type = EVENT_TYPE_ZONE;
+    evt.zone = zone;
+    evt.start_ns = start_ns;
+    evt.duration_ns = end_ns - start_ns;
+    push_event(evt);
+}
+
+void set_enabled(bool value) {
+    _impl::enabled.store(value, std::memory_order_relaxed);
+}
+
+void counter(const char* name, int64_t value) {
+    if(!is_enabled()) {
+        return;
+    }
+
+    Event evt;
+    evt.type = EVENT_TYPE_COUNTER;
+    evt.counter_name = name;
+    evt.start_ns = _impl::now_in_ns();
+    evt.counter_value = value;
+    push_event(evt);
+}
+
+static void accumulate(ZoneTotals& totals, const Event& evt) {
+    auto& stats = totals[evt.zone];
+    stats.zone = evt.zone;
+    stats.total_ns += evt.duration_ns;
+    stats.calls++;
+}
+
+void frame_mark() {
+    if(!is_enabled()) {
+        return;
+    }
+
+    auto& c = collector();
+
+#ifdef SIMULANT_PROFILE_ALLOCATIONS
+    auto allocations = allocation_count();
+    counter("allocations", allocations - c.last_allocation_count);
+    c.last_allocation_count = allocations;
 #endif
+
+    /* Must happen before taking the lock, registering a ring locks too */
+    auto ring = this_thread_ring();
+
+    std::lock_guard<std::mutex> lock(c.mutex);
+
+    Event evt;
+    evt.type = EVENT_TYPE_FRAME;
+    evt.thread_index = ring->thread_index();
+    evt.zone = nullptr;
+    evt.start_ns = _impl::now_in_ns();
+    evt.frame_number = c.frame_number++;
+
+    if(!ring->push(evt)) {
+        c.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    for(auto& ring: c.rings) {
+        ring->drain([&c](const Event& evt) {
+            if(evt.type == EVENT_TYPE_ZONE) {
+                accumulate(c.current_frame, evt);
+                accumulate(c.session, evt);
+            }
+
+            c.captured.push_back(evt);
+            if(c.captured.size() > c.capture_limit) {
+                c.captured.pop_front();
+                c.dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    std::swap(c.last_frame, c.current_frame);
+    c.current_frame.clear();
 }
 
-std::string RootProfiler::generate_current_path() {
-    std::string path;
+static std::vector<ZoneStats> to_sorted_vector(const ZoneTotals& totals) {
+    std::vector<ZoneStats> result;
+    result.reserve(totals.size());
+    for(auto& p: totals) {
+        result.push_back(p.second);
+    }
+
+    sort_stats(result);
+    return result;
+}
 
-    uint32_t i = 0;
-    uint32_t c = stack_.size();
+std::vector<ZoneStats> last_frame_stats() {
+    auto& c = collector();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    return to_sorted_vector(c.last_frame);
+}
 
-    for(auto& profiler: stack_) {
-        path += profiler->name();
+std::vector<ZoneStats> session_stats() {
+    auto& c = collector();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    return to_sorted_vector(c.session);
+}
 
-        if(i < c - 1) {
-            path += ".";
+uint64_t dropped_event_count() {
+    return collector().dropped.load(std::memory_order_relaxed);
+}
+
+void set_capture_limit(std::size_t max_events) {
+    auto& c = collector();
+    std::lock_guard<std::mutex> lock(c.mutex);
+    c.capture_limit = max_events;
+    while(c.captured.size() > c.capture_limit) {
+        c.captured.pop_front();
+    }
+}
+
+void clear() {
+    auto& c = collector();
+    std::lock_guard<std::mutex> lock(c.mutex);
+
+    for(auto& ring: c.rings) {
+        ring->drain([](const Event&) {});
+    }
+
+    c.captured.clear();
+    c.current_frame.clear();
+    c.last_frame.clear();
+    c.session.clear();
+    c.dropped.store(0);
+}
+
+static std::string escape_json(const char* str) {
+    std::string result;
+    for(const char* c = str; *c; ++c) {
+        if(*c == '"' || *c == '\\') {
+            result.push_back('\\');
         }
+        result.push_back(*c);
+    }
+    return result;
+}
+
+bool write_chrome_trace(const std::string& filename) {
+    std::ofstream file(filename.c_str());
+    if(!file.good()) {
+        return false;
     }
 
-    return path;
+    auto& c = collector();
+    std::lock_guard<std::mutex> lock(c.mutex);
+
+    const uint64_t epoch = (c.captured.empty()) ? 0 : c.captured.front().start_ns;
+
+    file << std::setiosflags(std::ios::fixed) << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+    auto separator = [&first, &file]() {
+        if(!first) file << ",\n";
+        first = false;
+    };
+
+    for(uint32_t i = 0; i < c.rings.size(); ++i) {
+        separator();
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+             << ",\"args\":{\"name\":\"Thread " << i << "\"}}";
+    }
+
+    for(auto& evt: c.captured) {
+        /* Events from other threads can start slightly before the first captured one */
+        double ts = (evt.start_ns >= epoch) ?
+            double(evt.start_ns - epoch) * 0.001 : -double(epoch - evt.start_ns) * 0.001;
+
+        separator();
+
+        switch(evt.type) {
+            case EVENT_TYPE_ZONE:
+                file << "{\"name\":\"" << escape_json(evt.zone->name) << "\",\"cat\":\"zone\",\"ph\":\"X\""
+                     << ",\"ts\":" << ts << ",\"dur\":" << double(evt.duration_ns) * 0.001
+                     << ",\"pid\":1,\"tid\":" << evt.thread_index
+                     << ",\"args\":{\"file\":\"" << escape_json(evt.zone->file) << "\",\"line\":" << evt.zone->line << "}}";
+            break;
+            case EVENT_TYPE_COUNTER:
+                file << "{\"name\":\"" << escape_json(evt.counter_name) << "\",\"ph\":\"C\""
+                     << ",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << evt.thread_index
+                     << ",\"args\":{\"value\":" << evt.counter_value << "}}";
+            break;
+            case EVENT_TYPE_FRAME:
+                file << "{\"name\":\"frame\",\"ph\":\"i\",\"s\":\"g\""
+                     << ",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << evt.thread_index
+                     << ",\"args\":{\"frame\":" << evt.frame_number << "}}";
+            break;
+        }
+    }
+
+    file << "\n]}\n";
+    return file.good();
 }
 
-void RootProfiler::print_stats() {
+#else
+
+void _impl::record_zone(const ZoneInfo*, uint64_t, uint64_t) {}
+void set_enabled(bool) {}
+void frame_mark() {}
+void counter(const char*, int64_t) {}
+std::vector<ZoneStats> last_frame_stats() { return std::vector<ZoneStats>(); }
+std::vector<ZoneStats> session_stats() { return std::vector<ZoneStats>(); }
+uint64_t dropped_event_count() { return 0; }
+void set_capture_limit(std::size_t) {}
+void clear() {}
+bool write_chrome_trace(const std::string&) { return false; }
+
+#endif
+
+void print_stats() {
     std::cout << std::setiosflags(std::ios::fixed)
               << std::setprecision(3)
               << std::setw(60)
               << std::left
-              << "Path"
+              << "Zone"
               << std::setw(30)
               << std::left
               << "Average"
               << "Total"
               << std::endl;
 
-    for(auto& value: results_) {
-        std::string path = value.first;
-        ProfilerResult result = value.second;
-
-        float ms = float(result.total_us) / 1000;
-        float avg = ms / float(result.total_calls);
+    for(auto& stats: session_stats()) {
+        float ms = float(stats.total_ns) / 1000000.0f;
+        float avg = ms / float(stats.calls);
 
         std::cout << std::setiosflags(std::ios::fixed)
                   << std::setprecision(3)
                   << std::setw(60)
                   << std::left
-                  << path
+                  << stats.zone->name
                   << std::setw(30)
                   << std::left
                   << avg
@@ -87,29 +422,5 @@ void RootProfiler::print_stats() {
     }
 }
 
-void Profiler::checkpoint(const std::string& name) {
-    std::string path = root_->generate_current_path();
-    std::string full_path = path + ":" + name;
-
-    auto now = current_time_in_us();
-    auto elapsed = now - start_time_;
-    start_time_ = now;
-
-    auto it = root_->results_.find(full_path);
-    if(it == root_->results_.end()) {
-        ProfilerResult result;
-        result.total_us = elapsed;
-        result.total_calls = 1;
-        root_->results_[full_path] = result;
-    } else {
-        ProfilerResult& result = (*it).second;
-        result.total_us += elapsed;
-        result.total_calls++;
-    }
 }
-
-Profiler::~Profiler() {
-    root_->stack_.pop_back();
-}
-
 }
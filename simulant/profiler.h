@@ -1,83 +1,181 @@
 #ifndef PROFILER_H
 #define PROFILER_H
 
-/* Really basic heirarchial profiler. Usage:
+/* Low-overhead timeline profiler. Usage:
  *
- * Profiler profiler("main");
+ * void Something::update(float dt) {
+ *     S_PROFILE_SCOPE("Something::update");
  *
- * ... stuff ...
+ *     {
+ *         S_PROFILE_SCOPE("physics");
+ *         ... stuff ...
+ *     }
  *
- * profile.checkpoint("loading");
- *
- *
- * profile.checkpoint("rendering");
- *
- * {
- *     Profiler other("something");
- *
- *     other.checkpoint("something_else");
+ *     S_PROFILE_COUNTER("bodies", body_count);
  * }
  *
- * profile.print_stats();
+ * Zones are recorded into a per-thread lock-free ring buffer and collected
+ * once per frame (S_PROFILE_FRAME_MARK, called by the Window). The collected
+ * timeline can be exported as Chrome trace JSON (chrome://tracing, Perfetto,
+ * or Tracy's import-chrome tool), and per-frame zone totals are shown by the
+ * ProfilerPanel.
  *
- * OUTPUT:
+ * Zone and counter names must be string literals (or otherwise outlive the
+ * profiler) - they are stored by pointer, never copied.
  *
- * main.loading                                 0.15ms     100ms
- * main.rendering                               0.23ms     230ms
- *     something.something_else                 xxxx
+ * Recording is off until profiler::set_enabled(true) is called (the Window
+ * does this if SIMULANT_PROFILE is set in the environment). If the engine is
+ * built without SIMULANT_PROFILING defined, all of the macros compile away
+ * to nothing.
  */
 
+#include <cstdint>
 #include <string>
-#include <map>
-#include <deque>
+#include <vector>
 
+#ifdef SIMULANT_PROFILING
+#include <atomic>
+#endif
 
 namespace smlt {
+namespace profiler {
 
-struct ProfilerResult {
-    unsigned long total_us = 0;
-    unsigned long total_calls = 0;
+struct ZoneInfo {
+    const char* name;
+    const char* file;
+    uint32_t line;
 };
 
-class Profiler;
+enum EventType {
+    EVENT_TYPE_ZONE,
+    EVENT_TYPE_COUNTER,
+    EVENT_TYPE_FRAME
+};
 
-class RootProfiler {
-public:
-    RootProfiler() {}
+struct Event {
+    EventType type;
+    uint32_t thread_index;
+
+    union {
+        const ZoneInfo* zone;
+        const char* counter_name;
+    };
+
+    uint64_t start_ns;
+    union {
+        uint64_t duration_ns;
+        int64_t counter_value;
+        uint64_t frame_number;
+    };
+};
 
-    void print_stats();
-    std::string generate_current_path();
+struct ZoneStats {
+    const ZoneInfo* zone = nullptr;
+    uint64_t total_ns = 0;
+    uint32_t calls = 0;
+};
 
-private:
-    std::deque<Profiler*> stack_;
-    std::map<std::string, ProfilerResult> results_;
+namespace _impl {
+#ifdef SIMULANT_PROFILING
+    extern std::atomic<bool> enabled;
+#endif
+    uint64_t now_in_ns();
+    void record_zone(const ZoneInfo* zone, uint64_t start_ns, uint64_t end_ns);
+}
 
-    friend class Profiler;
-};
+inline bool is_enabled() {
+#ifdef SIMULANT_PROFILING
+    return _impl::enabled.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
 
+void set_enabled(bool value);
 
-class Profiler {
-public:
-    Profiler(const std::string& name);
-    ~Profiler();
+/* Ends the current frame: collects the events from every thread's buffer and
+ * updates the per-frame zone statistics */
+void frame_mark();
+
+void counter(const char* name, int64_t value);
+
+/* Zone totals for the last completed frame, sorted by total time, descending */
+std::vector<ZoneStats> last_frame_stats();
+
+/* Totals across the whole session */
+std::vector<ZoneStats> session_stats();
+
+/* Number of events thrown away because a thread's ring buffer was full or
+ * the capture limit was reached */
+uint64_t dropped_event_count();
+
+/* The maximum number of events kept for export, older events are discarded first */
+void set_capture_limit(std::size_t max_events);
 
-    void checkpoint(const std::string& name);
+/* Discard all captured events and statistics */
+void clear();
 
-    RootProfiler* get_root() const {
-        return root_;
+/* Writes everything captured so far in Chrome's trace event format. Returns false
+ * if the file couldn't be written */
+bool write_chrome_trace(const std::string& filename);
+
+/* Prints the session totals to stdout */
+void print_stats();
+
+/* Number of allocations made since the process started. Only tracked when
+ * built with SIMULANT_PROFILE_ALLOCATIONS, otherwise always zero */
+uint64_t allocation_count();
+
+class ScopedZone {
+public:
+    ScopedZone(const ZoneInfo* zone):
+        zone_(zone) {
+
+        if(is_enabled()) {
+            start_ns_ = _impl::now_in_ns();
+        }
     }
 
-    std::string name() const { return name_; }
-private:
-    static RootProfiler* root_;
+    ~ScopedZone() {
+        if(start_ns_) {
+            _impl::record_zone(zone_, start_ns_, _impl::now_in_ns());
+        }
+    }
 
-    void init_root();
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
 
-    std::string name_;
-    uint64_t start_time_ = 0;
-    uint64_t current_time_in_us() const;
+private:
+    const ZoneInfo* zone_;
+    uint64_t start_ns_ = 0;
 };
 
 }
+}
+
+#define _S_PROFILE_CONCAT2(a, b) a ## b
+#define _S_PROFILE_CONCAT(a, b) _S_PROFILE_CONCAT2(a, b)
+
+#ifdef SIMULANT_PROFILING
+
+#define S_PROFILE_SCOPE(name) \
+    static const smlt::profiler::ZoneInfo _S_PROFILE_CONCAT(_s_zone_info_, __LINE__) = {name, __FILE__, __LINE__}; \
+    smlt::profiler::ScopedZone _S_PROFILE_CONCAT(_s_zone_, __LINE__)(&_S_PROFILE_CONCAT(_s_zone_info_, __LINE__))
+
+#define S_PROFILE_FUNCTION() S_PROFILE_SCOPE(__func__)
+
+#define S_PROFILE_COUNTER(name, value) \
+    do { if(smlt::profiler::is_enabled()) { smlt::profiler::counter((name), (value)); } } while(0)
+
+#define S_PROFILE_FRAME_MARK() smlt::profiler::frame_mark()
+
+#else
+
+#define S_PROFILE_SCOPE(name) do {} while(0)
+#define S_PROFILE_FUNCTION() do {} while(0)
+#define S_PROFILE_COUNTER(name, value) do {} while(0)
+#define S_PROFILE_FRAME_MARK() do {} while(0)
+
+#endif
 
 #endif // PROFILER_H
@@ -27,6 +27,8 @@
 #include "nodes/actor.h"
 #include "nodes/camera.h"
 #include "nodes/light.h"
+#include "managers/sprite_manager.h"
+#include "nodes/ui/ui_manager.h"
 
 #include "meshes/mesh.h"
 #include "window.h"
@@ -203,7 +205,7 @@ uint64_t generate_frame_id() {
 }
 
 void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rendered) {
-    Profiler profiler(__func__);
+    S_PROFILE_SCOPE("RenderSequence::run_pipeline");
 
     uint64_t frame_id = generate_frame_id();
 
@@ -244,17 +246,17 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
     auto stage = window->stage(stage_id);
     auto camera = stage->camera(camera_id);
 
-    profiler.checkpoint("prepare");
-
-    // Trigger a signal to indicate the stage is about to be rendered
-    stage->signal_stage_pre_render()(camera_id, viewport);
-
-    profiler.checkpoint("pre_render");
-
-    // Apply any outstanding writes to the partitioner
-    stage->partitioner->_apply_writes();
+    {
+        S_PROFILE_SCOPE("pre_render");
+        // Trigger a signal to indicate the stage is about to be rendered
+        stage->signal_stage_pre_render()(camera_id, viewport);
+    }
 
-    profiler.checkpoint("apply_writes");
+    {
+        S_PROFILE_SCOPE("apply_writes");
+        // Apply any outstanding writes to the partitioner
+        stage->partitioner->_apply_writes();
+    }
 
     static std::vector<LightID> light_ids;
     static std::vector<StageNode*> nodes_visible;
@@ -263,68 +265,99 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
     light_ids.resize(0);
     nodes_visible.resize(0);
 
-    // Gather the lights and geometry visible to the camera
-    stage->partitioner->lights_and_geometry_visible_from(camera_id, light_ids, nodes_visible);
+    std::vector<LightPtr> lights_visible;
+
+    {
+        S_PROFILE_SCOPE("gather");
 
-    // Get the actual lights from the IDs
-    auto lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
-        light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
-    );
+        // Gather the lights and geometry visible to the camera
+        stage->partitioner->lights_and_geometry_visible_from(camera_id, light_ids, nodes_visible);
 
-    profiler.checkpoint("gather");
+        // Get the actual lights from the IDs
+        lights_visible = map<decltype(light_ids), std::vector<LightPtr>>(
+            light_ids, [&](const LightID& light_id) -> LightPtr { return stage->light(light_id); }
+        );
+    }
 
     uint32_t renderables_rendered = 0;
-    // Mark the visible objects as visible
-    for(auto& node: nodes_visible) {
-        if(!node->is_visible()) {
-            continue;
-        }
 
-        auto renderable_lights = filter(lights_visible, [=](const LightPtr& light) -> bool {
-            // Filter by whether or not the renderable bounds intersects the light bounds
-            if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
-                return true;
-            } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
-                return node->transformed_aabb().intersects_aabb(light->transformed_aabb());
-            } else {
-                return node->transformed_aabb().intersects_sphere(light->absolute_position(), light->range() * 2);
+    {
+        S_PROFILE_SCOPE("lights");
+
+        // Mark the visible objects as visible
+        for(auto& node: nodes_visible) {
+            if(!node->is_visible()) {
+                continue;
             }
-        });
-
-        std::partial_sort(
-            renderable_lights.begin(),
-            renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
-            renderable_lights.end(),
-            [=](LightPtr lhs, LightPtr rhs) {
-                /* FIXME: Sorting by the centre point is problematic. A renderable is made up
-                 * of many polygons, by choosing the light closest to the center you may find that
-                 * that polygons far away from the center aren't affected by lights when they should be.
-                 * This needs more thought, probably. */
-                if(lhs->type() == LIGHT_TYPE_DIRECTIONAL && rhs->type() != LIGHT_TYPE_DIRECTIONAL) {
+
+            auto renderable_lights = filter(lights_visible, [=](const LightPtr& light) -> bool {
+                // Filter by whether or not the renderable bounds intersects the light bounds
+                if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
                     return true;
-                } else if(rhs->type() == LIGHT_TYPE_DIRECTIONAL && lhs->type() != LIGHT_TYPE_DIRECTIONAL) {
-                    return false;
+                } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
+                    return node->transformed_aabb().intersects_aabb(light->transformed_aabb());
+                } else {
+                    return node->transformed_aabb().intersects_sphere(light->absolute_position(), light->range() * 2);
+                }
+            });
+
+            std::partial_sort(
+                renderable_lights.begin(),
+                renderable_lights.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) renderable_lights.size()),
+                renderable_lights.end(),
+                [=](LightPtr lhs, LightPtr rhs) {
+                    /* FIXME: Sorting by the centre point is problematic. A renderable is made up
+                     * of many polygons, by choosing the light closest to the center you may find that
+                     * that polygons far away from the center aren't affected by lights when they should be.
+                     * This needs more thought, probably. */
+                    if(lhs->type() == LIGHT_TYPE_DIRECTIONAL && rhs->type() != LIGHT_TYPE_DIRECTIONAL) {
+                        return true;
+                    } else if(rhs->type() == LIGHT_TYPE_DIRECTIONAL && lhs->type() != LIGHT_TYPE_DIRECTIONAL) {
+                        return false;
+                    }
+
+                    float lhs_dist = (node->centre() - lhs->position()).length_squared();
+                    float rhs_dist = (node->centre() - rhs->position()).length_squared();
+                    return lhs_dist < rhs_dist;
                 }
+            );
 
-                float lhs_dist = (node->centre() - lhs->position()).length_squared();
-                float rhs_dist = (node->centre() - rhs->position()).length_squared();
-                return lhs_dist < rhs_dist;
-            }
-        );
+            for(auto& renderable: node->_get_renderables(camera->frustum())) {
+                if(!renderable->index_element_count()) {
+                    // Don't render things with no indices
+                    continue;
+                }
 
-        for(auto& renderable: node->_get_renderables(camera->frustum())) {
-            if(!renderable->index_element_count()) {
-                // Don't render things with no indices
-                continue;
+                renderable->update_last_visible_frame_id(frame_id);
+                renderable->set_affected_by_lights(renderable_lights);
+                ++renderables_rendered;
             }
-
-            renderable->update_last_visible_frame_id(frame_id);
-            renderable->set_affected_by_lights(renderable_lights);
-            ++renderables_rendered;
         }
     }
 
-    profiler.checkpoint("lights");
+    {
+        S_PROFILE_SCOPE("batches");
+
+        /* Batched sprites and widgets aren't in the partitioner, their
+         * managers cull the batches for this camera */
+        auto batches = stage->sprites->_get_renderables(camera->frustum());
+
+        auto ui_batches = stage->ui->_get_renderables(camera->frustum());
+        batches.insert(batches.end(), ui_batches.begin(), ui_batches.end());
+
+        if(!batches.empty()) {
+            std::vector<LightPtr> batch_lights(
+                lights_visible.begin(),
+                lights_visible.begin() + std::min(MAX_LIGHTS_PER_RENDERABLE, (uint32_t) lights_visible.size())
+            );
+
+            for(auto& renderable: batches) {
+                renderable->update_last_visible_frame_id(frame_id);
+                renderable->set_affected_by_lights(batch_lights);
+                ++renderables_rendered;
+            }
+        }
+    }
 
     window->stats->set_geometry_visible(renderables_rendered);
 
@@ -332,16 +365,19 @@ void RenderSequence::run_pipeline(Pipeline::ptr pipeline_stage, int &actors_rend
 
     auto visitor = renderer_->get_render_queue_visitor(camera);
 
-    // Render the visible objects
-    stage->render_queue->traverse(visitor.get(), frame_id);
-
-    profiler.checkpoint("traversal");
+    {
+        S_PROFILE_SCOPE("traversal");
+        // Render the visible objects
+        stage->render_queue->traverse(visitor.get(), frame_id);
+    }
 
-    // Trigger a signal to indicate the stage has been rendered
-    stage->signal_stage_post_render()(camera_id, viewport);
+    {
+        S_PROFILE_SCOPE("post_render");
+        // Trigger a signal to indicate the stage has been rendered
+        stage->signal_stage_post_render()(camera_id, viewport);
 
-    signal_pipeline_finished_(*pipeline_stage);
-    profiler.checkpoint("post_render");
+        signal_pipeline_finished_(*pipeline_stage);
+    }
 }
 
 }
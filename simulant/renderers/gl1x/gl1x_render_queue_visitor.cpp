@@ -439,6 +439,8 @@ static GLenum convert_arrangement(MeshArrangement arrangement) {
         return GL_TRIANGLE_STRIP;
     case MESH_ARRANGEMENT_TRIANGLE_FAN:
         return GL_TRIANGLE_FAN;
+    case MESH_ARRANGEMENT_POINTS:
+        return GL_POINTS;
     default:
         assert(0 && "Invalid mesh arrangement");
         return GL_TRIANGLES;
@@ -468,6 +470,8 @@ void GL1RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* mater
         return;
     }
 
+    renderer_->note_texture_use(material_pass, renderable, camera_);
+
     const Mat4 model = renderable->final_transformation();
     const Mat4& view = camera_->view_matrix();
     const Mat4& projection = camera_->projection_matrix();
@@ -555,6 +559,7 @@ void GL1RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* mater
     );
 
     renderer_->window->stats->increment_polygons_rendered(renderable->arrangement(), element_count);
+    renderer_->window->stats->increment_draw_calls();
 }
 
 }
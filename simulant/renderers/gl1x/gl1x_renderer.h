@@ -55,6 +55,10 @@ private:
         GLRenderer::on_texture_prepare(texture);
     }
 
+    void on_texture_stream(TexturePtr texture, uint32_t first_level) override {
+        GLRenderer::on_texture_stream(texture, first_level);
+    }
+
     void on_texture_register(TextureID tex_id, TexturePtr texture) override {
         GLRenderer::on_texture_register(tex_id, texture);
     }
@@ -17,6 +17,8 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <cstdlib>
+
 #include "generic_renderer.h"
 
 #include "../../nodes/actor.h"
@@ -334,6 +336,11 @@ void GL2RenderQueueVisitor::visit(Renderable* renderable, MaterialPass* material
 
 void GL2RenderQueueVisitor::start_traversal(const batcher::RenderQueue& queue, uint64_t frame_id, Stage* stage) {
     global_ambient_ = stage->ambient_light();
+
+    // The viewport has already been applied by the render sequence
+    GLint viewport[4];
+    GLCheck(glGetIntegerv, GL_VIEWPORT, viewport);
+    viewport_height_ = float(viewport[3]);
 }
 
 void GL2RenderQueueVisitor::end_traversal(const batcher::RenderQueue &queue, Stage* stage) {
@@ -457,6 +464,11 @@ void GL2RenderQueueVisitor::change_material_pass(const MaterialPass* prev, const
     renderer_->set_stage_uniforms(next, program_, global_ambient_);
     renderer_->set_material_uniforms(next, program_);
 
+    if(next->uniforms->uses_auto(SP_AUTO_VIEWPORT_HEIGHT)) {
+        auto varname = next->uniforms->auto_variable_name(SP_AUTO_VIEWPORT_HEIGHT);
+        program_->set_uniform_float(varname, viewport_height_);
+    }
+
     /* Set any material properties on the gpu program */
     for(auto& p: next->material->properties()) {
         auto& name = p.first;
@@ -605,6 +617,8 @@ void GL2RenderQueueVisitor::do_visit(Renderable* renderable, MaterialPass* mater
         return;
     }
 
+    renderer_->note_texture_use(material_pass, renderable, camera_);
+
     renderer_->set_renderable_uniforms(material_pass, program_, renderable, camera_);
 
     renderable->prepare_buffers(renderer_);
@@ -642,6 +656,8 @@ static GLenum convert_arrangement(MeshArrangement arrangement) {
         return GL_TRIANGLE_STRIP;
     case MESH_ARRANGEMENT_TRIANGLE_FAN:
         return GL_TRIANGLE_FAN;
+    case MESH_ARRANGEMENT_POINTS:
+        return GL_POINTS;
     default:
         assert(0 && "Invalid mesh arrangement");
         return GL_TRIANGLES;
@@ -658,8 +674,13 @@ void GenericRenderer::send_geometry(Renderable *renderable) {
     auto index_type = convert_index_type(renderable->index_type());
     auto arrangement = renderable->arrangement();
 
+    if(arrangement == MESH_ARRANGEMENT_POINTS && !point_sprites_enabled_) {
+        enable_point_sprites();
+    }
+
     GLCheck(glDrawElements, convert_arrangement(arrangement), element_count, index_type, BUFFER_OFFSET(0));
     window->stats->increment_polygons_rendered(arrangement, element_count);
+    window->stats->increment_draw_calls();
 }
 
 void GenericRenderer::init_context() {
@@ -670,6 +691,39 @@ void GenericRenderer::init_context() {
     GLCheck(glEnable, GL_DEPTH_TEST);
     GLCheck(glDepthFunc, GL_LEQUAL);
     GLCheck(glEnable, GL_CULL_FACE);
+
+    point_sprites_enabled_ = false;
+}
+
+void GenericRenderer::enable_point_sprites() {
+    point_sprites_enabled_ = true;
+
+#ifndef __ANDROID__
+    /* Let shaders size points (gl_PointSize) and texture them (gl_PointCoord),
+     * used by the billboarded particle material. GLES2 always does both. */
+    const char* version = (const char*) glGetString(GL_VERSION);
+    int major = (version) ? std::atoi(version) : 0;
+
+    bool core_profile = false;
+    if(major >= 3) {
+        const GLenum CONTEXT_PROFILE_MASK = 0x9126;
+        const GLint CONTEXT_CORE_PROFILE_BIT = 0x1;
+
+        GLint mask = 0;
+        GLCheck(glGetIntegerv, CONTEXT_PROFILE_MASK, &mask);
+        core_profile = (mask & CONTEXT_CORE_PROFILE_BIT) != 0;
+    }
+
+    if(GLAD_GL_VERSION_2_0) {
+        // GL_PROGRAM_POINT_SIZE in core profiles, same value
+        GLCheck(glEnable, GL_VERTEX_PROGRAM_POINT_SIZE);
+    }
+
+    // Always on in core profiles, where enabling it is an error
+    if(GLAD_GL_VERSION_2_0 && !core_profile) {
+        GLCheck(glEnable, GL_POINT_SPRITE);
+    }
+#endif
 }
 
 
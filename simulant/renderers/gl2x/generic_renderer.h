@@ -57,6 +57,7 @@ private:
     GenericRenderer* renderer_;
     CameraPtr camera_;
     Colour global_ambient_;
+    float viewport_height_ = 0.0f;
 
     GPUProgram* program_ = nullptr;
     const MaterialPass* pass_ = nullptr;
@@ -123,12 +124,21 @@ private:
     void set_blending_mode(BlendType type);
     void send_geometry(Renderable* renderable);
 
+    /* Point size and point sprite state is only switched on the first time
+     * points are drawn, so other contexts never see it */
+    bool point_sprites_enabled_ = false;
+    void enable_point_sprites();
+
     friend class GL2RenderQueueVisitor;
 
     void on_texture_prepare(TexturePtr texture) override {
         GLRenderer::on_texture_prepare(texture);
     }
 
+    void on_texture_stream(TexturePtr texture, uint32_t first_level) override {
+        GLRenderer::on_texture_stream(texture, first_level);
+    }
+
     void on_texture_register(TextureID tex_id, TexturePtr texture) override {
         GLRenderer::on_texture_register(tex_id, texture);
     }
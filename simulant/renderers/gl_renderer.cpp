@@ -1,3 +1,6 @@
+#include <cstring>
+#include <algorithm>
+
 #include "gl_renderer.h"
 
 #include "../window.h"
@@ -99,13 +102,7 @@ GLint texture_format_to_internal_format(TextureFormat format) {
 }
 
 void GLRenderer::on_texture_prepare(TexturePtr texture) {
-    auto lock = texture->try_lock();
-    if(!lock) {
-        // Don't update anything unless we can get a lock
-        return;
-    }
-
-    // Do nothing if everything is up to date
+    // The texture is locked by the TextureStreamer, do nothing if everything is up to date
     if(!texture->_data_dirty() && !texture->_params_dirty()) {
         return;
     }
@@ -129,7 +126,71 @@ void GLRenderer::on_texture_prepare(TexturePtr texture) {
         auto internal_format = texture_format_to_internal_format(texture->format());
         auto type = convert_texel_type(texture->texel_type());
 
-        if(format > 0 && type > 0) {
+        auto& regions = texture->_dirty_regions();
+
+        if(format > 0 && type > 0 && !regions.empty() && !texture->is_compressed() && !texture->data().empty()) {
+            /* Only upload the changed regions. GL 1.x and GLES 2 have no
+             * GL_UNPACK_ROW_LENGTH, so each region is copied into a tightly
+             * packed buffer first */
+            const std::size_t bpp = texture->bytes_per_pixel();
+            const std::size_t stride = texture->width() * bpp;
+
+            std::size_t uploaded = 0;
+            std::vector<uint8_t> region_data;
+
+            GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+
+            for(auto& region: regions) {
+                const std::size_t row_size = region.width * bpp;
+                region_data.resize(row_size * region.height);
+
+                for(uint32_t row = 0; row < region.height; ++row) {
+                    std::memcpy(
+                        &region_data[row * row_size],
+                        &texture->data()[((region.y + row) * stride) + (region.x * bpp)],
+                        row_size
+                    );
+                }
+
+                GLCheck(glTexSubImage2D,
+                    GL_TEXTURE_2D, 0,
+                    region.x, region.y, region.width, region.height,
+                    format, type, &region_data[0]
+                );
+
+                uploaded += region_data.size();
+            }
+
+            if(texture->mipmap_count()) {
+                /* The CPU mipmaps were built from the old data. Filters can
+                 * reach past the region, so rebuild and upload every level */
+                texture->_rebuild_mipmaps();
+
+                uint32_t width = texture->width();
+                uint32_t height = texture->height();
+
+                for(uint32_t level = 1; level <= texture->mipmap_count(); ++level) {
+                    width = std::max(width / 2, 1u);
+                    height = std::max(height / 2, 1u);
+
+                    auto& level_data = texture->mipmap_data(level);
+
+                    GLCheck(glTexSubImage2D,
+                        GL_TEXTURE_2D, level,
+                        0, 0, width, height,
+                        format, type, &level_data[0]
+                    );
+
+                    uploaded += level_data.size();
+                }
+            } else if(texture->mipmap_generation() == MIPMAP_GENERATE_COMPLETE) {
+                GLCheck(glGenerateMipmapEXT, GL_TEXTURE_2D);
+            }
+
+            GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+            win_->stats->record_texture_upload(uploaded);
+        } else if(format > 0 && type > 0) {
             if(texture->is_compressed()) {
                 GLCheck(glCompressedTexImage2D,
                     GL_TEXTURE_2D,
@@ -149,16 +210,48 @@ void GLRenderer::on_texture_prepare(TexturePtr texture) {
                 );
             }
 
+            win_->stats->record_texture_upload(texture->data().size());
+
+            const uint32_t mipmap_count = texture->mipmap_count();
+
+            if(mipmap_count) {
+                /* Mipmaps were generated on the CPU, so upload them rather
+                 * than have the driver build them again. The smaller levels
+                 * are rarely a multiple of 4 bytes wide */
+                GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
+
+                uint32_t width = texture->width();
+                uint32_t height = texture->height();
+
+                for(uint32_t level = 1; level <= mipmap_count; ++level) {
+                    width = std::max(width / 2, 1u);
+                    height = std::max(height / 2, 1u);
+
+                    auto& level_data = texture->mipmap_data(level);
+
+                    GLCheck(glTexImage2D,
+                        GL_TEXTURE_2D,
+                        level, internal_format,
+                        width, height, 0,
+                        format,
+                        type, &level_data[0]
+                    );
+
+                    win_->stats->record_texture_upload(level_data.size());
+                }
+
+                GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+                texture->_set_has_mipmaps(true);
+            }
+
             /* Free the data if that's what is wanted */
             if(texture->free_data_mode() == TEXTURE_FREE_DATA_AFTER_UPLOAD) {
-                texture->data().clear();
-
-                // Necessary to actually free the data, which on the Dreamcast
-                // is important!
-                texture->data().shrink_to_fit();
+                // Necessary to actually free the data (and any mipmaps),
+                // which on the Dreamcast is important!
+                texture->free();
             }
 
-            if(texture->mipmap_generation() == MIPMAP_GENERATE_COMPLETE) {
+            if(!mipmap_count && texture->mipmap_generation() == MIPMAP_GENERATE_COMPLETE) {
                 GLCheck(glGenerateMipmapEXT, GL_TEXTURE_2D);
                 texture->_set_has_mipmaps(true);
             }
@@ -172,51 +265,104 @@ void GLRenderer::on_texture_prepare(TexturePtr texture) {
     }
 
     if(texture->_params_dirty()) {
-        auto filter_mode = texture->texture_filter();
-        switch(filter_mode) {
-            case TEXTURE_FILTER_TRILINEAR: {
-                if(!texture->has_mipmaps()) {
-                    // Same as bilinear
-                    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                } else {
-                    // Trilinear
-                    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                }
+        apply_texture_params(texture);
+    }
+
+    if(active != (GLint) target) {
+        GLCheck(glBindTexture, GL_TEXTURE_2D, active);
+    }
+}
 
-            } break;
-            case TEXTURE_FILTER_BILINEAR: {
+void GLRenderer::apply_texture_params(TexturePtr texture) {
+    auto filter_mode = texture->texture_filter();
+    switch(filter_mode) {
+        case TEXTURE_FILTER_TRILINEAR: {
+            if(!texture->has_mipmaps()) {
+                // Same as bilinear
                 GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                 GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            } break;
-            case TEXTURE_FILTER_POINT:
-            default: {
-                GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            } else {
+                // Trilinear
+                GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
             }
+
+        } break;
+        case TEXTURE_FILTER_BILINEAR: {
+            GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        } break;
+        case TEXTURE_FILTER_POINT:
+        default: {
+            GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
         }
+    }
 
-        auto convert_wrap_mode = [](TextureWrap wrap) -> GLenum {
-            switch(wrap) {
-                case TEXTURE_WRAP_CLAMP_TO_EDGE:
-                    return GL_CLAMP_TO_EDGE;
-                break;
-                default:
-                    // FIXME: Implement other modes
-                    return GL_REPEAT;
-            }
-        };
+    auto convert_wrap_mode = [](TextureWrap wrap) -> GLenum {
+        switch(wrap) {
+            case TEXTURE_WRAP_CLAMP_TO_EDGE:
+                return GL_CLAMP_TO_EDGE;
+            break;
+            default:
+                // FIXME: Implement other modes
+                return GL_REPEAT;
+        }
+    };
+
+    auto wrapu = convert_wrap_mode(texture->wrap_u());
+    auto wrapv = convert_wrap_mode(texture->wrap_v());
+
+    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapu);
+    GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapv);
+
+    texture->_set_params_clean();
+}
+
+void GLRenderer::on_texture_stream(TexturePtr texture, uint32_t first_level) {
+    GLint active;
+    GLCheck(glGetIntegerv, GL_TEXTURE_BINDING_2D, &active);
+
+    GLuint target;
+
+    {
+        std::lock_guard<std::mutex> lock(texture_object_mutex_);
+        target = texture_objects_.at(texture->id());
+    }
+
+    GLCheck(glBindTexture, GL_TEXTURE_2D, target);
+
+    auto format = convert_texture_format(texture->format());
+    auto internal_format = texture_format_to_internal_format(texture->format());
+    auto type = convert_texel_type(texture->texel_type());
 
-        auto wrapu = convert_wrap_mode(texture->wrap_u());
-        auto wrapv = convert_wrap_mode(texture->wrap_v());
+    /* GL 1.x and GLES 2 have no GL_TEXTURE_BASE_LEVEL, so the first resident
+     * level is respecified as level 0, along with everything smaller */
+    GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 1);
 
-        GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapu);
-        GLCheck(glTexParameteri, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapv);
+    const uint32_t last_level = texture->mipmap_count();
+    for(uint32_t level = first_level; level <= last_level; ++level) {
+        auto& data = (level == 0) ? texture->data() : texture->mipmap_data(level);
 
-        texture->_set_params_clean();
+        GLCheck(glTexImage2D,
+            GL_TEXTURE_2D,
+            level - first_level, internal_format,
+            std::max(texture->width() >> level, 1u),
+            std::max(texture->height() >> level, 1u), 0,
+            format,
+            type, &data[0]
+        );
+
+        win_->stats->record_texture_upload(data.size());
     }
 
+    GLCheck(glPixelStorei, GL_UNPACK_ALIGNMENT, 4);
+
+    texture->_set_has_mipmaps(first_level < last_level);
+
+    // Switching between mipmapped and not changes the filtering
+    apply_texture_params(texture);
+
     if(active != (GLint) target) {
         GLCheck(glBindTexture, GL_TEXTURE_2D, active);
     }
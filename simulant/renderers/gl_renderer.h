@@ -22,6 +22,7 @@ protected:
     void on_texture_register(TextureID tex_id, TexturePtr texture);
     void on_texture_unregister(TextureID tex_id);
     void on_texture_prepare(TexturePtr texture);
+    void on_texture_stream(TexturePtr texture, uint32_t first_level);
 
     uint32_t convert_texture_format(TextureFormat format);
     uint32_t convert_texel_type(TextureTexelType type);
@@ -30,6 +31,8 @@ protected:
     std::unordered_map<TextureID, uint32_t> texture_objects_;
 
 private:
+    void apply_texture_params(TexturePtr texture);
+
     // Not called window_ to avoid name clashes in subclasses
     Window* win_;
 };
@@ -17,7 +17,12 @@
 //     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
 //
 
+#include <algorithm>
+
 #include "renderer.h"
+#include "../material.h"
+#include "../texture.h"
+#include "../nodes/camera.h"
 
 namespace smlt {
 
@@ -33,6 +38,7 @@ void Renderer::unregister_texture(TextureID texture_id) {
         write_lock<shared_mutex> lock(texture_registry_mutex_);
         texture_registry_.erase(texture_id);
     }
+    texture_streamer_.forget(texture_id);
     on_texture_unregister(texture_id);
 }
 
@@ -42,14 +48,63 @@ bool Renderer::is_texture_registered(TextureID texture_id) const {
 }
 
 void Renderer::prepare_texture(TextureID texture_id) {
-    if(is_texture_registered(texture_id)) {
+    TexturePtr tex;
+
+    {
         read_lock<shared_mutex> lock(texture_registry_mutex_);
-        auto tex = texture_registry_.at(texture_id).lock();
-        if(tex) {
-            on_texture_prepare(tex);
+        auto it = texture_registry_.find(texture_id);
+        if(it == texture_registry_.end()) {
+            return;
         }
+
+        tex = it->second.lock();
+    }
+
+    if(tex) {
+        texture_streamer_.prepare(tex);
     }
 }
 
+void Renderer::begin_frame() {
+    texture_streamer_.begin_frame();
+}
+
+void Renderer::begin_render() {
+    texture_streamer_.apply_evictions();
+}
+
+void Renderer::note_texture_use(const MaterialPass* pass, Renderable* renderable, const Camera* camera) {
+    // Only streamed textures care, which is usually none of them
+    TextureID streamed[MAX_TEXTURE_UNITS];
+    uint32_t count = 0;
+
+    for(uint32_t i = 0; i < pass->texture_unit_count() && count < MAX_TEXTURE_UNITS; ++i) {
+        auto& texture = pass->texture_unit(i).texture();
+        if(texture && texture->streaming_enabled()) {
+            streamed[count++] = texture->id();
+        }
+    }
+
+    if(!count) {
+        return;
+    }
+
+    /* A rough projected size: the largest side of the bounds, scaled by the
+     * projection and assuming the viewport covers the window */
+    auto aabb = renderable->transformed_aabb();
+    auto& projection = camera->projection_matrix();
+
+    float size = aabb.max_dimension() * projection[5] * 0.5f * float(window_->height());
+
+    if(projection[15] == 0.0f) {
+        // Perspective, so shrinks with distance
+        float distance = (aabb.centre() - camera->absolute_position()).length();
+        size /= std::max(distance, 0.0001f);
+    }
+
+    texture_streamer_.note_use(streamed, count, size);
+}
+
+
 
 }
@@ -29,11 +29,13 @@
 
 #include "batching/renderable.h"
 #include "batching/render_queue.h"
+#include "texture_streamer.h"
 
 namespace smlt {
 
 class SubActor;
 class HardwareBufferManager;
+class MaterialPass;
 
 class Renderer:
     public batcher::RenderGroupFactory {
@@ -42,7 +44,8 @@ public:
     typedef std::shared_ptr<Renderer> ptr;
 
     Renderer(Window* window):
-        window_(window) {}
+        window_(window),
+        texture_streamer_(this) {}
 
     virtual std::shared_ptr<batcher::RenderQueueVisitor> get_render_queue_visitor(CameraPtr camera) = 0;
 
@@ -80,10 +83,31 @@ public:
      */
     bool is_texture_registered(TextureID texture_id) const;
 
+    /* Uploads the texture if it has changed, within the per-frame upload
+     * budget (see TextureStreamer) */
     void prepare_texture(TextureID texture_id);
 
+    /* Called by the Window at the start of each frame, before any textures
+     * are prepared. This may run without a context. */
+    void begin_frame();
+
+    /* Called by the Window with the context current, before the render
+     * sequence runs */
+    void begin_render();
+
+    /*
+     * Called by the render queue visitors for each renderable drawn, so that
+     * streamed textures are loaded at the resolution they're seen at
+     */
+    void note_texture_use(const MaterialPass* pass, Renderable* renderable, const Camera* camera);
+
+    TextureStreamer* texture_streamer() { return &texture_streamer_; }
+
 private:    
+    friend class TextureStreamer;
+
     Window* window_ = nullptr;
+    TextureStreamer texture_streamer_;
 
     /*
      * Called when a texture is created. This should do whatever is necessary to
@@ -112,11 +136,21 @@ private:
      * - Updating texture filters and wrap modes if necessary
      * - Generating or deleting mipmaps if the mipmap generation changed
      *
-     * Guaranteed to be called from the main (render) thread, although must obviously
-     * be aware of register/unregister
+     * The texture is locked by the caller. Guaranteed to be called from the main
+     * (render) thread, although must obviously be aware of register/unregister
      */
     virtual void on_texture_prepare(TexturePtr texture) {}
 
+    /*
+     * Given a streamed Texture, this should replace whatever was uploaded
+     * with mipmap level `first_level` and the smaller levels below it. The
+     * texture is locked, and the levels are available from Texture::data()
+     * and Texture::mipmap_data(). The data must not be freed.
+     *
+     * Guaranteed to be called from the main (render) thread
+     */
+    virtual void on_texture_stream(TexturePtr texture, uint32_t first_level) {}
+
     mutable shared_mutex texture_registry_mutex_;
     std::unordered_map<TextureID, std::weak_ptr<Texture>> texture_registry_;
 };
@@ -0,0 +1,348 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <vector>
+#include <algorithm>
+
+#include "texture_streamer.h"
+#include "renderer.h"
+#include "../texture.h"
+
+namespace smlt {
+
+static std::size_t level_bytes(const Texture* texture, uint32_t level) {
+    return (level == 0) ? texture->data().size() : texture->mipmap_data(level).size();
+}
+
+/* The bytes uploaded to make `level` the finest resident level */
+static std::size_t chain_bytes(const Texture* texture, uint32_t level) {
+    std::size_t total = 0;
+    for(uint32_t i = level; i <= texture->mipmap_count(); ++i) {
+        total += level_bytes(texture, i);
+    }
+    return total;
+}
+
+static std::size_t upload_bytes(const Texture* texture) {
+    auto& regions = texture->_dirty_regions();
+    if(regions.empty() || texture->is_compressed() || texture->data().empty()) {
+        return texture->memory_usage();
+    }
+
+    std::size_t total = 0;
+    for(auto& region: regions) {
+        total += region.width * region.height * texture->bytes_per_pixel();
+    }
+
+    // CPU mipmaps are rebuilt and uploaded in full
+    for(uint32_t level = 1; level <= texture->mipmap_count(); ++level) {
+        total += texture->mipmap_data(level).size();
+    }
+    return total;
+}
+
+static bool can_stream(const Texture* texture) {
+    return (
+        texture->streaming_enabled() &&
+        !texture->is_compressed() &&
+        texture->texel_type() == TEXTURE_TEXEL_TYPE_UNSIGNED_BYTE &&
+        !texture->data().empty()
+    );
+}
+
+TextureStreamer::TextureStreamer(Renderer* renderer):
+    renderer_(renderer) {
+
+}
+
+void TextureStreamer::begin_frame() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    ++frame_;
+    uploaded_ = 0;
+    deferred_ = 0;
+
+    for(auto& p: entries_) {
+        auto& entry = p.second;
+        entry.wanted_level = entry.requested_level;
+        entry.requested_level = NOT_RESIDENT;
+    }
+
+    choose_evictions();
+}
+
+void TextureStreamer::apply_evictions() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto& texture_id: evictions_) {
+        auto it = entries_.find(texture_id);
+        if(it == entries_.end()) {
+            continue;
+        }
+
+        auto& entry = it->second;
+        const uint32_t level = entry.evict_level;
+        entry.evict_level = NOT_RESIDENT;
+
+        auto texture = entry.texture.lock();
+        if(!texture || level == NOT_RESIDENT || entry.resident_level == NOT_RESIDENT || level <= entry.resident_level) {
+            continue;
+        }
+
+        auto texture_lock = texture->try_lock();
+        if(!texture_lock || texture->_data_dirty()) {
+            // Will be uploaded from scratch anyway
+            continue;
+        }
+
+        stream(entry, texture, level, true);
+    }
+
+    evictions_.clear();
+}
+
+bool TextureStreamer::spend(std::size_t bytes) {
+    if(uploaded_ && uploaded_ + bytes > upload_budget_) {
+        ++deferred_;
+        return false;
+    }
+
+    uploaded_ += bytes;
+    return true;
+}
+
+void TextureStreamer::prepare(TexturePtr texture) {
+    auto texture_lock = texture->try_lock();
+    if(!texture_lock) {
+        // Something is changing the data, try again next frame
+        return;
+    }
+
+    if(can_stream(texture.get())) {
+        prepare_streamed(texture);
+    } else if(texture->_data_dirty() && texture->auto_upload()) {
+        // In case streaming was switched off
+        forget(texture->id());
+
+        if(!spend(upload_bytes(texture.get()))) {
+            return;
+        }
+
+        renderer_->on_texture_prepare(texture);
+        return;
+    }
+
+    if(texture->_params_dirty() && !(texture->_data_dirty() && texture->auto_upload())) {
+        // Nothing to upload, so this only updates the filtering and wrapping
+        renderer_->on_texture_prepare(texture);
+    }
+}
+
+void TextureStreamer::prepare_streamed(TexturePtr texture) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& entry = entries_[texture->id()];
+
+    if(texture->_data_dirty() && texture->auto_upload()) {
+        // New data, start again from the coarsest levels
+        if(!texture->mipmap_count()) {
+            texture->generate_mipmaps();
+        } else if(!texture->_dirty_regions().empty()) {
+            // Only part of the data changed, so the levels are out of date
+            texture->_rebuild_mipmaps();
+        }
+
+        entry.texture = texture;
+        entry.width = texture->width();
+        entry.height = texture->height();
+        entry.level_count = texture->mipmap_count() + 1;
+
+        uint32_t level = 0;
+        while(level + 1 < entry.level_count && std::max(entry.width >> level, entry.height >> level) > initial_size_) {
+            ++level;
+        }
+
+        stream(entry, texture, level);
+        return;
+    }
+
+    if(entry.resident_level == NOT_RESIDENT || entry.resident_level == 0) {
+        return;
+    }
+
+    if(entry.wanted_level < entry.resident_level) {
+        // One level per frame, each costs about a third more than the last
+        const uint32_t level = entry.resident_level - 1;
+        const std::size_t bytes = chain_bytes(texture.get(), level);
+
+        if(resident_bytes_ - entry.resident_bytes + bytes > memory_cap_) {
+            // Would only be evicted again
+            return;
+        }
+
+        stream(entry, texture, level);
+    }
+}
+
+bool TextureStreamer::stream(Entry& entry, TexturePtr texture, uint32_t level, bool forced) {
+    const std::size_t bytes = chain_bytes(texture.get(), level);
+
+    if(forced) {
+        uploaded_ += bytes;
+    } else if(!spend(bytes)) {
+        return false;
+    }
+
+    renderer_->on_texture_stream(texture, level);
+    texture->_set_data_clean();
+
+    resident_bytes_ = resident_bytes_ - entry.resident_bytes + bytes;
+    entry.resident_bytes = bytes;
+    entry.resident_level = level;
+    return true;
+}
+
+void TextureStreamer::choose_evictions() {
+    for(auto& texture_id: evictions_) {
+        auto it = entries_.find(texture_id);
+        if(it != entries_.end()) {
+            it->second.evict_level = NOT_RESIDENT;
+        }
+    }
+    evictions_.clear();
+
+    if(resident_bytes_ <= memory_cap_) {
+        return;
+    }
+
+    std::vector<Entry*> candidates;
+    for(auto& p: entries_) {
+        auto& entry = p.second;
+        if(entry.resident_level != NOT_RESIDENT && entry.resident_level + 1 < entry.level_count) {
+            candidates.push_back(&entry);
+        }
+    }
+
+    // Levels finer than what was drawn go first, then the least recently drawn
+    std::sort(candidates.begin(), candidates.end(), [](const Entry* lhs, const Entry* rhs) {
+        const bool lhs_excess = lhs->resident_level < lhs->wanted_level;
+        const bool rhs_excess = rhs->resident_level < rhs->wanted_level;
+
+        if(lhs_excess != rhs_excess) {
+            return lhs_excess;
+        }
+
+        if(lhs->last_used_frame != rhs->last_used_frame) {
+            return lhs->last_used_frame < rhs->last_used_frame;
+        }
+
+        return lhs->resident_bytes > rhs->resident_bytes;
+    });
+
+    // What will be resident once the evictions are applied
+    std::size_t projected = resident_bytes_;
+
+    for(auto entry: candidates) {
+        auto texture = entry->texture.lock();
+        if(!texture) {
+            continue;
+        }
+
+        auto texture_lock = texture->try_lock();
+        if(!texture_lock || texture->_data_dirty()) {
+            continue;
+        }
+
+        // Drop straight to the finest level that fits, rather than uploading each one on the way
+        const std::size_t others = projected - entry->resident_bytes;
+
+        uint32_t level = entry->resident_level + 1;
+        while(level + 1 < entry->level_count && others + chain_bytes(texture.get(), level) > memory_cap_) {
+            ++level;
+        }
+
+        entry->evict_level = level;
+        evictions_.push_back(texture->id());
+
+        projected = others + chain_bytes(texture.get(), level);
+        if(projected <= memory_cap_) {
+            break;
+        }
+    }
+}
+
+uint32_t TextureStreamer::level_for_size(const Entry& entry, float screen_size) const {
+    // The coarsest level which is still at least as big as it is on screen
+    uint32_t level = 0;
+    while(level + 1 < entry.level_count && float(std::max(entry.width >> (level + 1), entry.height >> (level + 1))) >= screen_size) {
+        ++level;
+    }
+    return level;
+}
+
+void TextureStreamer::note_use(Entry& entry, float screen_size) {
+    entry.requested_level = std::min(entry.requested_level, level_for_size(entry, screen_size));
+    entry.last_used_frame = frame_;
+}
+
+void TextureStreamer::note_use(TextureID texture_id, float screen_size) {
+    note_use(&texture_id, 1, screen_size);
+}
+
+void TextureStreamer::note_use(const TextureID* texture_ids, uint32_t count, float screen_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(uint32_t i = 0; i < count; ++i) {
+        auto it = entries_.find(texture_ids[i]);
+        if(it != entries_.end()) {
+            note_use(it->second, screen_size);
+        }
+    }
+}
+
+void TextureStreamer::forget(TextureID texture_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(texture_id);
+    if(it != entries_.end()) {
+        resident_bytes_ -= it->second.resident_bytes;
+        entries_.erase(it);
+    }
+}
+
+std::size_t TextureStreamer::resident_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return resident_bytes_;
+}
+
+uint32_t TextureStreamer::resident_level(TextureID texture_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(texture_id);
+    return (it == entries_.end()) ? NOT_RESIDENT : it->second.resident_level;
+}
+
+uint32_t TextureStreamer::wanted_level(TextureID texture_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = entries_.find(texture_id);
+    return (it == entries_.end()) ? NOT_RESIDENT : it->second.wanted_level;
+}
+
+}
@@ -0,0 +1,159 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "../types.h"
+
+namespace smlt {
+
+class Renderer;
+
+/*
+ * Decides which texture data the renderer uploads each frame.
+ *
+ * Uploads are limited to a byte budget per frame, textures which don't fit
+ * stay dirty and are uploaded on a later frame. The first upload of a frame
+ * is always allowed so that a texture bigger than the budget still arrives.
+ *
+ * Textures with streaming enabled (Texture::set_streaming_enabled) are
+ * uploaded mip by mip instead. Only the levels no bigger than initial_size
+ * are uploaded at first. After that, one finer level is added per frame
+ * until the texture matches the size it was drawn at on the previous frame
+ * (see Renderer::note_texture_use). When the resident levels of streamed
+ * textures go over the memory cap, the least recently drawn are dropped back
+ * to coarser levels. Which textures to drop is decided in begin_frame, but
+ * they're only uploaded again in apply_evictions, once the renderer has a
+ * context.
+ *
+ * Renderers upload streamed textures in on_texture_stream, with the first
+ * resident level as level 0. Mipmap levels are counted from the full size
+ * image, so a resident level of 2 means a quarter of the width and height.
+ *
+ * None of this touches the GPU directly, so it can be driven with any
+ * Renderer.
+ */
+class TextureStreamer {
+public:
+    const static std::size_t DEFAULT_UPLOAD_BUDGET = 2 * 1024 * 1024;
+    const static std::size_t DEFAULT_MEMORY_CAP = 64 * 1024 * 1024;
+    const static uint32_t DEFAULT_INITIAL_SIZE = 64;
+
+    /* The resident level of a texture which hasn't been uploaded */
+    const static uint32_t NOT_RESIDENT = std::numeric_limits<uint32_t>::max();
+
+    TextureStreamer(Renderer* renderer);
+
+    /* Starts a new frame: resets the upload budget, takes the sizes textures
+     * were drawn at last frame, and picks levels to evict if over the memory
+     * cap. Doesn't upload anything, so doesn't need a context. */
+    void begin_frame();
+
+    /* Uploads the coarser levels picked by begin_frame. Must be called with
+     * the context current, before any textures are prepared. */
+    void apply_evictions();
+
+    /* Uploads whatever the texture needs, if it fits in this frame's budget */
+    void prepare(TexturePtr texture);
+
+    /* Records that the texture was drawn `screen_size` pixels across */
+    void note_use(TextureID texture_id, float screen_size);
+
+    /* The same for several textures drawn together, taking the lock once */
+    void note_use(const TextureID* texture_ids, uint32_t count, float screen_size);
+
+    /* Forgets about a texture which has been unregistered */
+    void forget(TextureID texture_id);
+
+    void set_upload_budget(std::size_t bytes) { upload_budget_ = bytes; }
+    std::size_t upload_budget() const { return upload_budget_; }
+
+    void set_memory_cap(std::size_t bytes) { memory_cap_ = bytes; }
+    std::size_t memory_cap() const { return memory_cap_; }
+
+    void set_initial_size(uint32_t pixels) { initial_size_ = pixels; }
+    uint32_t initial_size() const { return initial_size_; }
+
+    /* Bytes uploaded since begin_frame */
+    std::size_t uploaded_bytes() const { return uploaded_; }
+
+    /* Uploads that were put off since begin_frame for lack of budget */
+    uint32_t deferred_count() const { return deferred_; }
+
+    /* Bytes held by the resident levels of streamed textures */
+    std::size_t resident_bytes() const;
+
+    /* The finest level of a streamed texture that has been uploaded */
+    uint32_t resident_level(TextureID texture_id) const;
+
+    /* The level a streamed texture is working towards */
+    uint32_t wanted_level(TextureID texture_id) const;
+
+private:
+    struct Entry {
+        std::weak_ptr<Texture> texture;
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t level_count = 0;
+
+        uint32_t resident_level = NOT_RESIDENT;
+        std::size_t resident_bytes = 0;
+
+        /* From the last frame, and being gathered for this one */
+        uint32_t wanted_level = NOT_RESIDENT;
+        uint32_t requested_level = NOT_RESIDENT;
+
+        uint64_t last_used_frame = 0;
+
+        /* Picked by begin_frame, uploaded by apply_evictions */
+        uint32_t evict_level = NOT_RESIDENT;
+    };
+
+    Renderer* renderer_ = nullptr;
+
+    std::size_t upload_budget_ = DEFAULT_UPLOAD_BUDGET;
+    std::size_t memory_cap_ = DEFAULT_MEMORY_CAP;
+    uint32_t initial_size_ = DEFAULT_INITIAL_SIZE;
+
+    std::size_t uploaded_ = 0;
+    uint32_t deferred_ = 0;
+    uint64_t frame_ = 0;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<TextureID, Entry> entries_;
+    std::size_t resident_bytes_ = 0;
+
+    std::vector<TextureID> evictions_;
+
+    bool spend(std::size_t bytes);
+    void prepare_streamed(TexturePtr texture);
+    bool stream(Entry& entry, TexturePtr texture, uint32_t level, bool forced=false);
+    void choose_evictions();
+    void note_use(Entry& entry, float screen_size);
+
+    uint32_t level_for_size(const Entry& entry, float screen_size) const;
+};
+
+}
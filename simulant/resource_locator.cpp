@@ -174,6 +174,22 @@ std::shared_ptr<std::stringstream> ResourceLocator::read_file(const unicode& fil
 #endif
 }
 
+FileView::ptr ResourceLocator::map_file(const unicode& filename) {
+#ifdef __ANDROID__
+    return FileView::from_stream(*read_file(filename));
+#else
+    unicode path = locate_file(filename);
+
+    std::string ext = filename.encode().substr(filename.encode().find_last_of(".") + 1);
+
+    try {
+        return FileView::open(path.encode(), is_text(ext));
+    } catch(std::runtime_error&) {
+        throw ResourceMissingError("Unable to load file: " + filename.encode());
+    }
+#endif
+}
+
 std::vector<std::string> ResourceLocator::read_file_lines(const unicode &filename) {
     unicode path = locate_file(filename);
     std::ifstream file_in(path.encode().c_str(),std::ios::in);
@@ -25,6 +25,7 @@
 
 #include "generic/managed.h"
 #include "utils/unicode.h"
+#include "utils/file_view.h"
 
 namespace smlt {
 class Window;
@@ -47,6 +48,10 @@ public:
     unicode locate_file(const unicode& filename) const;
     std::shared_ptr<std::istream> open_file(const unicode& filename);
     std::shared_ptr<std::stringstream> read_file(const unicode& filename);
+
+    /* Returns the whole file as a read-only view. This avoids copying where
+     * possible (large files are memory mapped) */
+    FileView::ptr map_file(const unicode& filename);
     std::vector<std::string> read_file_lines(const unicode& filename);
 
     void add_search_path(const unicode& path);
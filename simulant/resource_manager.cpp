@@ -98,18 +98,43 @@ void ResourceManager::update(float dt) {
     });
 }
 
-void ResourceManager::run_garbage_collection() {
+uint32_t ResourceManager::run_garbage_collection() {
+    auto deadline = gc_clock::now() + std::chrono::microseconds(gc_time_budget_us_);
+    return collect_garbage(deadline);
+}
+
+uint32_t ResourceManager::collect_garbage(gc_clock::time_point deadline) {
+    uint32_t collected = 0;
+
     for(auto child: children_) {
-        child->run_garbage_collection();
+        collected += child->collect_garbage(deadline);
     }
 
     //Garbage collect all the things
-    MeshManager::garbage_collect();
-    MaterialManager::garbage_collect();
-    TextureManager::garbage_collect();
-    SoundManager::garbage_collect();
+    collected += MeshManager::garbage_collect(deadline);
+    collected += MaterialManager::garbage_collect(deadline);
+    collected += TextureManager::garbage_collect(deadline);
+    collected += SoundManager::garbage_collect(deadline);
+
+    collected += font_manager_->garbage_collect(deadline);
+
+    return collected;
+}
+
+GarbageCollectionStats ResourceManager::garbage_collection_stats() const {
+    GarbageCollectionStats stats;
+
+    for(auto child: children_) {
+        stats += child->garbage_collection_stats();
+    }
+
+    stats += MeshManager::garbage_collection_stats();
+    stats += MaterialManager::garbage_collection_stats();
+    stats += TextureManager::garbage_collection_stats();
+    stats += SoundManager::garbage_collection_stats();
+    stats += font_manager_->garbage_collection_stats();
 
-    font_manager_->garbage_collect();
+    return stats;
 }
 
 MeshPtr ResourceManager::mesh(MeshID m) {
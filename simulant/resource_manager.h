@@ -206,9 +206,26 @@ public:
         return ret;
     }
 
-    void run_garbage_collection();
+    /* Runs an incremental collection of this manager and its children,
+     * stopping once the time budget is used up. Returns the number of
+     * objects collected */
+    uint32_t run_garbage_collection();
+
+    void set_garbage_collection_time_budget(uint32_t microseconds) {
+        gc_time_budget_us_ = microseconds;
+    }
+
+    uint32_t garbage_collection_time_budget() const {
+        return gc_time_budget_us_;
+    }
+
+    /* Totals for this manager and its children */
+    GarbageCollectionStats garbage_collection_stats() const;
 
 private:
+    uint32_t collect_garbage(gc_clock::time_point deadline);
+    uint32_t gc_time_budget_us_ = 2000;
+
     ResourceManager* parent_ = nullptr;
 
     MaterialID default_material_id_;
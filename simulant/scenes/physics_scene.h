@@ -26,13 +26,22 @@ protected:
 private:
     void pre_load() override {
         physics_.reset(new smlt::behaviours::RigidBodySimulation(this->window->time_keeper));
+
+        // In deferred and threaded modes the step runs alongside rendering
+        late_update_connection_ = this->window->signal_late_update().connect([this](float) {
+            if(physics_) {
+                physics_->begin_queued_step();
+            }
+        });
     }
 
     void post_unload() override {
+        late_update_connection_.disconnect();
         physics_.reset();
     }
 
     std::shared_ptr<smlt::behaviours::RigidBodySimulation> physics_;
+    sig::connection late_update_connection_;
 };
 
 }
@@ -1,150 +1,430 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
 
 #include "shadows.h"
 #include "nodes/light.h"
 #include "meshes/mesh.h"
+#include "meshes/submesh.h"
 #include "meshes/adjacency_info.h"
+#include "generic/threading/thread_pool.h"
 
 namespace smlt {
 
-MeshSilhouette::MeshSilhouette(MeshPtr mesh, const Mat4& mesh_transformation, const LightPtr light):
-    mesh_(mesh),
-    light_direction_or_position_(
-        (light->type() == LIGHT_TYPE_DIRECTIONAL) ? light->direction() : light->absolute_position()
-    ),
-    light_type_(light->type()) {
-
-    mesh_transformation.extract_rotation_and_translation(inverse_mesh_rotation_, inverse_mesh_position_);
-    inverse_mesh_rotation_.inverse();
-    inverse_mesh_position_ = -inverse_mesh_position_;
-
-    // Directional lights are always in range
-    auto within_range = true;
-
-    if(light->type() == LIGHT_TYPE_POINT) {
-        // If it's a point light, we see if the meshes aabb intersects the
-        // radius of the light
-        // FIXME: Do we need to rotate the light position based on the mesh rotation?
-        //        the AABB won't be the same if the mesh is rotated, so probably the light
-        //        position should be rotated into the mesh identity first...
-        within_range = mesh->aabb().intersects_sphere(
-            light_direction_or_position_ + inverse_mesh_position_,
-            light->range() * 2.0 // Range is radius, intersects_sphere takes diameter
-        );
-    } else if(light->type() == LIGHT_TYPE_SPOT_LIGHT) {
-        // FIXME: need to check spotlight cone for AABB intersection
-        assert(0 && "Not Implemented");
-    }
+const std::size_t SilhouetteEngine::DEFAULT_VOLUMES_PER_CASTER;
 
-    if(within_range) {
-        recalculate_silhouette();
+Vec4 light_in_local_space(const LightPtr light, const Mat4& transformation) {
+    const Mat4 inverse = transformation.inversed();
+
+    if(light->type() == LIGHT_TYPE_DIRECTIONAL) {
+        // The light's direction is from the light, we want the direction to it
+        auto to_light = (-light->direction()).rotated_by(inverse);
+        return Vec4(to_light.normalized(), 0.0f);
     }
-}
 
-const std::vector<SilhouetteEdge> &MeshSilhouette::edge_list() {
-    return edge_list_;
+    return Vec4(light->absolute_position().transformed_by(inverse), 1.0f);
 }
 
-void MeshSilhouette::recalculate_silhouette() {
-    /*
-     * For directional lights we just need to make sure that
-     * we rotate the direction by the inverse of the mesh rotation
-     * then calculate the silhouette from there
-     *
-     * For point lights, we can transform the position of the light by the inverse(?)
-     * of the mesh transformation.
-     */
-
-    edge_list_.clear();
-
-    if(light_type_ == LIGHT_TYPE_DIRECTIONAL) {
-        calculate_directional_silhouette();
-    } else if(light_type_ == LIGHT_TYPE_POINT) {
-        calculate_point_silhouette();
-    } else if(light_type_ == LIGHT_TYPE_SPOT_LIGHT) {
-        calculate_spot_silhouette();
+/*
+ * Writes 1 to out for each plane facing the light, which is when
+ * (normal . light.xyz) - (d * light.w) > threshold. For a directional light
+ * that's the angle between the normal and the light direction, for a point
+ * light it's the distance of the light in front of the plane.
+ */
+static void facing_light(const ShadowCaster::Planes& planes, const Vec4& light, float threshold, uint8_t* out) {
+    const std::size_t count = planes.size();
+    const float* x = planes.x.data();
+    const float* y = planes.y.data();
+    const float* z = planes.z.data();
+    const float* w = planes.w.data();
+
+    std::size_t i = 0;
+
+#ifdef __SSE__
+    const __m128 lx = _mm_set1_ps(light.x);
+    const __m128 ly = _mm_set1_ps(light.y);
+    const __m128 lz = _mm_set1_ps(light.z);
+    const __m128 lw = _mm_set1_ps(light.w);
+    const __m128 vthreshold = _mm_set1_ps(threshold);
+
+    for(; i + 4 <= count; i += 4) {
+        __m128 d = _mm_mul_ps(_mm_loadu_ps(x + i), lx);
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(y + i), ly));
+        d = _mm_add_ps(d, _mm_mul_ps(_mm_loadu_ps(z + i), lz));
+        d = _mm_sub_ps(d, _mm_mul_ps(_mm_loadu_ps(w + i), lw));
+
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(d, vthreshold));
+        out[i] = mask & 1;
+        out[i + 1] = (mask >> 1) & 1;
+        out[i + 2] = (mask >> 2) & 1;
+        out[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+
+    for(; i < count; ++i) {
+        float d = (x[i] * light.x) + (y[i] * light.y) + (z[i] * light.z) - (w[i] * light.w);
+        out[i] = (d > threshold) ? 1 : 0;
     }
 }
 
-void MeshSilhouette::calculate_directional_silhouette() {
-    auto light_direction = light_direction_or_position_;
-    light_direction = light_direction.rotated_by(inverse_mesh_rotation_);
-    light_direction = -light_direction; // Reverse to be direction to, rather than from
+ShadowCaster::ShadowCaster(Mesh* mesh) {
+    if(!mesh->has_adjacency_info()) {
+        mesh->generate_adjacency_info();
+    }
+
+    AdjacencyInfo* adj = mesh->adjacency_info.get();
+    VertexData* vertices = mesh->vertex_data.get();
 
-    AdjacencyInfo* adj = mesh_->adjacency_info.get();
-    VertexData* vertices = mesh_->vertex_data.get();
+    adjacency_revision_ = adj->revision();
 
-    /* Generate mesh adjacency if we haven't already */
-    if(!adj) {
-        mesh_->generate_adjacency_info();
-        adj = mesh_->adjacency_info.get();
+    positions_.reserve(vertices->count());
+    for(uint32_t i = 0; i < vertices->count(); ++i) {
+        positions_.push_back(vertices->position_at<Vec3>(i));
     }
 
-    adj->each_edge([&](std::size_t, const EdgeInfo& edge) {
-        auto d1 = edge.normals[0].dot(light_direction);
+    auto& edges = adj->edges();
+
+    edge_first_.reserve(edges.size());
+    edge_second_.reserve(edges.size());
+
+    for(auto& edge: edges) {
+        const Vec3& v = positions_[edge.indexes[0]];
 
-        // If we have only one triangle, the missing triangle is the opposite of the first
-        // (e.g. if the only triangle is facing the light, the edge must be a silhouette,
-        // likewise if a triangle is facing away from the light, we must assume that the edge
-        // is part of the silhouette)
-        auto d2 = (edge.triangle_count == 2) ? edge.normals[1].dot(light_direction) : -d1;
+        edge_first_.push_back(edge.indexes[0]);
+        edge_second_.push_back(edge.indexes[1]);
 
-        auto v1 = vertices->position_at<smlt::Vec3>(edge.indexes[0]);
-        auto v2 = vertices->position_at<smlt::Vec3>(edge.indexes[1]);
+        // Both planes pass through the edge, so either vertex gives the distance
+        edge_planes_[0].push_back(edge.normals[0], edge.normals[0].dot(v));
+
+        if(edge.triangle_count == 2) {
+            edge_planes_[1].push_back(edge.normals[1], edge.normals[1].dot(v));
+        } else {
+            // If we have only one triangle, the missing triangle is the opposite of the first
+            // (e.g. if the only triangle is facing the light, the edge must be a silhouette,
+            // likewise if a triangle is facing away from the light, we must assume that the edge
+            // is part of the silhouette)
+            edge_planes_[1].push_back(-edge.normals[0], -edge.normals[0].dot(v));
+        }
+    }
 
-        // If one normal is facing the light and one isn't then
-        // store the edge as a silhouette
-        if(d1 >= 0 && d2 < 0) {
-            edge_list_.push_back(SilhouetteEdge(v1, v2));
-        } else if(d1 < 0 && d1 >= 0) {
-            edge_list_.push_back(SilhouetteEdge(v2, v1));
+    mesh->each([&](const std::string&, SubMeshPtr submesh) {
+        if(!submesh->contributes_to_edge_list()) {
+            return;
         }
+
+        submesh->each_triangle([&](uint32_t a, uint32_t b, uint32_t c) {
+            const Vec3& va = positions_[a];
+            auto normal = (positions_[b] - va).cross(positions_[c] - va).normalized();
+
+            triangles_.push_back(a);
+            triangles_.push_back(b);
+            triangles_.push_back(c);
+            triangle_planes_.push_back(normal, normal.dot(va));
+        });
     });
 }
 
-void MeshSilhouette::calculate_point_silhouette() {
-    auto light_position = light_direction_or_position_;
+ShadowVolumePtr ShadowCaster::extrude(const Vec4& light, bool generate_caps) const {
+    const bool directional = (light.w == 0.0f);
+    const float threshold = (directional) ? 0.0f : std::numeric_limits<float>::epsilon();
+
+    auto volume = std::make_shared<ShadowVolume>();
+
+    const std::size_t edge_count = edge_first_.size();
+    std::vector<uint8_t> facing(edge_count * 2);
+
+    if(edge_count) {
+        facing_light(edge_planes_[0], light, threshold, &facing[0]);
+        facing_light(edge_planes_[1], light, threshold, &facing[edge_count]);
+    }
+
+    for(std::size_t i = 0; i < edge_count; ++i) {
+        const uint8_t first = facing[i];
+        const uint8_t second = facing[edge_count + i];
 
-    // Move the light into the mesh's local space (to prevent transforming vertex data)
-    light_position += inverse_mesh_position_;
+        if(first && !second) {
+            volume->silhouette.push_back(edge_first_[i]);
+            volume->silhouette.push_back(edge_second_[i]);
+        } else if(!first && second) {
+            volume->silhouette.push_back(edge_second_[i]);
+            volume->silhouette.push_back(edge_first_[i]);
+        }
+    }
+
+    /* Each mesh vertex used gets a vertex on the mesh and one extruded to
+     * infinity, directly away from the light */
+    const uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(positions_.size(), UNUSED);
+
+    auto near = [&](uint32_t i) -> uint32_t {
+        if(remap[i] == UNUSED) {
+            const Vec3& p = positions_[i];
+            remap[i] = volume->vertices.size();
+            volume->vertices.push_back(Vec4(p, 1.0f));
+            volume->vertices.push_back(Vec4(
+                (p.x * light.w) - light.x,
+                (p.y * light.w) - light.y,
+                (p.z * light.w) - light.z,
+                0.0f
+            ));
+        }
+
+        return remap[i];
+    };
+
+    auto far = [&](uint32_t i) -> uint32_t {
+        return near(i) + 1;
+    };
+
+    auto& indices = volume->indices;
+    indices.reserve(volume->silhouette.size() * 3);
+
+    for(std::size_t i = 0; i < volume->silhouette.size(); i += 2) {
+        const uint32_t a = volume->silhouette[i];
+        const uint32_t b = volume->silhouette[i + 1];
+
+        indices.insert(indices.end(), {near(b), near(a), far(a)});
+        indices.insert(indices.end(), {near(b), far(a), far(b)});
+    }
+
+    volume->side_index_count = indices.size();
+
+    if(generate_caps && !triangles_.empty()) {
+        std::vector<uint8_t> lit(triangle_planes_.size());
+        facing_light(triangle_planes_, light, threshold, &lit[0]);
+
+        for(std::size_t i = 0; i < lit.size(); ++i) {
+            if(!lit[i]) {
+                continue;
+            }
 
-    AdjacencyInfo* adj = mesh_->adjacency_info.get();
-    VertexData* vertices = mesh_->vertex_data.get();
+            const uint32_t* tri = &triangles_[i * 3];
 
-    if(!adj) {
-        mesh_->generate_adjacency_info();
-        adj = mesh_->adjacency_info.get();
+            // Front cap
+            indices.insert(indices.end(), {near(tri[0]), near(tri[1]), near(tri[2])});
+
+            /* Back cap, the same triangle at infinity facing the other way.
+             * The extruded vertices of a directional light all meet at the
+             * same point so there's no back cap to draw */
+            if(!directional) {
+                indices.insert(indices.end(), {far(tri[0]), far(tri[2]), far(tri[1])});
+            }
+        }
     }
 
-    const float eps = std::numeric_limits<float>::epsilon();
+    return volume;
+}
 
-    adj->each_edge([&](std::size_t, const EdgeInfo& edge) {
-        auto v1 = vertices->position_at<smlt::Vec3>(edge.indexes[0]);
-        auto v2 = vertices->position_at<smlt::Vec3>(edge.indexes[1]);
+std::size_t SilhouetteEngine::LightKeyHash::operator()(const LightKey& key) const {
+    std::size_t seed = std::hash<int32_t>()(key.x);
 
-        // Just use one of the edge vertices to determine the light direction
-        auto light_direction = light_position - v1;
+    auto combine = [&seed](std::size_t value) {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    };
 
-        auto d1 = edge.normals[0].dot(light_direction);
+    combine(std::hash<int32_t>()(key.y));
+    combine(std::hash<int32_t>()(key.z));
+    combine(key.directional);
+    return seed;
+}
+
+SilhouetteEngine::SilhouetteEngine(thread::ThreadPool* pool):
+    pool_((pool) ? pool : &thread::ThreadPool::global()) {
+
+}
 
-        // If we have only one triangle, the missing triangle is the opposite of the first
-        // (e.g. if the only triangle is facing the light, the edge must be a silhouette,
-        // likewise if a triangle is facing away from the light, we must assume that the edge
-        // is part of the silhouette)
-        auto d2 = (edge.triangle_count == 2) ? edge.normals[1].dot(light_direction) : -d1;
+void SilhouetteEngine::set_caps_enabled(bool value) {
+    if(caps_enabled_ != value) {
+        caps_enabled_ = value;
 
-        // If one normal is facing the light and one isn't then
-        // store the edge as a silhouette
-        if(d1 > eps && d2 <= 0) {
-            edge_list_.push_back(SilhouetteEdge(v1, v2));
-        } else if(d1 <= 0 && d2 > eps) {
-            edge_list_.push_back(SilhouetteEdge(v2, v1));
+        // Cached volumes have the wrong caps
+        for(auto& p: casters_) {
+            p.second.volumes.clear();
+        }
+    }
+}
+
+void SilhouetteEngine::set_cache_precision(float precision) {
+    if(precision <= 0.0f) {
+        throw std::logic_error("Cache precision must be greater than zero");
+    }
+
+    cache_precision_ = precision;
+
+    for(auto& p: casters_) {
+        p.second.volumes.clear();
+    }
+}
+
+SilhouetteEngine::LightKey SilhouetteEngine::key_for(const Vec4& light) const {
+    LightKey key;
+    key.x = int32_t(std::floor(light.x / cache_precision_ + 0.5f));
+    key.y = int32_t(std::floor(light.y / cache_precision_ + 0.5f));
+    key.z = int32_t(std::floor(light.z / cache_precision_ + 0.5f));
+    key.directional = (light.w == 0.0f);
+    return key;
+}
+
+SilhouetteEngine::CasterEntry& SilhouetteEngine::entry_for(MeshPtr mesh) {
+    auto& entry = casters_[mesh->id()];
+
+    if(!entry.caster || !mesh->has_adjacency_info() ||
+        mesh->adjacency_info->revision() != entry.caster->adjacency_revision()) {
+
+        entry.caster = std::make_shared<ShadowCaster>(mesh.get());
+        entry.volumes.clear();
+    }
+
+    return entry;
+}
+
+ShadowVolumePtr SilhouetteEngine::evaluate(MeshPtr mesh, const Mat4& transformation, LightPtr light) {
+    Request request;
+    request.mesh = mesh;
+    request.transformation = transformation;
+    request.light = light;
+
+    return evaluate(std::vector<Request>(1, request)).front();
+}
+
+std::vector<ShadowVolumePtr> SilhouetteEngine::evaluate(const std::vector<Request>& requests) {
+    std::vector<ShadowVolumePtr> results(requests.size());
+
+    struct Job {
+        CasterEntry* entry;
+        LightKey key;
+        Vec4 light;
+        ShadowVolumePtr volume;
+
+        /* The requests which want this volume */
+        std::vector<std::size_t> requests;
+    };
+
+    /* Which job, if any, already covers a caster and light */
+    struct JobKey {
+        const CasterEntry* entry;
+        LightKey key;
+
+        bool operator==(const JobKey& rhs) const {
+            return entry == rhs.entry && key == rhs.key;
+        }
+    };
+
+    struct JobKeyHash {
+        std::size_t operator()(const JobKey& job_key) const {
+            std::size_t seed = std::hash<const CasterEntry*>()(job_key.entry);
+            return seed ^ (LightKeyHash()(job_key.key) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+        }
+    };
+
+    std::vector<Job> jobs;
+    std::unordered_map<JobKey, std::size_t, JobKeyHash> job_lookup;
+
+    /* Everything which touches the caches happens here, on this thread. Only
+     * the volume generation is spread across the pool */
+    for(std::size_t i = 0; i < requests.size(); ++i) {
+        auto& request = requests[i];
+        auto light = light_in_local_space(request.light, request.transformation);
+
+        if(light.w != 0.0f) {
+            // Point and spot lights only cast shadows from casters in range
+            auto position = Vec3(light.x, light.y, light.z);
+            if(!request.mesh->aabb().intersects_sphere(position, request.light->range() * 2.0f)) {
+                continue;
+            }
+        }
+
+        auto& entry = entry_for(request.mesh);
+        auto key = key_for(light);
+
+        auto cached = entry.volumes.find(key);
+        if(cached != entry.volumes.end()) {
+            results[i] = cached->second;
+            ++cache_hits_;
+            continue;
+        }
+
+        ++cache_misses_;
+
+        // The same caster and light might be requested more than once
+        JobKey job_key = {&entry, key};
+        auto found = job_lookup.find(job_key);
+
+        std::size_t job = 0;
+        if(found == job_lookup.end()) {
+            Job new_job;
+            new_job.entry = &entry;
+            new_job.key = key;
+            new_job.light = light;
+
+            job = jobs.size();
+            jobs.push_back(new_job);
+            job_lookup.insert(std::make_pair(job_key, job));
+        } else {
+            job = found->second;
+        }
+
+        jobs[job].requests.push_back(i);
+    }
+
+    const bool caps = caps_enabled_;
+    pool_->parallel_for(0, jobs.size(), [&jobs, caps](std::size_t first, std::size_t last) {
+        for(auto i = first; i < last; ++i) {
+            jobs[i].volume = jobs[i].entry->caster->extrude(jobs[i].light, caps);
         }
     });
+
+    for(auto& job: jobs) {
+        auto& volumes = job.entry->volumes;
+        if(volumes.size() >= DEFAULT_VOLUMES_PER_CASTER) {
+            // The light is moving around this caster, caching won't help much
+            volumes.clear();
+        }
+
+        volumes[job.key] = job.volume;
+
+        for(auto i: job.requests) {
+            results[i] = job.volume;
+        }
+    }
+
+    return results;
 }
 
-void MeshSilhouette::calculate_spot_silhouette() {
-    assert(0 && "Not implemented");
+MeshSilhouette::MeshSilhouette(MeshPtr mesh, const Mat4& mesh_transformation, const LightPtr light) {
+    auto local_light = light_in_local_space(light, mesh_transformation);
+
+    if(light->type() != LIGHT_TYPE_DIRECTIONAL) {
+        // Directional lights are always in range, otherwise see if the
+        // mesh's AABB intersects the radius of the light
+        auto within_range = mesh->aabb().intersects_sphere(
+            Vec3(local_light.x, local_light.y, local_light.z),
+            light->range() * 2.0 // Range is radius, intersects_sphere takes diameter
+        );
+
+        if(!within_range) {
+            return;
+        }
+    }
+
+    ShadowCaster caster(mesh.get());
+    auto volume = caster.extrude(local_light, false);
+
+    edge_list_.reserve(volume->silhouette_edge_count());
+    for(std::size_t i = 0; i < volume->silhouette.size(); i += 2) {
+        edge_list_.push_back(SilhouetteEdge(
+            caster.position(volume->silhouette[i]),
+            caster.position(volume->silhouette[i + 1])
+        ));
+    }
 }
 
+const std::vector<SilhouetteEdge> &MeshSilhouette::edge_list() {
+    return edge_list_;
 }
 
+}
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
 #include "renderers/batching/renderable.h"
+#include "math/vec4.h"
 
 namespace smlt {
 
+namespace thread {
+    class ThreadPool;
+}
+
 
 enum ShadowMethod {
     SHADOW_METHOD_STENCIL_DEPTH_FAIL, // Standard
@@ -40,6 +49,161 @@ struct SilhouetteEdge {
     }
 };
 
+/*
+ * The extruded shadow volume of a mesh for one light, in the mesh's local
+ * space.
+ *
+ * Vertices on the mesh have w = 1, vertices extruded away from the light have
+ * w = 0 (they are at infinity), so the volume should be drawn with an
+ * infinite far plane. The side faces come first in the index list, followed
+ * by the front and back caps if they were generated (needed for depth-fail
+ * stencil shadows).
+ */
+struct ShadowVolume {
+    /* Pairs of indexes into the mesh vertex data. Each pair is wound the same
+     * way as the triangle which faces the light */
+    std::vector<uint32_t> silhouette;
+
+    std::vector<Vec4> vertices;
+    std::vector<uint32_t> indices;
+    uint32_t side_index_count = 0;
+
+    std::size_t silhouette_edge_count() const { return silhouette.size() / 2; }
+};
+
+typedef std::shared_ptr<const ShadowVolume> ShadowVolumePtr;
+
+/*
+ * Returns the light in the local space of something with the given
+ * transformation as a homogeneous vector: (position, 1) for point and spot
+ * lights or (direction towards the light, 0) for directional lights.
+ */
+Vec4 light_in_local_space(const LightPtr light, const Mat4& transformation);
+
+/*
+ * A packed copy of a mesh's edges and triangles for generating shadow volumes.
+ * Each edge stores the planes of the two triangles which share it in
+ * structure-of-arrays form so that facing tests can run four edges at a time.
+ * An edge with only one triangle uses the flipped plane for the missing one,
+ * so it's always part of the silhouette.
+ */
+class ShadowCaster {
+public:
+    /* Generates the mesh's adjacency info if it doesn't have any yet */
+    ShadowCaster(Mesh* mesh);
+
+    /* The volume for a light from light_in_local_space() */
+    ShadowVolumePtr extrude(const Vec4& light, bool generate_caps=true) const;
+
+    std::size_t edge_count() const { return edge_first_.size(); }
+    std::size_t triangle_count() const { return triangles_.size() / 3; }
+
+    const Vec3& position(uint32_t i) const { return positions_[i]; }
+
+    /* The AdjacencyInfo::revision() this was built from */
+    uint64_t adjacency_revision() const { return adjacency_revision_; }
+
+    struct Planes {
+        std::vector<float> x, y, z, w;
+
+        void push_back(const Vec3& normal, float d) {
+            x.push_back(normal.x);
+            y.push_back(normal.y);
+            z.push_back(normal.z);
+            w.push_back(d);
+        }
+
+        std::size_t size() const { return x.size(); }
+    };
+
+private:
+    std::vector<Vec3> positions_;
+
+    std::vector<uint32_t> edge_first_;
+    std::vector<uint32_t> edge_second_;
+    Planes edge_planes_[2];
+
+    std::vector<uint32_t> triangles_;
+    Planes triangle_planes_;
+
+    uint64_t adjacency_revision_ = 0;
+};
+
+typedef std::shared_ptr<ShadowCaster> ShadowCasterPtr;
+
+/*
+ * Generates shadow volumes for many caster/light pairs at once.
+ *
+ * A ShadowCaster is kept for each mesh until its adjacency info is rebuilt.
+ * Volumes are cached per caster, keyed on the light in the caster's local
+ * space (rounded to cache_precision()), so nothing is recalculated while a
+ * light and a caster don't move relative to each other. The volumes which
+ * aren't cached are generated in parallel on the thread pool.
+ */
+class SilhouetteEngine {
+public:
+    struct Request {
+        MeshPtr mesh;
+        Mat4 transformation;
+        LightPtr light;
+    };
+
+    const static std::size_t DEFAULT_VOLUMES_PER_CASTER = 8;
+
+    SilhouetteEngine(thread::ThreadPool* pool=nullptr);
+
+    /* Returns a volume for each request, or null where the caster is out of
+     * the light's range */
+    std::vector<ShadowVolumePtr> evaluate(const std::vector<Request>& requests);
+    ShadowVolumePtr evaluate(MeshPtr mesh, const Mat4& transformation, LightPtr light);
+
+    void set_caps_enabled(bool value);
+    bool caps_enabled() const { return caps_enabled_; }
+
+    void set_cache_precision(float precision);
+    float cache_precision() const { return cache_precision_; }
+
+    /* Forget everything stored for a mesh, e.g. when it's destroyed */
+    void forget_mesh(MeshID mesh_id) { casters_.erase(mesh_id); }
+    void clear() { casters_.clear(); }
+
+    std::size_t caster_count() const { return casters_.size(); }
+    uint64_t cache_hits() const { return cache_hits_; }
+    uint64_t cache_misses() const { return cache_misses_; }
+
+private:
+    struct LightKey {
+        int32_t x, y, z;
+        bool directional;
+
+        bool operator==(const LightKey& rhs) const {
+            return x == rhs.x && y == rhs.y && z == rhs.z && directional == rhs.directional;
+        }
+    };
+
+    struct LightKeyHash {
+        std::size_t operator()(const LightKey& key) const;
+    };
+
+    struct CasterEntry {
+        ShadowCasterPtr caster;
+        std::unordered_map<LightKey, ShadowVolumePtr, LightKeyHash> volumes;
+    };
+
+    thread::ThreadPool* pool_ = nullptr;
+
+    std::unordered_map<MeshID, CasterEntry> casters_;
+
+    bool caps_enabled_ = true;
+    float cache_precision_ = 0.001f;
+
+    uint64_t cache_hits_ = 0;
+    uint64_t cache_misses_ = 0;
+
+    CasterEntry& entry_for(MeshPtr mesh);
+    LightKey key_for(const Vec4& light) const;
+};
+
 class MeshSilhouette {
     /*
      * Stores the chain of edges that form a silohette from a particular light
@@ -47,6 +211,9 @@ class MeshSilhouette {
      * INVALIDATED:
      *  - When the mesh adjacency is invalided
      *  - When the light moves
+     *
+     * This builds a ShadowCaster each time, use a SilhouetteEngine to reuse
+     * them between frames.
     */
 public:
 
@@ -64,18 +231,7 @@ public:
     const std::vector<SilhouetteEdge>& edge_list();
 
 private:
-    void recalculate_silhouette();
-    void calculate_directional_silhouette();
-    void calculate_point_silhouette();
-    void calculate_spot_silhouette();
-
     std::vector<SilhouetteEdge> edge_list_;
-
-    smlt::MeshPtr mesh_;
-    smlt::Vec3 inverse_mesh_position_;
-    smlt::Quaternion inverse_mesh_rotation_;
-    smlt::Vec3 light_direction_or_position_;
-    LightType light_type_;
 };
 
 class ShadowVolumeManager {
@@ -25,6 +25,13 @@
 
 namespace smlt {
 
+/* Driver buffers per source, and decoded chunks waiting in each stream */
+const static uint32_t STREAM_BUFFER_COUNT = 4;
+const static std::size_t STREAM_CHUNK_COUNT = 4;
+
+/* Chunks decoded on the calling thread so playback can begin immediately */
+const static std::size_t STREAM_PRIME_CHUNKS = 2;
+
 Sound::Sound(SoundID id, ResourceManager *resource_manager, SoundDriver *sound_driver):
     generic::Identifiable<SoundID>(id),
     Resource(resource_manager),
@@ -36,7 +43,6 @@ Sound::Sound(SoundID id, ResourceManager *resource_manager, SoundDriver *sound_d
 SourceInstance::SourceInstance(Source &parent, SoundID sound, bool loop_stream):
     parent_(parent),
     source_(0),
-    buffers_{0, 0},
     sound_(sound),
     loop_stream_(loop_stream),
     is_dead_(false) {
@@ -45,26 +51,80 @@ SourceInstance::SourceInstance(Source &parent, SoundID sound, bool loop_stream):
     SoundDriver* driver = parent_._sound_driver();
 
     source_ = driver->generate_sources(1).back();
-    buffers_ = driver->generate_buffers(2);
+
+    driver->set_source_gain(source_, parent_.gain_);
+    driver->set_source_distance(source_, parent_.distance_);
 }
 
 SourceInstance::~SourceInstance() {
     SoundDriver* driver = parent_._sound_driver();
 
+    if(stream_) {
+        stream_->close();
+    }
+
     driver->stop_source(source_); // Make sure we have stopped playing!
     driver->delete_sources({source_});
-    driver->delete_buffers(buffers_);
+
+    if(!buffers_.empty()) {
+        driver->delete_buffers(buffers_);
+    }
+}
+
+void SourceInstance::generate_stream_buffers() {
+    // Cached sounds play shared buffers, so these are only made when streaming
+    if(buffers_.empty()) {
+        buffers_ = parent_._sound_driver()->generate_buffers(STREAM_BUFFER_COUNT);
+        free_buffers_ = buffers_;
+    }
+}
+
+void SourceInstance::set_decode_func(DecodeFunc func, AudioDataFormat format, uint32_t sample_rate, std::size_t chunk_samples) {
+    if(stream_) {
+        stream_->close();
+    }
+
+    stream_ = std::make_shared<AudioStream>(func, chunk_samples, STREAM_CHUNK_COUNT);
+    stream_format_ = format;
+    stream_sample_rate_ = sample_rate;
+    stream_ended_ = false;
 }
 
 void SourceInstance::start() {
+    SoundDriver* driver = parent_._sound_driver();
+
+    if(cached_) {
+        auto& buffers = cached_->buffers();
+        driver->queue_buffers_to_source(source_, buffers.size(), buffers);
+        queued_buffers_ += buffers.size();
+
+        if(!is_playing()) {
+            driver->play_source(source_);
+        }
+        return;
+    }
+
+    generate_stream_buffers();
+
+    if(stream_) {
+        stream_->decode_ahead(STREAM_PRIME_CHUNKS);
+        queue_decoded_chunks();
+
+        AudioStreamer::global().add_stream(stream_);
+
+        // When looping, the previous run may still be playing its tail
+        if(!is_playing()) {
+            driver->play_source(source_);
+        }
+        return;
+    }
+
     //Fill up two buffers to begin with
     auto bs1 = stream_func_(buffers_[0]);
     auto bs2 = stream_func_(buffers_[1]);
 
     int to_queue = (bs1 && bs2) ? 2 : (bs1 || bs2)? 1 : 0;
 
-    SoundDriver* driver = parent_._sound_driver();
-
     driver->queue_buffers_to_source(source_, to_queue, buffers_);
     driver->play_source(source_);
 }
@@ -74,7 +134,110 @@ bool SourceInstance::is_playing() const {
     return driver->source_state(source_) == AUDIO_SOURCE_STATE_PLAYING;
 }
 
+bool SourceInstance::queue_decoded_chunks() {
+    SoundDriver* driver = parent_._sound_driver();
+    PCMRingBuffer& ring = stream_->buffer();
+
+    bool consumed = false;
+    bool ended = false;
+
+    int16_t* pcm = nullptr;
+    std::size_t samples = 0;
+    while(!free_buffers_.empty() && (pcm = ring.begin_read(&samples))) {
+        if(!samples) {
+            ring.end_read();
+            ended = true;
+            break;
+        }
+
+        AudioBufferID buffer = free_buffers_.back();
+        free_buffers_.pop_back();
+
+        driver->upload_buffer_data(buffer, stream_format_, pcm, samples * sizeof(int16_t), stream_sample_rate_);
+        ring.end_read();
+
+        driver->queue_buffers_to_source(source_, 1, {buffer});
+        ++queued_buffers_;
+        consumed = true;
+    }
+
+    if(consumed) {
+        // There's room in the ring again
+        AudioStreamer::global().wake();
+    }
+
+    return !ended;
+}
+
+void SourceInstance::update_stream() {
+    SoundDriver* driver = parent_._sound_driver();
+
+    int32_t processed = driver->source_buffers_processed_count(source_);
+    if(processed > 0) {
+        auto buffers = driver->unqueue_buffers_from_source(source_, processed);
+        free_buffers_.insert(free_buffers_.end(), buffers.begin(), buffers.end());
+        queued_buffers_ -= buffers.size();
+    }
+
+    if(stream_ended_) {
+        // Let the queued buffers drain before going away
+        is_dead_ = (queued_buffers_ == 0);
+        return;
+    }
+
+    if(queue_decoded_chunks()) {
+        // Resume if the source ran dry while waiting for the decoder
+        if(queued_buffers_ && !is_playing()) {
+            driver->play_source(source_);
+        }
+        return;
+    }
+
+    parent_.signal_stream_finished_();
+    if(loop_stream_) {
+        //Restart the sound
+        auto sound = parent_.stage_->assets->sound(sound_);
+        sound->init_source_(*this);
+        start();
+    } else {
+        stream_ended_ = true;
+        is_dead_ = (queued_buffers_ == 0);
+    }
+}
+
+void SourceInstance::update_cached() {
+    SoundDriver* driver = parent_._sound_driver();
+
+    int32_t processed = driver->source_buffers_processed_count(source_);
+    if(processed > 0) {
+        queued_buffers_ -= driver->unqueue_buffers_from_source(source_, processed).size();
+    }
+
+    if(loop_stream_) {
+        /* Keep the next loop queued behind the current one, so there's no
+         * gap. Once the last buffer of the previous loop has been consumed
+         * only one loop is left, so queue another. Looping sounds never
+         * finish. */
+        if(queued_buffers_ <= cached_->buffers().size()) {
+            start();
+        }
+    } else if(!queued_buffers_) {
+        parent_.signal_stream_finished_();
+        is_dead_ = true;
+    }
+}
+
 void SourceInstance::update(float dt) {
+    if(cached_) {
+        update_cached();
+        return;
+    }
+
+    if(stream_) {
+        update_stream();
+        return;
+    }
+
     SoundDriver* driver = parent_._sound_driver();
 
     int32_t processed = driver->source_buffers_processed_count(source_);
@@ -128,11 +291,14 @@ void Source::play_sound(SoundID sound, bool loop) {
     SourceInstance::ptr new_source = SourceInstance::create(*this, sound, loop);
 
     /* This is surely wrong... */
-    if(stage_) {
-        auto s = stage_->assets->sound(sound);
-        s->init_source_(*new_source);
+    auto s = (stage_) ? stage_->assets->sound(sound) : window_->shared_assets->sound(sound);
+
+    /* Short sounds are decoded once and shared, anything else streams */
+    auto cache = _pcm_cache();
+    auto cached = (cache) ? cache->fetch(s.get()) : CachedPCM::ptr();
+    if(cached) {
+        new_source->set_cached_pcm(cached);
     } else {
-        auto s = window_->shared_assets->sound(sound);
         s->init_source_(*new_source);
     }
 
@@ -157,6 +323,34 @@ void Source::update_source(float dt) {
     );
 }
 
+void Source::set_gain(float gain) {
+    gain_ = gain;
+
+    auto driver = _sound_driver();
+    for(auto instance: instances_) {
+        driver->set_source_gain(instance->_driver_source(), gain);
+    }
+}
+
+void Source::set_distance_to_listener(float distance) {
+    distance_ = distance;
+
+    auto driver = _sound_driver();
+    for(auto instance: instances_) {
+        driver->set_source_distance(instance->_driver_source(), distance);
+    }
+}
+
+PCMCache* Source::_pcm_cache() const {
+    if(window_) {
+        return window_->_pcm_cache();
+    }
+
+    // The cached buffers belong to the window's driver, so can't be queued on another
+    Window* window = stage_->window;
+    return (driver_ == window->_sound_driver()) ? window->_pcm_cache() : nullptr;
+}
+
 SoundDriver *Source::_sound_driver() const {
     return (window_) ? window_->_sound_driver() : driver_;
 }
@@ -23,6 +23,9 @@
 #include <list>
 
 #include "sound_driver.h"
+#include "audio_streamer.h"
+#include "pcm_cache.h"
+#include "utils/file_view.h"
 
 #include "generic/managed.h"
 #include "generic/identifiable.h"
@@ -63,19 +66,41 @@ public:
     std::vector<uint8_t>& data() { return sound_data_; }
     void set_data(const std::vector<uint8_t>& data) { sound_data_ = data; }
 
+    /* The encoded file, when the decoders read it straight from a FileView
+     * rather than a copy in data() */
+    void set_file_view(FileView::ptr view) { file_view_ = view; }
+    FileView::ptr file_view() const { return file_view_; }
+
+    std::size_t memory_usage() const {
+        return sound_data_.size() + ((file_view_) ? file_view_->size() : 0);
+    }
+
     void set_source_init_function(std::function<void (SourceInstance&)> func) { init_source_ = func; }
 
+    /* Total interleaved samples once decoded, zero if unknown */
+    std::size_t sample_count() const { return sample_count_; }
+    void set_sample_count(std::size_t count) { sample_count_ = count; }
+
+    /* Creates a decoder from the start of the sound, used to decode short
+     * sounds in full for the PCMCache */
+    void set_decoder_factory(std::function<DecodeFunc ()> factory) { decoder_factory_ = factory; }
+    bool has_decoder() const { return bool(decoder_factory_); }
+    DecodeFunc new_decoder() const { return decoder_factory_(); }
+
     SoundDriver* _driver() const { return driver_; }
 private:
     std::function<void (SourceInstance&)> init_source_;
+    std::function<DecodeFunc ()> decoder_factory_;
 
     SoundDriver* driver_ = nullptr;
     std::vector<uint8_t> sound_data_;
+    FileView::ptr file_view_;
 
     uint32_t sample_rate_ = 0;
     AudioDataFormat format_;
     uint8_t channels_ = 0;
     std::size_t buffer_size_ = 0;
+    std::size_t sample_count_ = 0;
 
     friend class Source;
     friend class SourceInstance;
@@ -96,9 +121,25 @@ private:
     SoundID sound_;
     StreamFunc stream_func_;
 
+    /* Set when the sound is decoded on the streaming thread */
+    AudioStream::ptr stream_;
+    AudioDataFormat stream_format_ = AUDIO_DATA_FORMAT_MONO16;
+    uint32_t stream_sample_rate_ = 0;
+    std::vector<AudioBufferID> free_buffers_;
+    uint32_t queued_buffers_ = 0;
+    bool stream_ended_ = false;
+
+    /* Set when the whole sound is already in driver buffers */
+    CachedPCM::ptr cached_;
+
     bool loop_stream_;
     bool is_dead_;
 
+    bool queue_decoded_chunks();
+    void update_stream();
+    void update_cached();
+    void generate_stream_buffers();
+
 public:
     SourceInstance(Source& parent, SoundID sound, bool loop_stream);
     ~SourceInstance();
@@ -109,7 +150,17 @@ public:
     bool is_playing() const;
     void set_stream_func(StreamFunc func) { stream_func_ = func; }
 
+    /* Decodes the sound ahead of time on the audio streaming thread, update()
+     * then only uploads chunks which are ready. Takes priority over the
+     * stream function. */
+    void set_decode_func(DecodeFunc func, AudioDataFormat format, uint32_t sample_rate, std::size_t chunk_samples);
+
+    /* Plays the cached buffers rather than decoding anything */
+    void set_cached_pcm(CachedPCM::ptr pcm) { cached_ = pcm; }
+
     bool is_dead() const { return is_dead_; }
+
+    AudioSourceID _driver_source() const { return source_; }
 };
 
 class Source {
@@ -123,10 +174,20 @@ public:
 
     void update_source(float dt);
 
+    /* Applied to every sound this source plays. The distance is from
+     * whatever is listening (usually the camera), drivers with a limited
+     * number of voices play the loudest, nearest sounds first. */
+    void set_gain(float gain);
+    void set_distance_to_listener(float distance);
+
+    float gain() const { return gain_; }
+    float distance_to_listener() const { return distance_; }
+
     sig::signal<void ()>& signal_stream_finished() { return signal_stream_finished_; }
 
 private:
     SoundDriver* _sound_driver() const;
+    PCMCache* _pcm_cache() const;
 
     Stage* stage_ = nullptr;
     Window* window_ = nullptr;
@@ -135,6 +196,9 @@ private:
     std::list<SourceInstance::ptr> instances_;
     sig::signal<void ()> signal_stream_finished_;
 
+    float gain_ = 1.0f;
+    float distance_ = 0.0f;
+
     friend class Sound;
     friend class SourceInstance;
 };
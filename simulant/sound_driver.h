@@ -30,7 +30,7 @@ class Window;
 /* Basically a hacky abstraction over OpenAL with the thinking that the only other drivers will be:
  *
  * - Dreamcast
- * - Dummy
+ * - Dummy (see MixerSoundDriver)
  *
  * If that ceases to be the case for whatever reason, then we should probably design a nicer API for this. Perhaps.
  */
@@ -60,6 +60,11 @@ public:
     virtual AudioSourceState source_state(AudioSourceID source) = 0;
     virtual int32_t source_buffers_processed_count(AudioSourceID source) const = 0;
 
+    /* Volume and distance from the listener. Drivers with a limited number
+     * of voices also use these to decide which sources are worth playing. */
+    virtual void set_source_gain(AudioSourceID source, float gain) {}
+    virtual void set_source_distance(AudioSourceID source, float distance) {}
+
     Property<SoundDriver, Window> window = {this, &SoundDriver::window_};
 
 private:
@@ -0,0 +1,79 @@
+#include <algorithm>
+
+#include "mix_kernels.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace smlt {
+namespace mix {
+
+void accumulate_mono(float* out, const float* in, std::size_t frames, float left, float right) {
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 gain = _mm_setr_ps(left, right, left, right);
+    for(; i + 4 <= frames; i += 4) {
+        const __m128 s = _mm_loadu_ps(in + i);
+
+        // s0 s0 s1 s1, s2 s2 s3 s3
+        const __m128 lo = _mm_unpacklo_ps(s, s);
+        const __m128 hi = _mm_unpackhi_ps(s, s);
+
+        float* dest = out + (i * 2);
+        _mm_storeu_ps(dest, _mm_add_ps(_mm_loadu_ps(dest), _mm_mul_ps(lo, gain)));
+        _mm_storeu_ps(dest + 4, _mm_add_ps(_mm_loadu_ps(dest + 4), _mm_mul_ps(hi, gain)));
+    }
+#endif
+
+    for(; i < frames; ++i) {
+        out[i * 2] += in[i] * left;
+        out[i * 2 + 1] += in[i] * right;
+    }
+}
+
+void accumulate_stereo(float* out, const float* in, std::size_t frames, float left, float right) {
+    std::size_t i = 0;
+    const std::size_t samples = frames * 2;
+
+#if defined(__SSE2__)
+    const __m128 gain = _mm_setr_ps(left, right, left, right);
+    for(; i + 4 <= samples; i += 4) {
+        const __m128 s = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(s, gain)));
+    }
+#endif
+
+    for(; i < samples; i += 2) {
+        out[i] += in[i] * left;
+        out[i + 1] += in[i + 1] * right;
+    }
+}
+
+void to_int16(int16_t* out, const float* in, std::size_t samples) {
+    std::size_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 lower = _mm_set1_ps(-1.0f);
+    const __m128 upper = _mm_set1_ps(1.0f);
+    for(; i + 8 <= samples; i += 8) {
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lower), upper);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lower), upper);
+
+        // Truncate like the scalar loop does
+        const __m128i ia = _mm_cvttps_epi32(_mm_mul_ps(a, scale));
+        const __m128i ib = _mm_cvttps_epi32(_mm_mul_ps(b, scale));
+        _mm_storeu_si128((__m128i*) (out + i), _mm_packs_epi32(ia, ib));
+    }
+#endif
+
+    for(; i < samples; ++i) {
+        const float s = std::min(std::max(in[i], -1.0f), 1.0f);
+        out[i] = int16_t(s * 32767.0f);
+    }
+}
+
+}
+}
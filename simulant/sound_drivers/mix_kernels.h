@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace smlt {
+namespace mix {
+
+/*
+ * The inner loops of the software mixer. These work on interleaved stereo
+ * float accumulation buffers and use SSE2 where it's available, falling
+ * back to plain loops elsewhere (e.g. the Dreamcast).
+ */
+
+/* out[2i] += in[i] * left, out[2i + 1] += in[i] * right */
+void accumulate_mono(float* out, const float* in, std::size_t frames, float left, float right);
+
+/* out[2i] += in[2i] * left, out[2i + 1] += in[2i + 1] * right */
+void accumulate_stereo(float* out, const float* in, std::size_t frames, float left, float right);
+
+/* Converts [-1, 1] floats to int16 samples, clamping anything outside */
+void to_int16(int16_t* out, const float* in, std::size_t samples);
+
+}
+}
@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "mixer_sound_driver.h"
+#include "mix_kernels.h"
+
+namespace smlt {
+
+/* Voices quieter than this aren't worth mixing, even if there's room */
+const static float MIN_AUDIBILITY = 0.001f;
+
+/* How often the null output wakes up to consume audio */
+const static std::chrono::milliseconds NULL_OUTPUT_PERIOD(10);
+
+/* How often the device output checks for finished buffers, well inside the
+ * length of one */
+const static std::chrono::milliseconds DEVICE_OUTPUT_PERIOD(5);
+
+MixerSoundDriver::MixerSoundDriver(Window* window, MixerOutput output, uint32_t hardware_voices, uint32_t sample_rate):
+    SoundDriver(window),
+    output_(output),
+    hardware_voices_(hardware_voices),
+    sample_rate_(sample_rate),
+    real_voice_count_(0),
+    virtual_voice_count_(0),
+    stolen_voice_count_(0) {
+
+}
+
+MixerSoundDriver::MixerSoundDriver(Window* window, std::shared_ptr<SoundDriver> device, uint32_t hardware_voices, uint32_t sample_rate):
+    MixerSoundDriver(window, MIXER_OUTPUT_DEVICE, hardware_voices, sample_rate) {
+
+    device_ = device;
+}
+
+MixerSoundDriver::~MixerSoundDriver() {
+    shutdown();
+}
+
+bool MixerSoundDriver::startup() {
+    if(output_ == MIXER_OUTPUT_MANUAL || thread_.joinable()) {
+        return true;
+    }
+
+    if(output_ == MIXER_OUTPUT_DEVICE && !start_device_output()) {
+        return false;
+    }
+
+    stopping_ = false;
+    thread_ = std::thread(
+        (output_ == MIXER_OUTPUT_DEVICE) ? &MixerSoundDriver::run_device_output : &MixerSoundDriver::run_null_output,
+        this
+    );
+
+    return true;
+}
+
+void MixerSoundDriver::shutdown() {
+    if(thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(thread_mutex_);
+            stopping_ = true;
+        }
+
+        thread_cv_.notify_one();
+        thread_.join();
+    }
+
+    stop_device_output();
+}
+
+void MixerSoundDriver::run_null_output() {
+    auto last = std::chrono::steady_clock::now();
+    double remainder = 0.0;
+
+    std::unique_lock<std::mutex> lock(thread_mutex_);
+    while(!stopping_) {
+        thread_cv_.wait_for(lock, NULL_OUTPUT_PERIOD);
+        if(stopping_) {
+            break;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        double frames = std::chrono::duration<double>(now - last).count() * sample_rate_ + remainder;
+        last = now;
+
+        // Don't try to catch up on more than a second if we were stalled
+        frames = std::min(frames, double(sample_rate_));
+
+        const uint32_t whole = uint32_t(frames);
+        remainder = frames - whole;
+
+        lock.unlock();
+        mix(nullptr, whole);
+        lock.lock();
+    }
+}
+
+bool MixerSoundDriver::start_device_output() {
+    if(!device_ || !device_->startup()) {
+        return false;
+    }
+
+    device_source_ = device_->generate_sources(1).at(0);
+    device_buffers_ = device_->generate_buffers(DEVICE_OUTPUT_BUFFERS);
+    device_pcm_.resize(DEVICE_OUTPUT_FRAMES * 2);
+
+    // Start with the whole ring queued, this is the output latency
+    for(auto buffer: device_buffers_) {
+        fill_device_buffer(buffer);
+    }
+
+    device_->queue_buffers_to_source(device_source_, device_buffers_.size(), device_buffers_);
+    device_->play_source(device_source_);
+
+    return true;
+}
+
+void MixerSoundDriver::stop_device_output() {
+    if(!device_source_) {
+        return;
+    }
+
+    // Stopping marks everything queued as processed, so it can all come back
+    device_->stop_source(device_source_);
+    device_->unqueue_buffers_from_source(device_source_, device_buffers_.size());
+
+    device_->delete_sources({device_source_});
+    device_->delete_buffers(device_buffers_);
+    device_source_ = 0;
+    device_buffers_.clear();
+
+    device_->shutdown();
+}
+
+void MixerSoundDriver::fill_device_buffer(AudioBufferID buffer) {
+    mix(&device_pcm_[0], DEVICE_OUTPUT_FRAMES);
+
+    device_->upload_buffer_data(
+        buffer, AUDIO_DATA_FORMAT_STEREO16,
+        &device_pcm_[0], device_pcm_.size() * sizeof(int16_t), sample_rate_
+    );
+}
+
+void MixerSoundDriver::run_device_output() {
+    std::unique_lock<std::mutex> lock(thread_mutex_);
+    while(!stopping_) {
+        thread_cv_.wait_for(lock, DEVICE_OUTPUT_PERIOD);
+        if(stopping_) {
+            break;
+        }
+
+        lock.unlock();
+
+        // Refill whatever the device has finished playing and put it back
+        // on the end of the queue
+        const int32_t processed = device_->source_buffers_processed_count(device_source_);
+        if(processed > 0) {
+            auto buffers = device_->unqueue_buffers_from_source(device_source_, processed);
+            for(auto buffer: buffers) {
+                fill_device_buffer(buffer);
+            }
+
+            device_->queue_buffers_to_source(device_source_, buffers.size(), buffers);
+        }
+
+        // A source which runs dry stops, so restart it after an underrun
+        if(device_->source_state(device_source_) != AUDIO_SOURCE_STATE_PLAYING) {
+            device_->play_source(device_source_);
+        }
+
+        lock.lock();
+    }
+}
+
+std::vector<AudioSourceID> MixerSoundDriver::generate_sources(uint32_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<AudioSourceID> sources;
+    sources.reserve(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        AudioSourceID id = next_source_id_++;
+        voices_[id] = Voice();
+        sources.push_back(id);
+    }
+
+    return sources;
+}
+
+std::vector<AudioBufferID> MixerSoundDriver::generate_buffers(uint32_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::vector<AudioBufferID> buffers;
+    buffers.reserve(count);
+    for(uint32_t i = 0; i < count; ++i) {
+        AudioBufferID id = next_buffer_id_++;
+        buffers_[id] = Buffer();
+        buffers.push_back(id);
+    }
+
+    return buffers;
+}
+
+void MixerSoundDriver::delete_buffers(const std::vector<AudioBufferID>& buffers) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto buffer: buffers) {
+        buffers_.erase(buffer);
+    }
+}
+
+void MixerSoundDriver::delete_sources(const std::vector<AudioSourceID>& sources) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for(auto source: sources) {
+        voices_.erase(source);
+    }
+}
+
+void MixerSoundDriver::play_source(AudioSourceID source_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& voice = voices_.at(source_id);
+
+    // Like OpenAL, a source with nothing queued stops straight away
+    voice.playing = !voice.queued.empty();
+}
+
+void MixerSoundDriver::stop_source(AudioSourceID source_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = voices_.find(source_id);
+    if(it == voices_.end()) {
+        return;
+    }
+
+    auto& voice = it->second;
+
+    // Everything queued counts as processed once stopped
+    voice.processed.insert(voice.processed.end(), voice.queued.begin(), voice.queued.end());
+    voice.queued.clear();
+    voice.position = 0.0;
+    voice.playing = false;
+    voice.real = false;
+}
+
+void MixerSoundDriver::queue_buffers_to_source(AudioSourceID source, uint32_t count, const std::vector<AudioBufferID>& buffers) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& voice = voices_.at(source);
+    voice.queued.insert(voice.queued.end(), buffers.begin(), buffers.begin() + std::min<std::size_t>(count, buffers.size()));
+}
+
+std::vector<AudioBufferID> MixerSoundDriver::unqueue_buffers_from_source(AudioSourceID source, uint32_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto& processed = voices_.at(source).processed;
+    count = std::min<uint32_t>(count, processed.size());
+
+    std::vector<AudioBufferID> buffers(processed.begin(), processed.begin() + count);
+    processed.erase(processed.begin(), processed.begin() + count);
+    return buffers;
+}
+
+void MixerSoundDriver::upload_buffer_data(AudioBufferID buffer, AudioDataFormat format, int16_t* data, uint32_t size, uint32_t frequency) {
+    /* Convert outside the lock, the mixing thread might be waiting */
+    Buffer converted;
+    converted.frequency = (frequency) ? frequency : sample_rate_;
+    converted.channels = (format == AUDIO_DATA_FORMAT_STEREO8 || format == AUDIO_DATA_FORMAT_STEREO16) ? 2 : 1;
+
+    if(format == AUDIO_DATA_FORMAT_MONO8 || format == AUDIO_DATA_FORMAT_STEREO8) {
+        const uint8_t* bytes = (const uint8_t*) data;
+        converted.samples.resize(size);
+        for(uint32_t i = 0; i < size; ++i) {
+            converted.samples[i] = (float(bytes[i]) - 128.0f) / 128.0f;
+        }
+    } else {
+        const uint32_t count = size / sizeof(int16_t);
+        converted.samples.resize(count);
+        for(uint32_t i = 0; i < count; ++i) {
+            converted.samples[i] = float(data[i]) / 32768.0f;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.at(buffer) = std::move(converted);
+}
+
+AudioSourceState MixerSoundDriver::source_state(AudioSourceID source) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = voices_.find(source);
+    if(it == voices_.end() || !it->second.playing) {
+        return AUDIO_SOURCE_STATE_STOPPED;
+    }
+
+    // Virtual voices are still playing as far as anyone else is concerned
+    return AUDIO_SOURCE_STATE_PLAYING;
+}
+
+int32_t MixerSoundDriver::source_buffers_processed_count(AudioSourceID source) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = voices_.find(source);
+    return (it == voices_.end()) ? 0 : it->second.processed.size();
+}
+
+void MixerSoundDriver::set_source_gain(AudioSourceID source, float gain) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    voices_.at(source).gain = std::max(gain, 0.0f);
+}
+
+void MixerSoundDriver::set_source_distance(AudioSourceID source, float distance) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    voices_.at(source).distance = std::max(distance, 0.0f);
+}
+
+uint32_t MixerSoundDriver::mix(int16_t* out, uint32_t frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    active_.clear();
+    for(auto& p: voices_) {
+        auto& voice = p.second;
+        if(!voice.playing) {
+            continue;
+        }
+
+        // Inverse distance attenuation, full volume within a unit
+        voice.audibility = voice.gain / std::max(voice.distance, 1.0f);
+        active_.push_back(&voice);
+    }
+
+    const std::size_t slots = std::min<std::size_t>(active_.size(), hardware_voices_);
+    if(slots < active_.size()) {
+        std::nth_element(
+            active_.begin(), active_.begin() + slots, active_.end(),
+            [](const Voice* lhs, const Voice* rhs) { return lhs->audibility > rhs->audibility; }
+        );
+    }
+
+    accumulator_.assign(frames * 2, 0.0f);
+
+    uint32_t mixed = 0;
+    uint32_t stolen = 0;
+    for(std::size_t i = 0; i < active_.size(); ++i) {
+        Voice* voice = active_[i];
+
+        if(i >= slots && voice->real) {
+            // Something louder took its place
+            ++stolen;
+        }
+
+        voice->real = (i < slots && voice->audibility >= MIN_AUDIBILITY);
+
+        if(voice->real) {
+            mix_voice(*voice, &accumulator_[0], frames);
+            ++mixed;
+        } else {
+            advance_voice(*voice, frames);
+        }
+    }
+
+    if(out && frames) {
+        mix::to_int16(out, &accumulator_[0], frames * 2);
+    }
+
+    real_voice_count_ = mixed;
+    virtual_voice_count_ = active_.size() - mixed;
+    stolen_voice_count_ += stolen;
+
+    return mixed;
+}
+
+void MixerSoundDriver::finish_buffer(Voice& voice) {
+    voice.processed.push_back(voice.queued.front());
+    voice.queued.erase(voice.queued.begin());
+    voice.position = 0.0;
+
+    if(voice.queued.empty()) {
+        voice.playing = false;
+        voice.real = false;
+    }
+}
+
+void MixerSoundDriver::mix_voice(Voice& voice, float* out, uint32_t frames) {
+    const float gain = voice.audibility;
+
+    while(frames && !voice.queued.empty()) {
+        auto it = buffers_.find(voice.queued.front());
+        if(it == buffers_.end() || it->second.samples.empty()) {
+            finish_buffer(voice);
+            continue;
+        }
+
+        const Buffer& buffer = it->second;
+        const std::size_t available = buffer.frames();
+        const double step = double(buffer.frequency) / double(sample_rate_);
+
+        const float* in = nullptr;
+        std::size_t count = 0;
+
+        if(buffer.frequency == sample_rate_) {
+            // The common case, mix straight from the buffer
+            const std::size_t start = std::size_t(voice.position);
+            count = std::min<std::size_t>(frames, available - start);
+            in = &buffer.samples[start * buffer.channels];
+            voice.position += count;
+        } else {
+            // Linearly resample into scratch space first
+            resampled_.resize(frames * buffer.channels);
+
+            const float* samples = &buffer.samples[0];
+            while(count < frames && voice.position < available) {
+                const std::size_t i0 = std::size_t(voice.position);
+                const std::size_t i1 = std::min(i0 + 1, available - 1);
+                const float t = float(voice.position - i0);
+
+                for(uint8_t c = 0; c < buffer.channels; ++c) {
+                    const float a = samples[i0 * buffer.channels + c];
+                    const float b = samples[i1 * buffer.channels + c];
+                    resampled_[count * buffer.channels + c] = a + (b - a) * t;
+                }
+
+                ++count;
+                voice.position += step;
+            }
+
+            in = &resampled_[0];
+        }
+
+        if(buffer.channels == 2) {
+            mix::accumulate_stereo(out, in, count, gain, gain);
+        } else {
+            mix::accumulate_mono(out, in, count, gain, gain);
+        }
+
+        out += count * 2;
+        frames -= count;
+
+        if(voice.position >= available) {
+            finish_buffer(voice);
+        }
+    }
+}
+
+void MixerSoundDriver::advance_voice(Voice& voice, uint32_t frames) {
+    while(frames && !voice.queued.empty()) {
+        auto it = buffers_.find(voice.queued.front());
+        if(it == buffers_.end() || it->second.samples.empty()) {
+            finish_buffer(voice);
+            continue;
+        }
+
+        const Buffer& buffer = it->second;
+        const double step = double(buffer.frequency) / double(sample_rate_);
+
+        // Output frames left before this buffer runs out
+        const double left = std::ceil((buffer.frames() - voice.position) / step);
+
+        if(double(frames) < left) {
+            voice.position += frames * step;
+            frames = 0;
+        } else {
+            frames -= uint32_t(left);
+            finish_buffer(voice);
+        }
+    }
+}
+
+}
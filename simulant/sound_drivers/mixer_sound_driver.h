@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+#include <memory>
+#include <vector>
+
+#include "../sound_driver.h"
+
+namespace smlt {
+
+enum MixerOutput {
+    /* Nothing pulls from the mixer, the owner calls mix() itself */
+    MIXER_OUTPUT_MANUAL,
+
+    /* A thread mixes in real time and throws the result away. For headless
+     * runs (tests, benchmarks, machines without an audio device) */
+    MIXER_OUTPUT_NULL,
+
+    /* A thread streams the mix to a device driver (e.g. OpenAL) through one
+     * of its sources and a small ring of queued buffers */
+    MIXER_OUTPUT_DEVICE
+};
+
+/*
+ * A sound driver which mixes sources on the CPU.
+ *
+ * Sources are cheap logical voices, there can be any number of them. Each
+ * mix only the hardware_voices most audible playing sources (gain attenuated
+ * by distance) are actually mixed. The rest are virtual: they keep their
+ * place in their buffers but cost nothing, and become real again when
+ * something louder stops. A real voice pushed out by a louder one is counted
+ * as stolen.
+ *
+ * With a device driver the mixer is the real driver: however many sources
+ * are playing, the device only ever sees one source and
+ * DEVICE_OUTPUT_BUFFERS buffers.
+ */
+class MixerSoundDriver : public SoundDriver {
+public:
+    const static uint32_t DEFAULT_HARDWARE_VOICES = 32;
+    const static uint32_t DEFAULT_SAMPLE_RATE = 44100;
+
+    /* The ring of buffers streamed to the device, about 23ms each at the
+     * default sample rate */
+    const static uint32_t DEVICE_OUTPUT_BUFFERS = 4;
+    const static uint32_t DEVICE_OUTPUT_FRAMES = 1024;
+
+    MixerSoundDriver(
+        Window* window,
+        MixerOutput output=MIXER_OUTPUT_NULL,
+        uint32_t hardware_voices=DEFAULT_HARDWARE_VOICES,
+        uint32_t sample_rate=DEFAULT_SAMPLE_RATE
+    );
+
+    /* Mixes into `device`, which the mixer starts up and shuts down */
+    MixerSoundDriver(
+        Window* window,
+        std::shared_ptr<SoundDriver> device,
+        uint32_t hardware_voices=DEFAULT_HARDWARE_VOICES,
+        uint32_t sample_rate=DEFAULT_SAMPLE_RATE
+    );
+
+    ~MixerSoundDriver();
+
+    bool startup() override;
+    void shutdown() override;
+
+    std::vector<AudioSourceID> generate_sources(uint32_t count) override;
+    std::vector<AudioBufferID> generate_buffers(uint32_t count) override;
+
+    void delete_buffers(const std::vector<AudioBufferID>& buffers) override;
+    void delete_sources(const std::vector<AudioSourceID>& sources) override;
+
+    void play_source(AudioSourceID source_id) override;
+    void stop_source(AudioSourceID source_id) override;
+
+    void queue_buffers_to_source(AudioSourceID source, uint32_t count, const std::vector<AudioBufferID>& buffers) override;
+    std::vector<AudioBufferID> unqueue_buffers_from_source(AudioSourceID source, uint32_t count) override;
+    void upload_buffer_data(AudioBufferID buffer, AudioDataFormat format, int16_t* data, uint32_t size, uint32_t frequency) override;
+
+    AudioSourceState source_state(AudioSourceID source) override;
+    int32_t source_buffers_processed_count(AudioSourceID source) const override;
+
+    void set_source_gain(AudioSourceID source, float gain) override;
+    void set_source_distance(AudioSourceID source, float distance) override;
+
+    /* Mixes the next `frames` frames of interleaved stereo into out (which
+     * may be null to just advance time). Returns the number of voices mixed. */
+    uint32_t mix(int16_t* out, uint32_t frames);
+
+    uint32_t sample_rate() const { return sample_rate_; }
+    uint32_t hardware_voice_count() const { return hardware_voices_; }
+
+    /* As of the last mix */
+    uint32_t real_voice_count() const { return real_voice_count_; }
+    uint32_t virtual_voice_count() const { return virtual_voice_count_; }
+
+    /* Total since startup */
+    uint32_t stolen_voice_count() const { return stolen_voice_count_; }
+
+private:
+    struct Buffer {
+        /* Interleaved when there are two channels */
+        std::vector<float> samples;
+        uint8_t channels = 1;
+        uint32_t frequency = 0;
+
+        std::size_t frames() const { return samples.size() / channels; }
+    };
+
+    struct Voice {
+        std::vector<AudioBufferID> queued;
+        std::vector<AudioBufferID> processed;
+
+        /* Position in the front queued buffer, in that buffer's frames */
+        double position = 0.0;
+
+        float gain = 1.0f;
+        float distance = 0.0f;
+        float audibility = 0.0f;
+
+        bool playing = false;
+        bool real = false;
+    };
+
+    MixerOutput output_;
+    uint32_t hardware_voices_;
+    uint32_t sample_rate_;
+
+    mutable std::mutex mutex_;
+
+    AudioSourceID next_source_id_ = 1;
+    AudioBufferID next_buffer_id_ = 1;
+
+    std::unordered_map<AudioSourceID, Voice> voices_;
+    std::unordered_map<AudioBufferID, Buffer> buffers_;
+
+    /* Reused between mixes */
+    std::vector<Voice*> active_;
+    std::vector<float> accumulator_;
+    std::vector<float> resampled_;
+
+    std::atomic<uint32_t> real_voice_count_;
+    std::atomic<uint32_t> virtual_voice_count_;
+    std::atomic<uint32_t> stolen_voice_count_;
+
+    std::shared_ptr<SoundDriver> device_;
+    AudioSourceID device_source_ = 0;
+    std::vector<AudioBufferID> device_buffers_;
+    std::vector<int16_t> device_pcm_;
+
+    std::thread thread_;
+    std::mutex thread_mutex_;
+    std::condition_variable thread_cv_;
+    bool stopping_ = false;
+
+    void run_null_output();
+
+    bool start_device_output();
+    void stop_device_output();
+    void run_device_output();
+    void fill_device_buffer(AudioBufferID buffer);
+
+    void mix_voice(Voice& voice, float* out, uint32_t frames);
+    void advance_voice(Voice& voice, uint32_t frames);
+    void finish_buffer(Voice& voice);
+};
+
+}
@@ -81,7 +81,8 @@ void OpenALSoundDriver::upload_buffer_data(AudioBufferID buffer, AudioDataFormat
         throw std::runtime_error("Invalid format");
     }
 
-    ALCheck(alBufferData, buffer, al_format, &data[0], size * sizeof(int16_t), frequency);
+    // size is in bytes
+    ALCheck(alBufferData, buffer, al_format, &data[0], size, frequency);
 }
 
 AudioSourceState OpenALSoundDriver::source_state(AudioSourceID source) {
@@ -103,4 +104,8 @@ int32_t OpenALSoundDriver::source_buffers_processed_count(AudioSourceID source)
     return processed;
 }
 
+void OpenALSoundDriver::set_source_gain(AudioSourceID source, float gain) {
+    ALCheck(alSourcef, source, AL_GAIN, gain);
+}
+
 }
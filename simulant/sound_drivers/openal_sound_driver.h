@@ -36,6 +36,8 @@ public:
     AudioSourceState source_state(AudioSourceID source) override;
     int32_t source_buffers_processed_count(AudioSourceID source) const override;
 
+    void set_source_gain(AudioSourceID source, float gain) override;
+
 private:
     ALCdevice* dev = nullptr;
     ALCcontext* ctx = nullptr;
@@ -37,6 +37,8 @@
 #include "partitioners/spatial_hash.h"
 #include "partitioners/frustum_partitioner.h"
 #include "renderers/batching/render_queue.h"
+#include "generic/threading/thread_pool.h"
+#include "profiler.h"
 
 namespace smlt {
 
@@ -54,7 +56,8 @@ Stage::Stage(StageID id, Window *parent, AvailablePartitioner partitioner):
     fog_(new FogSettings()),
     geom_manager_(new GeomManager()),
     sky_manager_(new SkyManager(parent, this)),
-    sprite_manager_(new SpriteManager(parent, this)) {
+    sprite_manager_(new SpriteManager(parent, this)),
+    tilemap_manager_(new TilemapManager(parent, this)) {
 
     set_partitioner(partitioner);
     render_queue_.reset(new batcher::RenderQueue(this, parent->renderer.get()));
@@ -286,6 +289,39 @@ ParticleSystemPtr Stage::delete_particle_system(ParticleSystemID pid) {
     return nullptr;
 }
 
+void Stage::_run_particle_simulations() {
+    if(queued_particle_systems_.empty()) {
+        return;
+    }
+
+    S_PROFILE_SCOPE("particle_simulation");
+
+    // Systems can be deleted between queuing and now, so look them up again
+    auto& systems = simulating_particle_systems_;
+    systems.clear();
+    for(auto pid: queued_particle_systems_) {
+        if(has_particle_system(pid)) {
+            systems.push_back(particle_system(pid));
+        }
+    }
+    queued_particle_systems_.clear();
+
+    // Systems share no state, so each one is a separate job. This returns
+    // once they're all done, so the vertex data is ready before rendering.
+    thread::ThreadPool::global().parallel_for(0, systems.size(), [&systems](std::size_t first, std::size_t last) {
+        for(auto i = first; i < last; ++i) {
+            systems[i]->_simulate();
+        }
+    });
+
+    // Anything that can destroy a system must happen back on this thread
+    for(auto ps: systems) {
+        ps->_finish_simulation();
+    }
+
+    systems.clear();
+}
+
 LightPtr Stage::new_light_as_directional(const Vec3& direction, const smlt::Colour& colour) {
     auto light = LightManager::make(this).fetch();
     auto light_id = light->id();
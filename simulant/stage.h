@@ -30,6 +30,7 @@
 #include "managers/window_holder.h"
 #include "managers/skybox_manager.h"
 #include "managers/sprite_manager.h"
+#include "managers/tilemap_manager.h"
 
 #include "nodes/stage_node.h"
 #include "nodes/light.h"
@@ -142,6 +143,12 @@ public:
     ParticleSystemPtr delete_particle_system(ParticleSystemID pid);
     std::size_t particle_system_count() const { return ParticleSystemManager::count(); }
 
+    /* Particle systems queue themselves during update(), and are simulated
+     * together by _run_particle_simulations() once the tree walk is done,
+     * spread across ThreadPool::global() */
+    void _queue_particle_simulation(ParticleSystemID pid) { queued_particle_systems_.push_back(pid); }
+    void _run_particle_simulations();
+
     LightPtr new_light_as_directional(const Vec3& direction=Vec3(1, -0.5, 0), const smlt::Colour& colour=DEFAULT_LIGHT_COLOUR);
     LightPtr new_light_as_point(const Vec3& position=Vec3(), const smlt::Colour& colour=DEFAULT_LIGHT_COLOUR);
 
@@ -166,6 +173,7 @@ public:
     Property<Stage, ui::UIManager> ui = {this, &Stage::ui_};
     Property<Stage, SkyManager> skies = {this, &Stage::sky_manager_};
     Property<Stage, SpriteManager> sprites = {this, &Stage::sprite_manager_};
+    Property<Stage, TilemapManager> tilemaps = {this, &Stage::tilemap_manager_};
     Property<Stage, FogSettings> fog = {this, &Stage::fog_};
 
     bool init() override;
@@ -227,9 +235,13 @@ private:
     std::unique_ptr<GeomManager> geom_manager_;
     std::unique_ptr<SkyManager> sky_manager_;
     std::unique_ptr<SpriteManager> sprite_manager_;
+    std::unique_ptr<TilemapManager> tilemap_manager_;
 
     generic::DataCarrier data_;
 
+    std::vector<ParticleSystemID> queued_particle_systems_;
+    std::vector<ParticleSystem*> simulating_particle_systems_;
+
 private:
     void on_actor_created(ActorID actor_id);
     void on_actor_destroyed(ActorID actor_id);
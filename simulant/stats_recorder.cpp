@@ -1,5 +1,10 @@
-#include "meshes/mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
 #include "stats_recorder.h"
+#include "time_keeper.h"
 
 namespace smlt {
 
@@ -22,9 +27,259 @@ void StatsRecorder::increment_polygons_rendered(MeshArrangement arrangement, uin
     case MESH_ARRANGEMENT_LINE_STRIP:
         increment = element_count - 1;
     break;
+    case MESH_ARRANGEMENT_POINTS:
+        increment = element_count;
+    break;
     }
 
     polygons_rendered_ += increment;
 }
 
+const char* frame_phase_name(FramePhase phase) {
+    switch(phase) {
+        case FRAME_PHASE_EVENTS: return "events";
+        case FRAME_PHASE_ASSET_UPDATES: return "asset_updates";
+        case FRAME_PHASE_FIXED_UPDATES: return "fixed_updates";
+        case FRAME_PHASE_UPDATES: return "updates";
+        case FRAME_PHASE_IDLE: return "idle";
+        case FRAME_PHASE_GARBAGE_COLLECTION: return "garbage_collection";
+        case FRAME_PHASE_RENDER: return "render";
+        case FRAME_PHASE_SWAP: return "swap";
+        default: return "unknown";
+    }
+}
+
+void StatsRecorder::begin_frame() {
+    current_ = FrameTimings();
+
+    if(!last_frame_end_us_) {
+        last_frame_end_us_ = TimeKeeper::now_in_us();
+    }
+}
+
+void StatsRecorder::end_frame() {
+    auto now = TimeKeeper::now_in_us();
+
+    current_.frame_number = next_frame_number_;
+    current_.frame_ms = float(now - last_frame_end_us_) * 0.001f;
+    last_frame_end_us_ = now;
+
+    record_frame(current_);
+    current_ = FrameTimings();
+}
+
+void StatsRecorder::discard_frame() {
+    last_frame_end_us_ = TimeKeeper::now_in_us();
+    current_ = FrameTimings();
+}
+
+void StatsRecorder::record_frame(const FrameTimings& timings) {
+    next_frame_number_ = timings.frame_number + 1;
+
+    history_.push_back(timings);
+    while(history_.size() > history_size_) {
+        history_.pop_front();
+    }
+
+    if(timings.frame_ms > hitch_threshold_ms_) {
+        FrameHitch hitch;
+        hitch.timings = timings;
+
+        float worst = 0.0f;
+        for(uint32_t i = 0; i < FRAME_PHASE_MAX; ++i) {
+            if(timings.phase_ms[i] > worst) {
+                worst = timings.phase_ms[i];
+                hitch.worst_phase = (FramePhase) i;
+            }
+        }
+
+        hitch_count_++;
+        hitches_by_phase_[hitch.worst_phase]++;
+
+        const uint32_t MAX_RECENT_HITCHES = 64;
+        recent_hitches_.push_back(hitch);
+        if(recent_hitches_.size() > MAX_RECENT_HITCHES) {
+            recent_hitches_.pop_front();
+        }
+    }
+}
+
+void StatsRecorder::set_frame_history_size(uint32_t frames) {
+    history_size_ = std::max(frames, 1u);
+    while(history_.size() > history_size_) {
+        history_.pop_front();
+    }
+}
+
+void StatsRecorder::reset_frame_stats() {
+    history_.clear();
+    recent_hitches_.clear();
+    hitch_count_ = 0;
+    std::fill(hitches_by_phase_, hitches_by_phase_ + FRAME_PHASE_MAX + 1, 0);
+}
+
+FrameTimeStats StatsRecorder::calculate_stats(std::vector<float>& values) const {
+    FrameTimeStats stats;
+    if(values.empty()) {
+        return stats;
+    }
+
+    std::sort(values.begin(), values.end());
+
+    /* Nearest-rank percentiles */
+    auto percentile = [&values](float p) -> float {
+        std::size_t rank = std::size_t(std::ceil(p * values.size()));
+        return values[std::min(std::max(rank, std::size_t(1)), values.size()) - 1];
+    };
+
+    float total = 0.0f;
+    for(auto v: values) {
+        total += v;
+    }
+
+    stats.samples = values.size();
+    stats.mean = total / float(values.size());
+    stats.p50 = percentile(0.50f);
+    stats.p95 = percentile(0.95f);
+    stats.p99 = percentile(0.99f);
+    stats.max = values.back();
+    return stats;
+}
+
+FrameTimeStats StatsRecorder::frame_time_stats() const {
+    std::vector<float> values;
+    values.reserve(history_.size());
+    for(auto& frame: history_) {
+        values.push_back(frame.frame_ms);
+    }
+
+    return calculate_stats(values);
+}
+
+FrameTimeStats StatsRecorder::phase_time_stats(FramePhase phase) const {
+    std::vector<float> values;
+    values.reserve(history_.size());
+    for(auto& frame: history_) {
+        values.push_back(frame.phase_ms[phase]);
+    }
+
+    return calculate_stats(values);
+}
+
+std::vector<uint32_t> StatsRecorder::frame_time_histogram(float bucket_ms, uint32_t bucket_count) const {
+    std::vector<uint32_t> buckets(bucket_count, 0);
+    if(!bucket_count || bucket_ms <= 0.0f) {
+        return buckets;
+    }
+
+    for(auto& frame: history_) {
+        uint32_t bucket = std::min(uint32_t(frame.frame_ms / bucket_ms), bucket_count - 1);
+        buckets[bucket]++;
+    }
+
+    return buckets;
+}
+
+void StatsRecorder::write_frame_history_csv(std::ostream& stream) const {
+    stream << "frame,frame_ms";
+    for(uint32_t i = 0; i < FRAME_PHASE_MAX; ++i) {
+        stream << "," << frame_phase_name((FramePhase) i) << "_ms";
+    }
+    stream << ",objects_collected,textures_uploaded,texture_bytes_uploaded\n";
+
+    stream << std::setiosflags(std::ios::fixed) << std::setprecision(3);
+
+    for(auto& frame: history_) {
+        stream << frame.frame_number << "," << frame.frame_ms;
+        for(uint32_t i = 0; i < FRAME_PHASE_MAX; ++i) {
+            stream << "," << frame.phase_ms[i];
+        }
+        stream << "," << frame.objects_collected
+               << "," << frame.textures_uploaded
+               << "," << frame.texture_bytes_uploaded << "\n";
+    }
+}
+
+static void write_stats_json(std::ostream& stream, const FrameTimeStats& stats) {
+    stream << "{\"samples\":" << stats.samples
+           << ",\"mean\":" << stats.mean
+           << ",\"p50\":" << stats.p50
+           << ",\"p95\":" << stats.p95
+           << ",\"p99\":" << stats.p99
+           << ",\"max\":" << stats.max << "}";
+}
+
+void StatsRecorder::write_frame_stats_json(std::ostream& stream) const {
+    stream << std::setiosflags(std::ios::fixed) << std::setprecision(3);
+
+    stream << "{\"hitch_threshold_ms\":" << hitch_threshold_ms_
+           << ",\"hitch_count\":" << hitch_count_
+           << ",\"pcm_cache\":{\"hits\":" << pcm_cache_hits_
+           << ",\"misses\":" << pcm_cache_misses_
+           << ",\"hit_rate\":" << pcm_cache_hit_rate()
+           << ",\"bytes\":" << pcm_cache_bytes_ << "}"
+           << ",\"frame_ms\":";
+
+    write_stats_json(stream, frame_time_stats());
+
+    stream << ",\"phases\":{";
+    for(uint32_t i = 0; i < FRAME_PHASE_MAX; ++i) {
+        if(i) stream << ",";
+        stream << "\"" << frame_phase_name((FramePhase) i) << "\":";
+        write_stats_json(stream, phase_time_stats((FramePhase) i));
+    }
+    stream << "}";
+
+    stream << ",\"hitches_by_phase\":{";
+    for(uint32_t i = 0; i < FRAME_PHASE_MAX; ++i) {
+        if(i) stream << ",";
+        stream << "\"" << frame_phase_name((FramePhase) i) << "\":" << hitches_by_phase_[i];
+    }
+    stream << "}";
+
+    stream << ",\"recent_hitches\":[";
+    bool first = true;
+    for(auto& hitch: recent_hitches_) {
+        if(!first) stream << ",";
+        first = false;
+
+        stream << "{\"frame\":" << hitch.timings.frame_number
+               << ",\"frame_ms\":" << hitch.timings.frame_ms
+               << ",\"worst_phase\":\"" << frame_phase_name(hitch.worst_phase) << "\""
+               << ",\"worst_phase_ms\":" << ((hitch.worst_phase < FRAME_PHASE_MAX) ? hitch.timings.phase_ms[hitch.worst_phase] : 0.0f)
+               << ",\"objects_collected\":" << hitch.timings.objects_collected
+               << ",\"textures_uploaded\":" << hitch.timings.textures_uploaded
+               << ",\"texture_bytes_uploaded\":" << hitch.timings.texture_bytes_uploaded
+               << "}";
+    }
+    stream << "]}\n";
+}
+
+bool StatsRecorder::dump_frame_stats(const std::string& filename) const {
+    std::ofstream file(filename.c_str());
+    if(!file.good()) {
+        return false;
+    }
+
+    const std::string ext = ".json";
+    if(filename.size() >= ext.size() && filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0) {
+        write_frame_stats_json(file);
+    } else {
+        write_frame_history_csv(file);
+    }
+
+    return file.good();
+}
+
+FramePhaseTimer::FramePhaseTimer(StatsRecorder* stats, FramePhase phase):
+    stats_(stats),
+    phase_(phase),
+    start_us_(TimeKeeper::now_in_us()) {
+
+}
+
+FramePhaseTimer::~FramePhaseTimer() {
+    stats_->add_phase_time(phase_, float(TimeKeeper::now_in_us() - start_us_) * 0.001f);
+}
+
 }
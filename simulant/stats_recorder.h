@@ -1,12 +1,123 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
+#include <vector>
+#include <string>
+#include <ostream>
+
 #include "types.h"
 
 namespace smlt {
 
+enum FramePhase {
+    FRAME_PHASE_EVENTS,
+    FRAME_PHASE_ASSET_UPDATES,
+    FRAME_PHASE_FIXED_UPDATES,
+    FRAME_PHASE_UPDATES,
+    FRAME_PHASE_IDLE,
+    FRAME_PHASE_GARBAGE_COLLECTION,
+    FRAME_PHASE_RENDER,
+    FRAME_PHASE_SWAP,
+    FRAME_PHASE_MAX
+};
+
+const char* frame_phase_name(FramePhase phase);
+
+struct FrameTimings {
+    uint64_t frame_number = 0;
+
+    /* Time since the end of the previous frame, this is what the
+     * player sees and what hitches are measured against */
+    float frame_ms = 0.0f;
+    float phase_ms[FRAME_PHASE_MAX] = {0};
+
+    uint32_t objects_collected = 0;
+    uint32_t textures_uploaded = 0;
+    uint64_t texture_bytes_uploaded = 0;
+};
+
+struct FrameTimeStats {
+    uint32_t samples = 0;
+    float mean = 0.0f;
+    float p50 = 0.0f;
+    float p95 = 0.0f;
+    float p99 = 0.0f;
+    float max = 0.0f;
+};
+
+struct FrameHitch {
+    FrameTimings timings;
+
+    /* The phase which took the longest during the hitch */
+    FramePhase worst_phase = FRAME_PHASE_MAX;
+
+    bool caused_by_garbage_collection() const {
+        return worst_phase == FRAME_PHASE_GARBAGE_COLLECTION && timings.objects_collected > 0;
+    }
+
+    bool caused_by_texture_upload() const {
+        return worst_phase == FRAME_PHASE_RENDER && timings.textures_uploaded > 0;
+    }
+};
+
 class StatsRecorder {
 public:
+    /* Frame timing: the Window calls begin_frame, wraps each phase in a
+     * FramePhaseTimer and calls end_frame. record_frame can be used directly
+     * to feed in timings from elsewhere. */
+    void begin_frame();
+    void end_frame();
+
+    /* Ends the current frame without recording it (e.g. the first frame,
+     * which includes startup costs) */
+    void discard_frame();
+
+    void add_phase_time(FramePhase phase, float ms) {
+        current_.phase_ms[phase] += ms;
+    }
+
+    void record_garbage_collected(uint32_t object_count) {
+        current_.objects_collected += object_count;
+    }
+
+    void record_texture_upload(uint64_t bytes) {
+        current_.textures_uploaded++;
+        current_.texture_bytes_uploaded += bytes;
+    }
+
+    void record_frame(const FrameTimings& timings);
+
+    /* The number of frames kept for the percentile calculations */
+    void set_frame_history_size(uint32_t frames);
+    uint32_t frame_history_size() const { return history_size_; }
+    const std::deque<FrameTimings>& frame_history() const { return history_; }
+
+    void set_hitch_threshold_ms(float ms) { hitch_threshold_ms_ = ms; }
+    float hitch_threshold_ms() const { return hitch_threshold_ms_; }
+
+    /* Hitches since startup (not just within the history) */
+    uint64_t hitch_count() const { return hitch_count_; }
+    uint64_t hitch_count(FramePhase worst_phase) const { return hitches_by_phase_[worst_phase]; }
+
+    /* The most recent hitches, oldest first */
+    const std::deque<FrameHitch>& recent_hitches() const { return recent_hitches_; }
+
+    FrameTimeStats frame_time_stats() const;
+    FrameTimeStats phase_time_stats(FramePhase phase) const;
+
+    /* Counts of frames in bucket_ms wide buckets, the last bucket also
+     * counts every frame that's longer */
+    std::vector<uint32_t> frame_time_histogram(float bucket_ms, uint32_t bucket_count) const;
+
+    void write_frame_history_csv(std::ostream& stream) const;
+    void write_frame_stats_json(std::ostream& stream) const;
+
+    /* Writes JSON if the filename ends with .json, otherwise CSV */
+    bool dump_frame_stats(const std::string& filename) const;
+
+    void reset_frame_stats();
+
     uint32_t geometry_visible() const {
         return geometry_visible_;
     }
@@ -45,6 +156,32 @@ public:
         return polygons_rendered_;
     }
 
+    void reset_draw_calls() {
+        draw_calls_ = 0;
+    }
+
+    void increment_draw_calls() { draw_calls_++; }
+    uint32_t draw_calls() const {
+        return draw_calls_;
+    }
+
+    /* Decoded sound cache, kept up to date by the PCMCache */
+    void set_pcm_cache_stats(uint64_t hits, uint64_t misses, uint64_t bytes) {
+        pcm_cache_hits_ = hits;
+        pcm_cache_misses_ = misses;
+        pcm_cache_bytes_ = bytes;
+    }
+
+    uint64_t pcm_cache_hits() const { return pcm_cache_hits_; }
+    uint64_t pcm_cache_misses() const { return pcm_cache_misses_; }
+    uint64_t pcm_cache_bytes() const { return pcm_cache_bytes_; }
+
+    /* Between 0 and 1, zero if nothing has been looked up yet */
+    float pcm_cache_hit_rate() const {
+        const uint64_t total = pcm_cache_hits_ + pcm_cache_misses_;
+        return (total) ? float(pcm_cache_hits_) / float(total) : 0.0f;
+    }
+
 private:
     float frame_time_ = 0;
     uint32_t subactors_renderered_ = 0;
@@ -55,6 +192,41 @@ private:
     uint64_t frames_run_ = 0;
 
     uint32_t polygons_rendered_ = 0;
+    uint32_t draw_calls_ = 0;
+
+    uint64_t pcm_cache_hits_ = 0;
+    uint64_t pcm_cache_misses_ = 0;
+    uint64_t pcm_cache_bytes_ = 0;
+
+    FrameTimings current_;
+    uint64_t last_frame_end_us_ = 0;
+    uint64_t next_frame_number_ = 0;
+
+    uint32_t history_size_ = 1024;
+    std::deque<FrameTimings> history_;
+
+    float hitch_threshold_ms_ = 1000.0f / 30.0f;
+    uint64_t hitch_count_ = 0;
+    uint64_t hitches_by_phase_[FRAME_PHASE_MAX + 1] = {0};
+    std::deque<FrameHitch> recent_hitches_;
+
+    FrameTimeStats calculate_stats(std::vector<float>& values) const;
+};
+
+/* Adds the time between construction and destruction to a phase of the
+ * current frame */
+class FramePhaseTimer {
+public:
+    FramePhaseTimer(StatsRecorder* stats, FramePhase phase);
+    ~FramePhaseTimer();
+
+    FramePhaseTimer(const FramePhaseTimer&) = delete;
+    FramePhaseTimer& operator=(const FramePhaseTimer&) = delete;
+
+private:
+    StatsRecorder* stats_;
+    FramePhase phase_;
+    uint64_t start_us_;
 };
 
 
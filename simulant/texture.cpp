@@ -18,11 +18,13 @@
 //
 
 #include <cassert>
+#include <algorithm>
 #include <stdexcept>
 
 #include "utils/gl_thread_check.h"
 #include "utils/gl_error.h"
 #include "utils/memory.h"
+#include "utils/texel_kernels.h"
 
 #include "deps/kazlog/kazlog.h"
 #include "deps/SOIL/SOIL.h"
@@ -68,8 +70,9 @@ void Texture::set_format(TextureFormat format, TextureTexelType texel_type) {
 
     data_.resize(width_ * height_ * bytes_per_pixel());
     data_.shrink_to_fit();
+    mipmaps_.clear();
 
-    data_dirty_ = true;
+    mark_data_changed();
 }
 
 void Texture::resize(uint32_t width, uint32_t height, uint32_t data_size) {
@@ -81,7 +84,8 @@ void Texture::resize(uint32_t width, uint32_t height, uint32_t data_size) {
     height_ = height;
     data_.resize(data_size);
     data_.shrink_to_fit();
-    data_dirty_ = true;
+    mipmaps_.clear();
+    mark_data_changed();
 }
 
 void Texture::resize(uint32_t width, uint32_t height) {
@@ -98,124 +102,134 @@ void Texture::resize(uint32_t width, uint32_t height) {
 
     data_.resize(width * height * bytes_per_pixel());
     data_.shrink_to_fit();
+    mipmaps_.clear();
 
-    data_dirty_ = true;
+    mark_data_changed();
 }
 
-static void explode_r8(uint8_t* source, const TextureChannelSet& channels, float& r, float& g, float& b, float& a) {
-    float sr = float(*source) / 255.0f;
-
-    auto calculate_component = [&channels](uint8_t i, float sr, float sg, float sb, float sa) -> float {
-        switch(channels[i]) {
-            case TEXTURE_CHANNEL_ZERO: return 0.0f;
-            case TEXTURE_CHANNEL_ONE: return 1.0f;
-            case TEXTURE_CHANNEL_RED: return sr;
-            case TEXTURE_CHANNEL_GREEN: return sg;
-            case TEXTURE_CHANNEL_BLUE: return sb;
-            case TEXTURE_CHANNEL_ALPHA: return sa;
-            default:
-                return 0.0f;
-        }
-    };
+void Texture::convert(TextureFormat new_format, const TextureChannelSet &channels) {
+    if(data_.empty()) {
+        throw std::logic_error("Tried to convert a texture with no data");
+    }
 
-    r = calculate_component(0, sr, 0, 0, 0);
-    g = calculate_component(1, sr, 0, 0, 0);
-    b = calculate_component(2, sr, 0, 0, 0);
-    a = calculate_component(3, sr, 0, 0, 0);
-}
+    if(!texels::can_convert(format_, new_format)) {
+        throw std::logic_error("Unsupported texture conversion");
+    }
 
-static void compress_rgba4444(uint8_t* dest, float r, float g, float b, float a) {
-    uint16_t* out = (uint16_t*) dest;
+    auto original_format = format_;
+    auto original_data = data_;
 
-    uint8_t rr = (uint8_t) float(15) * r;
-    uint8_t rg = (uint8_t) float(15) * g;
-    uint8_t rb = (uint8_t) float(15) * b;
-    uint8_t ra = (uint8_t) float(15) * a;
+    set_format(new_format);
 
-    *out = (rr << 12) | (rg << 8) | (rb << 4) | ra;
+    texels::convert(
+        &original_data[0], original_format,
+        &data_[0], new_format,
+        width_, height_, channels
+    );
+
+    mipmaps_.clear();
+    mark_data_changed();
 }
 
-static void compress_rgba8888(uint8_t* dest, float r, float g, float b, float a) {
-    uint32_t* out = (uint32_t*) dest;
+void Texture::flip_vertically() {
+    /**
+     *  Flips the texture data vertically
+     */
+    if(data_.empty() || is_compressed()) {
+        return;
+    }
 
-    uint8_t rr = (uint8_t) float(255) * r;
-    uint8_t rg = (uint8_t) float(255) * g;
-    uint8_t rb = (uint8_t) float(255) * b;
-    uint8_t ra = (uint8_t) float(255) * a;
+    texels::flip_vertically(&data_[0], width_ * bytes_per_pixel(), height_);
 
-    *out = (rr << 24) | (rg << 16) | (rb << 8) | ra;
+    mipmaps_.clear();
 }
 
-typedef void (*ExplodeFunc)(uint8_t*, const TextureChannelSet&, float&, float&, float&, float&);
-typedef void (*CompressFunc)(uint8_t*, float, float, float, float);
-
-static const std::map<TextureFormat, ExplodeFunc> EXPLODERS = {
-    {TEXTURE_FORMAT_R8, explode_r8}
-};
-
-static const std::map<TextureFormat, CompressFunc> COMPRESSORS = {
-    {TEXTURE_FORMAT_RGBA4444, compress_rgba4444},
-    {TEXTURE_FORMAT_RGBA8888, compress_rgba8888}
-};
+void Texture::premultiply_alpha() {
+    if(format_ != TEXTURE_FORMAT_RGBA8888) {
+        throw std::logic_error("Alpha can only be premultiplied on RGBA8888 textures");
+    }
 
-void Texture::convert(TextureFormat new_format, const TextureChannelSet &channels) {
     if(data_.empty()) {
-        throw std::logic_error("Tried to convert a texture with no data");
+        return;
     }
 
-    auto original_format = format_;
-    auto original_data = data_;
+    texels::premultiply_alpha(&data_[0], width_, height_);
 
-    set_format(new_format);
+    mipmaps_.clear();
+    mark_data_changed();
+}
 
-    if(original_format == TEXTURE_FORMAT_R8 && new_format == TEXTURE_FORMAT_RGBA4444) {
-        auto source_stride = texture_format_stride(original_format);
-        auto dest_stride = texture_format_stride(new_format);
+void Texture::generate_mipmaps(MipmapFilter filter) {
+    if(is_compressed() || texel_type_ != TEXTURE_TEXEL_TYPE_UNSIGNED_BYTE) {
+        throw std::logic_error("Mipmaps can only be generated for textures with a byte per channel");
+    }
 
-        uint8_t* source_ptr = &original_data[0];
-        uint8_t* dest_ptr = &data_[0];
+    mipmap_filter_ = filter;
+    mipmaps_.clear();
 
-        auto explode = EXPLODERS.at(original_format);
-        auto compress = COMPRESSORS.at(new_format);
+    if(data_.empty()) {
+        return;
+    }
 
-        for(auto i = 0u; i < original_data.size(); i += source_stride, source_ptr += source_stride, dest_ptr += dest_stride) {
-            float r, g, b, a;
+    _rebuild_mipmaps();
+    mark_data_changed();
+}
 
-            explode(source_ptr, channels, r, g, b, a);
-            compress(dest_ptr, r, g, b, a);
-        }
-    } else {
-        throw std::logic_error("Unsupported texture conversion");
+void Texture::_rebuild_mipmaps() {
+    if(data_.empty()) {
+        mipmaps_.clear();
+        return;
     }
-}
 
-void Texture::flip_vertically() {
-    /**
-     *  Flips the texture data vertically
-     */
-    auto w = (uint32_t) width();
-    auto h = (uint32_t) height();
-    auto c = (uint32_t) channels();
+    const uint32_t levels = texels::mipmap_level_count(width_, height_);
+    const uint32_t c = channels();
 
-    auto row_size = w * c;
+    mipmaps_.resize(levels - 1);
 
-    std::vector<uint8_t> new_data(data_.size());
+    uint32_t w = width_;
+    uint32_t h = height_;
+    const uint8_t* previous = &data_[0];
 
-    auto* in = &data_[0];
-    auto* out = &new_data[row_size * (h - 1)];
+    for(uint32_t i = 1; i < levels; ++i) {
+        auto& level = mipmaps_[i - 1];
+        level.resize(std::max(w / 2, 1u) * std::max(h / 2, 1u) * c);
 
-    for(uint32_t j = 0; j < h; ++j) {
-        std::memcpy(out, in, row_size);
-        in += row_size;
-        out -= row_size;
+        // Each level is filtered from the one above it
+        texels::downsample(previous, w, h, c, &level[0], mipmap_filter_);
+
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+        previous = &level[0];
     }
+}
 
-    data_ = std::move(new_data);
+const Texture::Data& Texture::mipmap_data(uint32_t level) const {
+    if(level == 0 || level > mipmaps_.size()) {
+        throw std::out_of_range("Invalid mipmap level");
+    }
+
+    return mipmaps_[level - 1];
 }
 
 void Texture::free() {
     data_.clear();
     data_.shrink_to_fit();
+
+    mipmaps_.clear();
+    mipmaps_.shrink_to_fit();
+}
+
+std::size_t Texture::memory_usage() const {
+    if(data_.empty() && !is_compressed()) {
+        return width_ * height_ * bytes_per_pixel();
+    }
+
+    std::size_t total = data_.size();
+    for(auto& level: mipmaps_) {
+        total += level.size();
+    }
+
+    return total;
 }
 
 bool Texture::is_compressed() const {
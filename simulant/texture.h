@@ -37,6 +37,12 @@ enum MipmapGenerate {
     MIPMAP_GENERATE_COMPLETE
 };
 
+/* How CPU-side mipmaps are filtered, see Texture::generate_mipmaps */
+enum MipmapFilter {
+    MIPMAP_FILTER_BOX,
+    MIPMAP_FILTER_KAISER
+};
+
 enum TextureWrap {
     TEXTURE_WRAP_REPEAT,
     TEXTURE_WRAP_CLAMP_TO_EDGE,
@@ -96,6 +102,14 @@ enum TextureFreeData {
     TEXTURE_FREE_DATA_AFTER_UPLOAD
 };
 
+/* A rectangle of texels, y counts rows of the data buffer */
+struct TextureRegion {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
 class NoTextureLockError : public std::runtime_error {
 public:
     NoTextureLockError(const std::string& what):
@@ -196,7 +210,9 @@ public:
     TextureTexelType texel_type() const { return texel_type_; }
     TextureFormat format() const { return format_; }
 
-    /* Convert a texture to a new format and allow manipulating/filling the channels during the conversion */
+    /* Convert a texture to a new format and allow manipulating/filling the channels during the conversion.
+     * Any pair of uncompressed formats is supported, including converting to the same format to
+     * swizzle the channels */
     void convert(
         TextureFormat new_format,
         const TextureChannelSet& channels=DEFAULT_SOURCE_CHANNELS
@@ -220,6 +236,26 @@ public:
      */
     void flip_vertically();
 
+    /*
+     * Multiply the colour channels by alpha. Only RGBA8888 textures are
+     * supported, anything else throws a std::logic_error
+     */
+    void premultiply_alpha();
+
+    /*
+     * Build the full mipmap chain from the data buffer on the CPU. When
+     * these exist the renderer uploads them instead of asking the driver to
+     * generate mipmaps. They're discarded whenever the data buffer is
+     * resized, converted or freed.
+     */
+    void generate_mipmaps(MipmapFilter filter=MIPMAP_FILTER_BOX);
+
+    /* The number of CPU-side mipmap levels, not counting the base level */
+    uint32_t mipmap_count() const { return mipmaps_.size(); }
+
+    /* The data for mipmap level `level`, starting at 1 */
+    const Texture::Data& mipmap_data(uint32_t level) const;
+
     /* Clear the data buffer */
     void free();
 
@@ -253,12 +289,33 @@ public:
     /* Returns a non-const reference to the internal data buffer */
     Texture::Data& data() { return data_; }
 
+    /* Approximate memory used by the texture. This is the size of the data
+     * buffer or, if that has been freed after upload, the size of the texture
+     * on the GPU */
+    std::size_t memory_usage() const;
+
     /*
      * Mark the data as changed so it will be reuploaded to the GPU
      * by the renderer
      */
     void mark_data_changed() {
         data_dirty_ = true;
+        dirty_regions_.clear();
+    }
+
+    /*
+     * Mark part of the data as changed. Once the texture has been uploaded
+     * the renderer will only upload the changed regions, the data must not
+     * be freed after upload for this to be any use (see set_free_data_mode)
+     */
+    void mark_data_changed(const TextureRegion& region) {
+        if(data_dirty_ && dirty_regions_.empty()) {
+            // The whole texture is being uploaded anyway
+            return;
+        }
+
+        data_dirty_ = true;
+        dirty_regions_.push_back(region);
     }
 
     /*
@@ -335,6 +392,15 @@ public:
      */
     void _set_data_clean() {
         data_dirty_ = false;
+        dirty_regions_.clear();
+    }
+
+    /*
+     * INTERNAL: the regions changed since the last upload. If the data is
+     * dirty and this is empty, the whole texture must be uploaded
+     */
+    const std::vector<TextureRegion>& _dirty_regions() const {
+        return dirty_regions_;
     }
 
 
@@ -343,6 +409,11 @@ public:
     void cleanup() override;
     void update(float dt) override;
 
+    /* Rebuilds the CPU-side mipmaps from the data buffer with the filter
+     * they were generated with, without marking the data as changed. Used
+     * by renderers when only part of the data has changed. */
+    void _rebuild_mipmaps();
+
     void _set_has_mipmaps(bool v) {
         has_mipmaps_ = v;
     }
@@ -361,6 +432,23 @@ public:
         return auto_upload_;
     }
 
+    /*
+     * Upload the texture a mipmap level at a time, at the resolution it's
+     * drawn at, rather than all at once (see TextureStreamer). Mipmaps are
+     * generated on the CPU if there aren't any, and the data is kept after
+     * upload whatever the free data mode.
+     */
+    void set_streaming_enabled(bool v=true) {
+        if(streaming_enabled_ != v) {
+            streaming_enabled_ = v;
+            mark_data_changed();
+        }
+    }
+
+    bool streaming_enabled() const {
+        return streaming_enabled_;
+    }
+
 private:
     Renderer* renderer_ = nullptr;
 
@@ -373,8 +461,12 @@ private:
     unicode source_;
 
     bool auto_upload_ = true; /* If true, the texture is uploaded by the renderer asap */
+    bool streaming_enabled_ = false;
     bool data_dirty_ = true;
+    std::vector<TextureRegion> dirty_regions_;
     Texture::Data data_;
+    std::vector<Texture::Data> mipmaps_;
+    MipmapFilter mipmap_filter_ = MIPMAP_FILTER_BOX;
     TextureFreeData free_data_mode_ = TEXTURE_FREE_DATA_AFTER_UPLOAD;
 
     MipmapGenerate mipmap_generation_ = MIPMAP_GENERATE_COMPLETE;
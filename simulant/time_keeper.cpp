@@ -1,8 +1,10 @@
 #ifdef _arch_dreamcast
 #include <kos.h>
+#else
+#include <chrono>
 #endif
 
-#include <iostream>
+#include <algorithm>
 #include "time_keeper.h"
 
 namespace smlt {
@@ -21,12 +23,12 @@ uint64_t TimeKeeper::now_in_us() {
 #endif
 }
 
+uint64_t TimeKeeper::current_time_us() const {
+    return now_in_us();
+}
+
 bool TimeKeeper::init() {
-#ifdef _arch_dreamcast
-    last_update_ = timer_us_gettime64();
-#else
-    last_update_ = std::chrono::high_resolution_clock::now();
-#endif
+    last_update_ = current_time_us();
     return true;
 }
 
@@ -35,20 +37,12 @@ void TimeKeeper::cleanup() {
 }
 
 void TimeKeeper::update() {
-#ifdef _arch_dreamcast
-    auto now = timer_us_gettime64();
+    auto now = current_time_us();
     auto diff = now - last_update_;
     last_update_ = now;
 
-    delta_time_ = float(diff) * 0.000001;
-#else
-    auto now = std::chrono::high_resolution_clock::now();
-    std::chrono::duration<float> seconds = now - last_update_;
-    last_update_ = now;
-
     // Store the frame time, and the total elapsed time
-    delta_time_ = seconds.count();
-#endif
+    delta_time_ = float(diff) * 0.000001f;
 
     accumulator_ += delta_time_;
     total_time_ += delta_time_;
@@ -64,6 +58,14 @@ float TimeKeeper::fixed_step_remainder() const {
     return accumulator_;
 }
 
+float TimeKeeper::fixed_step_alpha() const {
+    if(fixed_step_ <= 0.0f) {
+        return 0.0f;
+    }
+
+    return std::min(accumulator_ / fixed_step_, 1.0f);
+}
+
 bool TimeKeeper::use_fixed_step() {
     bool can_update = accumulator_ >= fixed_step_;
 
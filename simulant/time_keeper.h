@@ -1,8 +1,8 @@
 #pragma once
 
-#ifdef _arch_dreamcast
-    #include <cstdint>
-#else
+#include <cstdint>
+
+#ifndef _arch_dreamcast
     #include <chrono>
 #endif
 
@@ -15,6 +15,7 @@ class TimeKeeper:
 
 public:
     TimeKeeper(const float fixed_step);
+    virtual ~TimeKeeper() {}
 
     bool init() override;
     void cleanup() override;
@@ -23,9 +24,18 @@ public:
 
     static uint64_t now_in_us();
 
+    /* The clock update() and the frame pacer read, now_in_us() unless
+     * overridden (e.g. to control time in tests) */
+    virtual uint64_t current_time_us() const;
+
     float delta_time() const { return delta_time_; }
     float fixed_step() const { return fixed_step_; }
     float fixed_step_remainder() const;
+
+    /* How far between the last fixed step and the next one the current frame
+     * is, from 0 to 1. Use it to blend between the last two fixed step
+     * states when rendering */
+    float fixed_step_alpha() const;
     float total_elapsed_seconds() const { return total_time_; }
 
     bool use_fixed_step();
@@ -35,11 +45,7 @@ public:
     }
 
 private:
-#ifdef _arch_dreamcast
-    uint64_t last_update_;
-#else
-    std::chrono::time_point<std::chrono::high_resolution_clock> last_update_;
-#endif
+    uint64_t last_update_ = 0;
 
     float accumulator_ = 0.0f;
     float total_time_ = 0.0f;
@@ -311,7 +311,8 @@ enum MeshArrangement {
     MESH_ARRANGEMENT_TRIANGLE_FAN,
     MESH_ARRANGEMENT_TRIANGLE_STRIP,
     MESH_ARRANGEMENT_LINES,
-    MESH_ARRANGEMENT_LINE_STRIP
+    MESH_ARRANGEMENT_LINE_STRIP,
+    MESH_ARRANGEMENT_POINTS
 };
 
 enum AvailablePartitioner {
@@ -500,6 +501,9 @@ typedef std::shared_ptr<GPUProgram> GPUProgramPtr;
 class Skybox;
 typedef Skybox* SkyboxPtr;
 
+class Tilemap;
+typedef Tilemap* TilemapPtr;
+
 typedef uint32_t IdleConnectionID;
 
 typedef UniqueID<MeshPtr> MeshID;
@@ -517,6 +521,7 @@ typedef UniqueID<SpritePtr> SpriteID;
 typedef UniqueID<BackgroundPtr> BackgroundID;
 typedef UniqueID<ParticleSystemPtr> ParticleSystemID;
 typedef UniqueID<SkyboxPtr> SkyID;
+typedef UniqueID<TilemapPtr> TilemapID;
 typedef UniqueID<GPUProgramPtr> GPUProgramID;
 typedef UniqueID<ui::WidgetPtr> WidgetID;
 
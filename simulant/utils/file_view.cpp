@@ -0,0 +1,159 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+
+#if (defined(__linux__) || defined(__APPLE__)) && !defined(__ANDROID__) && !defined(_arch_dreamcast)
+#define SIMULANT_HAS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "file_view.h"
+
+namespace smlt {
+
+#ifdef SIMULANT_HAS_MMAP
+/* Small files aren't worth a mapping (and the page it wastes) */
+static const std::size_t MIN_MAPPED_SIZE = 16 * 1024;
+#endif
+
+FileView::ptr FileView::open(const std::string& path, bool text_mode) {
+#ifdef SIMULANT_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Unable to open file: " + path);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && std::size_t(info.st_size) >= MIN_MAPPED_SIZE) {
+        void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if(addr != MAP_FAILED) {
+            /* Loaders mostly read front to back */
+            madvise(addr, info.st_size, MADV_SEQUENTIAL);
+
+            ptr result(new FileView());
+            result->data_ = (const uint8_t*) addr;
+            result->size_ = info.st_size;
+            result->mapped_ = true;
+            return result;
+        }
+
+        /* Fall through and read it instead */
+    } else {
+        ::close(fd);
+    }
+#endif
+
+    std::ifstream file(path.c_str(), (text_mode) ? std::ios::in : std::ios::in | std::ios::binary);
+    if(!file) {
+        throw std::runtime_error("Unable to open file: " + path);
+    }
+
+    return from_stream(file);
+}
+
+FileView::ptr FileView::from_buffer(std::vector<uint8_t>&& buffer) {
+    ptr result(new FileView());
+    result->buffer_ = std::move(buffer);
+    result->data_ = (result->buffer_.empty()) ? nullptr : &result->buffer_[0];
+    result->size_ = result->buffer_.size();
+    return result;
+}
+
+FileView::ptr FileView::from_stream(std::istream& stream) {
+    std::vector<uint8_t> buffer;
+
+    /* Size the buffer up front if the stream can tell us how long it is */
+    auto start = stream.tellg();
+    if(start != std::istream::pos_type(-1)) {
+        stream.seekg(0, std::ios::end);
+        auto end = stream.tellg();
+        stream.seekg(start);
+
+        if(end != std::istream::pos_type(-1) && end > start) {
+            buffer.resize(std::size_t(end - start));
+            stream.read((char*) &buffer[0], buffer.size());
+            buffer.resize(stream.gcount());
+        }
+    }
+
+    if(buffer.empty()) {
+        stream.clear();
+        buffer.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    return from_buffer(std::move(buffer));
+}
+
+FileView::~FileView() {
+#ifdef SIMULANT_HAS_MMAP
+    if(mapped_) {
+        munmap((void*) data_, size_);
+    }
+#endif
+}
+
+FileViewStreamBuf::FileViewStreamBuf(const FileView& view) {
+    /* The get area is never written to, std::streambuf just isn't const-correct */
+    char* begin = (char*) view.data();
+    setg(begin, begin, begin + view.size());
+}
+
+FileViewStreamBuf::pos_type FileViewStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+    if(!(which & std::ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+
+    char* target = nullptr;
+    if(dir == std::ios_base::beg) {
+        target = eback() + off;
+    } else if(dir == std::ios_base::cur) {
+        target = gptr() + off;
+    } else {
+        target = egptr() + off;
+    }
+
+    if(target < eback() || target > egptr()) {
+        return pos_type(off_type(-1));
+    }
+
+    setg(eback(), target, egptr());
+    return pos_type(target - eback());
+}
+
+FileViewStreamBuf::pos_type FileViewStreamBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+FileViewStream::FileViewStream(FileView::ptr view):
+    std::istream(nullptr),
+    view_(view),
+    buffer_(*view) {
+
+    rdbuf(&buffer_);
+}
+
+}
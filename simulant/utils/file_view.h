@@ -0,0 +1,95 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <string>
+#include <istream>
+#include <streambuf>
+
+namespace smlt {
+
+/*
+ * A read-only view of the contents of a file. Where the platform supports it
+ * the file is memory-mapped, otherwise it's read into a buffer. Either way
+ * the bytes are contiguous and stay valid for the lifetime of the view.
+ */
+class FileView {
+public:
+    typedef std::shared_ptr<FileView> ptr;
+
+    /* Throws std::runtime_error if the file can't be opened. text_mode only
+     * affects the fallback path on platforms which translate line endings */
+    static ptr open(const std::string& path, bool text_mode=false);
+
+    static ptr from_buffer(std::vector<uint8_t>&& buffer);
+
+    /* Reads the remainder of the stream */
+    static ptr from_stream(std::istream& stream);
+
+    ~FileView();
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+
+    const uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const uint8_t* begin() const { return data_; }
+    const uint8_t* end() const { return data_ + size_; }
+
+    bool is_mapped() const { return mapped_; }
+
+private:
+    FileView() = default;
+
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+
+    bool mapped_ = false;
+    std::vector<uint8_t> buffer_;
+};
+
+/* A streambuf which reads directly from a FileView, without copying */
+class FileViewStreamBuf : public std::streambuf {
+public:
+    FileViewStreamBuf(const FileView& view);
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+};
+
+/* An istream over a FileView, it keeps the view alive for as long as the
+ * stream exists */
+class FileViewStream : public std::istream {
+public:
+    FileViewStream(FileView::ptr view);
+
+    FileView::ptr view() const { return view_; }
+
+private:
+    FileView::ptr view_;
+    FileViewStreamBuf buffer_;
+};
+
+}
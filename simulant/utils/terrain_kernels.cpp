@@ -0,0 +1,261 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "terrain_kernels.h"
+#include "../generic/threading/thread_pool.h"
+
+namespace smlt {
+namespace terrain {
+
+/* Rows are cheap, so hand them out in batches */
+static const std::size_t ROW_GRAIN = 16;
+
+static void box_filter_row(const float* in, float* out, uint32_t width) {
+    if(width == 1) {
+        out[0] = in[0];
+        return;
+    }
+
+    const float third = 1.0f / 3.0f;
+
+    out[0] = (in[0] + in[1]) * 0.5f;
+
+    uint32_t x = 1;
+
+#ifdef __SSE__
+    const __m128 vthird = _mm_set1_ps(third);
+    for(; x + 4 <= width - 1; x += 4) {
+        __m128 l = _mm_loadu_ps(in + x - 1);
+        __m128 c = _mm_loadu_ps(in + x);
+        __m128 r = _mm_loadu_ps(in + x + 1);
+        _mm_storeu_ps(out + x, _mm_mul_ps(_mm_add_ps(_mm_add_ps(l, c), r), vthird));
+    }
+#endif
+
+    for(; x < width - 1; ++x) {
+        out[x] = (in[x - 1] + in[x] + in[x + 1]) * third;
+    }
+
+    out[width - 1] = (in[width - 2] + in[width - 1]) * 0.5f;
+}
+
+static void average_rows(const float* a, const float* b, const float* c, float* out, uint32_t width) {
+    /* c may be null, in which case this is the mean of two rows */
+    const float scale = (c) ? 1.0f / 3.0f : 0.5f;
+
+    uint32_t x = 0;
+
+#ifdef __SSE__
+    const __m128 vscale = _mm_set1_ps(scale);
+    for(; x + 4 <= width; x += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(a + x), _mm_loadu_ps(b + x));
+        if(c) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(c + x));
+        }
+        _mm_storeu_ps(out + x, _mm_mul_ps(sum, vscale));
+    }
+#endif
+
+    for(; x < width; ++x) {
+        float sum = a[x] + b[x] + ((c) ? c[x] : 0.0f);
+        out[x] = sum * scale;
+    }
+}
+
+void smooth_heights(float* heights, uint32_t width, uint32_t depth, uint32_t iterations) {
+    if(!width || !depth || !iterations) {
+        return;
+    }
+
+    auto& pool = thread::ThreadPool::global();
+
+    std::vector<float> scratch(width * depth);
+    float* tmp = &scratch[0];
+
+    /* A 3x3 box filter which is normalised per-axis is separable, and at the
+     * edges gives exactly the mean of the available neighbours */
+    for(uint32_t i = 0; i < iterations; ++i) {
+        pool.parallel_for(0, depth, [=](std::size_t first, std::size_t last) {
+            for(auto z = first; z < last; ++z) {
+                box_filter_row(heights + (z * width), tmp + (z * width), width);
+            }
+        }, ROW_GRAIN);
+
+        pool.parallel_for(0, depth, [=](std::size_t first, std::size_t last) {
+            for(auto z = first; z < last; ++z) {
+                float* out = heights + (z * width);
+                const float* row = tmp + (z * width);
+
+                if(depth == 1) {
+                    std::copy(row, row + width, out);
+                } else if(z == 0) {
+                    average_rows(row, row + width, nullptr, out, width);
+                } else if(z == depth - 1) {
+                    average_rows(row - width, row, nullptr, out, width);
+                } else {
+                    average_rows(row - width, row, row + width, out, width);
+                }
+            }
+        }, ROW_GRAIN);
+    }
+}
+
+void calculate_normals(const float* heights, uint32_t width, uint32_t depth, float spacing, Vec3* normals_out) {
+    if(!width || !depth) {
+        return;
+    }
+
+    thread::ThreadPool::global().parallel_for(0, depth, [=](std::size_t first, std::size_t last) {
+        for(auto z = first; z < last; ++z) {
+            const uint32_t up = (z > 0) ? z - 1 : z;
+            const uint32_t down = (z < depth - 1) ? z + 1 : z;
+
+            const float* row = heights + (z * width);
+            const float* row_up = heights + (up * width);
+            const float* row_down = heights + (down * width);
+            Vec3* out = normals_out + (z * width);
+
+            const float dz_scale = (down != up) ? 1.0f / (float(down - up) * spacing) : 0.0f;
+            const float dx_scale = 1.0f / (2.0f * spacing);
+
+            auto write_normal = [&](uint32_t x, float dx, float dz) {
+                /* The surface normal of y = h(x, z) is (-dh/dx, 1, -dh/dz) */
+                float inv_len = 1.0f / std::sqrt(dx * dx + 1.0f + dz * dz);
+                out[x] = Vec3(-dx * inv_len, inv_len, -dz * inv_len);
+            };
+
+            if(width == 1) {
+                write_normal(0, 0.0f, (row_down[0] - row_up[0]) * dz_scale);
+                continue;
+            }
+
+            const float edge_dx_scale = 1.0f / spacing;
+            write_normal(0, (row[1] - row[0]) * edge_dx_scale, (row_down[0] - row_up[0]) * dz_scale);
+
+            uint32_t x = 1;
+
+#ifdef __SSE__
+            const __m128 vdx_scale = _mm_set1_ps(dx_scale);
+            const __m128 vdz_scale = _mm_set1_ps(dz_scale);
+            const __m128 one = _mm_set1_ps(1.0f);
+
+            float nx[4], ny[4], nz[4];
+            for(; x + 4 <= width - 1; x += 4) {
+                __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row + x + 1), _mm_loadu_ps(row + x - 1)), vdx_scale);
+                __m128 dz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(row_down + x), _mm_loadu_ps(row_up + x)), vdz_scale);
+
+                __m128 len_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)), one);
+                __m128 inv_len = _mm_div_ps(one, _mm_sqrt_ps(len_sq));
+
+                _mm_storeu_ps(nx, _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), dx), inv_len));
+                _mm_storeu_ps(ny, inv_len);
+                _mm_storeu_ps(nz, _mm_mul_ps(_mm_sub_ps(_mm_setzero_ps(), dz), inv_len));
+
+                for(uint32_t i = 0; i < 4; ++i) {
+                    out[x + i] = Vec3(nx[i], ny[i], nz[i]);
+                }
+            }
+#endif
+
+            for(; x < width - 1; ++x) {
+                write_normal(x, (row[x + 1] - row[x - 1]) * dx_scale, (row_down[x] - row_up[x]) * dz_scale);
+            }
+
+            const uint32_t last_x = width - 1;
+            write_normal(
+                last_x,
+                (row[last_x] - row[last_x - 1]) * edge_dx_scale,
+                (row_down[last_x] - row_up[last_x]) * dz_scale
+            );
+        }
+    }, ROW_GRAIN);
+}
+
+float fast_acos(float x) {
+    /* Abramowitz and Stegun 4.4.45 */
+    x = std::min(1.0f, std::max(-1.0f, x));
+
+    const bool negate = x < 0.0f;
+    x = std::fabs(x);
+
+    float ret = -0.0187293f;
+    ret = ret * x + 0.0742610f;
+    ret = ret * x - 0.2121144f;
+    ret = ret * x + 1.5707288f;
+    ret = ret * std::sqrt(1.0f - x);
+
+    return (negate) ? 3.14159265f - ret : ret;
+}
+
+void calculate_occlusion(const float* heights, const Vec3* normals, uint32_t width, uint32_t depth, float spacing, float* occlusion_out) {
+    if(!width || !depth) {
+        return;
+    }
+
+    const float half_pi = 3.14159265f * 0.5f;
+
+    thread::ThreadPool::global().parallel_for(0, depth, [=](std::size_t first, std::size_t last) {
+        for(auto z = first; z < last; ++z) {
+            for(uint32_t x = 0; x < width; ++x) {
+                const uint32_t idx = (z * width) + x;
+                const float h = heights[idx];
+                const Vec3& n = normals[idx];
+
+                float sum = 0.0f;
+                uint32_t count = 0;
+
+                for(int32_t oz = -1; oz <= 1; ++oz) {
+                    int32_t nz = int32_t(z) + oz;
+                    if(nz < 0 || nz >= int32_t(depth)) continue;
+
+                    for(int32_t ox = -1; ox <= 1; ++ox) {
+                        int32_t nx = int32_t(x) + ox;
+                        if((!ox && !oz) || nx < 0 || nx >= int32_t(width)) continue;
+
+                        float dx = float(ox) * spacing;
+                        float dy = heights[(nz * width) + nx] - h;
+                        float dz = float(oz) * spacing;
+
+                        float inv_len = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+                        float d = (n.x * dx + n.y * dy + n.z * dz) * inv_len;
+
+                        sum += fast_acos(d);
+                        ++count;
+                    }
+                }
+
+                float v = (count) ? sum / float(count) : half_pi;
+
+                // If the average angle > 90 degrees, then we are completely open
+                occlusion_out[idx] = (v > half_pi) ? 1.0f : v / half_pi;
+            }
+        }
+    }, ROW_GRAIN);
+}
+
+}
+}
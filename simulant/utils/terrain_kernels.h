@@ -0,0 +1,61 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "../math/vec3.h"
+
+namespace smlt {
+namespace terrain {
+
+/*
+ * Grid-aware kernels for heightmap processing. They all operate on a
+ * row-major array of `width * depth` heights (x varies fastest) and are
+ * split by rows across ThreadPool::global(), with SSE inner loops where
+ * available.
+ */
+
+/*
+ * Smooth the heights with a separable 3x3 box filter, writing the result
+ * back into `heights`. Each iteration sets every height to the mean of
+ * itself and its (up to eight) neighbours as they were before the
+ * iteration (a Jacobi update). The old per-vertex smoothing updated
+ * heights in place, so later vertices saw already smoothed neighbours
+ * (Gauss-Seidel), and the results differ slightly.
+ */
+void smooth_heights(float* heights, uint32_t width, uint32_t depth, uint32_t iterations=1);
+
+/*
+ * Calculate per-vertex normals using central differences (one-sided at the
+ * edges). `spacing` is the distance between adjacent grid points in world units.
+ */
+void calculate_normals(const float* heights, uint32_t width, uint32_t depth, float spacing, Vec3* normals_out);
+
+/*
+ * Cheap per-vertex ambient occlusion term in the range [0, 1], computed
+ * from the average angle between the normal and the neighbouring points.
+ * 1.0 means completely open.
+ */
+void calculate_occlusion(const float* heights, const Vec3* normals, uint32_t width, uint32_t depth, float spacing, float* occlusion_out);
+
+/* Polynomial approximation of acos, max error is around 7e-5 radians */
+float fast_acos(float x);
+
+}
+}
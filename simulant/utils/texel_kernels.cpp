@@ -0,0 +1,479 @@
+//
+//   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+//
+//     This file is part of Simulant.
+//
+//     Simulant is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     Simulant is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "texel_kernels.h"
+#include "../generic/threading/thread_pool.h"
+
+namespace smlt {
+namespace texels {
+
+/* Rows are cheap, so hand them out in batches */
+static const std::size_t ROW_GRAIN = 16;
+
+/* x / 255 rounded down, exact for x < 65280 */
+static inline uint32_t div255(uint32_t x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+/* x / 255 rounded to nearest, exact for x <= 255 * 255 */
+static inline uint32_t div255_round(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+#ifdef __SSE2__
+static inline __m128i div255_epu16(__m128i x) {
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), _mm_srli_epi16(x, 8)), 8);
+}
+
+static inline __m128i div255_round_epu16(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+#endif
+
+static bool is_supported(TextureFormat format) {
+    switch(format) {
+    case TEXTURE_FORMAT_R8:
+    case TEXTURE_FORMAT_RGB888:
+    case TEXTURE_FORMAT_RGBA8888:
+    case TEXTURE_FORMAT_RGBA4444:
+    case TEXTURE_FORMAT_RGBA5551:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool can_convert(TextureFormat from, TextureFormat to) {
+    return is_supported(from) && is_supported(to);
+}
+
+static inline uint16_t load_short(const uint8_t* in) {
+    uint16_t v;
+    std::memcpy(&v, in, sizeof(v));
+    return v;
+}
+
+static inline void store_short(uint8_t* out, uint16_t v) {
+    std::memcpy(out, &v, sizeof(v));
+}
+
+/* Expands a row to RGBA8888, channels the format doesn't have are zero */
+static void unpack_row(const uint8_t* in, TextureFormat format, uint32_t width, uint8_t* rgba) {
+    switch(format) {
+    case TEXTURE_FORMAT_R8:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4) {
+            rgba[0] = in[x];
+            rgba[1] = rgba[2] = rgba[3] = 0;
+        }
+    break;
+    case TEXTURE_FORMAT_RGB888:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4, in += 3) {
+            rgba[0] = in[0];
+            rgba[1] = in[1];
+            rgba[2] = in[2];
+            rgba[3] = 0;
+        }
+    break;
+    case TEXTURE_FORMAT_RGBA8888:
+        std::memcpy(rgba, in, width * 4);
+    break;
+    case TEXTURE_FORMAT_RGBA4444:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4, in += 2) {
+            const uint16_t v = load_short(in);
+            rgba[0] = ((v >> 12) & 0xF) * 17;
+            rgba[1] = ((v >> 8) & 0xF) * 17;
+            rgba[2] = ((v >> 4) & 0xF) * 17;
+            rgba[3] = (v & 0xF) * 17;
+        }
+    break;
+    case TEXTURE_FORMAT_RGBA5551:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4, in += 2) {
+            const uint16_t v = load_short(in);
+            const uint8_t r = (v >> 11) & 0x1F;
+            const uint8_t g = (v >> 6) & 0x1F;
+            const uint8_t b = (v >> 1) & 0x1F;
+            rgba[0] = (r << 3) | (r >> 2);
+            rgba[1] = (g << 3) | (g >> 2);
+            rgba[2] = (b << 3) | (b >> 2);
+            rgba[3] = (v & 1) ? 255 : 0;
+        }
+    break;
+    default:
+        throw std::logic_error("Unsupported texture format");
+    }
+}
+
+static void pack_rgba4444(const uint8_t* rgba, uint32_t width, uint8_t* out) {
+    uint32_t x = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i fifteen = _mm_set1_epi16(15);
+    const __m128i shifts = _mm_setr_epi16(4096, 256, 16, 1, 4096, 256, 16, 1);
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i unbias = _mm_set1_epi16(short(0x8000));
+
+    for(; x + 4 <= width; x += 4) {
+        const __m128i px = _mm_loadu_si128((const __m128i*) (rgba + x * 4));
+
+        // Scale each channel to 0-15, then shift it into place and sum
+        // pairs: [p0 rg, p0 ba, p1 rg, p1 ba]
+        __m128i lo = div255_epu16(_mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), fifteen));
+        __m128i hi = div255_epu16(_mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), fifteen));
+        lo = _mm_madd_epi16(lo, shifts);
+        hi = _mm_madd_epi16(hi, shifts);
+
+        const __m128 flo = _mm_castsi128_ps(lo);
+        const __m128 fhi = _mm_castsi128_ps(hi);
+        __m128i sum = _mm_add_epi32(
+            _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(2, 0, 2, 0))),
+            _mm_castps_si128(_mm_shuffle_ps(flo, fhi, _MM_SHUFFLE(3, 1, 3, 1)))
+        );
+
+        // There's no unsigned 32 -> 16 bit pack in SSE2, so offset into
+        // signed range and back
+        sum = _mm_sub_epi32(sum, bias);
+        __m128i packed = _mm_xor_si128(_mm_packs_epi32(sum, sum), unbias);
+        _mm_storel_epi64((__m128i*) (out + x * 2), packed);
+    }
+#endif
+
+    for(; x < width; ++x) {
+        const uint8_t* p = rgba + x * 4;
+        // Truncates rather than rounds, as conversions always have
+        store_short(out + x * 2,
+            (div255(p[0] * 15) << 12) | (div255(p[1] * 15) << 8) |
+            (div255(p[2] * 15) << 4) | div255(p[3] * 15)
+        );
+    }
+}
+
+static void pack_row(const uint8_t* rgba, TextureFormat format, uint32_t width, uint8_t* out) {
+    switch(format) {
+    case TEXTURE_FORMAT_R8:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4) {
+            out[x] = rgba[0];
+        }
+    break;
+    case TEXTURE_FORMAT_RGB888:
+        for(uint32_t x = 0; x < width; ++x, rgba += 4, out += 3) {
+            out[0] = rgba[0];
+            out[1] = rgba[1];
+            out[2] = rgba[2];
+        }
+    break;
+    case TEXTURE_FORMAT_RGBA8888:
+        std::memcpy(out, rgba, width * 4);
+    break;
+    case TEXTURE_FORMAT_RGBA4444:
+        pack_rgba4444(rgba, width, out);
+    break;
+    case TEXTURE_FORMAT_RGBA5551:
+        // Rounded, otherwise unpacking and packing again isn't lossless
+        for(uint32_t x = 0; x < width; ++x, rgba += 4, out += 2) {
+            store_short(out,
+                (div255_round(rgba[0] * 31) << 11) | (div255_round(rgba[1] * 31) << 6) |
+                (div255_round(rgba[2] * 31) << 1) | ((rgba[3] >= 128) ? 1 : 0)
+            );
+        }
+    break;
+    default:
+        throw std::logic_error("Unsupported texture format");
+    }
+}
+
+static void map_channels(uint8_t* rgba, uint32_t width, const TextureChannelSet& channels) {
+    for(uint32_t x = 0; x < width; ++x, rgba += 4) {
+        const uint8_t source[6] = {rgba[0], rgba[1], rgba[2], rgba[3], 0, 255};
+
+        // The channel enum doubles as an index into source
+        rgba[0] = source[channels[0]];
+        rgba[1] = source[channels[1]];
+        rgba[2] = source[channels[2]];
+        rgba[3] = source[channels[3]];
+    }
+}
+
+void convert(const uint8_t* in, TextureFormat from, uint8_t* out, TextureFormat to, uint32_t width, uint32_t height, const TextureChannelSet& channels) {
+    if(!can_convert(from, to)) {
+        throw std::logic_error("Unsupported texture conversion");
+    }
+
+    if(!width || !height) {
+        return;
+    }
+
+    const bool identity = (channels == Texture::DEFAULT_SOURCE_CHANNELS);
+    const std::size_t in_stride = width * texture_format_stride(from);
+    const std::size_t out_stride = width * texture_format_stride(to);
+
+    if(identity && from == to) {
+        std::memcpy(out, in, in_stride * height);
+        return;
+    }
+
+    thread::ThreadPool::global().parallel_for(0, height, [=](std::size_t first, std::size_t last) {
+        std::vector<uint8_t> row(width * 4);
+
+        for(auto y = first; y < last; ++y) {
+            const uint8_t* src = in + (y * in_stride);
+            uint8_t* dest = out + (y * out_stride);
+
+            if(identity && from == TEXTURE_FORMAT_RGBA8888) {
+                // Nothing to unpack
+                pack_row(src, to, width, dest);
+                continue;
+            }
+
+            unpack_row(src, from, width, &row[0]);
+            if(!identity) {
+                map_channels(&row[0], width, channels);
+            }
+            pack_row(&row[0], to, width, dest);
+        }
+    }, ROW_GRAIN);
+}
+
+void flip_vertically(uint8_t* data, uint32_t row_bytes, uint32_t height) {
+    thread::ThreadPool::global().parallel_for(0, height / 2, [=](std::size_t first, std::size_t last) {
+        for(auto y = first; y < last; ++y) {
+            uint8_t* top = data + (y * row_bytes);
+            uint8_t* bottom = data + ((height - 1 - y) * row_bytes);
+            std::swap_ranges(top, top + row_bytes, bottom);
+        }
+    }, ROW_GRAIN);
+}
+
+#ifdef __SSE2__
+static inline __m128i premultiply_epu16(__m128i v) {
+    const __m128i alpha_lanes = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+
+    __m128i a = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+
+    // Alpha itself is multiplied by 255, i.e. kept
+    a = _mm_or_si128(_mm_andnot_si128(alpha_lanes, a), _mm_and_si128(alpha_lanes, _mm_set1_epi16(255)));
+    return div255_round_epu16(_mm_mullo_epi16(v, a));
+}
+#endif
+
+void premultiply_alpha(uint8_t* rgba, uint32_t width, uint32_t height) {
+    thread::ThreadPool::global().parallel_for(0, height, [=](std::size_t first, std::size_t last) {
+        uint8_t* p = rgba + (first * width * 4);
+        const std::size_t count = (last - first) * width;
+
+        std::size_t i = 0;
+
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        for(; i + 4 <= count; i += 4, p += 16) {
+            const __m128i px = _mm_loadu_si128((const __m128i*) p);
+            const __m128i lo = premultiply_epu16(_mm_unpacklo_epi8(px, zero));
+            const __m128i hi = premultiply_epu16(_mm_unpackhi_epi8(px, zero));
+            _mm_storeu_si128((__m128i*) p, _mm_packus_epi16(lo, hi));
+        }
+#endif
+
+        for(; i < count; ++i, p += 4) {
+            const uint32_t a = p[3];
+            p[0] = div255_round(p[0] * a);
+            p[1] = div255_round(p[1] * a);
+            p[2] = div255_round(p[2] * a);
+        }
+    }, ROW_GRAIN);
+}
+
+uint32_t mipmap_level_count(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while(width > 1 || height > 1) {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        ++levels;
+    }
+    return levels;
+}
+
+static void box_downsample(const uint8_t* in, uint32_t width, uint32_t height, uint32_t channels, uint8_t* out) {
+    const uint32_t out_width = std::max(width / 2, 1u);
+    const uint32_t out_height = std::max(height / 2, 1u);
+    const std::size_t stride = width * channels;
+
+    thread::ThreadPool::global().parallel_for(0, out_height, [=](std::size_t first, std::size_t last) {
+        for(auto y = first; y < last; ++y) {
+            const uint8_t* row0 = in + (std::min<std::size_t>(y * 2, height - 1) * stride);
+            const uint8_t* row1 = in + (std::min<std::size_t>(y * 2 + 1, height - 1) * stride);
+            uint8_t* dest = out + (y * out_width * channels);
+
+            uint32_t x = 0;
+
+#ifdef __SSE2__
+            if(channels == 4) {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i two = _mm_set1_epi16(2);
+
+                // Two output texels from four input texels on each row
+                for(; x + 2 <= out_width && (x + 2) * 2 <= width; x += 2) {
+                    const __m128i a = _mm_loadu_si128((const __m128i*) (row0 + x * 8));
+                    const __m128i b = _mm_loadu_si128((const __m128i*) (row1 + x * 8));
+
+                    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+                    // Add the right texel of each pair to the left one
+                    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+                    __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+                    _mm_storel_epi64((__m128i*) (dest + x * 4), _mm_packus_epi16(sum, sum));
+                }
+            }
+#endif
+
+            for(; x < out_width; ++x) {
+                const std::size_t x0 = std::min(x * 2, width - 1) * channels;
+                const std::size_t x1 = std::min(x * 2 + 1, width - 1) * channels;
+
+                for(uint32_t c = 0; c < channels; ++c) {
+                    dest[x * channels + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2;
+                }
+            }
+        }
+    }, ROW_GRAIN);
+}
+
+/* Taps either side of the centre of each output texel */
+static const int KAISER_TAPS = 6;
+
+static double bessel_i0(double x) {
+    // Power series, converges quickly for the small values used here
+    double sum = 1.0;
+    double term = 1.0;
+    for(int k = 1; k < 20; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static std::vector<float> kaiser_weights() {
+    const double alpha = 4.0;
+    const double radius = 1.5; // In output texels
+    const double pi = 3.14159265358979323846;
+
+    std::vector<float> weights(KAISER_TAPS);
+
+    double total = 0.0;
+    for(int k = 0; k < KAISER_TAPS; ++k) {
+        // Source texel centres relative to the output texel centre
+        const double t = ((k - KAISER_TAPS / 2) + 0.5) / 2.0;
+
+        const double sinc = (t == 0.0) ? 1.0 : std::sin(pi * t) / (pi * t);
+        const double r = t / radius;
+        const double window = bessel_i0(alpha * std::sqrt(std::max(0.0, 1.0 - r * r))) / bessel_i0(alpha);
+
+        weights[k] = float(sinc * window);
+        total += weights[k];
+    }
+
+    for(auto& w: weights) {
+        w = float(w / total);
+    }
+
+    return weights;
+}
+
+static void kaiser_downsample(const uint8_t* in, uint32_t width, uint32_t height, uint32_t channels, uint8_t* out) {
+    static const std::vector<float> weights = kaiser_weights();
+    const float* w = &weights[0];
+
+    const uint32_t out_width = std::max(width / 2, 1u);
+    const uint32_t out_height = std::max(height / 2, 1u);
+    const int last_x = int(width) - 1;
+    const int last_y = int(height) - 1;
+
+    /* Separable, so filter horizontally into a float buffer first */
+    std::vector<float> scratch(out_width * height * channels);
+    float* tmp = &scratch[0];
+
+    auto& pool = thread::ThreadPool::global();
+
+    pool.parallel_for(0, height, [=](std::size_t first, std::size_t last) {
+        for(auto y = first; y < last; ++y) {
+            const uint8_t* row = in + (y * width * channels);
+            float* dest = tmp + (y * out_width * channels);
+
+            for(uint32_t x = 0; x < out_width; ++x) {
+                for(uint32_t c = 0; c < channels; ++c) {
+                    float sum = 0.0f;
+                    for(int k = 0; k < KAISER_TAPS; ++k) {
+                        const int sx = std::min(std::max(int(x * 2) + k - (KAISER_TAPS / 2 - 1), 0), last_x);
+                        sum += w[k] * row[sx * channels + c];
+                    }
+                    dest[x * channels + c] = sum;
+                }
+            }
+        }
+    }, ROW_GRAIN);
+
+    const std::size_t tmp_stride = out_width * channels;
+
+    pool.parallel_for(0, out_height, [=](std::size_t first, std::size_t last) {
+        for(auto y = first; y < last; ++y) {
+            uint8_t* dest = out + (y * tmp_stride);
+
+            for(std::size_t i = 0; i < tmp_stride; ++i) {
+                float sum = 0.0f;
+                for(int k = 0; k < KAISER_TAPS; ++k) {
+                    const int sy = std::min(std::max(int(y * 2) + k - (KAISER_TAPS / 2 - 1), 0), last_y);
+                    sum += w[k] * tmp[sy * tmp_stride + i];
+                }
+
+                // The negative lobes can overshoot
+                dest[i] = uint8_t(std::min(std::max(sum + 0.5f, 0.0f), 255.0f));
+            }
+        }
+    }, ROW_GRAIN);
+}
+
+void downsample(const uint8_t* in, uint32_t width, uint32_t height, uint32_t channels, uint8_t* out, MipmapFilter filter) {
+    if(!width || !height || !channels) {
+        return;
+    }
+
+    if(filter == MIPMAP_FILTER_KAISER) {
+        kaiser_downsample(in, width, height, channels, out);
+    } else {
+        box_downsample(in, width, height, channels, out);
+    }
+}
+
+}
+}
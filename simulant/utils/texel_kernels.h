@@ -0,0 +1,76 @@
+/* *   Copyright (c) 2011-2017 Luke Benstead https://simulant-engine.appspot.com
+ *
+ *     This file is part of Simulant.
+ *
+ *     Simulant is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     Simulant is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with Simulant.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "../texture.h"
+
+namespace smlt {
+namespace texels {
+
+/*
+ * Kernels for processing uncompressed texture data on the CPU. They work on
+ * tightly packed rows, are split by rows across ThreadPool::global() and use
+ * SSE2 inner loops where available.
+ *
+ * None of them touch a Texture, so they can be used (and tested) without a
+ * renderer. Texture::convert, flip_vertically, premultiply_alpha and
+ * generate_mipmaps are built on them.
+ */
+
+/* True for any pair of R8, RGB888, RGBA8888, RGBA4444 and RGBA5551 */
+bool can_convert(TextureFormat from, TextureFormat to);
+
+/*
+ * Converts width * height texels from one format to another. Each output
+ * channel is taken from the source channel named in `channels`, missing
+ * source channels read as zero. Throws std::logic_error for unsupported
+ * formats.
+ */
+void convert(
+    const uint8_t* in, TextureFormat from,
+    uint8_t* out, TextureFormat to,
+    uint32_t width, uint32_t height,
+    const TextureChannelSet& channels=Texture::DEFAULT_SOURCE_CHANNELS
+);
+
+/* Swaps rows in place */
+void flip_vertically(uint8_t* data, uint32_t row_bytes, uint32_t height);
+
+/* Multiplies the colour of RGBA8888 texels by their alpha, in place */
+void premultiply_alpha(uint8_t* rgba, uint32_t width, uint32_t height);
+
+/* The number of levels in a full mipmap chain, including the base level */
+uint32_t mipmap_level_count(uint32_t width, uint32_t height);
+
+/*
+ * Writes the next mipmap level of an image with one byte per channel.
+ * The output is max(width / 2, 1) by max(height / 2, 1).
+ *
+ * MIPMAP_FILTER_BOX averages 2x2 blocks. MIPMAP_FILTER_KAISER uses a
+ * Kaiser-windowed sinc over 6x6 texels, which keeps more detail at the
+ * cost of being slower.
+ */
+void downsample(
+    const uint8_t* in, uint32_t width, uint32_t height, uint32_t channels,
+    uint8_t* out, MipmapFilter filter=MIPMAP_FILTER_BOX
+);
+
+}
+}
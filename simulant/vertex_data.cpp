@@ -18,6 +18,7 @@
 //
 
 #include <stdexcept>
+#include <atomic>
 #include "vertex_data.h"
 #include "window.h"
 #include "utils/gl_thread_check.h"
@@ -76,8 +77,11 @@ VertexAttribute attribute_for_type(VertexAttributeType type, const VertexSpecifi
     }
 }
 
+static std::atomic<uint64_t> revision_counter(0);
+
 VertexData::VertexData(VertexSpecification vertex_specification):
-    cursor_position_(0) {
+    cursor_position_(0),
+    revision_(++revision_counter) {
 
     reset(vertex_specification);
 }
@@ -392,6 +396,7 @@ void VertexData::interp_vertex(uint32_t source_idx, const VertexData &dest_state
 }
 
 void VertexData::done() {
+    revision_ = ++revision_counter;
     signal_update_complete_();
 }
 
@@ -414,7 +419,8 @@ static constexpr uint32_t calc_index_stride(IndexType type) {
 
 IndexData::IndexData(IndexType type):
     index_type_(type),
-    stride_(calc_index_stride(type)){
+    stride_(calc_index_stride(type)),
+    revision_(++revision_counter) {
 
 }
 
@@ -463,6 +469,7 @@ std::vector<uint32_t> IndexData::all() {
 }
 
 void IndexData::done() {
+    revision_ = ++revision_counter;
     signal_update_complete_();
 }
 
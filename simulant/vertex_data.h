@@ -137,6 +137,10 @@ public:
     sig::signal<void ()>& signal_update_complete() { return signal_update_complete_; }
     bool empty() const { return data_.empty(); }
 
+    /* Unique across all vertex and index data, changes each time done() is
+     * called. Lets anything derived from the data know when it's out of date */
+    uint64_t revision() const { return revision_; }
+
     const int32_t cursor_position() const { return cursor_position_; }
     const int32_t cursor_offset() const { return cursor_position_ * stride_; }
 
@@ -200,6 +204,7 @@ private:
     VertexAttribute attribute_from_type(VertexAttributeType type);
 
     sig::signal<void ()> signal_update_complete_;
+    uint64_t revision_ = 0;
 
     void push_back();
 
@@ -343,6 +348,7 @@ public:
     sig::signal<void ()>& signal_update_complete() { return signal_update_complete_; }
 
     const uint8_t* data() const { return &indices_[0]; }
+    uint8_t* data() { if(indices_.empty()) { return nullptr; } return &indices_[0]; }
     std::size_t data_size() const { return indices_.size() * sizeof(uint8_t); }
 
     uint32_t stride() const {
@@ -351,11 +357,15 @@ public:
 
     IndexType index_type() const { return index_type_; }
 
+    /* See VertexData::revision() */
+    uint64_t revision() const { return revision_; }
+
 private:
     IndexType index_type_;
     std::vector<uint8_t> indices_;
     uint32_t stride_ = 0;
     uint32_t count_ = 0;
+    uint64_t revision_ = 0;
 
     sig::signal<void ()> signal_update_complete_;
 };
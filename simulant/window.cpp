@@ -50,6 +50,7 @@
 
 #include "renderers/renderer_config.h"
 #include "sound.h"
+#include "sound_drivers/mixer_sound_driver.h"
 #include "render_sequence.h"
 #include "stage.h"
 #include "virtual_gamepad.h"
@@ -60,6 +61,7 @@
 
 #include "panels/stats_panel.h"
 #include "panels/partitioner_panel.h"
+#include "panels/profiler_panel.h"
 
 namespace smlt {
 
@@ -100,9 +102,16 @@ LoaderPtr Window::loader_for(const unicode &filename, LoaderHint hint) {
    
     std::vector<std::pair<LoaderTypePtr, LoaderPtr>> possible_loaders;
 
+    /* Read (or map) the file once, however many loaders might want it */
+    FileView::ptr file_view;
+
     for(LoaderTypePtr loader_type: loaders_) {
         if(loader_type->supports(final_file)) {
-            auto new_loader = loader_type->loader_for(final_file, resource_locator->read_file(final_file));
+            if(!file_view) {
+                file_view = resource_locator->map_file(final_file);
+            }
+
+            auto new_loader = loader_type->loader_for(final_file, std::make_shared<FileViewStream>(file_view));
             new_loader->set_resource_locator(this->resource_locator_.get());
 
             possible_loaders.push_back(
@@ -135,7 +144,9 @@ LoaderPtr Window::loader_for(const unicode& loader_name, const unicode &filename
     for(LoaderTypePtr loader_type: loaders_) {
         if(loader_type->name() == loader_name) {
             if(loader_type->supports(final_file)) {
-                return loader_type->loader_for(final_file, resource_locator->open_file(final_file));
+                return loader_type->loader_for(
+                    final_file, std::make_shared<FileViewStream>(resource_locator->map_file(final_file))
+                );
             } else {
                 throw std::logic_error(_u("Loader '{0}' does not support file '{1}'").format(loader_name, filename).encode());
             }
@@ -174,6 +185,8 @@ void Window::_cleanup() {
 
     delete_all_stages();
 
+    pcm_cache_.reset();
+
     if(sound_driver_) {
         sound_driver_->shutdown();
         sound_driver_.reset();
@@ -195,13 +208,40 @@ bool Window::_init() {
 
     L_DEBUG("Starting initialization");
 
+    if(std::getenv("SIMULANT_PROFILE")) {
+        profiler::set_enabled(true);
+    }
+
 #ifdef _arch_dreamcast
     print_available_ram();
 #endif
 
     // Initialize the sound driver (here rather than constructor as it relies on subclass type)
-    sound_driver_ = create_sound_driver();
-    sound_driver_->startup();
+    const char* sound_driver = std::getenv("SIMULANT_SOUND_DRIVER");
+    if(sound_driver && std::string(sound_driver) == "null") {
+        sound_driver_ = std::make_shared<MixerSoundDriver>(this, MIXER_OUTPUT_NULL);
+        sound_driver_->startup();
+    } else {
+        if(sound_driver && std::string(sound_driver) == "mixer") {
+            // Mix on the CPU and stream the result to the platform driver
+            sound_driver_ = std::make_shared<MixerSoundDriver>(this, create_sound_driver());
+        } else {
+            sound_driver_ = create_sound_driver();
+        }
+
+        if(!sound_driver_->startup()) {
+            // No audio device (e.g. a headless test run), keep sounds
+            // ticking along without any output
+            L_WARN("Falling back to the null sound driver");
+            sound_driver_ = std::make_shared<MixerSoundDriver>(this, MIXER_OUTPUT_NULL);
+            sound_driver_->startup();
+        }
+    }
+
+    pcm_cache_.reset(new PCMCache(sound_driver_, &stats_));
+
+    frame_pacer_.reset(new FramePacer(time_keeper_.get(), platform_.get()));
+    frame_pacer_->set_target_frame_time(requested_frame_time_ms_);
 
     renderer_ = new_renderer(this, std::getenv("SIMULANT_RENDERER"));
 
@@ -246,6 +286,7 @@ bool Window::_init() {
 
         register_panel(1, std::make_shared<StatsPanel>(this));
         register_panel(2, std::make_shared<PartitionerPanel>(this));
+        register_panel(3, std::make_shared<ProfilerPanel>(this));
 
         initialized_ = true;
     }
@@ -327,17 +368,16 @@ void Window::run_fixed_updates() {
 
 void Window::request_frame_time(float ms) {
     requested_frame_time_ms_ = ms;
+
+    if(frame_pacer_) {
+        frame_pacer_->set_target_frame_time(ms);
+    }
 }
 
 void Window::await_frame_time() {
-    auto this_time = time_keeper_->now_in_us();
-    while((float(this_time - last_frame_time_us_) * 0.001f) < requested_frame_time_ms_) {
-
-        platform->sleep_ms(0);
-
-        this_time = time_keeper_->now_in_us();
+    if(frame_pacer_) {
+        frame_pacer_->wait();
     }
-    last_frame_time_us_ = this_time;
 }
 
 bool Window::run_frame() {
@@ -345,7 +385,11 @@ bool Window::run_frame() {
 
     await_frame_time(); /* Frame limiter */
 
-    Profiler profiler(__func__);
+    /* Everything recorded since the last mark belongs to the previous frame */
+    S_PROFILE_FRAME_MARK();
+    S_PROFILE_SCOPE("Window::run_frame");
+
+    stats_.begin_frame();
 
     signal_frame_started_();
 
@@ -356,54 +400,85 @@ bool Window::run_frame() {
         dt = time_keeper_->delta_time();
     }
 
-    check_events(); // Check for any window events
-
-    profiler.checkpoint("event_poll");
-
-    Source::update_source(dt); //Update any playing sounds
-    input_state_->update(dt); // Update input devices
-    input_manager_->update(dt); // Now update any manager stuff based on the new input state
-    shared_assets->update(dt); // Update animated assets
-
-    profiler.checkpoint("asset_updates");
-
-    run_fixed_updates();
-
-    profiler.checkpoint("fixed_updates");
+    {
+        S_PROFILE_SCOPE("event_poll");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_EVENTS);
+        check_events(); // Check for any window events
+    }
 
-    run_update();
+    {
+        S_PROFILE_SCOPE("asset_updates");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_ASSET_UPDATES);
+        renderer_->begin_frame(); // Reset the texture upload budget
+        Source::update_source(dt); //Update any playing sounds
+        pcm_cache_->update(); // Cache any sounds decoded in the background
+        input_state_->update(dt); // Update input devices
+        input_manager_->update(dt); // Now update any manager stuff based on the new input state
+        shared_assets->update(dt); // Update animated assets
+    }
 
-    profiler.checkpoint("updates");
+    {
+        S_PROFILE_SCOPE("fixed_updates");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_FIXED_UPDATES);
+        run_fixed_updates();
+    }
 
-    idle_.execute(); //Execute idle tasks before render
+    {
+        S_PROFILE_SCOPE("updates");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_UPDATES);
+        run_update();
+    }
 
-    profiler.checkpoint("idle");
+    {
+        S_PROFILE_SCOPE("idle");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_IDLE);
+        idle_.execute(); //Execute idle tasks before render
+    }
 
-    // Garbage collect resources after idle, but before rendering
-    resource_manager_->run_garbage_collection();
+    {
+        S_PROFILE_SCOPE("garbage_collection");
+        FramePhaseTimer timer(&stats_, FRAME_PHASE_GARBAGE_COLLECTION);
 
-    profiler.checkpoint("garbage_collection");
+        // Garbage collect resources after idle, but before rendering
+        stats_.record_garbage_collected(resource_manager_->run_garbage_collection());
+    }
 
     /* Don't run the render sequence if we don't have a context, and don't update the resource
      * manager either because that probably needs a context too! */
     {
+        S_PROFILE_SCOPE("rendering");
+
         std::lock_guard<std::mutex> rendering_lock(context_lock_);
         if(has_context()) {
 
-            stats->reset_polygons_rendered();
-            render_sequence_->run();
+            {
+                FramePhaseTimer timer(&stats_, FRAME_PHASE_RENDER);
+
+                stats->reset_polygons_rendered();
+                stats->reset_draw_calls();
 
-            signal_pre_swap_();
+                // Evictions picked in begin_frame need the context
+                renderer_->begin_render();
+                render_sequence_->run();
+
+                signal_pre_swap_();
+            }
+
+            {
+                S_PROFILE_SCOPE("swap_buffers");
+                FramePhaseTimer timer(&stats_, FRAME_PHASE_SWAP);
+                swap_buffers();
+            }
 
-            swap_buffers();
             GLChecker::end_of_frame_check();
 
+            S_PROFILE_COUNTER("polygons", stats->polygons_rendered());
+            S_PROFILE_COUNTER("draw_calls", stats->draw_calls());
+
             //std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
     }
 
-    profiler.checkpoint("rendering");
-
     signal_frame_finished_();
 
     /* We totally ignore the first frame as it can take a while and messes up
@@ -412,8 +487,10 @@ bool Window::run_frame() {
     if(first_frame) {
         first_frame = false;
         time_keeper_->restart();
+        stats_.discard_frame();
     } else {
         stats_.increment_frames();
+        stats_.end_frame();
     }
 
     if(!is_running_) {
@@ -429,8 +506,28 @@ bool Window::run_frame() {
         std::cout << "Total time: " << time_keeper->total_elapsed_seconds() << std::endl;
         std::cout << "Average FPS: " << float(stats_.frames_run() - 1) / (time_keeper->total_elapsed_seconds()) << std::endl;
 
-        if(getenv("SIMULANT_PROFILE")) {
-            profiler.get_root()->print_stats();
+        auto frame_stats = stats_.frame_time_stats();
+        std::cout << "Frame time (p50/p95/p99/max): "
+                  << frame_stats.p50 << "/" << frame_stats.p95 << "/"
+                  << frame_stats.p99 << "/" << frame_stats.max << "ms" << std::endl;
+        std::cout << "Hitches: " << stats_.hitch_count() << std::endl;
+
+        const char* frame_stats_file = getenv("SIMULANT_FRAME_STATS");
+        if(frame_stats_file && !stats_.dump_frame_stats(frame_stats_file)) {
+            L_WARN(_F("Unable to write frame stats to {0}").format(frame_stats_file));
+        }
+
+        if(profiler::is_enabled()) {
+            profiler::print_stats();
+
+            const char* trace_file = getenv("SIMULANT_PROFILE_TRACE");
+            if(trace_file) {
+                if(profiler::write_chrome_trace(trace_file)) {
+                    std::cout << "Profiler trace written to: " << trace_file << std::endl;
+                } else {
+                    L_WARN(_F("Unable to write profiler trace to {0}").format(trace_file));
+                }
+            }
         }
     }
 
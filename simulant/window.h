@@ -32,6 +32,7 @@
 #include "input/input_state.h"
 #include "types.h"
 #include "sound.h"
+#include "pcm_cache.h"
 #include "managers.h"
 #include "backgrounds/background_manager.h"
 #include "pipeline_helper.h"
@@ -39,6 +40,7 @@
 #include "loader.h"
 #include "event_listener.h"
 #include "time_keeper.h"
+#include "frame_pacer.h"
 #include "stats_recorder.h"
 
 namespace smlt {
@@ -314,6 +316,7 @@ private:
     StatsRecorder stats_;
 
     std::shared_ptr<SoundDriver> sound_driver_;
+    std::unique_ptr<PCMCache> pcm_cache_;
 
     virtual std::shared_ptr<SoundDriver> create_sound_driver() = 0;
 
@@ -321,7 +324,7 @@ private:
     std::shared_ptr<InputManager> input_manager_;
 
     void await_frame_time();
-    uint64_t last_frame_time_us_ = 0;
+    std::unique_ptr<FramePacer> frame_pacer_;
     float requested_frame_time_ms_ = 0;
 protected:
     InputState* _input_state() const { return input_state_.get(); }
@@ -346,6 +349,12 @@ public:
 
     SoundDriver* _sound_driver() const { return sound_driver_.get(); }
 
+    /* Short sounds decoded in full, shared by every source that plays them */
+    PCMCache* _pcm_cache() const { return pcm_cache_.get(); }
+
+    /* Holds frames to the time passed to request_frame_time(), null until initialized */
+    FramePacer* frame_pacer() const { return frame_pacer_.get(); }
+
     void run_update();
     void run_fixed_updates();
     void request_frame_time(float ms);
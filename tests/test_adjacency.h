@@ -72,6 +72,36 @@ public:
         // Should've detected another shared edges
         assert_equal(2, shared);
     }
+
+    void test_only_changed_submeshes_are_rebuilt() {
+        auto mesh = window->shared_assets->new_mesh_as_rectangle(1.0, 1.0f).fetch();
+        auto second = mesh->new_submesh_as_rectangle(
+            "second", mesh->first_submesh()->material_id(), 1.0f, 1.0f, Vec3(5, 0, 0)
+        );
+
+        mesh->generate_adjacency_info();
+
+        assert_equal(10u, mesh->adjacency_info->edge_count());
+        assert_equal(2u, mesh->adjacency_info->last_rebuild_submesh_count());
+
+        auto revision = mesh->adjacency_info->revision();
+
+        // Nothing changed
+        mesh->generate_adjacency_info();
+        assert_equal(0u, mesh->adjacency_info->last_rebuild_submesh_count());
+        assert_equal(10u, mesh->adjacency_info->edge_count());
+        assert_true(mesh->adjacency_info->revision() > revision);
+
+        second->index_data->done();
+        mesh->generate_adjacency_info();
+        assert_equal(1u, mesh->adjacency_info->last_rebuild_submesh_count());
+        assert_equal(10u, mesh->adjacency_info->edge_count());
+
+        // Not contributing to the edge list drops its edges
+        second->set_contributes_to_edge_list(false);
+        mesh->generate_adjacency_info();
+        assert_equal(5u, mesh->adjacency_info->edge_count());
+    }
 };
 
 }
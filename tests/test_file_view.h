@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+
+#include "global.h"
+#include "../simulant/utils/file_view.h"
+
+namespace {
+
+using namespace smlt;
+
+class FileViewTests : public TestCase {
+public:
+    std::string write_file(const std::string& name, std::size_t size) {
+        std::string path = "/tmp/" + name;
+        std::ofstream file(path.c_str(), std::ios::binary);
+        for(std::size_t i = 0; i < size; ++i) {
+            file.put(char(i % 251));
+        }
+        return path;
+    }
+
+    void check_contents(const FileView& view, std::size_t size) {
+        assert_equal(size, view.size());
+        for(std::size_t i = 0; i < size; ++i) {
+            if(view.data()[i] != uint8_t(i % 251)) {
+                assert_true(false);
+            }
+        }
+    }
+
+    void test_small_and_large_files() {
+        auto small = write_file("simulant_file_view_small.bin", 100);
+        auto large = write_file("simulant_file_view_large.bin", 1024 * 1024 + 7);
+
+        check_contents(*FileView::open(small), 100);
+        check_contents(*FileView::open(large), 1024 * 1024 + 7);
+
+#if defined(__linux__) && !defined(__ANDROID__)
+        assert_true(FileView::open(large)->is_mapped());
+#endif
+
+        std::remove(small.c_str());
+        std::remove(large.c_str());
+    }
+
+    void test_missing_file_throws() {
+        assert_raises(std::runtime_error, std::bind(&FileView::open, "/tmp/simulant_does_not_exist.bin", false));
+    }
+
+    void test_stream_reads_and_seeks() {
+        std::vector<uint8_t> bytes = {'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd'};
+        FileViewStream stream(FileView::from_buffer(std::move(bytes)));
+
+        std::string word;
+        stream >> word;
+        assert_equal("hello", word);
+
+        stream.seekg(0, std::ios::end);
+        assert_equal(11, (int) stream.tellg());
+
+        stream.seekg(6);
+        stream >> word;
+        assert_equal("world", word);
+
+        stream.clear();
+        stream.seekg(-5, std::ios::end);
+        assert_equal('w', (char) stream.get());
+    }
+
+    void test_from_stream() {
+        std::stringstream source("some data");
+        auto view = FileView::from_stream(source);
+
+        assert_equal(9u, view->size());
+        assert_false(view->is_mapped());
+        assert_equal(std::string("some data"), std::string(view->begin(), view->end()));
+    }
+};
+
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+
+#include "global.h"
+#include "../simulant/frame_pacer.h"
+#include "../simulant/time_keeper.h"
+#include "../simulant/platform.h"
+
+namespace {
+
+using namespace smlt;
+
+/* Time only moves when something sleeps or the test says so */
+class MockTimeKeeper : public TimeKeeper {
+public:
+    MockTimeKeeper(float fixed_step=0.1f):
+        TimeKeeper(fixed_step) {}
+
+    uint64_t current_time_us() const override {
+        return now;
+    }
+
+    uint64_t now = 1000000;
+};
+
+/* Sleeps advance the mock clock, always waking up `oversleep_us` late */
+class MockPlatform : public Platform {
+public:
+    const static uint32_t YIELD_US = 20;
+
+    MockPlatform(MockTimeKeeper* time_keeper):
+        time_keeper_(time_keeper) {}
+
+    std::string name() const override { return "mock"; }
+
+    void sleep_ms(uint32_t ms) const override {
+        if(ms) {
+            time_keeper_->now += ms * 1000 + oversleep_us;
+            ++sleeps;
+        } else {
+            time_keeper_->now += YIELD_US;
+            ++yields;
+        }
+    }
+
+    uint32_t oversleep_us = 0;
+    mutable uint32_t sleeps = 0;
+    mutable uint32_t yields = 0;
+
+private:
+    MockTimeKeeper* time_keeper_;
+};
+
+class FramePacerTests : public TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+
+        time_keeper_.reset(new MockTimeKeeper());
+        platform_.reset(new MockPlatform(time_keeper_.get()));
+        pacer_.reset(new FramePacer(time_keeper_.get(), platform_.get()));
+    }
+
+    /* Runs frames which each take work_us, returning the longest and
+     * shortest time between frames starting */
+    std::pair<uint64_t, uint64_t> run_frames(uint32_t count, uint64_t work_us) {
+        uint64_t shortest = ~0ull;
+        uint64_t longest = 0;
+
+        pacer_->wait();
+        uint64_t last = time_keeper_->now;
+
+        for(uint32_t i = 0; i < count; ++i) {
+            time_keeper_->now += work_us;
+            pacer_->wait();
+
+            shortest = std::min(shortest, time_keeper_->now - last);
+            longest = std::max(longest, time_keeper_->now - last);
+            last = time_keeper_->now;
+        }
+
+        return std::make_pair(shortest, longest);
+    }
+
+    void test_frames_are_evenly_paced() {
+        platform_->oversleep_us = 300;
+        pacer_->set_target_frame_time(16.667f);
+
+        auto range = run_frames(120, 4000);
+
+        assert_true(range.first >= 16667 - MockPlatform::YIELD_US);
+        assert_true(range.second <= 16667 + MockPlatform::YIELD_US);
+    }
+
+    void test_most_of_the_wait_is_spent_asleep() {
+        platform_->oversleep_us = 300;
+        pacer_->set_target_frame_time(16.667f);
+
+        run_frames(120, 4000);
+
+        // Spinning for all of it would keep a core busy
+        assert_true(pacer_->spun_us() * 20 < pacer_->slept_us());
+        assert_true(platform_->sleeps >= 120u);
+    }
+
+    void test_sleep_margin_follows_oversleeping() {
+        // Far worse than assumed, so the first frame may be late
+        platform_->oversleep_us = 3000;
+        pacer_->set_target_frame_time(16.667f);
+
+        run_frames(2, 4000);
+        assert_true(pacer_->sleep_margin_us() >= 3000u);
+
+        for(uint32_t i = 0; i < 30; ++i) {
+            time_keeper_->now += 4000;
+            pacer_->wait();
+            assert_true(pacer_->last_error_us() <= MockPlatform::YIELD_US);
+        }
+    }
+
+    void test_slow_frames_dont_wait() {
+        pacer_->set_target_frame_time(16.667f);
+
+        auto range = run_frames(10, 40000);
+
+        assert_equal(0u, platform_->sleeps);
+        assert_equal(0u, platform_->yields);
+        assert_equal(40000u, range.first);
+
+        // Once it's fast again, it doesn't rush to catch up
+        time_keeper_->now += 4000;
+        const uint64_t before = time_keeper_->now;
+        pacer_->wait();
+        assert_true(time_keeper_->now - before >= 12667u);
+        assert_true(time_keeper_->now - before <= 12667u + MockPlatform::YIELD_US);
+    }
+
+    void test_no_target_means_no_waiting() {
+        run_frames(10, 1000);
+
+        assert_equal(0u, platform_->sleeps);
+        assert_equal(0u, platform_->yields);
+    }
+
+    void test_fixed_step_alpha() {
+        time_keeper_->init();
+
+        time_keeper_->now += 250000;
+        time_keeper_->update();
+
+        assert_true(time_keeper_->use_fixed_step());
+        assert_true(time_keeper_->use_fixed_step());
+        assert_false(time_keeper_->use_fixed_step());
+
+        // Half way between the second step and the third
+        assert_close(0.5f, time_keeper_->fixed_step_alpha(), 0.001f);
+    }
+
+private:
+    std::unique_ptr<MockTimeKeeper> time_keeper_;
+    std::unique_ptr<MockPlatform> platform_;
+    std::unique_ptr<FramePacer> pacer_;
+};
+
+}
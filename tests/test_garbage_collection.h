@@ -0,0 +1,129 @@
+#pragma once
+
+#include "global.h"
+#include "../simulant/generic/managed.h"
+#include "../simulant/generic/unique_id.h"
+#include "../simulant/generic/refcount_manager.h"
+
+namespace {
+
+using namespace smlt;
+
+class GCObject;
+
+typedef UniqueID<std::shared_ptr<GCObject>> GCObjectID;
+
+class GCObject : public Managed<GCObject> {
+public:
+    GCObject(GCObjectID id, uint32_t* destroyed):
+        id_(id),
+        destroyed_(destroyed) {}
+
+    ~GCObject() {
+        ++(*destroyed_);
+    }
+
+    std::size_t memory_usage() const { return 100; }
+
+private:
+    GCObjectID id_;
+    uint32_t* destroyed_;
+};
+
+typedef generic::RefCountedTemplatedManager<GCObject, GCObjectID> GCObjectManager;
+
+class GarbageCollectionTests : public TestCase {
+public:
+    std::vector<GCObjectID> make_objects(GCObjectManager& manager, uint32_t count, uint32_t* destroyed) {
+        std::vector<GCObjectID> ids;
+        for(uint32_t i = 0; i < count; ++i) {
+            auto id = manager.make(GARBAGE_COLLECT_PERIODIC, destroyed);
+
+            // Accessing an object marks it as used, so it's collectable
+            manager.get(id);
+            ids.push_back(id);
+        }
+
+        return ids;
+    }
+
+    void test_every_object_is_eventually_examined() {
+        uint32_t destroyed = 0;
+
+        GCObjectManager manager;
+        manager.set_garbage_collection_budget(16, 1000);
+
+        make_objects(manager, 200, &destroyed);
+
+        for(uint32_t i = 0; i < 12; ++i) {
+            assert_equal(16u, manager.garbage_collect());
+        }
+
+        assert_equal(8u, manager.count());
+        assert_equal(8u, manager.garbage_collect());
+        assert_equal(0u, manager.count());
+
+        auto stats = manager.garbage_collection_stats();
+        assert_equal(200u, stats.objects_collected);
+        assert_equal(200u, stats.objects_destroyed);
+        assert_equal(200u * 100u, stats.bytes_collected);
+        assert_equal(200u, destroyed);
+    }
+
+    void test_referenced_objects_are_skipped() {
+        uint32_t destroyed = 0;
+
+        GCObjectManager manager;
+        manager.set_garbage_collection_budget(4, 1000);
+
+        auto ids = make_objects(manager, 10, &destroyed);
+        auto held = manager.get(ids[5]).lock();
+
+        // The cursor carries on past the held object each time
+        for(uint32_t i = 0; i < 5; ++i) {
+            manager.garbage_collect();
+        }
+
+        assert_equal(1u, manager.count());
+        assert_true(manager.contains(ids[5]));
+
+        held.reset();
+        manager.garbage_collect();
+        assert_equal(0u, manager.count());
+    }
+
+    void test_destruction_is_deferred() {
+        uint32_t destroyed = 0;
+
+        GCObjectManager manager;
+        manager.set_garbage_collection_budget(64, 2);
+
+        make_objects(manager, 10, &destroyed);
+
+        assert_equal(10u, manager.garbage_collect());
+        assert_equal(0u, manager.count());
+        assert_equal(2u, destroyed);
+        assert_equal(8u, manager.garbage_collection_stats().pending_destruction);
+
+        manager.garbage_collect();
+        assert_equal(4u, destroyed);
+
+        manager.flush_pending_destruction();
+        assert_equal(10u, destroyed);
+        assert_equal(0u, manager.garbage_collection_stats().pending_destruction);
+    }
+
+    void test_unused_objects_are_kept_for_a_while() {
+        uint32_t destroyed = 0;
+
+        GCObjectManager manager;
+
+        // Never accessed, so kept until it's been around for a few seconds
+        manager.make(GARBAGE_COLLECT_PERIODIC, &destroyed);
+        manager.garbage_collect();
+
+        assert_equal(1u, manager.count());
+    }
+};
+
+}
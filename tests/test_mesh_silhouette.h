@@ -40,6 +40,72 @@ public:
         MeshSilhouette silhouette(mesh, Mat4(), light);
         assert_equal(0u, silhouette.edge_list().size());
     }
+
+    void test_shadow_volume_generation() {
+        auto stage = window->new_stage();
+        auto mesh = stage->assets->new_mesh_as_rectangle(1.0f, 1.0f).fetch();
+        auto light = stage->new_light_as_point();
+        light->move_to(0, 0, 10);
+
+        ShadowCaster caster(mesh.get());
+        assert_equal(5u, caster.edge_count());
+        assert_equal(2u, caster.triangle_count());
+
+        auto volume = caster.extrude(light_in_local_space(light, Mat4()));
+        assert_equal(4u, volume->silhouette_edge_count());
+
+        // Each vertex on the rectangle, and each extruded to infinity
+        assert_equal(8u, volume->vertices.size());
+        assert_equal(1.0f, volume->vertices[0].w);
+        assert_equal(0.0f, volume->vertices[1].w);
+
+        // Two triangles per silhouette edge, then both caps
+        assert_equal(24u, volume->side_index_count);
+        assert_equal(36u, volume->indices.size());
+
+        volume = caster.extrude(light_in_local_space(light, Mat4()), false);
+        assert_equal(24u, volume->indices.size());
+    }
+
+    void test_engine_caches_volumes() {
+        auto stage = window->new_stage();
+        auto mesh = stage->assets->new_mesh_as_rectangle(1.0f, 1.0f).fetch();
+        auto light = stage->new_light_as_point();
+        light->move_to(0, 0, 10);
+
+        SilhouetteEngine engine;
+
+        auto first = engine.evaluate(mesh, Mat4(), light);
+        assert_true(first.get());
+        assert_equal(0u, engine.cache_hits());
+
+        // The light hasn't moved relative to the mesh, so this is cached
+        light->move_to(5, 0, 10);
+        auto second = engine.evaluate(mesh, Mat4::as_translation(Vec3(5, 0, 0)), light);
+        assert_true(first == second);
+        assert_equal(1u, engine.cache_hits());
+
+        // Multiple pairs at once, one out of range
+        auto far_light = stage->new_light_as_point();
+        far_light->move_to(0, 0, -100);
+        far_light->set_attenuation_from_range(5.0);
+
+        std::vector<SilhouetteEngine::Request> requests(2);
+        requests[0].mesh = requests[1].mesh = mesh;
+        requests[0].light = light;
+        requests[0].transformation = Mat4::as_translation(Vec3(0, 1, 0));
+        requests[1].light = far_light;
+
+        auto volumes = engine.evaluate(requests);
+        assert_equal(2u, volumes.size());
+        assert_true(volumes[0].get());
+        assert_false(volumes[1].get());
+        assert_equal(1u, engine.caster_count());
+
+        // Rebuilding the adjacency rebuilds the caster
+        mesh->generate_adjacency_info();
+        assert_false(engine.evaluate(mesh, Mat4(), light) == first);
+    }
 };
 
 }
@@ -3,6 +3,7 @@
 
 #include "simulant/deps/kfs/kfs.h"
 #include "simulant/loaders/obj_loader.h"
+#include "simulant/loaders/obj_parser.h"
 #include "simulant/resource_manager.h"
 
 class OBJLoaderTest : public SimulantTestCase {
@@ -58,6 +59,125 @@ public:
         //Shouldn't throw
         smlt::MeshID mid = window->shared_assets->new_mesh_from_file("cube.obj");
     }
+
+    void test_number_parsing() {
+        using namespace smlt::loaders;
+
+        std::string input = "-1.25e2 ";
+        float f = 0.0f;
+        auto end = parse_float(input.c_str(), input.c_str() + input.size(), f);
+
+        assert_close(-125.0f, f, 0.0001f);
+        assert_equal(7, end - input.c_str());
+
+        input = ".5";
+        parse_float(input.c_str(), input.c_str() + input.size(), f);
+        assert_close(0.5f, f, 0.0001f);
+
+        // Nothing read, nothing changed
+        input = "x";
+        f = 3.0f;
+        end = parse_float(input.c_str(), input.c_str() + input.size(), f);
+        assert_equal(input.c_str(), end);
+        assert_equal(3.0f, f);
+
+        input = "-42/";
+        int32_t i = 0;
+        end = parse_int(input.c_str(), input.c_str() + input.size(), i);
+        assert_equal(-42, i);
+        assert_equal(3, end - input.c_str());
+    }
+
+    void test_shared_corners_share_vertices() {
+        using namespace smlt::loaders;
+
+        std::string input =
+            "v 0 0 0\n"
+            "v 1 0 0\n"
+            "v 1 1 0\r\n"
+            "v 0 1 0\n"
+            "vt 0 0\n"
+            "f 1/1 2/1 3/1\n"
+            "f 1/1 3/1 4/1\n";
+
+        OBJData data;
+        parse_obj(input.c_str(), input.c_str() + input.size(), data);
+
+        assert_equal(4u, data.positions.size());
+        assert_equal(4u, data.cache.size());
+        assert_equal(1u, data.groups.size());
+        assert_equal(6u, data.groups[0].indices.size());
+        assert_equal(0u, data.groups[0].indices[3]);
+        assert_equal(2u, data.groups[0].indices[4]);
+    }
+
+    void test_faces_are_fanned_and_grouped() {
+        using namespace smlt::loaders;
+
+        std::string input =
+            "v 0 0 0\n"
+            "v 1 0 0\n"
+            "v 1 1 0\n"
+            "v 0 1 0\n"
+            "vn 0 0 2\n"
+            "f 1//1 2//1 3//1 4//1\n"
+            "usemtl dark red \r\n"
+            "f -4//-1 -2//-1 -1\n";
+
+        OBJData data;
+        parse_obj(input.c_str(), input.c_str() + input.size(), data);
+
+        // Normals are normalized as they're read
+        assert_close(1.0f, data.normals[0].z, 0.0001f);
+
+        assert_equal(2u, data.groups.size());
+        assert_equal("", data.groups[0].material);
+        assert_equal(6u, data.groups[0].indices.size());
+
+        // Relative indices find the same corners, the last has no normal so is new
+        assert_equal("dark red", data.groups[1].material);
+        assert_equal(0u, data.groups[1].indices[0]);
+        assert_equal(2u, data.groups[1].indices[1]);
+        assert_equal(4u, data.groups[1].indices[2]);
+        assert_equal(5u, data.cache.size());
+    }
+
+    void test_bad_indices_throw() {
+        using namespace smlt::loaders;
+
+        std::string input =
+            "v 0 0 0\n"
+            "f 1 2 3\n";
+
+        OBJData data;
+        assert_raises(std::runtime_error, std::bind(parse_obj, input.c_str(), input.c_str() + input.size(), std::ref(data)));
+    }
+
+    void test_mtl_parsing() {
+        using namespace smlt::loaders;
+
+        std::string input =
+            "# Comment\n"
+            "newmtl red\n"
+            "Ns 10\n"
+            "Kd 1 0 0\n"
+            "map_Kd textures\\red brick.png \n"
+            "newmtl blue\n";
+
+        std::vector<MTLMaterial> materials;
+        parse_mtl(input.c_str(), input.c_str() + input.size(), materials);
+
+        assert_equal(2u, materials.size());
+        assert_equal("red", materials[0].name);
+        assert_true(materials[0].has_shininess);
+        assert_close(10.0f, materials[0].shininess, 0.0001f);
+        assert_true(materials[0].has_diffuse);
+        assert_false(materials[0].has_ambient);
+        assert_equal("textures/red brick.png", materials[0].diffuse_map);
+
+        assert_equal("blue", materials[1].name);
+        assert_false(materials[1].has_diffuse);
+    }
 };
 
 #endif // TEST_OBJ_LOADER_H
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <chrono>
+
+#include "global.h"
+#include "../simulant/nodes/particles/particle_store.h"
+#include "../simulant/nodes/particle_system.h"
+
+namespace {
+
+using namespace smlt;
+using namespace smlt::particles;
+
+class ParticleStoreTests : public TestCase {
+public:
+    Particle make_particle(float ttl, float x=0.0f) {
+        Particle p;
+        p.position = Vec3(x, 0, 0);
+        p.velocity = Vec3(1, 2, 3);
+        p.dimensions = Vec2(2, 4);
+        p.ttl = ttl;
+        p.colour = Colour(0.25f, 0.5f, 0.75f, 1.0f);
+        return p;
+    }
+
+    void test_push_and_read_back() {
+        ParticleStore store;
+        store.push(make_particle(1.0f, 5.0f));
+
+        assert_equal(1u, store.size());
+
+        auto p = store.particle(0);
+        assert_close(5.0f, p.position.x, 0.0001f);
+        assert_close(2.0f, p.velocity.y, 0.0001f);
+        assert_close(4.0f, p.dimensions.y, 0.0001f);
+        assert_close(0.75f, p.colour.b, 0.0001f);
+    }
+
+    void test_integrate_and_remove_dead() {
+        ParticleStore store;
+
+        // Odd count so that both the vector and scalar paths run
+        for(uint32_t i = 0; i < 7; ++i) {
+            store.push(make_particle((i % 2) ? 1.0f : 0.25f, float(i)));
+        }
+
+        store.integrate(0.5f);
+
+        assert_equal(4u, store.remove_dead());
+        assert_equal(3u, store.size());
+
+        for(uint32_t i = 0; i < store.size(); ++i) {
+            auto p = store.particle(i);
+            assert_close(0.5f, p.ttl, 0.0001f);
+            assert_close(1.0f, p.position.y, 0.0001f);
+            assert_close(1.5f, p.position.z, 0.0001f);
+
+            // Survivors were the odd ones, moved by half a unit
+            int original = int(p.position.x - 0.5f + 0.001f);
+            assert_true(original % 2 == 1);
+        }
+    }
+
+    void test_scale_clamped() {
+        std::vector<float> values = {1, 2, 3, 4, 5, -6};
+        scale_clamped(&values[0], values.size(), 2.0f, 0.0f);
+
+        assert_close(2.0f, values[0], 0.0001f);
+        assert_close(8.0f, values[3], 0.0001f);
+        assert_close(10.0f, values[4], 0.0001f);
+        assert_close(0.0f, values[5], 0.0001f);
+    }
+
+    void test_write_quads() {
+        ParticleStore store;
+        store.push(make_particle(1.0f, 10.0f));
+
+        const VertexLayout layout = {48, 0, 12, 20};
+        std::vector<uint8_t> out(48 * 4, 0);
+        write_quads(store, &out[0], layout);
+
+        const float* v2 = (const float*) &out[48];
+        assert_close(11.0f, v2[0], 0.0001f);
+        assert_close(-2.0f, v2[1], 0.0001f);
+        assert_close(1.0f, v2[3], 0.0001f);
+        assert_close(0.0f, v2[4], 0.0001f);
+        assert_close(0.5f, v2[6], 0.0001f);
+
+        std::vector<uint16_t> indices(12);
+        write_quad_indices(&indices[0], 2);
+        assert_equal(4, indices[6]);
+        assert_equal(7, indices[11]);
+    }
+
+    void test_write_points() {
+        ParticleStore store;
+        store.push(make_particle(1.0f, 10.0f));
+        store.push(make_particle(1.0f, 20.0f));
+
+        const VertexLayout layout = {48, 0, 12, 20};
+        std::vector<uint8_t> out(48 * 2, 0);
+        write_points(store, &out[0], layout);
+
+        const float* v = (const float*) &out[48];
+        assert_close(20.0f, v[0], 0.0001f);
+
+        // The texcoord carries the particle size
+        assert_close(2.0f, v[3], 0.0001f);
+        assert_close(4.0f, v[4], 0.0001f);
+        assert_close(0.25f, v[5], 0.0001f);
+    }
+
+    void test_sort_back_to_front() {
+        ParticleStore store;
+        store.push(make_particle(1.0f, 1.0f));
+        store.push(make_particle(3.0f, 5.0f));
+        store.push(make_particle(2.0f, 3.0f));
+
+        // Looking down +X, so the largest X is furthest away
+        store.sort_back_to_front(Vec3(1, 0, 0));
+
+        assert_close(5.0f, store.particle(0).position.x, 0.0001f);
+        assert_close(3.0f, store.particle(1).position.x, 0.0001f);
+        assert_close(1.0f, store.particle(2).position.x, 0.0001f);
+
+        // Every channel moves with the position
+        assert_close(3.0f, store.particle(0).ttl, 0.0001f);
+        assert_close(1.0f, store.particle(2).ttl, 0.0001f);
+    }
+};
+
+
+class ParticleSystemTests : public SimulantTestCase {
+public:
+    void test_same_seed_gives_same_particles() {
+        auto stage = window->new_stage();
+
+        std::vector<ParticleSystemPtr> systems;
+
+        // More systems than threads, so several are simulated per worker
+        for(uint32_t i = 0; i < 16; ++i) {
+            auto ps = stage->new_particle_system();
+            ps->set_quota(100);
+            ps->set_random_seed(1234);
+
+            auto emitter = ps->push_emitter();
+            emitter->set_type(particles::PARTICLE_EMITTER_BOX);
+            emitter->set_emission_rate(1000);
+
+            systems.push_back(ps);
+        }
+
+        for(uint32_t i = 0; i < 5; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            window->run_frame();
+        }
+
+        auto& first = systems[0]->particles();
+        assert_true(first.size() > 0);
+
+        for(auto ps: systems) {
+            auto& store = ps->particles();
+            assert_equal(first.size(), store.size());
+
+            for(uint32_t j = 0; j < store.size(); ++j) {
+                assert_equal(first.particle(j).position, store.particle(j).position);
+            }
+        }
+    }
+
+    void test_points_keep_the_material_textures() {
+        skip_if(!window->renderer->supports_gpu_programs(), "Point particles need GPU programs");
+
+        auto stage = window->new_stage();
+        auto ps = stage->new_particle_system();
+
+        auto texture = stage->assets->new_texture();
+        auto material = stage->assets->new_material_from_texture(texture);
+        ps->set_material_id(material);
+
+        ps->set_render_mode(PARTICLE_RENDER_MODE_POINTS);
+        assert_not_equal(material, ps->material_id());
+
+        auto points = stage->assets->material(ps->material_id());
+        assert_equal(texture, points->pass(0)->texture_unit(0).texture_id());
+
+        // The original material comes back, not a default one
+        ps->set_render_mode(PARTICLE_RENDER_MODE_QUADS);
+        assert_equal(material, ps->material_id());
+    }
+};
+
+}
@@ -37,6 +37,25 @@ public:
     bool* leave_called = nullptr;
 };
 
+class RecordingListener : public behaviours::CollisionListener {
+public:
+    void on_collision_enter(const behaviours::Collision& collision) override {
+        entered.push_back(collision);
+    }
+
+    void on_collision_stay() override {
+        ++stays;
+    }
+
+    void on_collision_exit(const behaviours::Collision& collision) override {
+        exited.push_back(collision);
+    }
+
+    std::vector<behaviours::Collision> entered;
+    std::vector<behaviours::Collision> exited;
+    uint32_t stays = 0;
+};
+
 class ColliderTests : public SimulantTestCase {
 public:
     void set_up() {
@@ -94,6 +113,107 @@ public:
         assert_close(distance, 1.0, 0.0001);
     }
 
+    void test_batched_queries() {
+        auto actor1 = stage->new_actor();
+        auto box = actor1->new_behaviour<behaviours::RigidBody>(physics.get());
+        box->add_box_collider(Vec3(2, 2, 1), behaviours::PhysicsMaterial::WOOD);
+
+        auto actor2 = stage->new_actor();
+        actor2->move_to(10, 0, 0);
+        auto sphere = actor2->new_behaviour<behaviours::RigidBody>(physics.get());
+        sphere->add_sphere_collider(2.0, behaviours::PhysicsMaterial::WOOD);
+
+        std::vector<behaviours::RayQuery> rays;
+        for(int i = 0; i < 100; ++i) {
+            // Every other ray misses
+            rays.push_back(behaviours::RayQuery(Vec3((i % 2) ? 0.0f : 3.0f, 2, 0), Vec3(0, -2, 0)));
+        }
+        rays.push_back(behaviours::RayQuery(Vec3(10, 2, 0), Vec3(0, -2, 0)));
+
+        std::vector<behaviours::QueryHit> hits;
+        for(bool parallel: {false, true}) {
+            assert_equal(51u, physics->intersect_rays(rays, hits, parallel));
+            assert_equal(rays.size(), hits.size());
+            assert_false(hits[0].hit);
+            assert_true(hits[1].hit);
+            assert_close(hits[1].distance, 1.0, 0.0001);
+            assert_true(hits[1].body == box);
+            assert_true(hits[100].body == sphere);
+        }
+
+        std::vector<behaviours::SphereSweepQuery> sweeps = {
+            behaviours::SphereSweepQuery(Vec3(0, 3, 0), Vec3(0, -3, 0), 0.5f),
+            behaviours::SphereSweepQuery(Vec3(10, 3, 0), Vec3(0, -3, 0), 0.5f),
+            behaviours::SphereSweepQuery(Vec3(5, 3, 0), Vec3(0, -3, 0), 0.5f)
+        };
+
+        assert_equal(2u, physics->sweep_spheres(sweeps, hits));
+        assert_close(hits[0].distance, 1.5, 0.0001);
+        assert_close(hits[0].normal.y, 1.0, 0.0001);
+        assert_close(hits[1].distance, 1.5, 0.0001);
+        assert_false(hits[2].hit);
+
+        std::vector<behaviours::BoxOverlapQuery> boxes = {
+            behaviours::BoxOverlapQuery(Vec3(), Vec3(0.5, 0.5, 0.5)),
+            behaviours::BoxOverlapQuery(Vec3(5, 0, 0), Vec3(0.5, 0.5, 0.5)),
+            behaviours::BoxOverlapQuery(Vec3(5, 0, 0), Vec3(5, 1, 1))
+        };
+
+        std::vector<behaviours::OverlapHit> overlaps;
+        assert_equal(3u, physics->overlap_boxes(boxes, overlaps));
+        assert_equal(0u, overlaps[0].query);
+        assert_equal(2u, overlaps[1].query);
+        assert_equal(2u, overlaps[2].query);
+    }
+
+    void test_threaded_steps_match_deferred_steps() {
+        auto run = [this](behaviours::PhysicsStepMode mode) -> std::vector<float> {
+            auto sim = behaviours::RigidBodySimulation::create(window->time_keeper);
+            sim->set_step_mode(mode);
+
+            auto ground = stage->new_actor();
+            auto floor = ground->new_behaviour<behaviours::StaticBody>(sim.get());
+            floor->add_box_collider(Vec3(20, 1, 20), behaviours::PhysicsMaterial::STONE);
+
+            std::vector<behaviours::RigidBody*> boxes;
+            for(int i = 0; i < 5; ++i) {
+                auto actor = stage->new_actor();
+                actor->move_to(i * 0.5f, 2.0f + i, 0);
+
+                auto body = actor->new_behaviour<behaviours::RigidBody>(sim.get());
+                body->add_box_collider(Vec3(1, 1, 1), behaviours::PhysicsMaterial::WOOD);
+                boxes.push_back(body);
+            }
+
+            for(int i = 0; i < 120; ++i) {
+                sim->fixed_update(1.0f / 60.0f);
+                boxes[i % boxes.size()]->add_force(Vec3(10, 0, 0));
+                sim->begin_queued_step();
+            }
+
+            std::vector<float> result;
+            for(auto body: boxes) {
+                auto p = body->position();
+                auto r = body->rotation();
+                result.insert(result.end(), {p.x, p.y, p.z, r.x, r.y, r.z, r.w});
+            }
+
+            return result;
+        };
+
+        auto deferred = run(behaviours::PHYSICS_STEP_MODE_DEFERRED);
+        auto threaded = run(behaviours::PHYSICS_STEP_MODE_THREADED);
+
+        assert_equal(deferred.size(), threaded.size());
+        for(std::size_t i = 0; i < deferred.size(); ++i) {
+            // Bit for bit
+            assert_true(deferred[i] == threaded[i]);
+        }
+
+        // Something actually happened
+        assert_true(deferred[1] < 2.0f);
+    }
+
     void test_mesh_collider_addition() {
         auto mesh_id = stage->assets->new_mesh_as_box(1.0, 1.0, 1.0);
         auto actor1 = stage->new_actor();
@@ -183,9 +303,50 @@ public:
         body->unregister_collision_listener(&listener);
     }
 
-    void test_collision_listener_stay() {
-        skip_if(true, "Not yet implemented");
+    void test_contact_events() {
+        RecordingListener listener;
 
+        auto actor1 = stage->new_actor();
+        auto body = actor1->new_behaviour<behaviours::StaticBody>(physics.get());
+        auto collider = body->add_box_collider(Vec3(1, 1, 1), behaviours::PhysicsMaterial::WOOD);
+        body->register_collision_listener(&listener);
+
+        auto actor2 = stage->new_actor();
+        auto body2 = actor2->new_behaviour<behaviours::RigidBody>(physics.get());
+        body2->add_sphere_collider(0.5, behaviours::PhysicsMaterial::WOOD);
+        auto collider2 = body2->add_box_collider(Vec3(1, 1, 1), behaviours::PhysicsMaterial::WOOD);
+
+        assert_true(collider != 0);
+        assert_not_equal(collider, collider2);
+
+        physics->fixed_update(1.0f / 60.0f);
+
+        assert_true(physics->contact_count() > 0u);
+        assert_false(listener.entered.empty());
+        assert_equal(0u, listener.stays);
+
+        bool found = false;
+        for(auto& collision: listener.entered) {
+            assert_true(collision.this_body == body);
+            assert_equal(collider, collision.this_collider);
+            assert_true(collision.other_body == body2);
+            found = found || collision.other_collider == collider2;
+        }
+
+        assert_true(found);
+
+        // Contacts stay for each step after the first
+        physics->fixed_update(1.0f / 60.0f);
+        assert_true(listener.stays > 0u);
+
+        actor2->ask_owner_for_destruction();
+        assert_equal(listener.entered.size(), listener.exited.size());
+        assert_equal(0u, physics->contact_count());
+
+        body->unregister_collision_listener(&listener);
+    }
+
+    void test_collision_listener_stay() {
         uint32_t stay_count = 0;
 
         Listener listener(nullptr, &stay_count, nullptr);
@@ -201,22 +362,22 @@ public:
 
         assert_false(stay_count);
 
+        // The first step the boxes touch is an enter, not a stay
         physics->fixed_update(1.0 / 60.0f);
-        window->run_frame();
-
-        assert_equal(stay_count, 1u);
+        assert_equal(0u, stay_count);
 
+        // Then one stay per step while they keep touching
         physics->fixed_update(1.0 / 60.0f);
-        window->run_frame();
+        assert_equal(1u, stay_count);
 
-        assert_equal(stay_count, 2u);
+        physics->fixed_update(1.0 / 60.0f);
+        assert_equal(2u, stay_count);
 
         actor2->ask_owner_for_destruction();
 
+        // Nothing left to touch
         physics->fixed_update(1.0 / 60.0f);
-        window->run_frame();
-
-        assert_equal(stay_count, 1u);
+        assert_equal(2u, stay_count);
 
         body->unregister_collision_listener(&listener);
     }
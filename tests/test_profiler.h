@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <fstream>
+#include <sstream>
+
+#include "global.h"
+#include "../simulant/profiler.h"
+
+namespace {
+
+using namespace smlt;
+
+/* A uniquely named file in the temp directory, removed when this goes out
+ * of scope (even if an assertion fails) */
+struct TemporaryFile {
+    std::string path;
+
+    TemporaryFile(const std::string& prefix, const std::string& extension) {
+        const char* dir = std::getenv("TMPDIR");
+        if(!dir) dir = std::getenv("TEMP");
+        if(!dir) dir = std::getenv("TMP");
+
+#ifdef _WIN32
+        std::string base = (dir) ? dir : ".";
+#else
+        std::string base = (dir) ? dir : "/tmp";
+#endif
+
+        std::random_device device;
+        path = base + "/" + prefix + std::to_string(device()) + extension;
+    }
+
+    ~TemporaryFile() {
+        std::remove(path.c_str());
+    }
+};
+
+class ProfilerTests : public TestCase {
+public:
+    void set_up() {
+        TestCase::set_up();
+
+        profiler::clear();
+        profiler::set_enabled(true);
+    }
+
+    void tear_down() {
+        profiler::set_enabled(false);
+        profiler::clear();
+
+        TestCase::tear_down();
+    }
+
+    const profiler::ZoneStats* find_zone(const std::vector<profiler::ZoneStats>& stats, const std::string& name) {
+        for(auto& zone: stats) {
+            if(name == zone.zone->name) {
+                return &zone;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void test_zones_are_collected_per_frame() {
+        if(!profiler::is_enabled()) {
+            return; // Compiled out
+        }
+
+        for(int i = 0; i < 3; ++i) {
+            S_PROFILE_SCOPE("test_zone");
+        }
+
+        profiler::frame_mark();
+
+        auto zone = find_zone(profiler::last_frame_stats(), "test_zone");
+        assert_true(zone);
+        assert_equal(3u, zone->calls);
+
+        profiler::frame_mark();
+
+        assert_false(find_zone(profiler::last_frame_stats(), "test_zone"));
+        assert_equal(3u, find_zone(profiler::session_stats(), "test_zone")->calls);
+    }
+
+    void test_zones_from_other_threads() {
+        if(!profiler::is_enabled()) {
+            return;
+        }
+
+        std::thread thread([]() {
+            S_PROFILE_SCOPE("thread_zone");
+        });
+        thread.join();
+
+        profiler::frame_mark();
+
+        assert_true(find_zone(profiler::last_frame_stats(), "thread_zone"));
+    }
+
+    void test_nothing_recorded_when_disabled() {
+        profiler::set_enabled(false);
+
+        {
+            S_PROFILE_SCOPE("disabled_zone");
+        }
+
+        profiler::set_enabled(true);
+        profiler::frame_mark();
+
+        assert_false(find_zone(profiler::last_frame_stats(), "disabled_zone"));
+    }
+
+    void test_chrome_trace_export() {
+        if(!profiler::is_enabled()) {
+            return;
+        }
+
+        {
+            S_PROFILE_SCOPE("exported_zone");
+            S_PROFILE_COUNTER("exported_counter", 42);
+        }
+
+        profiler::frame_mark();
+
+        TemporaryFile capture("simulant_profiler_test_", ".json");
+        const std::string& filename = capture.path;
+        assert_true(profiler::write_chrome_trace(filename));
+
+        std::ifstream file(filename);
+        std::stringstream contents;
+        contents << file.rdbuf();
+
+        auto json = contents.str();
+        assert_true(json.find("\"traceEvents\"") != std::string::npos);
+        assert_true(json.find("\"name\":\"exported_zone\",\"cat\":\"zone\",\"ph\":\"X\"") != std::string::npos);
+        assert_true(json.find("\"name\":\"exported_counter\",\"ph\":\"C\"") != std::string::npos);
+        assert_true(json.find("\"value\":42") != std::string::npos);
+        assert_true(json.find("\"name\":\"frame\",\"ph\":\"i\"") != std::string::npos);
+    }
+};
+
+}
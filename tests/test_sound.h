@@ -2,7 +2,10 @@
 #define TEST_SOUND_H
 
 #include <cstdlib>
+#include <thread>
 #include "simulant/simulant.h"
+#include "simulant/audio_streamer.h"
+#include "simulant/sound_drivers/mixer_sound_driver.h"
 #include "kaztest/kaztest.h"
 
 #include "global.h"
@@ -58,7 +61,270 @@ public:
         }
     }
 
+    void test_memory_usage_counts_the_encoded_file() {
+        auto sound = window->shared_assets->new_sound_from_file("test_sound.ogg").fetch();
+
+        // Decoded straight from the file, rather than a copy
+        assert_true(sound->data().empty());
+        assert_true(sound->file_view());
+        assert_equal(sound->file_view()->size(), sound->memory_usage());
+        assert_true(sound->memory_usage() > 0u);
+    }
+
+    void test_short_sounds_are_cached() {
+        smlt::SoundID sound = stage_->assets->new_sound_from_file("test_sound.ogg");
+
+        auto cache = window->_pcm_cache();
+        cache->clear();
+        cache->set_budget(64 * 1024 * 1024);
+        cache->set_max_sound_bytes(64 * 1024 * 1024);
+
+        auto hits = cache->hits();
+        auto misses = cache->misses();
+
+        auto actor = stage_->new_actor();
+        actor->play_sound(sound);
+
+        // The first play streams while the whole sound decodes in the background
+        assert_equal(misses + 1, cache->misses());
+        assert_equal(0u, cache->entry_count());
+
+        while(!cache->entry_count()) {
+            std::this_thread::yield();
+            window->run_frame();
+        }
+
+        actor->play_sound(sound);
+
+        assert_equal(misses + 1, cache->misses());
+        assert_equal(hits + 1, cache->hits());
+        assert_equal(1u, cache->entry_count());
+        assert_equal(cache->hits(), window->stats->pcm_cache_hits());
+        assert_true(window->stats->pcm_cache_bytes() > 0u);
+
+        // Evicting doesn't stop the sounds which are using it
+        cache->set_budget(0);
+        assert_equal(0u, cache->entry_count());
+        assert_equal(0u, cache->used_bytes());
+        assert_true(actor->playing_sound_count() > 0);
+
+        while(actor->playing_sound_count()) {
+            window->run_frame();
+        }
+
+        cache->set_budget(smlt::PCMCache::DEFAULT_BUDGET);
+        cache->set_max_sound_bytes(smlt::PCMCache::DEFAULT_MAX_SOUND_BYTES);
+    }
+
+    void test_ring_buffer_marks_the_end_of_stream() {
+        /* Counts up from zero, 10 samples in total */
+        int16_t next = 0;
+        auto decode = [&next](int16_t* out, std::size_t max_samples) -> std::size_t {
+            std::size_t count = 0;
+            while(count < max_samples && next < 10) {
+                out[count++] = next++;
+            }
+            return count;
+        };
+
+        smlt::AudioStream stream(decode, 4, 2);
+
+        // The ring only holds two chunks
+        assert_equal(2u, stream.decode_ahead());
+        assert_false(stream.finished_decoding());
+
+        std::size_t samples = 0;
+        int16_t* pcm = stream.buffer().begin_read(&samples);
+        assert_true(pcm);
+        assert_equal(4u, samples);
+        assert_equal(0, pcm[0]);
+        assert_equal(3, pcm[3]);
+        stream.buffer().end_read();
+
+        // A short chunk, then the end marker once there's room
+        assert_equal(1u, stream.decode_ahead());
+        stream.buffer().begin_read(&samples);
+        stream.buffer().end_read();
+        assert_equal(4u, samples);
+
+        pcm = stream.buffer().begin_read(&samples);
+        assert_equal(2u, samples);
+        assert_equal(9, pcm[1]);
+        stream.buffer().end_read();
+
+        assert_equal(1u, stream.decode_ahead());
+        assert_true(stream.finished_decoding());
+
+        stream.buffer().begin_read(&samples);
+        assert_equal(0u, samples);
+        stream.buffer().end_read();
+
+        assert_false(stream.buffer().begin_read(&samples));
+        assert_equal(0u, stream.decode_ahead());
+    }
+
+    void test_streamed_sound_stays_in_order() {
+        const std::size_t total = 100000;
+
+        /* The streaming thread may still call this after the test returns
+         * (e.g. if an assertion fails), so it owns its counter */
+        auto next = std::make_shared<std::size_t>(0);
+        auto decode = [next, total](int16_t* out, std::size_t max_samples) -> std::size_t {
+            std::size_t count = 0;
+            while(count < max_samples && *next < total) {
+                out[count++] = int16_t((*next)++ & 0x7FFF);
+            }
+            return count;
+        };
+
+        auto stream = std::make_shared<smlt::AudioStream>(decode, 1000, 3);
+        smlt::AudioStreamer::global().add_stream(stream);
+
+        // Stop the streaming thread decoding it however the test ends
+        struct CloseStream {
+            smlt::AudioStream::ptr stream;
+            ~CloseStream() { stream->close(); }
+        } close_stream = {stream};
+
+        std::size_t expected = 0;
+        bool ended = false;
+        while(!ended) {
+            std::size_t samples = 0;
+            int16_t* pcm = stream->buffer().begin_read(&samples);
+            if(!pcm) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            for(std::size_t i = 0; i < samples; ++i, ++expected) {
+                assert_equal(int16_t(expected & 0x7FFF), pcm[i]);
+            }
+
+            ended = (samples == 0);
+            stream->buffer().end_read();
+            smlt::AudioStreamer::global().wake();
+        }
+
+        assert_equal(total, expected);
+    }
+
+    void test_mixer_virtualises_quiet_voices() {
+        using namespace smlt;
+
+        MixerSoundDriver driver(nullptr, MIXER_OUTPUT_MANUAL, 2);
+        driver.startup();
+
+        std::vector<int16_t> pcm(1000, 8192);
+
+        auto sources = driver.generate_sources(4);
+        for(uint32_t i = 0; i < sources.size(); ++i) {
+            auto buffers = driver.generate_buffers(1);
+            driver.upload_buffer_data(buffers[0], AUDIO_DATA_FORMAT_MONO16, &pcm[0], pcm.size() * sizeof(int16_t), driver.sample_rate());
+            driver.queue_buffers_to_source(sources[i], 1, buffers);
+            driver.set_source_distance(sources[i], 10.0f * (i + 1));
+            driver.play_source(sources[i]);
+        }
+
+        std::vector<int16_t> out(200);
+        assert_equal(2u, driver.mix(&out[0], 100));
+        assert_equal(2u, driver.real_voice_count());
+        assert_equal(2u, driver.virtual_voice_count());
+        assert_true(out[0] > 0);
+
+        // Moving the furthest voice closest steals a slot
+        driver.set_source_distance(sources[3], 0.0f);
+        driver.mix(&out[0], 100);
+        assert_equal(1u, driver.stolen_voice_count());
+
+        // Virtual voices still run to the end and release their buffers
+        driver.mix(nullptr, 800);
+        for(auto source: sources) {
+            assert_equal(AUDIO_SOURCE_STATE_STOPPED, driver.source_state(source));
+            assert_equal(1, driver.source_buffers_processed_count(source));
+        }
+
+        assert_equal(0u, driver.mix(&out[0], 100));
+        assert_equal(0, out[0]);
+    }
+
+    void test_mixer_streams_to_the_device() {
+        using namespace smlt;
+
+        auto device = std::make_shared<FakeDevice>();
+
+        MixerSoundDriver driver(nullptr, device);
+        assert_true(driver.startup());
+
+        // The whole ring is queued on a single device source
+        assert_equal(1u, device->sources_generated);
+        assert_equal(MixerSoundDriver::DEVICE_OUTPUT_BUFFERS, device->queued.size());
+        assert_equal(MixerSoundDriver::DEVICE_OUTPUT_FRAMES * 2 * sizeof(int16_t), device->last_upload_size);
+        assert_true(device->playing);
+
+        driver.shutdown();
+        assert_false(device->started);
+        assert_true(device->queued.empty());
+    }
+
 private:
+    /* Records what the mixer asks of its output device */
+    struct FakeDevice : public smlt::SoundDriver {
+        FakeDevice():
+            smlt::SoundDriver(nullptr) {}
+
+        bool started = false;
+        bool playing = false;
+        uint32_t sources_generated = 0;
+        uint32_t last_upload_size = 0;
+        std::vector<smlt::AudioBufferID> queued;
+
+        bool startup() override { started = true; return true; }
+        void shutdown() override { started = false; }
+
+        std::vector<smlt::AudioSourceID> generate_sources(uint32_t count) override {
+            sources_generated += count;
+            return std::vector<smlt::AudioSourceID>(count, 1);
+        }
+
+        std::vector<smlt::AudioBufferID> generate_buffers(uint32_t count) override {
+            std::vector<smlt::AudioBufferID> buffers;
+            for(uint32_t i = 0; i < count; ++i) {
+                buffers.push_back(i + 1);
+            }
+            return buffers;
+        }
+
+        void delete_buffers(const std::vector<smlt::AudioBufferID>&) override {}
+        void delete_sources(const std::vector<smlt::AudioSourceID>&) override {}
+
+        void play_source(smlt::AudioSourceID) override { playing = true; }
+        void stop_source(smlt::AudioSourceID) override { playing = false; }
+
+        void queue_buffers_to_source(smlt::AudioSourceID, uint32_t count, const std::vector<smlt::AudioBufferID>& buffers) override {
+            queued.insert(queued.end(), buffers.begin(), buffers.begin() + count);
+        }
+
+        std::vector<smlt::AudioBufferID> unqueue_buffers_from_source(smlt::AudioSourceID source, uint32_t count) override {
+            count = std::min<uint32_t>(count, source_buffers_processed_count(source));
+            std::vector<smlt::AudioBufferID> buffers(queued.begin(), queued.begin() + count);
+            queued.erase(queued.begin(), queued.begin() + count);
+            return buffers;
+        }
+
+        void upload_buffer_data(smlt::AudioBufferID, smlt::AudioDataFormat, int16_t*, uint32_t size, uint32_t) override {
+            last_upload_size = size;
+        }
+
+        smlt::AudioSourceState source_state(smlt::AudioSourceID) override {
+            return (playing) ? smlt::AUDIO_SOURCE_STATE_PLAYING : smlt::AUDIO_SOURCE_STATE_STOPPED;
+        }
+
+        /* Nothing finishes while playing, everything has once stopped */
+        int32_t source_buffers_processed_count(smlt::AudioSourceID) const override {
+            return (playing) ? 0 : queued.size();
+        }
+    };
+
     smlt::CameraPtr camera_;
     smlt::StagePtr stage_;
 
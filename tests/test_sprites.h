@@ -1,9 +1,15 @@
 #pragma once
 
+#include <vector>
+#include <functional>
+
 #include "global.h"
+#include "../simulant/managers/sprite_manager.h"
 
 namespace {
 
+using namespace smlt;
+
 class SpriteTests : public SimulantTestCase {
 public:
     void test_set_alpha() {
@@ -14,6 +20,50 @@ public:
 
         assert_equal(sprite->alpha(), 0.5f);
     }
+
+    void test_batched_sprites_share_a_batch() {
+        auto stage = window->new_stage();
+        stage->sprites->set_batching_enabled();
+
+        auto texture = stage->assets->new_texture();
+        stage->assets->texture(texture)->resize(32, 32);
+
+        auto camera = stage->new_camera();
+        camera->set_perspective_projection(Degrees(45.0), 1.0, 0.1, 100.0);
+
+        std::vector<SpritePtr> sprites;
+        for(uint32_t i = 0; i < 10; ++i) {
+            auto sprite = stage->sprites->new_sprite_from_texture(texture, 8, 8);
+            sprite->move_to(i, 0, -50.0f - i);
+            sprites.push_back(sprite);
+        }
+
+        assert_true(sprites[0]->is_batched());
+        assert_true(sprites[0]->actor.get() == nullptr);
+        assert_equal(sprites[0]->material_id(), sprites[9]->material_id());
+
+        auto renderables = stage->sprites->_get_renderables(camera->frustum());
+        assert_equal(1u, renderables.size());
+        assert_equal(60u, renderables[0]->index_element_count());
+        assert_equal(1u, stage->sprites->batch_count());
+
+        // A different render priority can't share the batch
+        sprites[0]->set_render_priority(RENDER_PRIORITY_FOREGROUND);
+        renderables = stage->sprites->_get_renderables(camera->frustum());
+        assert_equal(2u, renderables.size());
+
+        // Sprites outside the frustum are culled
+        sprites[1]->move_to(0, 0, 50.0f);
+        renderables = stage->sprites->_get_renderables(camera->frustum());
+        assert_equal(54u, renderables[0]->index_element_count() + renderables[1]->index_element_count());
+    }
+
+    void test_batching_cant_change_with_sprites() {
+        auto stage = window->new_stage();
+        stage->sprites->new_sprite();
+
+        assert_raises(std::logic_error, std::bind(&SpriteManager::set_batching_enabled, stage->sprites.get(), true));
+    }
 };
 
 }
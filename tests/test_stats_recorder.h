@@ -0,0 +1,122 @@
+#pragma once
+
+#include <sstream>
+
+#include "global.h"
+#include "../simulant/stats_recorder.h"
+
+namespace {
+
+using namespace smlt;
+
+class StatsRecorderTests : public TestCase {
+public:
+    FrameTimings make_frame(uint64_t number, float ms) {
+        FrameTimings frame;
+        frame.frame_number = number;
+        frame.frame_ms = ms;
+        frame.phase_ms[FRAME_PHASE_RENDER] = ms * 0.5f;
+        return frame;
+    }
+
+    void test_percentiles() {
+        StatsRecorder stats;
+
+        // 1ms..100ms, shuffled order shouldn't matter
+        for(uint32_t i = 0; i < 100; ++i) {
+            stats.record_frame(make_frame(i, float(((i * 37) % 100) + 1)));
+        }
+
+        auto result = stats.frame_time_stats();
+        assert_equal(100u, result.samples);
+        assert_close(50.0f, result.p50, 0.001f);
+        assert_close(95.0f, result.p95, 0.001f);
+        assert_close(99.0f, result.p99, 0.001f);
+        assert_close(100.0f, result.max, 0.001f);
+        assert_close(50.5f, result.mean, 0.001f);
+
+        auto render = stats.phase_time_stats(FRAME_PHASE_RENDER);
+        assert_close(50.0f, render.max, 0.001f);
+    }
+
+    void test_history_is_rolling() {
+        StatsRecorder stats;
+        stats.set_frame_history_size(10);
+
+        for(uint32_t i = 0; i < 20; ++i) {
+            stats.record_frame(make_frame(i, float(i)));
+        }
+
+        assert_equal(10u, stats.frame_history().size());
+        assert_equal(10u, stats.frame_history().front().frame_number);
+        assert_close(14.0f, stats.frame_time_stats().p50, 0.001f);
+    }
+
+    void test_hitches_are_attributed() {
+        StatsRecorder stats;
+        stats.set_hitch_threshold_ms(20.0f);
+
+        stats.record_frame(make_frame(0, 16.0f));
+
+        auto gc_frame = make_frame(1, 40.0f);
+        gc_frame.phase_ms[FRAME_PHASE_RENDER] = 5.0f;
+        gc_frame.phase_ms[FRAME_PHASE_GARBAGE_COLLECTION] = 30.0f;
+        gc_frame.objects_collected = 12;
+        stats.record_frame(gc_frame);
+
+        auto upload_frame = make_frame(2, 50.0f);
+        upload_frame.textures_uploaded = 1;
+        upload_frame.texture_bytes_uploaded = 1024 * 1024;
+        stats.record_frame(upload_frame);
+
+        assert_equal(2u, stats.hitch_count());
+        assert_equal(1u, stats.hitch_count(FRAME_PHASE_GARBAGE_COLLECTION));
+        assert_equal(1u, stats.hitch_count(FRAME_PHASE_RENDER));
+
+        auto& hitches = stats.recent_hitches();
+        assert_equal(2u, hitches.size());
+        assert_true(hitches[0].caused_by_garbage_collection());
+        assert_false(hitches[0].caused_by_texture_upload());
+        assert_true(hitches[1].caused_by_texture_upload());
+    }
+
+    void test_histogram() {
+        StatsRecorder stats;
+        stats.record_frame(make_frame(0, 1.0f));
+        stats.record_frame(make_frame(1, 5.5f));
+        stats.record_frame(make_frame(2, 6.0f));
+        stats.record_frame(make_frame(3, 500.0f));
+
+        auto histogram = stats.frame_time_histogram(5.0f, 4);
+        assert_equal(4u, histogram.size());
+        assert_equal(1u, histogram[0]);
+        assert_equal(2u, histogram[1]);
+        assert_equal(0u, histogram[2]);
+        assert_equal(1u, histogram[3]);
+    }
+
+    void test_csv_and_json_output() {
+        StatsRecorder stats;
+        stats.set_hitch_threshold_ms(10.0f);
+        stats.record_frame(make_frame(0, 16.0f));
+
+        std::stringstream csv;
+        stats.write_frame_history_csv(csv);
+
+        std::string header;
+        std::getline(csv, header);
+        assert_true(header.find("frame,frame_ms,events_ms") == 0);
+
+        std::string row;
+        std::getline(csv, row);
+        assert_true(row.find("0,16.000") == 0);
+
+        std::stringstream json;
+        stats.write_frame_stats_json(json);
+        assert_true(json.str().find("\"hitch_count\":1") != std::string::npos);
+        assert_true(json.str().find("\"p99\":16.000") != std::string::npos);
+        assert_true(json.str().find("\"worst_phase\":\"render\"") != std::string::npos);
+    }
+};
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+#include "global.h"
+#include "../simulant/utils/terrain_kernels.h"
+
+namespace {
+
+using namespace smlt;
+
+class TerrainKernelTests : public TestCase {
+public:
+    void test_smooth_heights_averages_neighbours() {
+        std::vector<float> heights = {
+            0, 0, 0, 0,
+            0, 9, 0, 0,
+            0, 0, 0, 0
+        };
+
+        terrain::smooth_heights(&heights[0], 4, 3, 1);
+
+        // Interior points average all 9, corners and edges only what's available
+        assert_close(1.0f, heights[(1 * 4) + 1], 0.0001f);
+        assert_close(9.0f / 4.0f, heights[0], 0.0001f);
+        assert_close(9.0f / 6.0f, heights[1], 0.0001f);
+        assert_close(0.0f, heights[3], 0.0001f);
+    }
+
+    void test_smooth_heights_preserves_flat_terrain() {
+        std::vector<float> heights(37 * 23, 5.0f);
+
+        terrain::smooth_heights(&heights[0], 37, 23, 10);
+
+        for(auto h: heights) {
+            assert_close(5.0f, h, 0.0001f);
+        }
+    }
+
+    void test_normals_of_slope() {
+        const uint32_t size = 9;
+        std::vector<float> heights(size * size);
+
+        // Rises by one unit for each unit along X
+        for(uint32_t z = 0; z < size; ++z) {
+            for(uint32_t x = 0; x < size; ++x) {
+                heights[(z * size) + x] = float(x);
+            }
+        }
+
+        std::vector<Vec3> normals(size * size);
+        terrain::calculate_normals(&heights[0], size, size, 1.0f, &normals[0]);
+
+        Vec3 expected = Vec3(-1, 1, 0).normalized();
+        for(auto& n: normals) {
+            assert_close(expected.x, n.x, 0.0001f);
+            assert_close(expected.y, n.y, 0.0001f);
+            assert_close(expected.z, n.z, 0.0001f);
+        }
+    }
+
+    void test_occlusion_darkens_valleys() {
+        const uint32_t size = 5;
+        std::vector<float> heights(size * size, 0.0f);
+
+        // A pit in the middle of flat ground
+        heights[(2 * size) + 2] = -4.0f;
+
+        std::vector<Vec3> normals(size * size);
+        terrain::calculate_normals(&heights[0], size, size, 1.0f, &normals[0]);
+
+        std::vector<float> occlusion(size * size);
+        terrain::calculate_occlusion(&heights[0], &normals[0], size, size, 1.0f, &occlusion[0]);
+
+        // Flat ground away from the pit is completely open
+        assert_close(1.0f, occlusion[0], 0.0001f);
+
+        // The bottom of the pit is surrounded by higher ground
+        assert_true(occlusion[(2 * size) + 2] < 0.5f);
+    }
+
+    void test_fast_acos() {
+        for(float x = -1.0f; x <= 1.0f; x += 0.01f) {
+            assert_close(std::acos(x), terrain::fast_acos(x), 0.0001f);
+        }
+    }
+};
+
+}
@@ -19,6 +19,29 @@ public:
         assert_true(tex->try_lock());
     }
 
+    void test_dirty_regions() {
+        auto tex = window->shared_assets->new_texture().fetch();
+        tex->resize(64, 64);
+
+        // A full upload is pending, so regions aren't tracked
+        TextureRegion region;
+        region.width = region.height = 8;
+        tex->mark_data_changed(region);
+        assert_true(tex->_dirty_regions().empty());
+
+        tex->_set_data_clean();
+        tex->mark_data_changed(region);
+        region.x = 16;
+        tex->mark_data_changed(region);
+
+        assert_true(tex->_data_dirty());
+        assert_equal(2u, tex->_dirty_regions().size());
+
+        // A full change replaces the regions
+        tex->mark_data_changed();
+        assert_true(tex->_dirty_regions().empty());
+    }
+
     void test_conversion_from_r8_to_rgba4444() {
         auto tex = window->shared_assets->new_texture().fetch();
 
@@ -53,6 +76,143 @@ public:
         uint16_t* third_pixel = (uint16_t*) &data[4];
         assert_equal(*third_pixel, expected3);
     }
+
+    void test_conversion_between_formats() {
+        auto tex = window->shared_assets->new_texture().fetch();
+
+        tex->set_format(TEXTURE_FORMAT_RGBA8888);
+        tex->resize(5, 1);
+
+        auto& data = tex->data();
+        for(uint32_t i = 0; i < data.size(); ++i) {
+            data[i] = (i * 37) % 256;
+        }
+
+        auto original = data;
+
+        // 4444 and 5551 expand back to the values they were packed from
+        tex->convert(TEXTURE_FORMAT_RGBA4444);
+        tex->convert(TEXTURE_FORMAT_RGBA8888);
+        auto expanded = data;
+        tex->convert(TEXTURE_FORMAT_RGBA4444);
+        tex->convert(TEXTURE_FORMAT_RGBA8888);
+        assert_true(expanded == data);
+
+        tex->data() = original;
+        tex->convert(TEXTURE_FORMAT_RGB888);
+        assert_equal(15u, data.size());
+        assert_equal(original[4], data[3]);
+        assert_equal(original[6], data[5]);
+
+        // Converting to the same format swizzles
+        tex->convert(
+            TEXTURE_FORMAT_RGB888,
+            {{TEXTURE_CHANNEL_BLUE, TEXTURE_CHANNEL_GREEN, TEXTURE_CHANNEL_RED, TEXTURE_CHANNEL_ONE}}
+        );
+        assert_equal(original[2], data[0]);
+        assert_equal(original[1], data[1]);
+        assert_equal(original[0], data[2]);
+    }
+
+    void test_flip_vertically() {
+        auto tex = window->shared_assets->new_texture().fetch();
+
+        tex->set_format(TEXTURE_FORMAT_RGBA4444);
+        tex->resize(1, 3);
+
+        uint16_t* texels = (uint16_t*) &tex->data()[0];
+        texels[0] = 1;
+        texels[1] = 2;
+        texels[2] = 3;
+
+        tex->flip_vertically();
+
+        texels = (uint16_t*) &tex->data()[0];
+        assert_equal(3, texels[0]);
+        assert_equal(2, texels[1]);
+        assert_equal(1, texels[2]);
+    }
+
+    void test_premultiply_alpha() {
+        auto tex = window->shared_assets->new_texture().fetch();
+
+        tex->set_format(TEXTURE_FORMAT_RGBA8888);
+        tex->resize(5, 1);
+
+        auto& data = tex->data();
+        for(uint32_t i = 0; i < 5; ++i) {
+            data[i * 4 + 0] = 255;
+            data[i * 4 + 1] = 128;
+            data[i * 4 + 2] = 0;
+            data[i * 4 + 3] = i * 60;
+        }
+
+        tex->premultiply_alpha();
+
+        assert_equal(0, data[0]);
+        assert_equal(120, data[8]);
+        assert_equal(60, data[9]);
+        assert_equal(0, data[10]);
+        assert_equal(120, data[11]);
+        assert_equal(240, data[16]);
+
+        tex->convert(TEXTURE_FORMAT_RGBA4444);
+        assert_raises(std::logic_error, std::bind(&Texture::premultiply_alpha, tex.get()));
+    }
+
+    void test_generate_mipmaps() {
+        auto tex = window->shared_assets->new_texture().fetch();
+
+        tex->set_format(TEXTURE_FORMAT_RGBA8888);
+        tex->resize(4, 2);
+
+        auto& data = tex->data();
+        for(uint32_t i = 0; i < data.size(); ++i) {
+            data[i] = (i % 8 < 4) ? 0 : 200;
+        }
+
+        tex->generate_mipmaps();
+
+        // 2x1 then 1x1
+        assert_equal(2u, tex->mipmap_count());
+        assert_equal(8u, tex->mipmap_data(1).size());
+        assert_equal(4u, tex->mipmap_data(2).size());
+
+        assert_equal(100, tex->mipmap_data(1)[0]);
+        assert_equal(100, tex->mipmap_data(2)[3]);
+        assert_equal(tex->memory_usage(), 32u + 8u + 4u);
+
+        tex->generate_mipmaps(MIPMAP_FILTER_KAISER);
+        assert_equal(2u, tex->mipmap_count());
+
+        // Changing the data layout throws them away
+        tex->resize(8, 8);
+        assert_equal(0u, tex->mipmap_count());
+    }
+
+    void test_rebuild_mipmaps_after_a_region_changes() {
+        auto tex = window->shared_assets->new_texture().fetch();
+
+        tex->set_format(TEXTURE_FORMAT_RGBA8888);
+        tex->resize(2, 2);
+        tex->generate_mipmaps();
+        tex->_set_data_clean();
+
+        assert_equal(0, tex->mipmap_data(1)[0]);
+
+        // One texel changes, the renderer only uploads that region
+        auto& data = tex->data();
+        data[0] = data[1] = data[2] = data[3] = 200;
+
+        TextureRegion region;
+        region.width = region.height = 1;
+        tex->mark_data_changed(region);
+
+        tex->_rebuild_mipmaps();
+        assert_equal(1u, tex->mipmap_count());
+        assert_equal(50, tex->mipmap_data(1)[0]);
+        assert_equal(1u, tex->_dirty_regions().size());
+    }
 };
 
 
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "global.h"
+#include "simulant/renderers/renderer.h"
+
+namespace {
+
+using namespace smlt;
+
+/* Records what would be uploaded instead of talking to the GPU */
+class RecordingRenderer : public Renderer {
+public:
+    const static int32_t FULL_UPLOAD = -1;
+
+    struct Upload {
+        TextureID texture;
+        int32_t first_level;
+    };
+
+    RecordingRenderer(Window* window):
+        Renderer(window) {}
+
+    std::shared_ptr<batcher::RenderQueueVisitor> get_render_queue_visitor(CameraPtr camera) override {
+        return std::shared_ptr<batcher::RenderQueueVisitor>();
+    }
+
+    void init_context() override {}
+
+    std::string name() const override {
+        return "recording";
+    }
+
+    HardwareBufferManager* _get_buffer_manager() const override {
+        return nullptr;
+    }
+
+    batcher::RenderGroup new_render_group(Renderable* renderable, MaterialPass* material_pass) override {
+        throw std::logic_error("The recording renderer can't render");
+    }
+
+    std::vector<Upload> uploads;
+
+private:
+    void on_texture_prepare(TexturePtr texture) override {
+        if(texture->_data_dirty()) {
+            uploads.push_back({texture->id(), FULL_UPLOAD});
+            texture->_set_data_clean();
+        }
+
+        texture->_set_params_clean();
+    }
+
+    void on_texture_stream(TexturePtr texture, uint32_t first_level) override {
+        uploads.push_back({texture->id(), int32_t(first_level)});
+    }
+};
+
+class TextureStreamingTests : public SimulantTestCase {
+public:
+    void set_up() {
+        SimulantTestCase::set_up();
+        renderer_.reset(new RecordingRenderer(window.get()));
+    }
+
+    void tear_down() {
+        for(auto& texture: textures_) {
+            renderer_->unregister_texture(texture->id());
+        }
+
+        textures_.clear();
+        renderer_.reset();
+
+        SimulantTestCase::tear_down();
+    }
+
+    TexturePtr make_texture(uint32_t size, bool streamed=false) {
+        auto texture = window->shared_assets->new_texture().fetch();
+        texture->set_format(TEXTURE_FORMAT_RGBA8888);
+        texture->resize(size, size);
+        texture->set_streaming_enabled(streamed);
+
+        renderer_->register_texture(texture->id(), texture);
+        textures_.push_back(texture);
+        return texture;
+    }
+
+    void run_frame() {
+        renderer_->begin_frame();
+        renderer_->begin_render();
+        for(auto& texture: textures_) {
+            renderer_->prepare_texture(texture->id());
+        }
+    }
+
+    void test_uploads_are_spread_over_frames() {
+        auto streamer = renderer_->texture_streamer();
+        streamer->set_upload_budget(40 * 1024);
+
+        // 16K each, so only two fit in a frame
+        make_texture(64);
+        make_texture(64);
+        make_texture(64);
+
+        run_frame();
+        assert_equal(2u, renderer_->uploads.size());
+        assert_equal(1u, streamer->deferred_count());
+
+        run_frame();
+        assert_equal(3u, renderer_->uploads.size());
+        assert_equal(0u, streamer->deferred_count());
+
+        // Nothing changed, nothing to upload
+        run_frame();
+        assert_equal(3u, renderer_->uploads.size());
+    }
+
+    void test_oversized_uploads_still_happen() {
+        auto streamer = renderer_->texture_streamer();
+        streamer->set_upload_budget(1024);
+
+        make_texture(64);
+        make_texture(64);
+
+        // Each is bigger than the budget, so one per frame
+        run_frame();
+        assert_equal(1u, renderer_->uploads.size());
+
+        run_frame();
+        assert_equal(2u, renderer_->uploads.size());
+    }
+
+    void test_streamed_textures_start_small() {
+        auto streamer = renderer_->texture_streamer();
+        streamer->set_initial_size(64);
+
+        auto texture = make_texture(512, true);
+
+        run_frame();
+
+        // 512 -> 256 -> 128 -> 64
+        assert_equal(1u, renderer_->uploads.size());
+        assert_equal(3, renderer_->uploads[0].first_level);
+        assert_equal(3u, streamer->resident_level(texture->id()));
+        assert_equal(9u, texture->mipmap_count());
+
+        // Not drawn, so nothing more is loaded
+        run_frame();
+        assert_equal(1u, renderer_->uploads.size());
+
+        // Drawn at 200 pixels wants the 256 level, one level per frame
+        for(uint32_t i = 0; i < 4; ++i) {
+            streamer->note_use(texture->id(), 200.0f);
+            run_frame();
+        }
+
+        assert_equal(1u, streamer->wanted_level(texture->id()));
+        assert_equal(1u, streamer->resident_level(texture->id()));
+        assert_equal(3u, renderer_->uploads.size());
+        assert_equal(1, renderer_->uploads.back().first_level);
+
+        // The data is kept to stream from
+        assert_false(texture->data().empty());
+    }
+
+    void test_streamed_textures_are_evicted_under_the_cap() {
+        auto streamer = renderer_->texture_streamer();
+        streamer->set_initial_size(256);
+        streamer->set_memory_cap(400 * 1024);
+
+        auto near = make_texture(256, true);
+        auto far = make_texture(256, true);
+
+        // Both start fully resident, which is over the cap
+        run_frame();
+        assert_equal(0u, streamer->resident_level(near->id()));
+        assert_equal(0u, streamer->resident_level(far->id()));
+        assert_true(streamer->resident_bytes() > streamer->memory_cap());
+
+        // Only the near one is drawn, so the far one makes room. That's
+        // decided at the start of the frame but uploaded with the context.
+        streamer->note_use(near->id(), 256.0f);
+
+        auto uploads = renderer_->uploads.size();
+        renderer_->begin_frame();
+        assert_equal(uploads, renderer_->uploads.size());
+        assert_equal(0u, streamer->resident_level(far->id()));
+
+        renderer_->begin_render();
+        assert_equal(uploads + 1, renderer_->uploads.size());
+
+        assert_equal(0u, streamer->resident_level(near->id()));
+        assert_equal(2u, streamer->resident_level(far->id()));
+        assert_true(streamer->resident_bytes() <= streamer->memory_cap());
+
+        // Drawing it again doesn't push it back over the cap
+        streamer->note_use(near->id(), 256.0f);
+        streamer->note_use(far->id(), 256.0f);
+        run_frame();
+        run_frame();
+
+        assert_equal(2u, streamer->resident_level(far->id()));
+        assert_true(streamer->resident_bytes() <= streamer->memory_cap());
+
+        // Unregistering releases what it held
+        renderer_->unregister_texture(far->id());
+        assert_equal(349524u, streamer->resident_bytes());
+    }
+
+private:
+    std::unique_ptr<RecordingRenderer> renderer_;
+    std::vector<TexturePtr> textures_;
+};
+
+}
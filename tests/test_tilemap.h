@@ -0,0 +1,140 @@
+#pragma once
+
+#include "global.h"
+#include "../simulant/managers/tilemap_manager.h"
+
+namespace {
+
+using namespace smlt;
+
+class TilemapTests : public SimulantTestCase {
+public:
+    void set_up() {
+        SimulantTestCase::set_up();
+
+        stage_ = window->new_stage();
+
+        texture_ = stage_->assets->new_texture();
+        stage_->assets->texture(texture_)->resize(64, 64);
+    }
+
+    void tear_down() {
+        SimulantTestCase::tear_down();
+        window->delete_stage(stage_->id());
+    }
+
+    void test_tilesets_share_tile_indexes() {
+        auto tilemap = stage_->tilemaps->new_tilemap();
+
+        assert_equal(1, tilemap->add_tileset(texture_, 16, 16));
+        assert_equal(17, tilemap->add_tileset(texture_, 32, 32));
+        assert_equal(4u, tilemap->tileset(1).tile_count);
+    }
+
+    void test_layers_are_chunked() {
+        auto tilemap = stage_->tilemaps->new_tilemap();
+        tilemap->set_chunk_size(8);
+
+        auto ground = tilemap->new_layer("ground", 20, 10);
+        auto detail = tilemap->new_layer("detail", 8, 8);
+
+        assert_equal(0, tilemap->find_layer("ground"));
+        assert_equal(1, tilemap->find_layer("detail"));
+        assert_equal(-1, tilemap->find_layer("sky"));
+
+        assert_equal(20u, tilemap->layer_width(ground));
+        assert_equal(8u, tilemap->layer_height(detail));
+
+        // 3x2 chunks, plus a single chunk
+        assert_equal(7u, tilemap->chunk_count());
+
+        // Can't change the chunk size once there are layers
+        assert_raises(std::logic_error, std::bind(&Tilemap::set_chunk_size, tilemap, 16));
+        assert_raises(std::out_of_range, std::bind(&Tilemap::set_tile, tilemap, ground, 20, 0, 1));
+    }
+
+    void test_chunks_are_rebuilt_when_dirty() {
+        auto tilemap = stage_->tilemaps->new_tilemap();
+        tilemap->set_chunk_size(8);
+
+        auto first = tilemap->add_tileset(texture_, 16, 16);
+        auto layer = tilemap->new_layer("ground", 16, 16);
+
+        assert_equal(0u, tilemap->dirty_chunk_count());
+
+        tilemap->set_tile(layer, 0, 0, first);
+        tilemap->set_tile(layer, 1, 0, first + 1);
+        tilemap->set_tile(layer, 9, 9, first + 2);
+
+        assert_equal(first + 1, tilemap->tile(layer, 1, 0));
+        assert_equal(2u, tilemap->dirty_chunk_count());
+        assert_equal(0u, tilemap->built_chunk_count());
+
+        assert_equal(2u, tilemap->rebuild_dirty_chunks());
+        assert_equal(0u, tilemap->dirty_chunk_count());
+        assert_equal(2u, tilemap->built_chunk_count());
+
+        // Setting the same tile doesn't dirty anything
+        tilemap->set_tile(layer, 0, 0, first);
+        assert_equal(0u, tilemap->dirty_chunk_count());
+
+        // Emptying a chunk removes its actor
+        tilemap->set_tile(layer, 9, 9, 0);
+        assert_equal(1u, tilemap->rebuild_dirty_chunks());
+        assert_equal(1u, tilemap->built_chunk_count());
+    }
+
+    void test_chunk_meshes_are_sized_to_their_tiles() {
+        auto tilemap = stage_->tilemaps->new_tilemap();
+        tilemap->set_chunk_size(8);
+
+        auto first = tilemap->add_tileset(texture_, 16, 16);
+        auto second = tilemap->add_tileset(texture_, 32, 32);
+        auto layer = tilemap->new_layer("ground", 8, 8);
+
+        tilemap->set_tile(layer, 0, 0, first);
+        tilemap->set_tile(layer, 7, 0, first);
+        tilemap->set_tile(layer, 3, 5, first + 3);
+        tilemap->set_tile(layer, 7, 7, second);
+
+        ActorID chunk_actor;
+        auto conn = stage_->signal_actor_created().connect([&](const ActorID& id) {
+            chunk_actor = id;
+        });
+
+        tilemap->rebuild_dirty_chunks();
+        conn.disconnect();
+
+        assert_true(chunk_actor);
+
+        // One quad per tile, not per grid corner
+        auto mesh = stage_->actor(chunk_actor)->mesh();
+        assert_equal(16u, mesh->vertex_data->count());
+        assert_equal(2u, mesh->submesh_count());
+        assert_equal(18u, mesh->submesh("tileset 0")->index_data->count());
+        assert_equal(6u, mesh->submesh("tileset 1")->index_data->count());
+    }
+
+    void test_destroying_a_tilemap_removes_chunks() {
+        auto tilemap = stage_->tilemaps->new_tilemap();
+
+        auto first = tilemap->add_tileset(texture_, 16, 16);
+        auto layer = tilemap->new_layer("ground", 4, 4);
+        tilemap->set_tile(layer, 0, 0, first);
+        tilemap->rebuild_dirty_chunks();
+
+        auto actors = stage_->actor_count();
+        assert_true(actors > 0);
+
+        stage_->tilemaps->delete_tilemap(tilemap->id());
+
+        assert_equal(0u, stage_->tilemaps->tilemap_count());
+        assert_equal(actors - 1, stage_->actor_count());
+    }
+
+private:
+    StagePtr stage_;
+    TextureID texture_;
+};
+
+}
@@ -47,6 +47,61 @@ public:
         assert_is_null((ui::Widget*) widget1->focused_in_chain());
     }
 
+    void test_layout_is_deferred() {
+        auto label = stage_->ui->new_widget_as_label("label");
+        assert_true(label->is_layout_dirty());
+
+        // Reading the size lays out the widget
+        float width = label->content_width();
+        assert_false(label->is_layout_dirty());
+
+        label->set_text("a longer label");
+        assert_true(label->is_layout_dirty());
+        assert_true(label->content_width() > width);
+    }
+
+    void test_widgets_share_batches() {
+        auto label1 = stage_->ui->new_widget_as_label("one");
+        auto label2 = stage_->ui->new_widget_as_label("two");
+        label2->move_to(0, 200, 0);
+
+        // Two ranges (rectangles and text) for each label
+        assert_equal(4u, stage_->ui->_sync_batches());
+        assert_equal(2u, stage_->ui->batch_count());
+        assert_equal(0u, stage_->ui->_sync_batches());
+
+        // Only the changed label is rewritten
+        label1->set_text("uno");
+        assert_equal(2u, stage_->ui->_sync_batches());
+
+        label2->move_to(10, 200, 0);
+        assert_equal(2u, stage_->ui->_sync_batches());
+
+        // Removing a label repacks the batches with what's left
+        stage_->ui->delete_widget(label1->id());
+        assert_equal(2u, stage_->ui->_sync_batches());
+        assert_equal(2u, stage_->ui->batch_count());
+    }
+
+    void test_overlapping_widgets_keep_their_order() {
+        auto label1 = stage_->ui->new_widget_as_label("one");
+        auto label2 = stage_->ui->new_widget_as_label("two");
+
+        // The second label's rectangles are drawn over the first one's text
+        stage_->ui->_sync_batches();
+        assert_equal(4u, stage_->ui->batch_count());
+
+        // Once they're apart they share batches again
+        label2->move_to(0, 200, 0);
+        stage_->ui->_sync_batches();
+        assert_equal(2u, stage_->ui->batch_count());
+
+        // Bringing one forward reorders them
+        label2->move_to(0, 0, 1);
+        stage_->ui->_sync_batches();
+        assert_equal(4u, stage_->ui->batch_count());
+    }
+
 private:
     StagePtr stage_;
 };
@@ -64,6 +119,63 @@ public:
         SimulantTestCase::tear_down();
     }
 
+    void test_text_layouts_are_cached() {
+        auto font = stage_->assets->font(stage_->assets->default_font_id());
+
+        ui::TextLayoutCache cache;
+        auto first = cache.layout(font.get(), "Hello World", 0, 20);
+        auto second = cache.layout(font.get(), "Hello World", 0, 20);
+
+        assert_true(first == second);
+        assert_equal(1u, cache.hits());
+        assert_equal(1u, first->lines().size());
+        assert_equal(11u, first->glyphs().size());
+
+        // The second word doesn't fit, so moves to the next line
+        auto wrapped = cache.layout(font.get(), "Hello World", first->width() * 0.75f, 20);
+        assert_equal(2u, wrapped->lines().size());
+        assert_equal(6u, wrapped->lines()[1].first_glyph);
+        assert_true(wrapped->height() > first->height());
+
+        auto lines = cache.layout(font.get(), "Hello\nWorld", 0, 20);
+        assert_equal(2u, lines->lines().size());
+        assert_equal(10u, lines->glyphs().size());
+
+        cache.set_capacity(2);
+        assert_equal(2u, cache.size());
+
+        // Labels with the same text share a layout
+        stage_->ui->new_widget_as_label("Same")->content_width();
+        auto misses = stage_->ui->_text_layouts()->misses();
+        stage_->ui->new_widget_as_label("Same")->content_width();
+        assert_equal(misses, stage_->ui->_text_layouts()->misses());
+    }
+
+    void test_glyphs_are_rasterised_on_demand() {
+        auto font = stage_->assets->font(stage_->assets->new_font_from_ttf("sample.ttf", 64));
+
+        auto glyphs = font->glyph_count();
+        assert_true(font->page_count() >= 1u);
+
+        // Printable ASCII is rasterised up front
+        font->character_page(U'A');
+        assert_equal(glyphs, font->glyph_count());
+
+        font->character_page(U'\u00e9');
+        assert_equal(glyphs + 1, font->glyph_count());
+
+        // Filling the pages evicts one, which invalidates laid out text
+        font->set_max_pages(font->page_count());
+        auto pages = font->page_count();
+        auto revision = font->atlas_revision();
+        for(char32_t ch = 0x100; ch < 0x800 && font->atlas_revision() == revision; ++ch) {
+            font->character_page(ch);
+        }
+
+        assert_equal(pages, font->page_count());
+        assert_true(font->atlas_revision() > revision);
+    }
+
     void test_image_creation() {
         auto texture = stage_->assets->new_texture_from_file("../assets/textures/simulant-icon.png").fetch();
         auto image = stage_->ui->new_widget_as_image(texture->id());